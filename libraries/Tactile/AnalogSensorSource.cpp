@@ -0,0 +1,61 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include <Arduino.h>
+#include "AnalogSensorSource.h"
+
+AnalogSensorSource::AnalogSensorSource() {
+  _adc = NULL;
+}
+
+void AnalogSensorSource::begin() {
+  _adc = new ADC();
+
+  // 10 bits, same as the Arduino analogRead() default. A little hardware
+  // averaging takes the edge off the noise without costing much time.
+  _adc->adc0->setResolution(10);
+  _adc->adc0->setAveraging(4);
+  _adc->adc0->setConversionSpeed(ADC_CONVERSION_SPEED::HIGH_SPEED);
+  _adc->adc0->setSamplingSpeed(ADC_SAMPLING_SPEED::HIGH_SPEED);
+  _adc->adc1->setResolution(10);
+  _adc->adc1->setAveraging(4);
+  _adc->adc1->setConversionSpeed(ADC_CONVERSION_SPEED::HIGH_SPEED);
+  _adc->adc1->setSamplingSpeed(ADC_SAMPLING_SPEED::HIGH_SPEED);
+}
+
+uint16_t AnalogSensorSource::fullScale() {
+  return 1024;
+}
+
+// Called from the sampling interrupt. Channels 0/1 and 2/3 are each
+// converted simultaneously on ADC0 and ADC1.
+
+void AnalogSensorSource::read(uint16_t values[]) {
+  int channel = 0;
+  for (; channel + 1 < NUM_CHANNELS; channel += 2) {
+    ADC::Sync_result r = _adc->analogSynchronizedRead(_channelToPinNumber[channel],
+                                                      _channelToPinNumber[channel+1]);
+    values[channel]   = (uint16_t)r.result_adc0;
+    values[channel+1] = (uint16_t)r.result_adc1;
+  }
+  if (channel < NUM_CHANNELS)
+    values[channel] = (uint16_t)_adc->adc0->analogRead(_channelToPinNumber[channel]);
+}
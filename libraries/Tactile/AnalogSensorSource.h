@@ -0,0 +1,55 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * The standard sensor source: each Gemma-M0 capacitive sensor board
+ * produces a voltage that is read by one of the Teensy's analog pins.
+ *
+ * The Teensy 4.1 has two ADCs, and pins A14-A17 are connected to both of
+ * them. So channels are read in pairs, one channel on each ADC at the same
+ * time, which halves the time spent in the sampling interrupt.
+ *
+ * Uses the ADC library (by Pedro Villanueva) that is included with
+ * Teensyduino.
+ ----------------------------------------------------------------------*/
+
+#ifndef AnalogSensorSource_h
+#define AnalogSensorSource_h 1
+
+#include <ADC.h>
+#include "SensorSource.h"
+
+class AnalogSensorSource : public SensorSource
+{
+ public:
+  AnalogSensorSource();
+
+  void     begin();
+  uint16_t fullScale();
+  void     read(uint16_t values[]);
+
+ private:
+  const int _channelToPinNumber[NUM_CHANNELS] = {A14, A15, A16, A17};
+
+  ADC *_adc;
+};
+
+#endif
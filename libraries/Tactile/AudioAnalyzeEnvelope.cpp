@@ -0,0 +1,40 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include "AudioAnalyzeEnvelope.h"
+
+void AudioAnalyzeEnvelope::update(void) {
+  for (int input = 0; input < 2; input++) {
+    audio_block_t *block = receiveReadOnly(input);
+    if (block) {
+      _follower[input].processBlock(block->data, AUDIO_BLOCK_SAMPLES);
+      release(block);
+    } else {
+      _follower[input].processBlock(NULL, 0);     // no data == silence
+    }
+  }
+}
+
+EnvelopeFollower *AudioAnalyzeEnvelope::getFollower(int input) {
+  if (input < 0 || input > 1)
+    return NULL;
+  return &_follower[input];
+}
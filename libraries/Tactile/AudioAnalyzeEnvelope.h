@@ -0,0 +1,49 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * A Teensy audio library object that runs an EnvelopeFollower on each of
+ * its two inputs (normally left and right of an AudioInputI2S). It runs
+ * in the audio library's update(), once per 128-sample block, so the
+ * envelope is never more than one block (about 3 msec) old.
+ ----------------------------------------------------------------------*/
+
+#ifndef AudioAnalyzeEnvelope_h
+#define AudioAnalyzeEnvelope_h 1
+
+#include <Arduino.h>
+#include <Audio.h>
+#include "EnvelopeFollower.h"
+
+class AudioAnalyzeEnvelope : public AudioStream
+{
+ public:
+  AudioAnalyzeEnvelope() : AudioStream(2, _inputQueueArray) {}
+
+  virtual void update(void);
+  EnvelopeFollower *getFollower(int input);
+
+ private:
+  audio_block_t   *_inputQueueArray[2];
+  EnvelopeFollower _follower[2];
+};
+
+#endif
@@ -0,0 +1,95 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+#include <math.h>
+#include "AudioEffectLimiter.h"
+
+// While limiting, the delay line keeps going through silence, so the
+// end of a sound comes out; missing inputs get a block of their own.
+
+void AudioEffectLimiter::update(void) {
+  if (!_limiting) {
+    audio_block_t *left  = receiveReadOnly(0);
+    audio_block_t *right = receiveReadOnly(1);
+    _limiter.measure(left ? left->data : NULL, right ? right->data : NULL, AUDIO_BLOCK_SAMPLES);
+    if (left) {
+      transmit(left, 0);
+      release(left);
+    }
+    if (right) {
+      transmit(right, 1);
+      release(right);
+    }
+    return;
+  }
+
+  audio_block_t *left  = receiveWritable(0);
+  audio_block_t *right = receiveWritable(1);
+  bool haveLeft  = left != NULL;
+  bool haveRight = right != NULL;
+  if (!left)
+    left = allocate();
+  if (!right)
+    right = allocate();
+  if (left && right) {
+    _limiter.process(haveLeft ? left->data : NULL, haveRight ? right->data : NULL,
+                     left->data, right->data, AUDIO_BLOCK_SAMPLES);
+    transmit(left, 0);
+    transmit(right, 1);
+  }
+  if (left)
+    release(left);
+  if (right)
+    release(right);
+}
+
+void AudioEffectLimiter::setLimiting(bool on) {
+  AudioNoInterrupts();
+  if (on && !_limiting)
+    _limiter.reset();
+  _limiting = on;
+  AudioInterrupts();
+}
+
+void AudioEffectLimiter::setThreshold(float dbfs) {
+  if (dbfs > 0.0)
+    dbfs = 0.0;
+  int32_t peak = (int32_t)(32767.0 * powf(10.0, dbfs / 20.0) + 0.5);
+  AudioNoInterrupts();
+  _limiter.setThreshold(peak);
+  AudioInterrupts();
+}
+
+void AudioEffectLimiter::setMakeupShift(int shift) {
+  AudioNoInterrupts();
+  _limiter.setMakeupShift(shift);
+  AudioInterrupts();
+}
+
+float AudioEffectLimiter::takeGainReduction() {
+  AudioNoInterrupts();
+  int32_t gain = _limiter.takeMinGain();
+  AudioInterrupts();
+  if (gain <= 0)
+    return 96.0;
+  return -20.0 * log10f((float)gain / LIMITER_UNITY);
+}
@@ -0,0 +1,56 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+/*----------------------------------------------------------------------
+ * A Teensy audio library object for the master bus, between the mixers
+ * and the output: inputs and outputs 0 and 1 are left and right. With
+ * setLimiting(true) it runs a PeakLimiter on them (about 1.5 msec late);
+ * otherwise it passes them straight through, and only meters what a
+ * limiter after it (the SGTL5000's) would be doing.
+ ----------------------------------------------------------------------*/
+
+#ifndef AudioEffectLimiter_h
+#define AudioEffectLimiter_h 1
+
+#include <Arduino.h>
+#include <Audio.h>
+#include "PeakLimiter.h"
+
+class AudioEffectLimiter : public AudioStream
+{
+ public:
+  AudioEffectLimiter() : AudioStream(2, _inputQueueArray), _limiter(AUDIO_SAMPLE_RATE_EXACT), _limiting(false) {}
+
+  virtual void update(void);
+
+  void  setLimiting(bool on);
+  void  setThreshold(float dbfs);          // 0 or less
+  void  setMakeupShift(int shift);         // the mix's headroom, in 6 dB steps
+  float takeGainReduction();               // dB, the most since the last call
+
+ private:
+  audio_block_t *_inputQueueArray[2];
+  PeakLimiter    _limiter;
+  volatile bool  _limiting;
+};
+
+#endif
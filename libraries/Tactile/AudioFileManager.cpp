@@ -39,12 +39,18 @@ AudioFileManager::AudioFileManager(TeensyUtils *tc) {
   _tu->log2("SD card initialization done.");
   _tu->log2("AudioFileManager: Reading filenames...");
 
-  for (int i = 0; i < NUM_CHANNELS; i++)
+  for (int i = 0; i < NUM_CHANNELS; i++) {
     _fileNames[i][0] = 0;
+    _converted[i] = false;
+  }
   for (int i = 0; i < NUM_CHANNELS; i++) {
     _numSubDirFiles[i] = 0;
-    for (int j = 0; j < NUM_FILES_IN_SUBDIR; j++)
+    _hasWeights[i] = false;
+    for (int j = 0; j < NUM_FILES_IN_SUBDIR; j++) {
       _subDirFileNames[i][j][0] = 0;
+      _weights[i][j] = 1;
+      _subDirConverted[i][j] = false;
+    }
   }
   _tu->log2("Name arrays initialized");
 
@@ -52,6 +58,7 @@ AudioFileManager::AudioFileManager(TeensyUtils *tc) {
   File dir = SD.open("/");
   _readDirIntoStringArray(&dir, -1);
   dir.close();
+  _convertFiles(-1);
 
   // Find WAV files in the subdirectories E1-E4
   char dirName[3] = "Ex";
@@ -60,6 +67,9 @@ AudioFileManager::AudioFileManager(TeensyUtils *tc) {
     dir = SD.open(dirName);
     if (dir) {
       _numSubDirFiles[dirNum-1] = _readDirIntoStringArray(&dir, dirNum-1);
+      dir.close();
+      _convertFiles(dirNum-1);
+      _readWeights(dirNum-1);
     } else if (getLogLevel() > 1) {
       Serial.print("AudioFileManager: Failed to open directory: '");
       Serial.print(dirName);
@@ -167,6 +177,300 @@ int AudioFileManager::_readDirIntoStringArray(File *dir, int subDirNum)
   return numFiles;
 }
 
+// Each line of the WEIGHTS_FILE is a track's name, then its weight after
+// the last space. Names are matched ignoring case; lines that don't
+// match a track are logged and skipped.
+
+void AudioFileManager::_readWeights(int dirNum)
+{
+  char path[MAX_FILE_NAME+5];
+  strcpy(path, "/Ex/" WEIGHTS_FILE);
+  path[2] = '1' + dirNum;
+  File file = SD.open(path, FILE_READ);
+  if (!file)
+    return;
+
+  char line[MAX_FILE_NAME+20];
+  int n;
+  while ((n = file.readBytesUntil('\n', line, sizeof(line) - 1)) > 0) {
+    line[n] = 0;
+    while (n > 0 && (line[n-1] == '\r' || line[n-1] == ' '))
+      line[--n] = 0;
+    char *space = strrchr(line, ' ');
+    if (!space)
+      continue;
+    *space = 0;
+    char *end;
+    long weight = strtol(space + 1, &end, 10);
+    int fileNum = 0;
+    while (fileNum < _numSubDirFiles[dirNum] && strcasecmp(_subDirFileNames[dirNum][fileNum], line) != 0)
+      fileNum++;
+    if (*end != 0 || weight < 0 || weight > MAX_TRACK_WEIGHT || fileNum == _numSubDirFiles[dirNum]) {
+      _tu->logAction("AudioFileManager: bad line in " WEIGHTS_FILE " of directory ", dirNum + 1);
+      continue;
+    }
+    _weights[dirNum][fileNum] = weight;
+    _hasWeights[dirNum] = true;
+  }
+  file.close();
+}
+
+/*----------------------------------------------------------------------
+ * Converting. Each file's header is read; one the players can't stream
+ * is converted into CACHE_DIR, unless the copy there is complete and
+ * was made from a file of the same size and date.
+ ----------------------------------------------------------------------*/
+
+enum {
+  fileNative,
+  fileConverted,
+  fileUnplayable
+};
+
+// A file's date as FAT keeps it, to 2 seconds
+static uint32_t packDate(const DateTimeFields &tm) {
+  return ((uint32_t)(tm.year - 80) << 25) | ((uint32_t)(tm.mon + 1) << 21) | ((uint32_t)tm.mday << 16)
+         | (tm.hour << 11) | (tm.min << 5) | (tm.sec >> 1);
+}
+
+// Subdirectories lose the files that can't be played; in the root, where
+// the file number is the channel, the channel is left without a track.
+
+void AudioFileManager::_convertFiles(int dirNum)
+{
+  char path[MAX_PATH_NAME];
+  char cachePath[MAX_PATH_NAME];
+  int numFiles = dirNum < 0 ? NUM_CHANNELS : _numSubDirFiles[dirNum];
+  int kept = 0;
+  for (int fileNum = 0; fileNum < numFiles; fileNum++) {
+    char *name = dirNum < 0 ? _fileNames[fileNum] : _subDirFileNames[dirNum][fileNum];
+    if (!name[0])
+      continue;
+    strcpy(path, "/Ex/");
+    if (dirNum < 0)
+      path[1] = 0;
+    else
+      path[2] = '1' + dirNum;
+    strcat(path, name);
+    strcpy(cachePath, CACHE_DIR);
+    strcat(cachePath, path);
+
+    int status = _prepareFile(path, cachePath);
+    if (dirNum < 0) {
+      if (status == fileUnplayable)
+        name[0] = 0;
+      _converted[fileNum] = status == fileConverted;
+    } else if (status != fileUnplayable) {
+      if (kept != fileNum)
+        strcpy(_subDirFileNames[dirNum][kept], name);
+      _subDirConverted[dirNum][kept] = status == fileConverted;
+      kept++;
+    }
+  }
+  if (dirNum >= 0) {
+    for (int fileNum = kept; fileNum < numFiles; fileNum++)
+      _subDirFileNames[dirNum][fileNum][0] = 0;
+    _numSubDirFiles[dirNum] = kept;
+  }
+}
+
+int AudioFileManager::_prepareFile(const char *path, const char *cachePath)
+{
+  WavSource source;
+  bool isWav = _source.open(path) && WavConverter::readSourceHeader(&_source, &source);
+  uint32_t sourceSize = _source.size();
+  _source.close();
+  if (isWav && WavConverter::isNative(&source))
+    return fileNative;
+  if (!isWav || !WavConverter::canConvert(&source)) {
+    Serial.print("AudioFileManager: WARNING: not a WAV file that can be played: ");
+    Serial.println(path);
+    return fileUnplayable;
+  }
+
+  uint32_t sourceDate = 0;
+  DateTimeFields tm;
+  File file = SD.open(path, FILE_READ);
+  if (file && file.getModifyTime(tm))
+    sourceDate = packDate(tm);
+  file.close();
+
+  if (_isConverted(cachePath, sourceSize, sourceDate))
+    return fileConverted;
+  if (_convert(path, cachePath, &source, sourceSize, sourceDate))
+    return fileConverted;
+  Serial.print("AudioFileManager: WARNING: couldn't convert ");
+  Serial.println(path);
+  return fileUnplayable;
+}
+
+bool AudioFileManager::_isConverted(const char *cachePath, uint32_t sourceSize, uint32_t sourceDate)
+{
+  File file = SD.open(cachePath, FILE_READ);
+  if (!file)
+    return false;
+  uint8_t header[WAV_CONVERTED_HEADER_BYTES];
+  uint32_t size, date, dataBytes;
+  bool ok = file.read(header, sizeof(header)) == sizeof(header)
+            && WavConverter::readKey(header, &size, &date, &dataBytes)
+            && size == sourceSize && date == sourceDate
+            && dataBytes > 0 && file.size() == WAV_CONVERTED_HEADER_BYTES + dataBytes;
+  file.close();
+  return ok;
+}
+
+// The copy is written as it's converted, with a header that says it
+// isn't complete. Every CONVERT_CHECKPOINT_CHUNKS, what's been written
+// is flushed and CONVERT_PENDING_FILE records how far it got; at the
+// end, the header gets the size and the record is removed.
+
+bool AudioFileManager::_convert(const char *path, const char *cachePath, const WavSource *source,
+                                uint32_t sourceSize, uint32_t sourceDate)
+{
+  uint8_t in[CONVERT_CHUNK_BYTES];
+  int16_t out[CONVERT_OUT_FRAMES * 2];
+  uint8_t header[WAV_CONVERTED_HEADER_BYTES];
+  uint32_t sourcePos = 0;
+  uint32_t outBytes = 0;
+
+  _converter.begin(source);
+  int frameOutBytes = 2 * _converter.getChannels();
+  File file;
+  bool resumed = _loadPending(path, sourceSize, sourceDate, &sourcePos, &outBytes);
+  if (resumed) {
+    file = SD.open(cachePath, FILE_WRITE);
+    uint32_t size, date, dataBytes;
+    resumed = file && file.seek(0) && file.read(header, sizeof(header)) == sizeof(header)
+              && WavConverter::readKey(header, &size, &date, &dataBytes)
+              && size == sourceSize && date == sourceDate
+              && file.size() >= WAV_CONVERTED_HEADER_BYTES + outBytes;
+    if (!resumed) {
+      file.close();
+      _converter.begin(source);
+      sourcePos = 0;
+      outBytes = 0;
+    }
+  }
+  if (!resumed) {
+    char dir[MAX_PATH_NAME];
+    strcpy(dir, cachePath);
+    *strrchr(dir, '/') = 0;
+    SD.mkdir(dir);
+    SD.remove(cachePath);
+    file = SD.open(cachePath, FILE_WRITE);
+    if (!file)
+      return false;
+    WavConverter::makeHeader(header, _converter.getChannels(), 0, sourceSize, sourceDate);
+    file.write(header, sizeof(header));
+  }
+  Serial.print(resumed ? "AudioFileManager: carrying on converting " : "AudioFileManager: converting ");
+  Serial.println(path);
+
+  bool ok = _source.open(path) && _source.seek(source->dataOffset + sourcePos)
+            && file.seek(WAV_CONVERTED_HEADER_BYTES + outBytes);
+  int chunkFrames = CONVERT_CHUNK_BYTES / source->frameBytes;
+  int chunks = 0;
+  while (ok && sourcePos + source->frameBytes <= source->dataBytes) {
+    int frames = (source->dataBytes - sourcePos) / source->frameBytes;
+    if (frames > chunkFrames)
+      frames = chunkFrames;
+    int bytes = frames * source->frameBytes;
+    ok = _source.read(in, bytes) == bytes;
+    const uint8_t *p = in;
+    while (ok && frames > 0) {
+      int made;
+      int used = _converter.convert(p, frames, out, CONVERT_OUT_FRAMES, &made);
+      p += used * source->frameBytes;
+      frames -= used;
+      ok = file.write(out, made * frameOutBytes) == (size_t)(made * frameOutBytes);
+      outBytes += made * frameOutBytes;
+    }
+    sourcePos += bytes;
+    if (ok && ++chunks % CONVERT_CHECKPOINT_CHUNKS == 0) {
+      file.flush();
+      _savePending(path, sourceSize, sourceDate, sourcePos, outBytes);
+    }
+  }
+  _source.close();
+
+  if (ok) {
+    int made = _converter.finish(out, CONVERT_OUT_FRAMES);
+    ok = file.write(out, made * frameOutBytes) == (size_t)(made * frameOutBytes);
+    outBytes += made * frameOutBytes;
+  }
+  if (ok) {
+    WavConverter::makeHeader(header, _converter.getChannels(), outBytes, sourceSize, sourceDate);
+    ok = file.truncate(WAV_CONVERTED_HEADER_BYTES + outBytes)
+         && file.seek(0) && file.write(header, sizeof(header)) == sizeof(header);
+  }
+  file.close();
+  if (ok)
+    SD.remove(CONVERT_PENDING_FILE);
+  return ok;
+}
+
+// The record: a header line, the original's path, its size and date and
+// how far the conversion got, and the converter's state.
+
+bool AudioFileManager::_loadPending(const char *path, uint32_t sourceSize, uint32_t sourceDate,
+                                    uint32_t *sourcePos, uint32_t *outBytes)
+{
+  File file = SD.open(CONVERT_PENDING_FILE, FILE_READ);
+  if (!file)
+    return false;
+
+  char line[MAX_PATH_NAME + WAV_CONVERTER_STATE_CHARS];
+  bool ok = true;
+  for (int lineNumber = 0; ok && lineNumber < 4; lineNumber++) {
+    int n = file.readBytesUntil('\n', line, sizeof(line) - 1);
+    if (n <= 0) {
+      ok = false;
+      break;
+    }
+    line[n] = 0;
+    if (line[n-1] == '\r')
+      line[n-1] = 0;
+    if (lineNumber == 0) {
+      ok = strcmp(line, "TactileAudio conversion 1") == 0;
+    } else if (lineNumber == 1) {
+      ok = strcmp(line, path) == 0;
+    } else if (lineNumber == 2) {
+      char *p = line;
+      uint32_t size = strtoul(p, &p, 10);
+      uint32_t date = strtoul(p, &p, 10);
+      *sourcePos = strtoul(p, &p, 10);
+      *outBytes = strtoul(p, &p, 10);
+      ok = size == sourceSize && date == sourceDate;
+    } else {
+      ok = _converter.loadState(line);
+    }
+  }
+  file.close();
+  return ok;
+}
+
+void AudioFileManager::_savePending(const char *path, uint32_t sourceSize, uint32_t sourceDate,
+                                    uint32_t sourcePos, uint32_t outBytes)
+{
+  char state[WAV_CONVERTER_STATE_CHARS];
+  SD.remove(CONVERT_PENDING_FILE);
+  if (!_converter.saveState(state, sizeof(state)))
+    return;
+  File file = SD.open(CONVERT_PENDING_FILE, FILE_WRITE);
+  if (!file)
+    return;
+  file.println("TactileAudio conversion 1");
+  file.println(path);
+  file.print(sourceSize);
+  file.print(" ");
+  file.print(sourceDate);
+  file.print(" ");
+  file.print(sourcePos);
+  file.print(" ");
+  file.println(outBytes);
+  file.println(state);
+  file.close();
+}
 
 const char *AudioFileManager::getFileName(int fileNum)
 {
@@ -191,6 +495,29 @@ const char *AudioFileManager::getFileName(int dirNum, int fileNum)
   return _subDirFileNames[dirNum][fileNum];
 }
 
+bool AudioFileManager::getPath(int fileNum, char *path)
+{
+  const char *fileName = getFileName(fileNum);
+  if (!fileName || !fileName[0])
+    return false;
+  strcpy(path, _converted[fileNum] ? CACHE_DIR "/" : "/");
+  strcat(path, fileName);
+  return true;
+}
+
+bool AudioFileManager::getPath(int dirNum, int fileNum, char *path)
+{
+  const char *fileName = getFileName(dirNum, fileNum);
+  if (!fileName)
+    return false;
+  strcpy(path, _subDirConverted[dirNum][fileNum] ? CACHE_DIR : "");
+  char *p = path + strlen(path);
+  strcpy(p, "/Ex/");
+  p[2] = '1' + dirNum;  // i.e. /E1/, /E2/, ...
+  strcpy(p+4, fileName);
+  return true;
+}
+
 int AudioFileManager::getNumFiles(int dirNum) {
   if (dirNum < 0 || dirNum >= NUM_CHANNELS) {
     _tu->log("AudioFileManager: getNumFiles(): dirNum out of range");
@@ -198,3 +525,9 @@ int AudioFileManager::getNumFiles(int dirNum) {
   }
   return _numSubDirFiles[dirNum];
 }
+
+const uint16_t *AudioFileManager::getWeights(int dirNum) {
+  if (dirNum < 0 || dirNum >= NUM_CHANNELS || !_hasWeights[dirNum])
+    return NULL;
+  return _weights[dirNum];
+}
@@ -28,6 +28,20 @@
  * (Note: The subdirectories are named starting with 1 (i.e. E1..EN)
  * for simplicity  with the expected use of this module, but are indexed
  * starting with zero.)
+ *
+ * A subdirectory may also have a WEIGHTS_FILE, for random tracks that
+ * should come up more (or less) often than the others: one line per
+ * track, its name and a weight, e.g. "RAIN.WAV 3". Tracks that aren't
+ * listed weigh 1; 0 is never chosen at random.
+ *
+ * The players stream 44.1 kHz 16-bit PCM (and IMA-ADPCM) WAV files. Any
+ * other WAV file is converted once, when it's found, into the same path
+ * under CACHE_DIR (see WavConverter), and getPath() gives the converted
+ * copy from then on. A copy is made again if the original's size or date
+ * changes. Converting takes a while (about as long as reading and
+ * writing the file), and if the power goes off in the middle, it carries
+ * on where it was at the next start, from CONVERT_PENDING_FILE. Files
+ * that can't be played or converted are left out, with a warning.
  ----------------------------------------------------------------------*/
 
 #ifndef AudioFileManager_h
@@ -39,6 +53,8 @@
 using namespace std;
 
 #include "TeensyUtils.h"
+#include "SdSampleFile.h"
+#include "WavConverter.h"
 
 // This is also the number of subdirectories for selecting random tracks.
 #define NUM_FILES_IN_SUBDIR 100
@@ -46,6 +62,18 @@ using namespace std;
 // Max string length of filename on SD card
 #define MAX_FILE_NAME 255
 
+// Max string length of a path, with the CACHE_DIR in front of "/E1/NAME.WAV"
+#define MAX_PATH_NAME (MAX_FILE_NAME + 12)
+
+#define WEIGHTS_FILE "_WEIGHTS.TXT"      // in each subdirectory; ignored as a track (it starts with '_')
+#define MAX_TRACK_WEIGHT 1000
+
+#define CACHE_DIR "/_CACHE"                // converted tracks
+#define CONVERT_PENDING_FILE CACHE_DIR "/_PENDING.TXT"
+#define CONVERT_CHUNK_BYTES 4096           // of the original, read at a time
+#define CONVERT_OUT_FRAMES 1024            // converted, written at a time
+#define CONVERT_CHECKPOINT_CHUNKS 64       // progress saved every 256 KB of the original
+
 class AudioFileManager {
 
  public:
@@ -54,14 +82,33 @@ class AudioFileManager {
   // The main methods
   const char *getFileName(int fileNum);
   const char *getFileName(int dirNum, int fileNum);
+  bool        getPath(int fileNum, char *path);               // "/NAME.WAV"; path holds MAX_PATH_NAME
+  bool        getPath(int dirNum, int fileNum, char *path);   // "/E1/NAME.WAV"
   int         getNumFiles(int dirNum);
+  const uint16_t *getWeights(int dirNum);   // one per file; NULL if the directory has no WEIGHTS_FILE
 
  private:
   char _fileNames[NUM_CHANNELS][MAX_FILE_NAME];
   char _subDirFileNames[NUM_CHANNELS][NUM_FILES_IN_SUBDIR][MAX_FILE_NAME];
   int  _numSubDirFiles[NUM_CHANNELS];
+  uint16_t _weights[NUM_CHANNELS][NUM_FILES_IN_SUBDIR];
+  bool _hasWeights[NUM_CHANNELS];
+  bool _converted[NUM_CHANNELS];            // root files
+  bool _subDirConverted[NUM_CHANNELS][NUM_FILES_IN_SUBDIR];
+  SdSampleFile _source;
+  WavConverter _converter;
 
   int _readDirIntoStringArray(File *dir, int subDirNum);
+  void _readWeights(int dirNum);
+  void _convertFiles(int dirNum);           // -1: the root
+  int  _prepareFile(const char *path, const char *cachePath);
+  bool _isConverted(const char *cachePath, uint32_t sourceSize, uint32_t sourceDate);
+  bool _convert(const char *path, const char *cachePath, const WavSource *source,
+                uint32_t sourceSize, uint32_t sourceDate);
+  bool _loadPending(const char *path, uint32_t sourceSize, uint32_t sourceDate,
+                    uint32_t *sourcePos, uint32_t *outBytes);
+  void _savePending(const char *path, uint32_t sourceSize, uint32_t sourceDate,
+                    uint32_t sourcePos, uint32_t outBytes);
 
   TeensyUtils *_tu;
 };
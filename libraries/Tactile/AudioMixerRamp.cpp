@@ -0,0 +1,78 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+#include "AudioMixerRamp.h"
+
+#if AUDIO_BLOCK_SAMPLES != MIXER_BLOCK_SAMPLES
+#error "AudioMixerRamp: AUDIO_BLOCK_SAMPLES must match MIXER_BLOCK_SAMPLES"
+#endif
+
+// The ramps have to keep moving even when no player is sending anything
+// (a fade-in is posted a block before the track's first samples arrive),
+// so this always mixes, with missing inputs as silence.
+
+void AudioMixerRamp::update(void) {
+  audio_block_t *in[2 * MIXER_VOICES];
+  const int16_t *left[MIXER_VOICES];
+  const int16_t *right[MIXER_VOICES];
+  for (int voice = 0; voice < MIXER_VOICES; voice++) {
+    in[2 * voice]     = receiveReadOnly(2 * voice);
+    in[2 * voice + 1] = receiveReadOnly(2 * voice + 1);
+    left[voice]  = in[2 * voice]     ? in[2 * voice]->data     : NULL;
+    right[voice] = in[2 * voice + 1] ? in[2 * voice + 1]->data : NULL;
+  }
+
+  audio_block_t *outLeft  = allocate();
+  audio_block_t *outRight = allocate();
+  if (outLeft && outRight) {
+    _mixer.mix(left, right, outLeft->data, outRight->data, AUDIO_BLOCK_SAMPLES);
+    transmit(outLeft, 0);
+    transmit(outRight, 1);
+  }
+  if (outLeft)
+    release(outLeft);
+  if (outRight)
+    release(outRight);
+  for (int i = 0; i < 2 * MIXER_VOICES; i++) {
+    if (in[i])
+      release(in[i]);
+  }
+}
+
+void AudioMixerRamp::gain(int voice, float gain, int rampMsec, FadeCurve curve) {
+  AudioNoInterrupts();
+  gainLocked(voice, gain, rampMsec, curve);
+  AudioInterrupts();
+}
+
+void AudioMixerRamp::gainLocked(int voice, float gain, int rampMsec, FadeCurve curve) {
+  int32_t q = (int32_t)(gain * (float)MIXER_UNITY + 0.5);
+  _mixer.setGain(voice, q, rampMsec, curve);
+}
+
+float AudioMixerRamp::getGain(int voice) {
+  return (float)_mixer.getGain(voice) / (float)MIXER_UNITY;
+}
+
+bool AudioMixerRamp::isRamping(int voice) {
+  return _mixer.isRamping(voice);
+}
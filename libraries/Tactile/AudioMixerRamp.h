@@ -0,0 +1,60 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+/*----------------------------------------------------------------------
+ * A Teensy audio library object that mixes four voices (players), in
+ * stereo, with a RampMixer, in place of a pair of AudioMixer4s. Inputs 2*v and
+ * 2*v+1 are voice v's left and right; outputs 0 and 1 are left and
+ * right.
+ *
+ * gain() only posts the target; the gain moves there, sample by sample,
+ * inside update(), so fades don't depend on how often the loop runs.
+ * gainLocked() is the same for a caller that has turned the audio
+ * interrupt off itself, so that several ramps (the two sides of a
+ * crossfade, maybe on different mixers) start in the same block.
+ ----------------------------------------------------------------------*/
+
+#ifndef AudioMixerRamp_h
+#define AudioMixerRamp_h 1
+
+#include <Arduino.h>
+#include <Audio.h>
+#include "RampMixer.h"
+
+class AudioMixerRamp : public AudioStream
+{
+ public:
+  AudioMixerRamp() : AudioStream(2 * MIXER_VOICES, _inputQueueArray), _mixer(AUDIO_SAMPLE_RATE_EXACT) {}
+
+  virtual void update(void);
+
+  void  gain(int voice, float gain, int rampMsec = 0, FadeCurve curve = fadeLinear);
+  void  gainLocked(int voice, float gain, int rampMsec = 0, FadeCurve curve = fadeLinear);
+  float getGain(int voice);
+  bool  isRamping(int voice);
+
+ private:
+  audio_block_t *_inputQueueArray[2 * MIXER_VOICES];
+  RampMixer      _mixer;
+};
+
+#endif
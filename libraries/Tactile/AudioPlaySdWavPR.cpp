@@ -20,11 +20,36 @@
 
 #include <AudioPlaySdWavPR.h>
 
+#if AUDIO_BLOCK_SAMPLES != WAV_BLOCK_SAMPLES
+#error "WAV_BLOCK_SAMPLES (WavStream.h) must be the same as AUDIO_BLOCK_SAMPLES"
+#endif
+
 void AudioPlaySdWavPR::update(void) {
-  if (paused) {
+  if (paused || !wav.isPlaying()) {
+    return;
+  }
+  audio_block_t *left = allocate();
+  if (!left)
+    return;
+  audio_block_t *right = allocate();
+  if (!right) {
+    release(left);
     return;
   }
-  AudioPlaySdWav::update();
+  if (wav.readBlock(left->data, right->data)) {
+    transmit(left, 0);
+    transmit(right, 1);
+  }
+  release(left);
+  release(right);
+  if (!wav.isPlaying())
+    stopUsingSPI();                       // that was the end of the track
+#ifdef TACTILE_LATENCY_PROBE
+  // The first update that has consumed data from the file is the first
+  // one that transmitted audio blocks.
+  if (latencyChannel >= 0 && positionMillis() > 0)
+    LATENCY_MARK(latencyChannel, latencyAudioOut, micros());
+#endif
 }
 
 void AudioPlaySdWavPR::pause(void) {
@@ -35,18 +60,150 @@ void AudioPlaySdWavPR::resume(void) {
   paused = 0;
 }
 
-void AudioPlaySdWavPR::play(const char *filename) {
+// Opening the file and filling the buffers take the card, which the
+// other players read from the audio interrupt.
+
+bool AudioPlaySdWavPR::prepare(const char *filename, bool fill) {
   if (!filename) {
     Serial.println("AudioPlaySdWavPR: ERROR: null filename");
-    return;
+    return false;
+  }
+  stop();
+  startUsingSPI();
+  AudioNoInterrupts();
+  bool ok = wav.open(&file, filename, fill);
+  AudioInterrupts();
+  if (!ok) {
+    stopUsingSPI();
+    Serial.print("AudioPlaySdWavPR: can't play ");
+    Serial.println(filename);
   }
+  return ok;
+}
+
+void AudioPlaySdWavPR::start(void) {
   paused = 0;
-  AudioPlaySdWav::play(filename);
+  wav.start();
+}
+
+void AudioPlaySdWavPR::cancel(void) {
+  if (wav.isArmed())
+    stop();
+}
+
+bool AudioPlaySdWavPR::isPrepared(void) {
+  return wav.isArmed();
+}
+
+void AudioPlaySdWavPR::play(const char *filename) {
+  if (prepare(filename))
+    start();
 }
 
 void AudioPlaySdWavPR::stop(void) {
   paused = 0;
-  AudioPlaySdWav::stop();
+  AudioNoInterrupts();
+  wav.stop();
+  AudioInterrupts();
+  stopUsingSPI();
+}
+
+// The audio library counts the objects that use SPI from the interrupt;
+// a pre-roll doesn't until it continues from the card.
+
+void AudioPlaySdWavPR::startUsingSPI(void) {
+  if (!usingSPI)
+    AudioStartUsingSPI();
+  usingSPI = true;
+}
+
+void AudioPlaySdWavPR::stopUsingSPI(void) {
+  if (usingSPI)
+    AudioStopUsingSPI();
+  usingSPI = false;
+}
+
+/*----------------------------------------------------------------------
+ * Pre-roll. The sound starts from memory with the next update. The file
+ * is opened later, from the loop: with the audio interrupt left on if no
+ * other player is reading the card (so this one's pre-roll keeps
+ * playing meanwhile), otherwise off, like prepare().
+ ----------------------------------------------------------------------*/
+
+void AudioPlaySdWavPR::playPreroll(const PrerollEntry *preroll) {
+  stop();
+  AudioNoInterrupts();
+  wav.startPreroll(&preroll->format, preroll->data, preroll->bytes);
+  AudioInterrupts();
+}
+
+bool AudioPlaySdWavPR::needsCard(void) {
+  return wav.needsFile();
+}
+
+bool AudioPlaySdWavPR::continueFromCard(const char *filename, bool cardIsFree) {
+  startUsingSPI();
+  if (!cardIsFree)
+    AudioNoInterrupts();
+  bool ok = wav.openRest(&file, filename);
+  if (!cardIsFree)
+    AudioInterrupts();
+  if (!ok) {
+    Serial.print("AudioPlaySdWavPR: can't continue ");
+    Serial.println(filename);
+  }
+  return ok;
+}
+
+bool AudioPlaySdWavPR::readsCard(void) {
+  return wav.readsFile();
+}
+
+uint32_t AudioPlaySdWavPR::underruns(void) {
+  return wav.getUnderruns();
+}
+
+/*----------------------------------------------------------------------
+ * Whole tracks in memory. A track played from memory is just a pre-roll
+ * that never needs the card. A prepared track isn't playing yet, so
+ * capture() doesn't need the audio interrupt off.
+ ----------------------------------------------------------------------*/
+
+void AudioPlaySdWavPR::playMemory(const WavFormat *format, const uint8_t *data) {
+  stop();
+  AudioNoInterrupts();
+  wav.startPreroll(format, data, format->dataBytes);
+  AudioInterrupts();
+}
+
+void AudioPlaySdWavPR::setLoop(bool on, int crossfadeMsec) {
+  AudioNoInterrupts();
+  wav.setLoop(on, (int)((uint32_t)crossfadeMsec * 44100 / 1000));
+  AudioInterrupts();
+}
+
+bool AudioPlaySdWavPR::capture(uint8_t *destination) {
+  return wav.setCapture(destination);
+}
+
+bool AudioPlaySdWavPR::isCaptured(void) {
+  return wav.isCaptured();
+}
+
+const WavFormat *AudioPlaySdWavPR::format(void) {
+  return wav.getFormat();
+}
+
+bool AudioPlaySdWavPR::isPlaying(void) {
+  return wav.isPlaying();
+}
+
+uint32_t AudioPlaySdWavPR::positionMillis(void) {
+  return wav.positionMillis();
+}
+
+uint32_t AudioPlaySdWavPR::lengthMillis(void) {
+  return wav.lengthMillis();
 }
 
 unsigned char AudioPlaySdWavPR::isPaused(void) {
@@ -19,14 +19,37 @@
 */
 
 /*----------------------------------------------------------------------
- * This class extends the Audio.h library from PJRC for the Teensy 4
- * audio shield, adding a pause/resume feature.
+ * WAV player for the Teensy audio library, in place of its
+ * AudioPlaySdWav. Besides play() and stop() it can:
  *
- * Note: it's not clear if this is the right way to do this. While paused,
- * this simply doesn't get any more data from the SD file and forward it
- * to the audio player. It might be that a more correct way is to
- * fill the buffer with zero bytes or something like that. But this
- * seems to work, so...
+ *   - pause and resume, where pause simply stops taking data from the
+ *     file and sending it on to the mixer
+ *
+ *   - prepare a track ahead of time: prepare() opens the file, parses
+ *     the header and fills the first buffers, silently; start() then
+ *     makes it audible with the next audio update, with no card access
+ *     at all. cancel() drops a prepared track that wasn't needed.
+ *     Without the fill, the first update() reads the first buffer.
+ *
+ *   - start a track from its pre-roll in memory (see PrerollCache):
+ *     playPreroll() starts the sound right away, and continueFromCard(),
+ *     called from the loop once the first block is out, opens the file
+ *     where the pre-roll ends.
+ *
+ *   - play a whole track from memory (playMemory(), see SampleCache),
+ *     or copy one into memory while it streams from the card (capture()
+ *     between prepare() and start()).
+ *
+ *   - loop a track with no gap, at the loop points in its "smpl" chunk
+ *     if it has one (setLoop()); isPlaying() stays true.
+ *
+ *   - play IMA-ADPCM tracks as well as 16-bit PCM, decoding them in
+ *     update(), for a quarter of the card reads.
+ *
+ * The streaming itself is done by a WavStream (no Arduino dependencies).
+ * File reads for a playing track happen in update(), from the audio
+ * interrupt, like the Teensy's own player. prepare() reads from the loop
+ * so it turns the audio interrupt off while it does.
  *
  * See: https://www.pjrc.com/teensy/td_libs_Audio.html
  ----------------------------------------------------------------------*/
@@ -40,28 +63,73 @@
 #include <SPI.h>
 #include <SD.h>
 #include <SerialFlash.h>
+#include "LatencyProbe.h"
+#include "SdSampleFile.h"
+#include "WavStream.h"
+#include "PrerollCache.h"
 
-class AudioPlaySdWavPR : public AudioPlaySdWav {
+class AudioPlaySdWavPR : public AudioStream {
 
 public:
   
   // Constructor.
-  AudioPlaySdWavPR() {
+  AudioPlaySdWavPR() : AudioStream(0, NULL) {
     paused = 0;
+    usingSPI = false;
+#ifdef TACTILE_LATENCY_PROBE
+    latencyChannel = -1;
+#endif
   }
 
-  // override base-class methods
   void update(void);
   void play(const char *filename);
   void stop(void);
+  bool isPlaying(void);
+  uint32_t positionMillis(void);
+  uint32_t lengthMillis(void);
   
-  // New methods
+  // Pause and resume
   void pause(void);
   void resume(void);
   unsigned char isPaused(void);
 
+  // Prepare a track now, start it later
+  bool prepare(const char *filename, bool fill = true);   // fill: read the first buffer too
+  void start(void);
+  void cancel(void);
+  bool isPrepared(void);
+
+  // Pre-roll
+  void playPreroll(const PrerollEntry *preroll);
+  bool needsCard(void);
+  bool continueFromCard(const char *filename, bool cardIsFree);
+  bool readsCard(void);
+  uint32_t underruns(void);
+
+  // Whole tracks in memory
+  void playMemory(const WavFormat *format, const uint8_t *data);
+  bool capture(uint8_t *destination);
+  bool isCaptured(void);
+  const WavFormat *format(void);
+
+  // Looping, with no gap, from the next track on (or this one, if set
+  // while it plays); the seam can be crossfaded over a few msec
+  void setLoop(bool on, int crossfadeMsec = 0);
+
+#ifdef TACTILE_LATENCY_PROBE
+  void setLatencyChannel(int channel) { latencyChannel = channel; }
+#endif
+
  private:
   unsigned char paused;
+  bool          usingSPI;
+  void          startUsingSPI(void);
+  void          stopUsingSPI(void);
+  SdSampleFile  file;
+  WavStream     wav;
+#ifdef TACTILE_LATENCY_PROBE
+  int latencyChannel;
+#endif
 };
 
 #endif // _AUDIO_PLAY_SD_WAV_PR_H_
@@ -27,29 +27,75 @@
 #include <SerialFlash.h>
 
 #include "AudioPlayer.h"
+#include "LatencyProbe.h"
+
+// The voices and the first row of the mixer tree (a ramp mixer per four
+// voices) are sized by NUM_VOICES, so they're patched together in
+// setup(). The ramp mixers' outputs are summed by a mixer per side.
+
+AudioPlaySdWavPR         voicePlayers[NUM_VOICES];
+AudioMixerRamp           voiceMixers[NUM_VOICE_MIXERS];
+AudioConnection          voiceCords[2*NUM_VOICES + 2*NUM_VOICE_MIXERS];
 
 // GUItool: begin automatically generated code
-AudioPlaySdWavPR           playSdWav1;     //xy=124,100
-AudioPlaySdWavPR           playSdWav2;     //xy=124,160
-AudioPlaySdWavPR           playSdWav3;     //xy=124,220
-AudioPlaySdWavPR           playSdWav4;     //xy=124,280
-AudioMixer4              mixer1;         //xy=470,160
-AudioMixer4              mixer2;         //xy=470,280
+AudioMixer4              mixerL;         //xy=470,160
+AudioMixer4              mixerR;         //xy=470,280
 AudioOutputI2S           i2s1;           //xy=650,220
-AudioConnection          patchCord1(playSdWav1, 0, mixer1, 0);
-AudioConnection          patchCord2(playSdWav1, 1, mixer2, 0);
-AudioConnection          patchCord3(playSdWav2, 0, mixer1, 1);
-AudioConnection          patchCord4(playSdWav2, 1, mixer2, 1);
-AudioConnection          patchCord5(playSdWav3, 0, mixer1, 2);
-AudioConnection          patchCord6(playSdWav3, 1, mixer2, 2);
-AudioConnection          patchCord7(playSdWav4, 0, mixer1, 3);
-AudioConnection          patchCord8(playSdWav4, 1, mixer2, 3);
-AudioConnection          patchCord9(mixer1, 0, i2s1, 0);
-AudioConnection          patchCord10(mixer2, 0, i2s1, 1);
+AudioInputI2S            i2sIn;          //xy=124,440
+AudioAnalyzeEnvelope     inputEnvelope;  //xy=300,440
+AudioEffectLimiter       limiter;        //xy=560,220
+AudioConnection          patchCord1(mixerL, 0, limiter, 0);
+AudioConnection          patchCord2(mixerR, 0, limiter, 1);
+AudioConnection          patchCord5(limiter, 0, i2s1, 0);
+AudioConnection          patchCord6(limiter, 1, i2s1, 1);
+AudioConnection          patchCord3(i2sIn, 0, inputEnvelope, 0);
+AudioConnection          patchCord4(i2sIn, 1, inputEnvelope, 1);
 AudioControlSGTL5000     sgtl5000;     //xy=127,379.111083984375
 // GUItool: end automatically generated code
 
-AudioPlayer::AudioPlayer(TeensyUtils *tc) {
+static void patchVoices() {
+  int cord = 0;
+  for (int voice = 0; voice < NUM_VOICES; voice++) {
+    AudioMixerRamp &mixer = voiceMixers[voice / MIXER_VOICES];
+    int input = 2 * (voice % MIXER_VOICES);
+    voiceCords[cord++].connect(voicePlayers[voice], 0, mixer, input);
+    voiceCords[cord++].connect(voicePlayers[voice], 1, mixer, input + 1);
+  }
+  for (int m = 0; m < NUM_VOICE_MIXERS; m++) {
+    voiceCords[cord++].connect(voiceMixers[m], 0, mixerL, m);
+    voiceCords[cord++].connect(voiceMixers[m], 1, mixerR, m);
+  }
+}
+
+// With a limiter on, every voice is mixed at mixScale of its gain, for
+// headroom, and the limiter makes it up (see useLimiter()). Gains are
+// given and read back without it.
+
+static float mixScale = 1.0;
+
+// locked: the caller has turned the audio interrupt off (see crossfade())
+
+static void setVoiceGain(int voice, float gain, int milliseconds, FadeCurve curve, bool locked = false) {
+  AudioMixerRamp &mixer = voiceMixers[voice / MIXER_VOICES];
+  if (locked)
+    mixer.gainLocked(voice % MIXER_VOICES, gain * mixScale, milliseconds, curve);
+  else
+    mixer.gain(voice % MIXER_VOICES, gain * mixScale, milliseconds, curve);
+}
+
+static float voiceGain(int voice) {
+  if (voice < 0)
+    return 0.0;
+  return voiceMixers[voice / MIXER_VOICES].getGain(voice % MIXER_VOICES) / mixScale;
+}
+
+static bool voiceIsRamping(int voice) {
+  if (voice < 0)
+    return false;
+  return voiceMixers[voice / MIXER_VOICES].isRamping(voice % MIXER_VOICES);
+}
+
+AudioPlayer::AudioPlayer(TeensyUtils *tc) : _voices(NUM_VOICES) {
   _tu = tc;
 }
 
@@ -58,42 +104,97 @@ AudioPlayer* AudioPlayer::setup(TeensyUtils *tc) {
   AudioPlayer* t = new AudioPlayer(tc);
 
   for (int channel = 0; channel < NUM_CHANNELS; channel++) {
-    t->setVolume(channel, 100);
     t->_fadeInTime[channel]            = 0;
     t->_fadeOutTime[channel]           = 0;
     t->_playAction[channel]            = playSingle;
     t->_loopMode[channel]              = false;
+    t->_loopCrossfade[channel]         = 0;
     t->_targetVolume[channel]          = 100;
-    t->_actualVolume[channel]          = 0;
+    t->_fadeCurve[channel]             = fadeLinear;
     t->_lastStartTime[channel]         = 0;
     t->_lastStopTime[channel]          = 0;
-    t->_thisFadeInTime[channel]        = 0;
-    t->_thisFadeOutTime[channel]       = 0;
-    t->_lastRandomTrackPlayed[channel] = -1;
     t->_isPaused[channel]              = false;
+    t->_nextTrackPath[channel][0]      = 0;
+    t->_prepareHits[channel]           = 0;
+    t->_prepareMisses[channel]         = 0;
+    t->_preopened[channel]             = false;
+    t->_prerollPending[channel][0]     = 0;
+    t->_prerollHits[channel]           = 0;
+    t->_prerollUnderruns[channel]      = 0;
+    t->_voice[channel]                 = -1;
+    t->_voicePriority[channel]         = 0;
+    t->_layering[channel]              = false;
   }  
+  for (int voice = 0; voice < NUM_VOICES; voice++) {
+    t->_voiceStartTime[voice]          = 0;
+    t->_underrunBase[voice]            = 0;
+    t->_prerolling[voice]              = NULL;
+    t->_cachePlaying[voice]            = NULL;
+    t->_cacheLoading[voice]            = NULL;
+  }
+  t->_crossfadeTime = 0;
+  t->_preopenMax    = 0;
+  t->_preopenFill   = true;
+  t->_preopenRecycled = 0;
+  t->_prerollPool   = NULL;
+  t->_prerollMillis = 0;
+  t->_prerollLazy   = false;
+  t->_rememberTracks = true;
+  t->_tracksChanged = false;
+  t->_tracksSavedTime = 0;
+  t->_limiterMode   = limiterOff;
 
   // Initialization for the Teensy Audio Shield
 #define SDCARD_CS_PIN    10
 #define SDCARD_MOSI_PIN  7
 #define SDCARD_SCK_PIN   14
-  AudioMemory(2*NUM_CHANNELS+4);
+  patchVoices();
+  AudioMemory(2*NUM_VOICES + 2*NUM_VOICE_MIXERS + 10);    // +4 for the line-in/mic input, +2 for the limiter
   sgtl5000.enable();
   sgtl5000.volume(0.90);
+  Wire.beginTransmission(SGTL5000_I2C_ADDRESS);
+  t->_codecFound = Wire.endTransmission() == 0;
+  t->useMicrophoneInput(false);
   delay(1000);  // wait for SGTL5000 to initialize
 
-  for (int i = 0; i < 4; i++) {
-    mixer1.gain(i, 1.0);
-    mixer2.gain(i, 1.0);
-  }
-
   t->_fm = new AudioFileManager(tc);
+
+  // Each channel's selector gets its own seed from random() (seeded by
+  // Tactile::setup()), and more of it after the saved state is loaded,
+  // so a restart carries on the order but not the same dice.
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    t->_selector[channel].setSeed(random(0x7FFFFFFF));
+    t->_resetTracks(channel);
+  }
+  t->_loadTrackState();
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    t->_selector[channel].mixSeed(random(0x7FFFFFFF));
  
   tc->log2("AudioPlayer::setup() complete.");
 
   return t;
 }
 
+/*----------------------------------------------------------------------
+ * Audio input. Line-in or microphone on the audio shield feeds an
+ * envelope follower per side (0=left, 1=right), which the Sensors module
+ * can use in place of a touch sensor.
+ ----------------------------------------------------------------------*/
+
+void AudioPlayer::useMicrophoneInput(bool on) {
+  if (on) {
+    sgtl5000.inputSelect(AUDIO_INPUT_MIC);
+    sgtl5000.micGain(36);
+  } else {
+    sgtl5000.inputSelect(AUDIO_INPUT_LINEIN);
+  }
+  _tu->log2(on ? "AudioPlayer: input: microphone" : "AudioPlayer: input: line-in");
+}
+
+EnvelopeFollower *AudioPlayer::getInputEnvelope(int input) {
+  return inputEnvelope.getFollower(input);
+}
+
 /*----------------------------------------------------------------------
  * Tracks
  ----------------------------------------------------------------------*/
@@ -104,21 +205,93 @@ const char *AudioPlayer::getTrackName(int channel) {
   return _fm->getFileName(channel);
 }
 
+/*----------------------------------------------------------------------
+ * Master bus limiter. Either way, the voices are mixed 12 dB down, so
+ * four at full scale add up to no more than full scale, and the 12 dB
+ * are put back after the mix, with the peaks held at the threshold:
+ *
+ *   chip  the SGTL5000's audio processor: automatic volume control with
+ *         up to +12 dB and a hard limit at the threshold. No CPU time,
+ *         but it can't look ahead, so the start of a loud sound can
+ *         clip for a moment.
+ *   cpu   an AudioEffectLimiter just before the output: a look-ahead
+ *         peak limiter, 1.5 msec later, that never lets a peak through.
+ *
+ * In chip mode the AudioEffectLimiter only meters.
+ ----------------------------------------------------------------------*/
+
+void AudioPlayer::useLimiter(LimiterMode mode, float thresholdDb) {
+  if (mode == limiterAuto || (mode == limiterChip && !_codecFound))
+    mode = _codecFound ? limiterChip : limiterCpu;
+  _limiterMode = mode;
+
+  int shift = mode == limiterOff ? 0 : LIMITER_HEADROOM_SHIFT;
+  mixScale = 1.0 / (float)(1 << shift);
+  limiter.setMakeupShift(shift);
+  limiter.setThreshold(thresholdDb);
+  limiter.setLimiting(mode == limiterCpu);
+  if (mode == limiterChip) {
+    sgtl5000.audioPostProcessorEnable();
+    sgtl5000.autoVolumeControl(LIMITER_CODEC_MAX_GAIN, 0, 1, thresholdDb, 200.0, 20.0);
+    sgtl5000.autoVolumeEnable();
+  } else if (_codecFound) {
+    sgtl5000.autoVolumeDisable();
+    sgtl5000.audioProcessorDisable();
+  }
+  if (getLogLevel() > 0) {
+    Serial.print("AudioPlayer: limiter: ");
+    Serial.println(mode == limiterChip ? "SGTL5000" : (mode == limiterCpu ? "CPU" : "off"));
+  }
+}
+
+LimiterMode AudioPlayer::getLimiterMode() {
+  return _limiterMode;
+}
+
+float AudioPlayer::takeLimiterReduction() {
+  return limiter.takeGainReduction();
+}
+
 /*----------------------------------------------------------------------
  * Volume controls
  ----------------------------------------------------------------------*/
 
-void AudioPlayer::_setActualVolume(int channel, int percent) {
-  _actualVolume[channel] = percent;
+// The mixer does the fading: this only posts where the gain of the
+// channel's current voice should go and how long it should take to get
+// there.
+
+void AudioPlayer::_rampVolume(int channel, int percent, int milliseconds) {
+  if (_voice[channel] < 0)
+    return;
   float gain  = (float)percent/100.0;  // Convert percent (0-100) to gain (0-1.0)
-  mixer1.gain(channel, gain);
-  mixer2.gain(channel, gain);
+  setVoiceGain(_voice[channel], gain, milliseconds, _fadeCurve[channel]);
+}
+
+int AudioPlayer::_currentVolume(int channel) {
+  return (int)(voiceGain(_voice[channel]) * 100.0 + 0.5);
 }
 
+// While a track is playing (and not fading out), a new volume is ramped
+// to: over what's left of the fade-in if one is under way, otherwise
+// quickly, just enough to avoid zipper noise when the volume follows the
+// proximity. Otherwise it's used for the next start or resume.
+
 void AudioPlayer::setVolume(int channel, int percent) {
   _targetVolume[channel] = percent;
-  if (!_fadeInTime[channel])
-    _setActualVolume(channel, percent);
+  if (_lastStartTime[channel] == 0)
+    return;
+  int time = MIXER_DEZIPPER_MSEC;
+  if (voiceIsRamping(_voice[channel])) {
+    int fadeTime = _calculateFadeTime(channel, true);
+    if (fadeTime > time)
+      time = fadeTime;
+  }
+  _rampVolume(channel, percent, time);
+}
+
+void AudioPlayer::setFadeCurve(int channel, FadeCurve curve) {
+  _fadeCurve[channel] = curve;
+  _tu->logAction2("AudioPlayer: setFadeCurve: ", (int)curve);
 }
 
 void AudioPlayer::setFadeInTime(int channel, int milliseconds) {
@@ -131,22 +304,32 @@ void AudioPlayer::setFadeOutTime(int channel, int milliseconds) {
   _tu->logAction2("AudioPlayer: setFadeOutTime: ", milliseconds);
 }
 
+// The next start fades in from silence, on a voice of its own; whatever
+// the channel was playing gets a short tail rather than being cut off.
+
 void AudioPlayer::cancelFades(int channel) {
+  _retireVoice(channel);
   _lastStartTime[channel] = 0;
   _lastStopTime[channel] = 0;
-  _setActualVolume(channel, 0);
 }
   
+// A track that's armed (pre-armed or pre-opened) isn't playing yet and
+// stays ready for the next touch.
+
 int AudioPlayer::cancelAll() {
   int cancelled = 0;
+  for (int voice = 0; voice < NUM_VOICES; voice++) {
+    int channel = _voices.getChannel(voice);
+    if (channel < 0 || _voices.isArmed(voice))
+      continue;                             // free, or ready for the next touch
+    if (voicePlayers[voice].isPlaying())
+      cancelled++;
+    _freeVoice(voice);
+  }
   for (int channel = 0; channel < NUM_CHANNELS; channel++) {
-    AudioPlaySdWavPR *player = _getPlayerByTrack(channel);
-    if (player) {
-      if (player->isPlaying()) {
-        player->stop();
-        cancelled++;
-      }
-    }
+    if (!_voices.isArmed(_voice[channel]))
+      _voice[channel] = -1;
+    _isPaused[channel] = false;
     _lastStartTime[channel] = 0;
     _lastStopTime[channel] = 0;
   }
@@ -157,160 +340,543 @@ int AudioPlayer::cancelAll() {
  * Play, pause, resume, and stop tracks
  ----------------------------------------------------------------------*/
 
-void AudioPlayer::_shuffleTracks(int channel) {
+void AudioPlayer::setPlayTrackAction(int channel, playTrackActionType playAction) {
+  _preopened[channel] = false;
+  cancelPreparedTrack(channel);           // it was chosen the old way
+  _playAction[channel] = playAction;
+  _nextTrackPath[channel][0] = 0;
+}          
+
+// The player loops the track itself, with no gap (see WavStream.h), so
+// a looping track never ends as far as doTimerTasks() is concerned.
+
+void AudioPlayer::setLoopMode(int channel, bool on, int crossfadeMsec) {
+  _loopMode[channel] = on;
+  _loopCrossfade[channel] = crossfadeMsec;
+  if (_voice[channel] >= 0)
+    voicePlayers[_voice[channel]].setLoop(on, crossfadeMsec);
+}
+
+// 1 (the default) is just not the same track twice in a row; 0 allows
+// it. At most one less than the tracks in the folder.
+
+void AudioPlayer::setNoRepeatWindow(int channel, int tracks) {
+  _selector[channel].setNoRepeat(tracks);
+  _tu->logAction2("AudioPlayer: setNoRepeatWindow: ", tracks);
+}
+
+/*----------------------------------------------------------------------
+ * Track order across restarts. Each channel's selector state -- the
+ * shuffle, where it is in it, the last random tracks -- is saved in
+ * TRACK_STATE_FILE, one line per channel, whenever it has changed and
+ * nothing is playing (the card is left alone while a track plays). At
+ * startup, a channel whose folder still has the same number of tracks
+ * carries on from there; otherwise it starts over.
+ *
+ * Turned off, nothing is saved, and what was loaded is forgotten.
+ ----------------------------------------------------------------------*/
+
+void AudioPlayer::rememberTrackOrder(bool on) {
+  _rememberTracks = on;
+  if (!on) {
+    for (int channel = 0; channel < NUM_CHANNELS; channel++)
+      _resetTracks(channel);
+  }
+  _tu->logAction2("AudioPlayer: rememberTrackOrder: ", on);
+}
 
-  // Assign each file number a random position in the shuffle-array. If
-  // that position is already taken, use a secondary random number to try
-  // again. This is essentially hashing with a primary and secondary hash
-  // key. In the unlikely event that it fails after a reasonable number of
-  // attempts, reverts to a simple linear search for an empty slot.
+void AudioPlayer::_resetTracks(int channel) {
+  _selector[channel].setTracks(_fm->getNumFiles(channel));
+  _selector[channel].setWeights(_fm->getWeights(channel));
+}
 
-  for (int i = 0; i < NUM_FILES_IN_SUBDIR; i++) {
-    _shuffledTracks[channel][i] = -1;
+bool AudioPlayer::_loadTrackState() {
+  AudioNoInterrupts();
+  File file = SD.open(TRACK_STATE_FILE, FILE_READ);
+  AudioInterrupts();
+  if (!file)
+    return false;
+
+  char line[TRACK_SELECTOR_STATE_CHARS];
+  int loaded = 0;
+  for (int lineNumber = 0; lineNumber <= NUM_CHANNELS; lineNumber++) {
+    AudioNoInterrupts();
+    int n = file.readBytesUntil('\n', line, sizeof(line) - 1);
+    AudioInterrupts();
+    if (n <= 0)
+      break;
+    line[n] = 0;
+    if (lineNumber == 0) {
+      if (strncmp(line, "TactileAudio tracks 1", 21) != 0)
+        break;
+    } else if (_selector[lineNumber - 1].loadState(line)) {
+      loaded++;
+    }
   }
-  int numFiles = _fm->getNumFiles(channel);
-  if (numFiles <= 0)
-    return;
-  for (int i = 0; i < numFiles; i++) {
-    int r = random(numFiles);
-    int count = 0;
-    while (_shuffledTracks[channel][r] != -1) {       // if slot used, find another
-      int r2 = random(numFiles);
-      r = r + r2;
-      if (r >= numFiles)
-        r = r - numFiles;
-      if (++count > numFiles * 10) {  // didn't find one by random tries, should be rare
-        r = 0;
-        while (_shuffledTracks[channel][r] != -1) {
-          if (r >= (numFiles-1))
-            return;
-          r++;
-        }
-      }
+  AudioNoInterrupts();
+  file.close();
+  AudioInterrupts();
+  _tu->logAction2("AudioPlayer: track order carried on, channels: ", loaded);
+  return loaded > 0;
+}
+
+void AudioPlayer::_saveTrackState() {
+  char line[TRACK_SELECTOR_STATE_CHARS];
+  AudioNoInterrupts();
+  SD.remove(TRACK_STATE_FILE);
+  File file = SD.open(TRACK_STATE_FILE, FILE_WRITE);
+  bool saved = file;
+  if (saved) {
+    file.println("TactileAudio tracks 1");
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+      if (!_selector[channel].saveState(line, sizeof(line)))
+        line[0] = 0;                        // starts over
+      file.println(line);
     }
-    _shuffledTracks[channel][r] = i;
+    file.close();
   }
-  if (getLogLevel() > 1) {
-    Serial.print("AudioPlayer::_shuffleTracks(");
-    Serial.print(channel);
-    Serial.print("): ");
-    for (int i = 0; i < numFiles; i++) {
-      Serial.print(" "); 
-      Serial.print(_shuffledTracks[channel][i]);
+  AudioInterrupts();
+  _tracksChanged = false;
+  _tracksSavedTime = millis();
+  if (!saved)
+    _tu->log("AudioPlayer: can't save the track order");
+}
+
+/*----------------------------------------------------------------------
+ * Voices. A channel gets a voice from the pool when it prepares or
+ * starts a track. When it starts another, the voice it had is retired:
+ * it fades out (over the channel's fade-out time, at least
+ * VOICE_TAIL_MSEC) while the new track starts on a voice of its own, or,
+ * with layering, it plays on to its end. doTimerTasks() returns voices
+ * to the pool when they've finished.
+ *
+ * When every voice is busy, the pool's policy picks one to steal (see
+ * VoicePool.h). It fades out over VOICE_TAIL_MSEC, and the channel that
+ * was playing it is stopped.
+ ----------------------------------------------------------------------*/
+
+void AudioPlayer::setVoiceStealing(VoiceStealPolicy policy) {
+  _voices.setPolicy(policy);
+  _tu->logAction2("AudioPlayer: setVoiceStealing: ", (int)policy);
+}
+
+void AudioPlayer::setVoicePriority(int channel, int priority) {
+  _voicePriority[channel] = priority;
+}
+
+void AudioPlayer::setLayering(int channel, bool on) {
+  _layering[channel] = on;
+  _tu->logAction2("AudioPlayer: setLayering: ", on);
+}
+
+VoicePool *AudioPlayer::getVoicePool() {
+  return &_voices;
+}
+
+AudioPlaySdWavPR *AudioPlayer::_getPlayer(int channel) {
+  if (channel < 0 || channel >= NUM_CHANNELS) {
+    _tu->logAction("AudioPlayer: Invalid channel: ", channel);
+    return NULL;
+  }
+  if (_voice[channel] < 0)
+    return NULL;
+  return &voicePlayers[_voice[channel]];
+}
+
+// Makes a voice the channel's current one. If steal, one is always
+// found, and if that took the last one, another is stolen now so that
+// the next sound won't have to cut one off.
+
+int AudioPlayer::_allocateVoice(int channel, bool steal) {
+  if (steal && _voices.getNumInUse() == NUM_VOICES)
+    _recyclePreopened(channel);            // rather than cut a sound off
+  for (int voice = 0; voice < NUM_VOICES; voice++)
+    _voices.setLevel(voice, (int32_t)(voiceGain(voice) * MIXER_UNITY));
+  int cutFrom;
+  int voice = _voices.allocate(channel, _voicePriority[channel], steal, &cutFrom);
+  if (voice < 0)
+    return -1;
+  if (cutFrom >= 0) {                       // sounds are starting faster than tails end
+    _disownVoice(voice, cutFrom);
+    _silenceVoice(voice);
+    _tu->logAction2("AudioPlayer: voice cut off: ", voice);
+  }
+  _voice[channel] = voice;
+  _voiceStartTime[voice] = millis();
+#ifdef TACTILE_LATENCY_PROBE
+  voicePlayers[voice].setLatencyChannel(channel);
+#endif
+
+  if (steal) {
+    int victim = _voices.findVictim(voice);
+    if (victim >= 0 && _recyclePreopened(channel))
+      victim = -1;                          // that's the free voice for the next sound
+    if (victim >= 0) {
+      _disownVoice(victim, _voices.getChannel(victim));
+      _voices.steal(victim);
+      _tailVoice(victim, VOICE_TAIL_MSEC);
+      _tu->logAction2("AudioPlayer: voice stolen: ", victim);
     }
-    Serial.print("\n");
   }
+  return voice;
 }
 
-void AudioPlayer::setPlayTrackAction(int channel, playTrackActionType playAction) {
-  _playAction[channel] = playAction;
-  _shufflePosition[channel] = 0;
-  if (playAction == playShuffled || playAction == playReshuffled) {
-    _shuffleTracks(channel);
+// The channel's current voice makes way for a new one. A prepared track
+// stays: startTrack() plays it.
+
+void AudioPlayer::_retireVoice(int channel) {
+  int voice = _voice[channel];
+  if (voice < 0)
+    return;
+  AudioPlaySdWavPR *player = &voicePlayers[voice];
+  if (player->isPrepared())
+    return;
+  bool layer = _layering[channel] && _lastStartTime[channel] > 0;
+  int time = _calculateFadeTime(channel, false);
+  _voice[channel] = -1;
+  _isPaused[channel] = false;
+  if (!player->isPlaying() || player->isPaused()) {
+    _freeVoice(voice);
+  } else if (!layer) {
+    _voices.release(voice);
+    _tailVoice(voice, time > VOICE_TAIL_MSEC ? time : VOICE_TAIL_MSEC);
+  } else {
+    player->setLoop(false);               // a layer plays on to its end, once
   }
-}          
+}
 
-void AudioPlayer::setLoopMode(int channel, bool on) {
-  _loopMode[channel] = on;
+// A voice is taken away from the channel it was current for (if it was):
+// as far as the channel knows, its track stopped.
+
+void AudioPlayer::_disownVoice(int voice, int channel) {
+  if (channel < 0 || _voice[channel] != voice)
+    return;
+  _voice[channel] = -1;
+  _preopened[channel] = false;
+  if (voicePlayers[voice].isPrepared()) {
+    voicePlayers[voice].cancel();
+    _voices.setArmed(voice, false);
+    _prepareMisses[channel]++;
+  }
+  _isPaused[channel] = false;
+  _lastStartTime[channel] = 0;
+  _lastStopTime[channel] = 0;
+}
+
+void AudioPlayer::_tailVoice(int voice, int milliseconds) {
+  int channel = _voices.getChannel(voice);
+  setVoiceGain(voice, 0.0, milliseconds, channel >= 0 ? _fadeCurve[channel] : fadeLinear);
+}
+
+// Stops the voice's player (or cancels its prepared track) and lets go
+// of whatever it was playing from, so it can start something else.
+
+void AudioPlayer::_silenceVoice(int voice) {
+  voicePlayers[voice].stop();
+  _voices.setArmed(voice, false);
+  setVoiceGain(voice, 0.0, 0, fadeLinear);
+  _prerolling[voice] = NULL;
+  _updateCache(voice);
 }
 
-AudioPlaySdWavPR *AudioPlayer::_getPlayerByTrack(int channel) {
-  switch (channel) {
-  case 0: return &playSdWav1;
-  case 1: return &playSdWav2;
-  case 2: return &playSdWav3;
-  case 3: return &playSdWav4;
+void AudioPlayer::_freeVoice(int voice) {
+  _silenceVoice(voice);
+  _voices.free(voice);
+}
+
+// Voices that aren't any channel's current one go back to the pool when
+// their track ends or their tail has faded out; a current one, when its
+// channel is done with it. Not in the first 50 msec (see doTimerTasks()).
+
+void AudioPlayer::_updateVoices() {
+  uint32_t now = millis();
+  for (int voice = 0; voice < NUM_VOICES; voice++) {
+    int channel = _voices.getChannel(voice);
+    if (channel < 0 || now - _voiceStartTime[voice] <= 50)
+      continue;
+    AudioPlaySdWavPR *player = &voicePlayers[voice];
+    if (_voice[channel] == voice) {
+      if (_lastStartTime[channel] == 0 && !_isPaused[channel]
+          && !player->isPlaying() && !player->isPrepared()) {
+        _voice[channel] = -1;
+        _freeVoice(voice);
+      }
+    } else if (!player->isPlaying()
+               || (_voices.isReleased(voice) && !voiceIsRamping(voice) && voiceGain(voice) <= 0.0)) {
+      _freeVoice(voice);
+    }
   }
-  _tu->logAction("AudioPlayer: Invalid channel: ", channel);
-  return NULL;  // to keep compiler happy, never happens
 }
 
+/*----------------------------------------------------------------------
+ * The next track of a channel is chosen once (single, random or shuffled)
+ * and stays chosen until it's played. So a track that was prepared ahead
+ * of a touch (see prepareTrack()) and then cancelled is still the one
+ * that's played next, and shuffling doesn't skip tracks.
+ ----------------------------------------------------------------------*/
+
 void AudioPlayer::startTrack(int channel) {
-  if (_playAction[channel] == playSingle)
-    _startTrack(channel);
-  else
-    _startRandomTrack(channel); // random includes shuffled
-  if (_fadeInTime[channel] == 0)
-    _setActualVolume(channel, _targetVolume[channel]);
-  else
-    _thisFadeInTime[channel] = _calculateFadeTime(channel, true);
+  if (channel < 0 || channel >= NUM_CHANNELS) return;
+  LATENCY_MARK(channel, latencyPlay, micros());
+  if (!_startVoice(channel))
+    return;
+  _rampVolume(channel, _targetVolume[channel], _calculateFadeTime(channel, true));
   _lastStartTime[channel] = millis();
   _lastStopTime[channel] = 0;
 }
 
-void AudioPlayer::_startTrack(int channel) {
-  const char *trackName = _fm->getFileName(channel);
-  if (!trackName) {
-    _tu->logAction("Can't find that track: ", channel);
-    return;
+// Starts the channel's next track, silently: the voice's gain is left
+// for the caller to ramp up. False if there's no voice to start it on.
+
+bool AudioPlayer::_startVoice(int channel) {
+  AudioPlaySdWavPR *player = _getPlayer(channel);
+  if (player && player->isPrepared()) {
+    _captureIntoCache(_voice[channel], _nextTrackPath[channel]);
+    player->start();
+    _voices.setArmed(_voice[channel], false);
+    _preopened[channel] = false;
+    _prepareHits[channel]++;
+    _tu->logAction2("AudioPlayer: start prepared track ", channel);
+  } else {
+    _retireVoice(channel);
+    int voice = _allocateVoice(channel, true);
+    if (voice < 0) return false;
+    player = &voicePlayers[voice];
+    player->setLoop(_loopMode[channel], _loopCrossfade[channel]);
+    const char *path = _nextTrack(channel);
+    SampleCacheEntry *cached = _cache.lookup(path);
+    const PrerollEntry *preroll = _preroll.find(path);
+    if (cached) {
+      player->playMemory(&cached->format, cached->data);
+      _cachePlaying[voice] = cached;
+    } else if (preroll) {
+      player->playPreroll(preroll);       // the file is opened later, see _continuePrerolls()
+      _prerolling[voice] = preroll;
+      _underrunBase[voice] = player->underruns();
+      _prerollHits[channel]++;
+    } else if (path && player->prepare(path)) {
+      _captureIntoCache(voice, path);
+      player->start();
+      if (_prerollLazy && _prerollMillis > 0)
+        strcpy(_prerollPending[channel], path);
+    }
   }
-  AudioPlaySdWavPR *player = _getPlayerByTrack(channel);
-  if (!player) return;
-  player->play(trackName);
   if (getLogLevel() > 1) {
     Serial.print("AudioPlayer: start track ");
     Serial.print(channel);
     Serial.print(", ");
-    Serial.println(trackName);
+    Serial.println(_nextTrackPath[channel]);
   }
+  _nextTrackPath[channel][0] = 0;
+  return true;
 }
 
-void AudioPlayer::_startRandomTrack(int channel) {
+/*----------------------------------------------------------------------
+ * Crossfade. Hands the sound over from one channel to another: to's
+ * track fades in while from's fades out, over the crossfade time, both
+ * on equal-power curves, so that (at equal volumes) the loudness
+ * neither dips nor bumps in the middle. The new track is opened first
+ * (if pre-arming hasn't already), while from's plays on at full volume,
+ * and only then are both ramps posted, with the audio interrupt off, so
+ * they start in the same block: no gap, and the two curves stay in
+ * step. from is stopped at once, as far as the
+ * channel is concerned; its voice fades out as a tail.
+ ----------------------------------------------------------------------*/
 
-  _tu->logAction2("AudioPlayer: startRandomTrack ", channel);
+void AudioPlayer::setCrossfadeTime(int milliseconds) {
+  _crossfadeTime = milliseconds > 0 ? milliseconds : 0;
+  _tu->logAction2("AudioPlayer: setCrossfadeTime: ", _crossfadeTime);
+}
 
-  AudioPlaySdWavPR *player = _getPlayerByTrack(channel);
-  if (!player) return;
+int AudioPlayer::getCrossfadeTime() {
+  return _crossfadeTime;
+}
 
-  int numFiles = _fm->getNumFiles(channel);
-  _tu->logAction2("AudioPlayer: Files in directory: ", numFiles);
-  if (numFiles < 1) return;
+void AudioPlayer::crossfade(int fromChannel, int toChannel) {
+  if (fromChannel < 0 || fromChannel >= NUM_CHANNELS || toChannel < 0 || toChannel >= NUM_CHANNELS)
+    return;
+  if (fromChannel == toChannel || _crossfadeTime == 0 || !isPlaying(fromChannel) || _isPaused[fromChannel]) {
+    stopTrack(fromChannel);
+    startTrack(toChannel);
+    return;
+  }
+  LATENCY_MARK(toChannel, latencyPlay, micros());
+  bool started = _startVoice(toChannel);
+  int fromVoice = _voice[fromChannel];     // (could have been stolen just now)
+  int toVoice = _voice[toChannel];
+  if (fromVoice >= 0)
+    _voices.release(fromVoice);
+
+  float toGain = (float)_targetVolume[toChannel] / 100.0;
+  AudioNoInterrupts();
+  if (started)
+    setVoiceGain(toVoice, toGain, _crossfadeTime, fadeEqualPower, true);
+  if (fromVoice >= 0)
+    setVoiceGain(fromVoice, 0.0, _crossfadeTime, fadeEqualPower, true);
+  AudioInterrupts();
+
+  _voice[fromChannel] = -1;
+  _lastStartTime[fromChannel] = 0;
+  _lastStopTime[fromChannel] = 0;
+  if (started) {
+    _lastStartTime[toChannel] = millis();
+    _lastStopTime[toChannel] = 0;
+  }
+  _tu->logAction2("AudioPlayer: crossfade to ", toChannel);
+}
 
-  int r;
+// Opening the file and reading the first of it takes longer than
+// everything else about starting a track, so it's done here, before the
+// touch, and startTrack() only has to switch it on. Not while the
+// channel is playing or paused; if it's fading out, that goes on on its
+// own voice. Only on a free voice: a sound isn't stolen for a track
+// that may never be played.
+
+bool AudioPlayer::prepareTrack(int channel, bool fill) {
+  if (channel < 0 || channel >= NUM_CHANNELS)
+    return false;
+  AudioPlaySdWavPR *player = _getPlayer(channel);
+  if ((player && player->isPrepared()) || _lastStartTime[channel] > 0 || _isPaused[channel])
+    return false;
+  _updateCache();                          // a track that's just been captured counts
+  const char *path = _nextTrack(channel);
+  if (!path || _cache.isCached(path))      // nothing to gain
+    return false;
+  _retireVoice(channel);
+  int voice = _allocateVoice(channel, false);
+  if (voice < 0)
+    return false;
+  _tu->logAction2("AudioPlayer: prepare track ", channel);
+  voicePlayers[voice].setLoop(_loopMode[channel], _loopCrossfade[channel]);
+  if (voicePlayers[voice].prepare(path, fill)) {
+    _voices.setArmed(voice, true);
+    return true;
+  }
+  _voice[channel] = -1;
+  _freeVoice(voice);
+  return false;
+}
 
-  // Shuffle mode: select next track from the shuffled array
-  if (_playAction[channel] == playShuffled || _playAction[channel] == playReshuffled) {
-    r = _shuffledTracks[channel][_shufflePosition[channel]];
-    _shufflePosition[channel] += 1;
-    if (_shufflePosition[channel] >= numFiles) {        // end of shuffled list
-      _shufflePosition[channel] = 0;                    // start again
-      if (_playAction[channel] == playReshuffled)       // time to reshuffle?
-        _shuffleTracks(channel);
+void AudioPlayer::cancelPreparedTrack(int channel) {
+  int voice = _voice[channel];
+  if (voice < 0 || !voicePlayers[voice].isPrepared() || _preopened[channel])
+    return;
+  _voice[channel] = -1;
+  _freeVoice(voice);
+  _prepareMisses[channel]++;
+  _tu->logAction2("AudioPlayer: prepared track cancelled ", channel);
+}
+
+void AudioPlayer::getPrepareStats(int channel, uint32_t *hits, uint32_t *misses) {
+  *hits = _prepareHits[channel];
+  *misses = _prepareMisses[channel];
+}
+
+/*----------------------------------------------------------------------
+ * Pre-open. Pre-arming (prepareTrack() when a hand comes near) only
+ * helps when there's a proximity sensor and the hand is slow enough. A
+ * pre-opened track is prepared as soon as the channel is idle: its next
+ * track is chosen (the next in the shuffle, or a random draw), opened,
+ * its header parsed and, with fill, its first buffer read, so a touch
+ * costs no card access at all. It stays open until it's played; moving
+ * the hand away doesn't cancel it.
+ *
+ * Each one holds a voice and its file, so there are at most maxTracks
+ * of them, and only while two voices are free: a sound that starts
+ * always has a voice, and one to steal ahead (see VoicePool.h). When
+ * voices run short, a pre-opened track is closed (recycled) before a
+ * sound is stolen; its channel opens it again when it's idle.
+ ----------------------------------------------------------------------*/
+
+void AudioPlayer::usePreopen(int maxTracks, bool fill) {
+  if (maxTracks < 0)
+    maxTracks = 0;
+  else if (maxTracks > NUM_CHANNELS)
+    maxTracks = NUM_CHANNELS;
+  _preopenMax = maxTracks;
+  _preopenFill = fill;
+  int numOpen = 0;
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    if (_preopened[channel] && ++numOpen > _preopenMax) {
+      _preopened[channel] = false;
+      cancelPreparedTrack(channel);
     }
-    _tu->logAction2("AudioPlayer: Shuffled track selected: ", r);
   }
+}
+
+// Call from the loop, for a channel that could be touched; does nothing
+// if the channel isn't idle or is ready already.
+
+bool AudioPlayer::preopenTrack(int channel) {
+  if (channel < 0 || channel >= NUM_CHANNELS || _preopenMax == 0)
+    return false;
+  int numOpen;
+  uint32_t recycled;
+  getPreopenStats(&numOpen, &recycled);
+  if (numOpen >= _preopenMax || NUM_VOICES - _voices.getNumInUse() < 2)
+    return false;
+  if (!prepareTrack(channel, _preopenFill))
+    return false;
+  _preopened[channel] = true;
+  return true;
+}
+
+void AudioPlayer::getPreopenStats(int *numOpen, uint32_t *recycled) {
+  *numOpen = 0;
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    if (_preopened[channel])
+      (*numOpen)++;
+  }
+  *recycled = _preopenRecycled;
+}
 
-  // Pure random mode: select track randomly (but avoid last track played).
-  else {
-    int tries = 0;
-    while (tries < 30) {
-      r = random(numFiles);
-      if (r != _lastRandomTrackPlayed[channel])       // avoid last track played
-        break;
-      tries++;
+// Closes another channel's pre-opened track, to free its voice.
+
+bool AudioPlayer::_recyclePreopened(int exceptChannel) {
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    int voice = _voice[channel];
+    if (channel == exceptChannel || !_preopened[channel] || voice < 0)
+      continue;
+    _disownVoice(voice, channel);
+    _freeVoice(voice);
+    _preopenRecycled++;
+    _tu->logAction2("AudioPlayer: pre-opened track closed ", channel);
+    return true;
+  }
+  return false;
+}
+
+const char *AudioPlayer::_nextTrack(int channel) {
+  if (_nextTrackPath[channel][0])
+    return _nextTrackPath[channel];
+
+  if (_playAction[channel] == playSingle) {
+    if (!_fm->getPath(channel, _nextTrackPath[channel])) {
+      _tu->logAction("Can't find that track: ", channel);
+      return NULL;
     }
-    _lastRandomTrackPlayed[channel] = r;
-    _tu->logAction2("AudioPlayer: Random track selected: ", r);
+    return _nextTrackPath[channel];
   }
 
-  const char *fileName = _fm->getFileName(channel, r);
-  if (!fileName) {
+  _tu->logAction2("AudioPlayer: choose random track ", channel);
+  int numFiles = _fm->getNumFiles(channel);
+  _tu->logAction2("AudioPlayer: Files in directory: ", numFiles);
+  if (numFiles < 1)
+    return NULL;
+  int r = _chooseRandomTrack(channel);
+
+  char *filePath = _nextTrackPath[channel];
+  if (!_fm->getPath(channel, r, filePath)) {
     _tu->logAction2("Error, couldn't get random filename (this shouldn't happen) for track ", channel);
-    return;
+    return NULL;
   }
-
-  char filePath[MAX_FILE_NAME+5] = "/Ex/";
-  filePath[2] = '1' + channel;  // i.e. /E1/, /E2/, ...
-  strcpy(filePath+4, fileName);
   _tu->log2(filePath);
 
-  player->play(filePath);
-
   if (getLogLevel() > 1) {
     if (_playAction[channel] == playRandom)
-      Serial.print("AudioPlayer: start random track: ");
+      Serial.print("AudioPlayer: random track: ");
     else
-      Serial.print("AudioPlayer: start shuffled track: ");
+      Serial.print("AudioPlayer: shuffled track: ");
     Serial.print(filePath);
     Serial.print(" (");
     Serial.print(channel);
@@ -318,18 +884,46 @@ void AudioPlayer::_startRandomTrack(int channel) {
     Serial.print(r);
     Serial.println(")");
   }
+  return filePath;
+}
+
+// The selector picks up where the channel's order left off, whichever
+// way it was last played; it only starts over if the folder changes.
+
+int AudioPlayer::_chooseRandomTrack(int channel) {
+  int r;
+  if (_playAction[channel] == playShuffled || _playAction[channel] == playReshuffled) {
+    r = _selector[channel].nextShuffled(_playAction[channel] == playReshuffled);
+    _tu->logAction2("AudioPlayer: Shuffled track selected: ", r);
+  } else {
+    r = _selector[channel].nextRandom();
+    _tu->logAction2("AudioPlayer: Random track selected: ", r);
+  }
+  _tracksChanged = true;
+  return r;
 }
 
 void AudioPlayer::stopTrack(int channel) {
-  AudioPlaySdWavPR *player = _getPlayerByTrack(channel);
+  if (channel < 0 || channel >= NUM_CHANNELS) return;
+
+  // Layers of the channel fade out with it (but not when the last one
+  // simply came to its end)
+  for (int voice = 0; voice < NUM_VOICES && _lastStartTime[channel] > 0; voice++) {
+    if (voice != _voice[channel] && _voices.getChannel(voice) == channel && !_voices.isReleased(voice)) {
+      _voices.release(voice);
+      _tailVoice(voice, _fadeOutTime[channel] > VOICE_TAIL_MSEC ? _fadeOutTime[channel] : VOICE_TAIL_MSEC);
+    }
+  }
+
+  AudioPlaySdWavPR *player = _getPlayer(channel);
   if (!player) return;
   if (_fadeOutTime[channel] == 0) {
     player->stop();
-    _setActualVolume(channel, 0);
+    _rampVolume(channel, 0, 0);
   } else {
     // If fade-out enabled, don't actually stop the track. That will happen
-    // when fade-out finishes (see _doFadeInOut(), below).
-    _thisFadeOutTime[channel] = _calculateFadeTime(channel, false);
+    // when fade-out finishes (see _finishFadeOut(), below).
+    _rampVolume(channel, 0, _calculateFadeTime(channel, false));
   }
 
   _tu->logAction2("AudioPlayer: stop ", channel);
@@ -338,7 +932,7 @@ void AudioPlayer::stopTrack(int channel) {
 }  
 
 bool AudioPlayer::isPlaying(int channel) {
-  AudioPlaySdWavPR *player = _getPlayerByTrack(channel);
+  AudioPlaySdWavPR *player = _getPlayer(channel);
   if (!player) return 0;
   return player->isPlaying();
 }
@@ -348,15 +942,15 @@ bool AudioPlayer::isPlaying(int channel) {
  ----------------------------------------------------------------------*/
 
 void AudioPlayer::pauseTrack(int channel) {
-  AudioPlaySdWavPR *player = _getPlayerByTrack(channel);
+  AudioPlaySdWavPR *player = _getPlayer(channel);
   if (!player|| !player->isPlaying()) return; 
   if (_fadeOutTime[channel] == 0) {
     player->pause();
-    _setActualVolume(channel, 0);
+    _rampVolume(channel, 0, 0);
   } else {
     // If fade-out enabled, don't actually pause the track. That will happen
-    // when fade-out finishes (see _doFadeInOut(), below).
-    _thisFadeOutTime[channel] = _calculateFadeTime(channel, false);
+    // when fade-out finishes (see _finishFadeOut(), below).
+    _rampVolume(channel, 0, _calculateFadeTime(channel, false));
   }
   _isPaused[channel] = true;
   _lastStartTime[channel] = 0;
@@ -366,15 +960,12 @@ void AudioPlayer::pauseTrack(int channel) {
 
 void AudioPlayer::resumeTrack(int channel) {
 
-  AudioPlaySdWavPR *player = _getPlayerByTrack(channel);
-  if (!player) return;
+  AudioPlaySdWavPR *player = _getPlayer(channel);
+  if (!player) return;                     // never started, or its voice was stolen
 
   player->resume();
   _isPaused[channel] = false;
-  if (_fadeInTime[channel] == 0)
-    _setActualVolume(channel, _targetVolume[channel]);
-  else
-    _thisFadeInTime[channel] = _calculateFadeTime(channel, true);
+  _rampVolume(channel, _targetVolume[channel], _calculateFadeTime(channel, true));
 
   _lastStartTime[channel] = millis();
   _lastStopTime[channel] = 0;
@@ -386,122 +977,290 @@ bool AudioPlayer::isPaused(int channel) {
   return _isPaused[channel];
 }
 
+// A full fade (between zero and the channel's volume) takes the fade-in or
+// fade-out time; a fade that starts part way, because the last one was
+// interrupted, takes the same fraction of it.
+
 int AudioPlayer::_calculateFadeTime(int channel, bool goingUp) {
+  int target = _targetVolume[channel];
+  int current = _currentVolume(channel);
   int deltaVolume;
   int fadeTime;
+  if (target <= 0)
+    return 0;
   if (goingUp) {
-    deltaVolume = 100 - _actualVolume[channel];
+    deltaVolume = target - current;
     fadeTime = _fadeInTime[channel];
   } else {
-    deltaVolume = _actualVolume[channel];
+    deltaVolume = current;
     fadeTime = _fadeOutTime[channel];
   }
-  int time = (int)(0.499 + (float)fadeTime * (float)deltaVolume/100.0);
+  if (deltaVolume <= 0)
+    return 0;
+  if (deltaVolume > target)
+    deltaVolume = target;
+  int time = (int)(0.499 + (float)fadeTime * (float)deltaVolume/(float)target);
   return time;
 }
 
-void AudioPlayer::_doFadeInOut(int channel)
+// When fade-out is enabled, a track can be in the "is stopped" state but
+// still be actually playing. Only when the mixer's gain gets to zero is
+// the track actually stopped (or paused). Note that _isPaused is true as
+// soon as pauseTrack() is called, but the track keeps playing until this
+// fade-out finishes.
+
+void AudioPlayer::_finishFadeOut(int channel)
 {
-  int targetVol = _targetVolume[channel];
-  int actualVol = _actualVolume[channel];
-
-  // Do fade-in? When fade-in is enabled, tracks are started at zero volume,
-  // so they're initially in the "is playing" state even though the volume
-  // is zero.
-
-  if (_lastStartTime[channel] > 0
-      && _fadeInTime[channel] != 0
-      && actualVol < targetVol
-      && isPlaying(channel)) {
-
-    // Calculate the target volume based on how much elapsed time since the track started playing.
-    unsigned long elapsedTime = millis() - _lastStartTime[channel];
-
-    // But if _thisFadeInTime is different that _fadeInTime, it means we started in the middle
-    // of a fade-out (i.e. the volume wasn't zero yet), so push the elapsed time forward by
-    // difference of the two.
-    if (_fadeInTime[channel] != _thisFadeInTime[channel])
-      elapsedTime += _fadeInTime[channel] - _thisFadeInTime[channel]; // push elapsed time forward
-    
-    int newVolumePercent = int((float)targetVol*(float)elapsedTime/(float)_fadeInTime[channel]);
-    
-    // Time to increase volume?
-    if (newVolumePercent != actualVol) {
-      if (newVolumePercent >= targetVol) {
-	newVolumePercent = targetVol;
-      }
-      _setActualVolume(channel, newVolumePercent);
-    }
+  if (_fadeOutTime[channel] == 0                    // fade-out isn't enabled
+      || _lastStopTime[channel] == 0                // the track isn't stopped or paused...
+      || !isPlaying(channel)                        // ... or isn't still playing
+      || voiceIsRamping(_voice[channel])            // or the fade-out isn't finished
+      || voiceGain(_voice[channel]) > 0.0)
+    return;
+
+  AudioPlaySdWavPR *player = _getPlayer(channel);
+  if (!player) return;
+  if (isPaused(channel)) {
+    player->pause();
+    _tu->logAction2("AudioPlayer: fade-out done, track paused: ", channel);
+  } else {
+    player->stop();
+    _tu->logAction2("AudioPlayer: fade-out done, track stopped: ", channel);
   }
+  _lastStopTime[channel] = 0;
+}
 
-  // Else -- do fade-out? When fade-out is enabled, a track can be in the "is stopped"
-  // state but still be actually playing. Only when the target volume gets to zero
-  // is the track actually stopped.
+/*----------------------------------------------------------------------
+ * Pre-roll. With a Teensy 4.1's PSRAM chip, the first part of each track
+ * is kept in memory, so a touch starts the sound with the next audio
+ * update. The file is opened afterwards, by doTimerTasks(), and the
+ * player carries on from the card at the first sample after the
+ * pre-roll. The pre-roll only has to cover the time it takes to open
+ * the file; 300 msec is plenty.
+ *
+ * The tracks are loaded at startup, until the budget is used up (tracks
+ * that don't fit are played from the card as usual). Or, "lazy", each
+ * track is loaded after it's first played, at a moment when no track is
+ * playing (loading one takes tens of msec).
+ ----------------------------------------------------------------------*/
 
-  else if (_fadeOutTime[channel] != 0               // fade-out is enabled
-           && _lastStopTime[channel] > 0            // the track is stopped or paused...
-           && isPlaying(channel)                    // ... but the track is still playing
-	   && actualVol > 0) {                      // and volume hasn't reached zero yet
+bool AudioPlayer::usePreroll(int milliseconds, int budgetKB, bool lazy) {
+  _preroll.setPool(NULL, 0);
+  if (_prerollPool)
+    extmem_free(_prerollPool);
+  _prerollPool = NULL;
+  _prerollMillis = 0;
+  for (int voice = 0; voice < NUM_VOICES; voice++)
+    _prerolling[voice] = NULL;
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    _prerollPending[channel][0] = 0;
+  if (milliseconds <= 0)
+    return true;
 
-    // Calculate the target volume based on how much elapsed time since the track stopped playing.
-    unsigned long elapsedTime = millis() - _lastStopTime[channel];
+  if (external_psram_size == 0) {
+    Serial.println("AudioPlayer: pre-roll needs a PSRAM chip; none found.");
+    return false;
+  }
+  uint32_t budget = (uint32_t)external_psram_size * 1024 - PREROLL_PSRAM_RESERVE_KB;
+  if (budgetKB > 0 && (uint32_t)budgetKB < budget)
+    budget = budgetKB;
+  _prerollPool = (uint8_t *)extmem_malloc(budget * 1024);
+  if (!_prerollPool) {
+    Serial.println("AudioPlayer: can't allocate the pre-roll memory.");
+    return false;
+  }
+  _preroll.setPool(_prerollPool, budget * 1024);
+  _prerollMillis = milliseconds;
+  _prerollLazy = lazy;
+  if (lazy)
+    return true;
 
-    // But if _thisFadeOutTime is different than _fadeOutTime, it means we started with volume less
-    // than 100%, so push elapsed time forward by the difference of the two.
-    if (_fadeOutTime[channel] != _thisFadeOutTime[channel]) {
-      elapsedTime += _fadeOutTime[channel] - _thisFadeOutTime[channel];
+  char path[MAX_PATH_NAME];
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    if (_fm->getPath(channel, path))
+      _prerollTrack(path);
+    for (int fileNum = 0; fileNum < _fm->getNumFiles(channel); fileNum++) {
+      if (_fm->getPath(channel, fileNum, path))
+        _prerollTrack(path);
     }
+  }
+  return true;
+}
 
-    int newVolumePercent = targetVol - int((float)(targetVol)*(float)elapsedTime/(float)_fadeOutTime[channel]);
-
-    if (newVolumePercent != actualVol) {
-
-      // Time to decrease volume.
-      if (newVolumePercent < 0)
-	newVolumePercent = 0;
-      _setActualVolume(channel, newVolumePercent);
-
-      // If fade-out reached zero volume, actually stop or pause the track.
-      // Note that _isPaused is true as soon as pauseTrack()
-      // is called, but the track keeps playing until this fade-out finishes.
-      if (newVolumePercent == 0) {
-        AudioPlaySdWavPR *player = _getPlayerByTrack(channel);
-        if (!player) return;
-	if (isPaused(channel)) {
-          player->pause();
-	  _tu->logAction2("AudioPlayer: fade-out done, track paused: ", channel);
-	} else {
-	  player->stop();
-          _tu->logAction2("AudioPlayer: fade-out done, track stopped: ", channel);
-	}
-        _lastStopTime[channel] = 0;
-      }
+void AudioPlayer::_prerollTrack(const char *path) {
+  if (_preroll.add(&_prerollFile, path, _prerollMillis)) {
+    _tu->log2(path);
+  } else if (getLogLevel() > 0) {
+    Serial.print("AudioPlayer: no pre-roll for ");
+    Serial.println(path);
+  }
+}
+
+// Once a pre-roll's first block is out, the file can be opened. If the
+// whole track fitted in the pre-roll, it never needs the file.
+
+// The blocks of silence while waiting for the card are counted for the
+// channel once the file is open (there can't be any more after that).
+
+void AudioPlayer::_continuePrerolls() {
+  for (int voice = 0; voice < NUM_VOICES; voice++) {
+    const PrerollEntry *preroll = _prerolling[voice];
+    if (!preroll)
+      continue;
+    AudioPlaySdWavPR *player = &voicePlayers[voice];
+    if (!player->needsCard()) {
+      _prerolling[voice] = NULL;
+      continue;
+    }
+    if (player->positionMillis() == 0)
+      continue;
+    player->continueFromCard(preroll->path, _cardIsFree(voice));
+    int channel = _voices.getChannel(voice);
+    if (channel >= 0)
+      _prerollUnderruns[channel] += player->underruns() - _underrunBase[voice];
+    _prerolling[voice] = NULL;
+  }
+
+  if (!_prerollLazy || _prerollMillis == 0)
+    return;
+  for (int voice = 0; voice < NUM_VOICES; voice++) {
+    AudioPlaySdWavPR *player = &voicePlayers[voice];
+    if (player->isPlaying() || player->isPrepared())
+      return;
+  }
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    if (_prerollPending[channel][0]) {
+      _prerollTrack(_prerollPending[channel]);
+      _prerollPending[channel][0] = 0;
+      return;                              // one per loop
     }
   }
 }
 
+bool AudioPlayer::_cardIsFree(int voice) {
+  for (int other = 0; other < NUM_VOICES; other++) {
+    if (other != voice && voicePlayers[other].readsCard())
+      return false;
+  }
+  return true;
+}
+
+void AudioPlayer::getPrerollUsage(int *tracks, int *skipped, uint32_t *usedBytes, uint32_t *budgetBytes) {
+  *tracks = _preroll.getNumTracks();
+  *skipped = _preroll.getNumSkipped();
+  *usedBytes = _preroll.getUsedBytes();
+  *budgetBytes = _preroll.getPoolBytes();
+}
+
+void AudioPlayer::getPrerollStats(int channel, uint32_t *hits, uint32_t *underruns) {
+  *hits = _prerollHits[channel];
+  *underruns = _prerollUnderruns[channel];
+}
+
+/*----------------------------------------------------------------------
+ * Sample cache. Short tracks that are played over and over are kept
+ * whole in memory (PSRAM if there is any, otherwise the regular heap),
+ * up to a budget, evicting the least recently used. A track gets in by
+ * being played from the card: the player copies it as it streams it, so
+ * caching costs no extra card reads. After that it's played from
+ * memory, and the card is free for the other channels.
+ *
+ * maxTrackMillis is for stereo tracks; mono ones can be twice as long,
+ * IMA-ADPCM ones four times.
+ ----------------------------------------------------------------------*/
+
+static void *cacheAlloc(size_t bytes) {
+  return extmem_malloc(bytes);
+}
+
+static void cacheFree(void *memory) {
+  extmem_free(memory);
+}
+
+void AudioPlayer::useSampleCache(int budgetKB, int maxTrackMillis) {
+  if (budgetKB < 0)
+    budgetKB = 0;
+  uint32_t maxTrackBytes = (uint32_t)maxTrackMillis * 44100 * 4 / 1000;
+  _cache.setBudget((uint32_t)budgetKB * 1024, maxTrackBytes, cacheAlloc, cacheFree);
+  _tu->logAction2("AudioPlayer: sample cache KB: ", budgetKB);
+}
+
+SampleCache *AudioPlayer::getSampleCache() {
+  return &_cache;
+}
+
+// Between prepare() and start(): the player copies the track into a new
+// cache entry as it streams it.
+
+void AudioPlayer::_captureIntoCache(int voice, const char *path) {
+  AudioPlaySdWavPR *player = &voicePlayers[voice];
+  SampleCacheEntry *entry = _cache.allocate(path, player->format());
+  if (!entry)
+    return;
+  if (player->capture(entry->data))
+    _cacheLoading[voice] = entry;
+  else
+    _cache.discard(entry);
+}
+
+// A voice's player mustn't be reading an entry (or copying into one) when
+// that entry is released; a voice is stopped (see _silenceVoice()) before
+// it starts something else, so this lets go of it then.
+
+void AudioPlayer::_updateCache(int voice) {
+  AudioPlaySdWavPR *player = &voicePlayers[voice];
+  SampleCacheEntry *entry = _cacheLoading[voice];
+  if (entry) {
+    if (player->isCaptured()) {
+      _cache.complete(entry);
+      _cacheLoading[voice] = NULL;
+      _tu->log2(entry->path);
+    } else if (!player->isPlaying()) {
+      _cache.discard(entry);               // stopped before the end
+      _cacheLoading[voice] = NULL;
+    }
+  }
+  entry = _cachePlaying[voice];
+  if (entry && !player->isPlaying()) {
+    _cache.release(entry);
+    _cachePlaying[voice] = NULL;
+  }
+}
+
+void AudioPlayer::_updateCache() {
+  for (int voice = 0; voice < NUM_VOICES; voice++)
+    _updateCache(voice);
+}
+
 void AudioPlayer::doTimerTasks()
 {
+  _continuePrerolls();
+  _updateCache();
+  _updateVoices();
+
   for (int channel = 0; channel < NUM_CHANNELS; channel++)
-    _doFadeInOut(channel);
+    _finishFadeOut(channel);
+
+  if (_rememberTracks && _tracksChanged && millis() - _tracksSavedTime > TRACK_STATE_SAVE_MSEC) {
+    bool playing = false;
+    for (int voice = 0; voice < NUM_VOICES; voice++)
+      playing = playing || voicePlayers[voice].isPlaying();
+    if (!playing)
+      _saveTrackState();
+  }
 
   // If a track that was playing reached the end of the track, change its status.
   for (int channel = 0; channel < NUM_CHANNELS; channel++) {
     if (_lastStartTime[channel] > 0) {
-      AudioPlaySdWavPR *player = _getPlayerByTrack(channel);
-      if (!player) return;
+      AudioPlaySdWavPR *player = _getPlayer(channel);
+      if (!player) continue;
       uint32_t now = millis();
       if (now - _lastStartTime[channel] > 50) {  // Player doesn't reliably report isPlaying() for a
         if (!player->isPlaying()) {                  // few msec, so if it just started playing, skip this.
-          if (_loopMode[channel]) {
-            startTrack(channel);
-            _tu->logAction2("end of track, looping: ", channel);
-          } else {
-            _lastStartTime[channel] = 0;
-            _lastStopTime[channel] = now;
-            _tu->logAction2("end of track ", channel);
-            stopTrack(channel);
-          }
+          _lastStartTime[channel] = 0;               // (a looping track only ends on a card error)
+          _lastStopTime[channel] = now;
+          _tu->logAction2("end of track ", channel);
+          stopTrack(channel);
         }
       }
     }
@@ -30,6 +30,42 @@
 #include "TeensyUtils.h"
 #include "AudioFileManager.h"
 #include "AudioPlaySdWavPR.h"     // extension of AudioPlayer.h that adds pause/resume feature
+#include "AudioMixerRamp.h"
+#include "AudioEffectLimiter.h"
+#include "AudioAnalyzeEnvelope.h"
+#include "PrerollCache.h"
+#include "SampleCache.h"
+#include "SdSampleFile.h"
+#include "TrackSelector.h"
+#include "VoicePool.h"
+
+#define PREROLL_PSRAM_RESERVE_KB 256     // left for other uses when the budget is "all of it"
+#define VOICE_TAIL_MSEC 20               // fade-out of a stolen or retriggered voice, at least
+#define TRACK_STATE_FILE "/_TRACKS.TXT"  // random/shuffle state, see rememberTrackOrder()
+#define TRACK_STATE_SAVE_MSEC 10000      // at most this often, and only when nothing is playing
+#define LIMITER_HEADROOM_SHIFT 2         // with a limiter, the voices are mixed at 1/4 (12 dB down)
+#define LIMITER_THRESHOLD_DB -1.0
+#define LIMITER_CODEC_MAX_GAIN LIMITER_HEADROOM_SHIFT   // SGTL5000 AVC maxGain: 0, 1, 2 = 0, 6, 12 dB, one 6 dB step per shift
+#define SGTL5000_I2C_ADDRESS 0x0A
+
+// The master bus limiter (see useLimiter()):
+//  limiterOff   -- the mix goes straight out, and clips if it's too loud
+//  limiterAuto  -- the SGTL5000's if it answers, otherwise the CPU's
+//  limiterChip  -- the SGTL5000's audio processor; no CPU time
+//  limiterCpu   -- a look-ahead limiter in the audio library's update
+
+enum LimiterMode { limiterOff, limiterAuto, limiterChip, limiterCpu };
+
+#define NUM_VOICE_MIXERS (NUM_VOICES / MIXER_VOICES)
+#if NUM_VOICES % MIXER_VOICES != 0 || NUM_VOICE_MIXERS < 1 || NUM_VOICE_MIXERS > 4 || NUM_VOICES > VOICE_POOL_MAX
+#error "NUM_VOICES must be 4, 8, 12 or 16"
+#endif
+#if LIMITER_HEADROOM_SHIFT < 0 || LIMITER_HEADROOM_SHIFT > 2
+#error "LIMITER_HEADROOM_SHIFT must be 0 to 2: the SGTL5000 limiter makes up at most 12 dB"
+#endif
+#if NUM_FILES_IN_SUBDIR > TRACK_SELECTOR_MAX_TRACKS
+#error "NUM_FILES_IN_SUBDIR is more than the TrackSelector can choose from"
+#endif
 
 class AudioPlayer
 {
@@ -43,21 +79,55 @@ class AudioPlayer
   void setVolume(int channel, int percent);
   void setFadeInTime(int channel, int milliseconds);
   void setFadeOutTime(int channel, int milliseconds);
+  void setFadeCurve(int channel, FadeCurve curve);
   void cancelFades(int channel);
 
   void setPlayTrackAction(int channel, playTrackActionType playAction);
-  void setLoopMode(int channel, bool on);
+  void setLoopMode(int channel, bool on, int crossfadeMsec = 0);
+  void setNoRepeatWindow(int channel, int tracks);   // random: not one of the last few again
+  void rememberTrackOrder(bool on);         // carry shuffles on across restarts
 
   void startTrack(int channel);
   void stopTrack(int channel);
   bool isPlaying(int channel);
 
+  void setCrossfadeTime(int milliseconds);   // 0 == off
+  int  getCrossfadeTime();
+  void crossfade(int fromChannel, int toChannel);   // stop one and start the other, overlapped
+
+  bool prepareTrack(int channel, bool fill = true);   // open the next track now, silently; startTrack() plays it
+  void cancelPreparedTrack(int channel);
+  void getPrepareStats(int channel, uint32_t *hits, uint32_t *misses);
+
+  void usePreopen(int maxTracks, bool fill = true);  // keep channels' next tracks open, touch or no touch
+  bool preopenTrack(int channel);
+  void getPreopenStats(int *numOpen, uint32_t *recycled);
+
+  bool usePreroll(int milliseconds, int budgetKB = 0, bool lazy = false);  // first of each track in PSRAM
+  void getPrerollUsage(int *tracks, int *skipped, uint32_t *usedBytes, uint32_t *budgetBytes);
+  void getPrerollStats(int channel, uint32_t *hits, uint32_t *underruns);
+
+  void useSampleCache(int budgetKB, int maxTrackMillis = 3000);   // whole short tracks in memory
+  SampleCache *getSampleCache();
+
+  void setVoiceStealing(VoiceStealPolicy policy);   // when every voice is busy
+  void setVoicePriority(int channel, int priority);  // for stealLowestPriority; higher is kept longer
+  void setLayering(int channel, bool on);   // a restarted track plays on under the new one
+  VoicePool *getVoicePool();
+
   void pauseTrack(int channel);
   void resumeTrack(int channel);
   bool isPaused(int channel);
 
   int  cancelAll();
 
+  void useLimiter(LimiterMode mode, float thresholdDb = LIMITER_THRESHOLD_DB);
+  LimiterMode getLimiterMode();             // limiterAuto is resolved to the one in use
+  float takeLimiterReduction();             // dB, the most since the last call
+
+  void useMicrophoneInput(bool on);
+  EnvelopeFollower *getInputEnvelope(int input);
+
   void doTimerTasks();
   
  private:
@@ -65,36 +135,93 @@ class AudioPlayer
   TeensyUtils *_tu;
   AudioFileManager *_fm;
 
+  // Voices. Each channel has a current voice (-1 == none): the one its
+  // start/stop/pause/volume act on. Other voices it still has are fading
+  // out, or layers.
+  VoicePool _voices;
+  int8_t   _voice[NUM_CHANNELS];
+  int      _voicePriority[NUM_CHANNELS];
+  bool     _layering[NUM_CHANNELS];
+  uint32_t _voiceStartTime[NUM_VOICES];
+
   // Volume control
   int _targetVolume[NUM_CHANNELS];
-  int _actualVolume[NUM_CHANNELS];
   int _fadeInTime[NUM_CHANNELS];
   int _fadeOutTime[NUM_CHANNELS];
+  FadeCurve _fadeCurve[NUM_CHANNELS];
+  int _crossfadeTime;
 
   bool _loopMode[NUM_CHANNELS];
+  int _loopCrossfade[NUM_CHANNELS];
   playTrackActionType _playAction[NUM_CHANNELS];
 
   // Audio player status (per track)
   uint32_t _lastStartTime[NUM_CHANNELS];
   uint32_t _lastStopTime[NUM_CHANNELS];
-  int      _thisFadeInTime[NUM_CHANNELS];
-  int      _thisFadeOutTime[NUM_CHANNELS];
-  int      _lastRandomTrackPlayed[NUM_CHANNELS];
   bool     _isPaused[NUM_CHANNELS];
+  char     _nextTrackPath[NUM_CHANNELS][MAX_PATH_NAME];   // chosen but not played yet; "" == none
+  uint32_t _prepareHits[NUM_CHANNELS];     // prepared track was started
+  uint32_t _prepareMisses[NUM_CHANNELS];   // prepared track was cancelled
+
+  // Pre-open (see usePreopen())
+  int      _preopenMax;                    // 0 == off
+  bool     _preopenFill;
+  bool     _preopened[NUM_CHANNELS];       // the prepared track was pre-opened, not pre-armed
+  uint32_t _preopenRecycled;
+
+  // Pre-roll (see usePreroll())
+  PrerollCache _preroll;
+  SdSampleFile _prerollFile;
+  uint8_t *_prerollPool;
+  int      _prerollMillis;                 // 0 == off
+  bool     _prerollLazy;                   // add tracks as they're played, not at startup
+  const PrerollEntry *_prerolling[NUM_VOICES];     // started from pre-roll, file not opened yet
+  char     _prerollPending[NUM_CHANNELS][MAX_PATH_NAME];   // lazy: played cold, add it later
+  uint32_t _prerollHits[NUM_CHANNELS];
+  uint32_t _prerollUnderruns[NUM_CHANNELS];
+  uint32_t _underrunBase[NUM_VOICES];              // the player's count when the pre-roll started
+
+  // Sample cache (see useSampleCache())
+  SampleCache _cache;
+  SampleCacheEntry *_cachePlaying[NUM_VOICES];     // player is playing from this
+  SampleCacheEntry *_cacheLoading[NUM_VOICES];     // player is copying its track into this
   
-  // Pre-computed play order for "shuffled" mode of random tracks.
-  int _shuffledTracks[NUM_CHANNELS][NUM_FILES_IN_SUBDIR];
-  int _shufflePosition[NUM_CHANNELS];
+  // Random and shuffled tracks (see TrackSelector.h)
+  TrackSelector _selector[NUM_CHANNELS];
+  bool     _rememberTracks;
+  bool     _tracksChanged;                 // since they were last saved
+  uint32_t _tracksSavedTime;
+
+  // Master bus limiter (see useLimiter())
+  LimiterMode _limiterMode;
+  bool     _codecFound;                    // the SGTL5000 answered on I2C
 
   // Internal methods
-  AudioPlaySdWavPR *_getPlayerByTrack(int channel);
-  uint8_t _volumePctToByte(int percent);
-  void    _setActualVolume(int trackNum, int percent);
+  AudioPlaySdWavPR *_getPlayer(int channel);       // of the current voice, NULL if none
+  bool    _startVoice(int channel);
+  int     _allocateVoice(int channel, bool steal);
+  void    _retireVoice(int channel);
+  void    _disownVoice(int voice, int channel);
+  void    _tailVoice(int voice, int milliseconds);
+  void    _silenceVoice(int voice);
+  void    _freeVoice(int voice);
+  void    _updateVoices();
+  void    _rampVolume(int channel, int percent, int milliseconds);
+  int     _currentVolume(int channel);
   int     _calculateFadeTime(int channel, bool goingUp);
-  void    _doFadeInOut(int channel);
-  void    _startTrack(int channel);
-  void    _startRandomTrack(int channel);
-  void    _shuffleTracks(int channel);
+  void    _finishFadeOut(int channel);
+  bool    _recyclePreopened(int exceptChannel);
+  const char *_nextTrack(int channel);
+  int     _chooseRandomTrack(int channel);
+  void    _resetTracks(int channel);
+  bool    _loadTrackState();
+  void    _saveTrackState();
+  void    _prerollTrack(const char *path);
+  void    _continuePrerolls();
+  bool    _cardIsFree(int voice);
+  void    _captureIntoCache(int voice, const char *path);
+  void    _updateCache(int voice);
+  void    _updateCache();
 };
 
 #endif
@@ -0,0 +1,105 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include "BaselineTracker.h"
+
+// Square root of a 64-bit integer, one result bit per iteration.
+
+static uint32_t isqrt64(uint64_t x) {
+  uint64_t result = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+  while (bit > x)
+    bit >>= 2;
+  while (bit != 0) {
+    if (x >= result + bit) {
+      x -= result + bit;
+      result = (result >> 1) + bit;
+    } else {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)result;
+}
+
+BaselineTracker::BaselineTracker() {
+  setTrackingSamples(16384);
+  reset(0);
+}
+
+void BaselineTracker::setTrackingSamples(int32_t samples) {
+  _maxShift = 0;
+  while (_maxShift < 24 && ((int32_t)1 << (_maxShift + 1)) <= samples)
+    _maxShift++;
+}
+
+void BaselineTracker::reset(int32_t value) {
+  _mean = value;
+  _variance = 0;
+  _sigma = 0;
+  _count = 0;
+  _shift = 0;
+  _sinceSigma = 0;
+}
+
+void BaselineTracker::reset(int32_t value, int32_t sigma) {
+  reset(value);
+  _sigma = sigma;
+  _variance = (int64_t)sigma * sigma;
+  _shift = _maxShift;
+  _count = (uint32_t)1 << _maxShift;
+}
+
+bool BaselineTracker::update(int32_t value) {
+
+  // Warm-up: average over all samples so far (the largest power of two
+  // of them) until we reach the full time constant.
+  _count++;
+  if (_shift < _maxShift && (_count >> (_shift + 1)) >= 1)
+    _shift++;
+
+  int32_t deviation = value - _mean;
+  int shift = _shift;
+  if (deviation < -4 * _sigma && shift > 4)   // a clear drop: follow it faster
+    shift -= 4;
+  _mean += deviation >> shift;
+  int64_t square = (int64_t)deviation * deviation;
+  _variance += (square - _variance) >> _shift;
+
+  if (++_sinceSigma >= BASELINE_SIGMA_INTERVAL) {
+    _sinceSigma = 0;
+    _sigma = (int32_t)(isqrt64((uint64_t)_variance));  // sqrt of Q32 is Q16
+    return true;
+  }
+  return false;
+}
+
+int32_t BaselineTracker::getBaseline() {
+  return _mean;
+}
+
+int32_t BaselineTracker::getNoise() {
+  return _sigma;
+}
+
+bool BaselineTracker::isSettled() {
+  return _shift >= _maxShift;
+}
@@ -0,0 +1,71 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * Tracks the "idle" level of a sensor (the baseline) and how noisy it is,
+ * so touch thresholds can be relative to the idle level instead of
+ * absolute. Humidity and temperature make the idle level drift slowly over
+ * hours; the tracker follows that drift, but only while the sensor isn't
+ * touched (the caller decides that and simply doesn't call update()).
+ *
+ * The statistics are exponentially-weighted running mean and variance, so
+ * each update is O(1) with no history kept. During the first samples the
+ * averaging is faster (over 2^k samples from the 2^k-th update on, up to
+ * the tracking time) so the baseline settles quickly after a reset.
+ * Clear drops below the baseline are followed faster than rises, since a
+ * touch can only make the reading go up.
+ *
+ * Values are Q16 fixed point, the same as ProximityFilter's output.
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef BaselineTracker_h
+#define BaselineTracker_h 1
+
+#include <stdint.h>
+
+// How often (in updates) the noise sigma is recalculated from the variance
+#define BASELINE_SIGMA_INTERVAL 64
+
+class BaselineTracker
+{
+ public:
+  BaselineTracker();
+
+  void    setTrackingSamples(int32_t samples);   // time constant, in samples
+  void    reset(int32_t value);
+  void    reset(int32_t value, int32_t sigma);    // already known (e.g. calibrated): no warm-up
+  bool    update(int32_t value);                 // true if baseline/noise were recalculated
+  int32_t getBaseline();                         // Q16
+  int32_t getNoise();                            // standard deviation, Q16
+  bool    isSettled();
+
+ private:
+  int      _maxShift;
+  int      _shift;
+  uint32_t _count;
+  int32_t  _mean;            // Q16
+  int64_t  _variance;        // Q32
+  int32_t  _sigma;           // Q16
+  int      _sinceSigma;
+};
+
+#endif
@@ -0,0 +1,197 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include <math.h>
+#include <string.h>
+#include "CrosstalkMatrix.h"
+
+CrosstalkMatrix::CrosstalkMatrix() {
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    _idle[channel] = 0;
+  reset();
+}
+
+void CrosstalkMatrix::reset() {
+  for (int i = 0; i < NUM_CHANNELS; i++) {
+    for (int j = 0; j < NUM_CHANNELS; j++)
+      _coupling[i][j] = (i == j) ? 1.0 : 0.0;
+  }
+  for (int i = 0; i < NUM_CHANNELS * CROSSTALK_ROW_LENGTH; i++)
+    _inverse[i] = 0;
+  for (int i = 0; i < NUM_CHANNELS; i++)
+    _inverse[i * CROSSTALK_ROW_LENGTH + i] = CROSSTALK_ONE;
+  _identity = true;
+}
+
+void CrosstalkMatrix::setIdle(const uint16_t idle[]) {
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    _idle[channel] = idle[channel];
+}
+
+uint16_t CrosstalkMatrix::getIdle(int channel) {
+  return _idle[channel];
+}
+
+void CrosstalkMatrix::setCoupling(int touched, int channel, float coupling) {
+  if (touched != channel)
+    _coupling[touched][channel] = coupling;
+}
+
+float CrosstalkMatrix::getCoupling(int touched, int channel) {
+  return _coupling[touched][channel];
+}
+
+bool CrosstalkMatrix::isIdentity() {
+  return _identity;
+}
+
+// Touching "touched" raises "channel" by coupling[touched][channel] times
+// the touched one's rise, so the raw reading of a channel is
+//
+//     raw[channel] = sum over t of coupling[t][channel] * true[t]
+//
+// that is, C[channel][t] = coupling[t][channel]. Gauss-Jordan elimination
+// with partial pivoting; N is small and this only runs at calibration.
+
+bool CrosstalkMatrix::invert() {
+  float a[NUM_CHANNELS][2 * NUM_CHANNELS];
+  for (int i = 0; i < NUM_CHANNELS; i++) {
+    for (int j = 0; j < NUM_CHANNELS; j++) {
+      a[i][j] = _coupling[j][i];
+      a[i][NUM_CHANNELS + j] = (i == j) ? 1.0 : 0.0;
+    }
+  }
+  for (int col = 0; col < NUM_CHANNELS; col++) {
+    int pivot = col;
+    for (int row = col + 1; row < NUM_CHANNELS; row++) {
+      if (fabsf(a[row][col]) > fabsf(a[pivot][col]))
+        pivot = row;
+    }
+    if (fabsf(a[pivot][col]) < 1e-3)
+      return false;
+    if (pivot != col) {
+      for (int j = 0; j < 2 * NUM_CHANNELS; j++) {
+        float t = a[col][j];
+        a[col][j] = a[pivot][j];
+        a[pivot][j] = t;
+      }
+    }
+    float scale = 1.0 / a[col][col];
+    for (int j = 0; j < 2 * NUM_CHANNELS; j++)
+      a[col][j] *= scale;
+    for (int row = 0; row < NUM_CHANNELS; row++) {
+      float f = a[row][col];
+      if (row == col || f == 0.0)
+        continue;
+      for (int j = 0; j < 2 * NUM_CHANNELS; j++)
+        a[row][j] -= f * a[col][j];
+    }
+  }
+
+  // Q14 has to hold every element; strong coupling (over about a third)
+  // makes the inverse too large, and the matrix is unusable anyway.
+  int16_t inverse[NUM_CHANNELS * CROSSTALK_ROW_LENGTH];
+  bool identity = true;
+  for (int i = 0; i < NUM_CHANNELS; i++) {
+    for (int j = 0; j < CROSSTALK_ROW_LENGTH; j++) {
+      int32_t q = 0;
+      if (j < NUM_CHANNELS) {
+        float x = a[i][NUM_CHANNELS + j] * (float)CROSSTALK_ONE;
+        if (x >= 32767.5 || x < -32768.0)
+          return false;
+        q = (int32_t)floorf(x + 0.5);
+        if (q != ((i == j) ? CROSSTALK_ONE : 0))
+          identity = false;
+      }
+      inverse[i * CROSSTALK_ROW_LENGTH + j] = q;
+    }
+  }
+  for (int i = 0; i < NUM_CHANNELS * CROSSTALK_ROW_LENGTH; i++)
+    _inverse[i] = inverse[i];
+  _identity = identity;
+  return true;
+}
+
+void CrosstalkMatrix::apply(uint16_t raw[], uint16_t fullScale) {
+  if (_identity)
+    return;
+  int16_t rise[CROSSTALK_ROW_LENGTH] __attribute__((aligned(4)));
+  int32_t out[NUM_CHANNELS];
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    rise[channel] = (int32_t)raw[channel] - (int32_t)_idle[channel];
+  for (int channel = NUM_CHANNELS; channel < CROSSTALK_ROW_LENGTH; channel++)
+    rise[channel] = 0;
+  multiply(_inverse, rise, out);
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    int32_t value = (int32_t)_idle[channel] + ((out[channel] + (CROSSTALK_ONE >> 1)) >> CROSSTALK_Q);
+    if (value < 0)
+      value = 0;
+    else if (value > fullScale)
+      value = fullScale;
+    raw[channel] = value;
+  }
+}
+
+/*----------------------------------------------------------------------
+ * The matrix-vector product. SMLAD multiplies the low halves and the high
+ * halves of two registers and adds both products to an accumulator, so a
+ * row of N elements takes N/2 instructions (plus the loads: one 32-bit
+ * load fetches two elements). Elements are little-endian pairs, so the
+ * low half is the even-numbered one.
+ ----------------------------------------------------------------------*/
+
+static inline int32_t smlad(uint32_t x, uint32_t y, int32_t acc) {
+#if defined(__ARM_FEATURE_DSP)
+  int32_t result;
+  asm ("smlad %0, %1, %2, %3" : "=r" (result) : "r" (x), "r" (y), "r" (acc));
+  return result;
+#else
+  return acc + (int32_t)(int16_t)(x & 0xFFFF) * (int16_t)(y & 0xFFFF)
+             + (int32_t)(int16_t)(x >> 16) * (int16_t)(y >> 16);
+#endif
+}
+
+// memcpy() of a pair is a single 32-bit load, without breaking the
+// compiler's aliasing rules the way a cast pointer would.
+
+void CrosstalkMatrix::multiply(const int16_t *m, const int16_t *in, int32_t *out) {
+  uint32_t v[CROSSTALK_ROW_LENGTH / 2];
+  memcpy(v, in, sizeof(v));
+  for (int i = 0; i < NUM_CHANNELS; i++) {
+    int32_t acc = 0;
+    for (int j = 0; j < CROSSTALK_ROW_LENGTH / 2; j++) {
+      uint32_t pair;
+      memcpy(&pair, m + 2 * j, sizeof(pair));
+      acc = smlad(pair, v[j], acc);
+    }
+    out[i] = acc;
+    m += CROSSTALK_ROW_LENGTH;
+  }
+}
+
+void CrosstalkMatrix::multiplyReference(const int16_t *m, const int16_t *in, int32_t *out) {
+  for (int i = 0; i < NUM_CHANNELS; i++) {
+    int32_t acc = 0;
+    for (int j = 0; j < NUM_CHANNELS; j++)
+      acc += (int32_t)m[i * CROSSTALK_ROW_LENGTH + j] * in[j];
+    out[i] = acc;
+  }
+}
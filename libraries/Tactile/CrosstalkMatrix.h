@@ -0,0 +1,80 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * Cross-talk between neighboring electrodes. Touching one sensor also
+ * raises its neighbors a little, which forces high touch thresholds. If
+ * the coupling is measured (touch one sensor at a time and see how much
+ * the others rise, relative to the touched one), it can be undone: the
+ * readings are a coupling matrix C times the "true" readings, so
+ * multiplying them by the inverse of C gives the true readings back.
+ *
+ * Coupling is linear in the rise above the idle level, so the correction
+ * is applied to that:
+ *
+ *     out = idle + inverse(C) * (raw - idle)
+ *
+ * The inverse is kept as Q14 (-2.0 to 2.0) 16-bit values, rows padded
+ * to an even length, so that on a Cortex-M4/M7 the matrix-vector product
+ * can use SMLAD (two 16x16 multiply-accumulates in one instruction).
+ * multiplyReference() is the plain C version that the fast one has to
+ * match exactly; elsewhere (on a host) SMLAD is emulated in C.
+ *
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef CrosstalkMatrix_h
+#define CrosstalkMatrix_h 1
+
+#include <stdint.h>
+#include "TactileBasics.h"
+
+#define CROSSTALK_Q           14
+#define CROSSTALK_ONE         (1 << CROSSTALK_Q)
+#define CROSSTALK_ROW_LENGTH  ((NUM_CHANNELS + 1) & ~1)    // even, for SMLAD pairs
+
+class CrosstalkMatrix
+{
+ public:
+  CrosstalkMatrix();
+
+  void  reset();                                    // no coupling
+  void  setIdle(const uint16_t idle[]);
+  uint16_t getIdle(int channel);
+  void  setCoupling(int touched, int channel, float coupling);  // channel's rise / touched's rise
+  float getCoupling(int touched, int channel);
+  bool  invert();                                   // false if C can't be inverted in Q14
+  bool  isIdentity();
+
+  void  apply(uint16_t raw[], uint16_t fullScale);  // in place
+
+  // The matrix-vector product out = m * in, Q14; rows of CROSSTALK_ROW_LENGTH
+  static void multiply(const int16_t *m, const int16_t *in, int32_t *out);
+  static void multiplyReference(const int16_t *m, const int16_t *in, int32_t *out);
+
+ private:
+  uint16_t _idle[NUM_CHANNELS];
+  float    _coupling[NUM_CHANNELS][NUM_CHANNELS];   // [touched][channel]
+  int16_t  _inverse[NUM_CHANNELS * CROSSTALK_ROW_LENGTH] __attribute__((aligned(4)));
+  bool     _identity;
+};
+
+#endif
@@ -0,0 +1,142 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include "EnvelopeFollower.h"
+
+static uint32_t isqrt32(uint32_t x) {
+  uint32_t result = 0;
+  uint32_t bit = (uint32_t)1 << 30;
+  while (bit > x)
+    bit >>= 2;
+  while (bit != 0) {
+    if (x >= result + bit) {
+      x -= result + bit;
+      result = (result >> 1) + bit;
+    } else {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  return result;
+}
+
+// Attack/release are in blocks and are rounded to a power of two.
+static int blocksToShift(int blocks) {
+  int shift = 0;
+  while (shift < 12 && (2 << shift) <= blocks)
+    shift++;
+  return shift;
+}
+
+/*----------------------------------------------------------------------
+ * EnvelopeFollower
+ ----------------------------------------------------------------------*/
+
+EnvelopeFollower::EnvelopeFollower() {
+  _type = rmsEnvelope;
+  _envelope = 0;
+  _output = 0;
+  setAttackRelease(1, 8);       // instant attack, ~25 msec release
+}
+
+void EnvelopeFollower::setType(EnvelopeType type) {
+  _type = type;
+}
+
+void EnvelopeFollower::setAttackRelease(int attackBlocks, int releaseBlocks) {
+  _attackShift = blocksToShift(attackBlocks);
+  _releaseShift = blocksToShift(releaseBlocks);
+}
+
+uint16_t EnvelopeFollower::processBlock(const int16_t *samples, int numSamples) {
+  int32_t level = 0;
+  if (samples && numSamples > 0) {
+    if (_type == peakEnvelope) {
+      for (int i = 0; i < numSamples; i++) {
+        int32_t s = samples[i];
+        if (s < 0)
+          s = -s;
+        if (s > level)
+          level = s;
+      }
+    } else {
+      uint64_t sumOfSquares = 0;
+      for (int i = 0; i < numSamples; i++)
+        sumOfSquares += (int32_t)samples[i] * samples[i];
+      level = (int32_t)isqrt32((uint32_t)(sumOfSquares / (uint32_t)numSamples));
+    }
+    if (level > 32767)
+      level = 32767;
+  }
+
+  int32_t x = level << 16;
+  if (x > _envelope)
+    _envelope += (x - _envelope) >> _attackShift;
+  else
+    _envelope += (x - _envelope) >> _releaseShift;
+  _output = (uint16_t)(_envelope >> 16);
+  return _output;
+}
+
+uint16_t EnvelopeFollower::getEnvelope() {
+  return _output;
+}
+
+/*----------------------------------------------------------------------
+ * EnvelopeSensorSource
+ ----------------------------------------------------------------------*/
+
+EnvelopeSensorSource::EnvelopeSensorSource(SensorSource *source) {
+  _source = source;
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    _follower[channel] = 0;
+}
+
+void EnvelopeSensorSource::setSource(SensorSource *source) {
+  _source = source;
+}
+
+void EnvelopeSensorSource::setFollower(int channel, EnvelopeFollower *follower) {
+  if (channel < 0 || channel >= NUM_CHANNELS)
+    return;
+  _follower[channel] = follower;
+}
+
+void EnvelopeSensorSource::begin() {
+  _source->begin();
+}
+
+uint16_t EnvelopeSensorSource::fullScale() {
+  return _source->fullScale();
+}
+
+void EnvelopeSensorSource::poll(uint32_t timeMicros) {
+  _source->poll(timeMicros);
+}
+
+void EnvelopeSensorSource::read(uint16_t values[]) {
+  _source->read(values);
+  uint32_t fullScale = _source->fullScale();
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    if (_follower[channel])
+      values[channel] = (uint16_t)(((uint32_t)_follower[channel]->getEnvelope() * fullScale) >> 15);
+  }
+}
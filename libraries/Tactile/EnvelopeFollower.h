@@ -0,0 +1,87 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * Envelope follower for audio input. Instead of a touch sensor, a
+ * channel can be triggered by sound: line-in or a microphone on the
+ * audio shield. Once per audio block (128 samples), the follower measures
+ * the block's level (RMS or peak) and smooths it with separate attack and
+ * release rates. The result, 0..32767, is treated just like a sensor
+ * reading, so the usual filtering, touch/release thresholds and
+ * proximity all apply to it.
+ *
+ * EnvelopeSensorSource is a SensorSource that reads another source (the
+ * real sensors) and then replaces the readings of the audio-input
+ * channels with the envelope, scaled to the same full-scale range. This
+ * happens in the sampling interrupt, so the audio level is picked up
+ * within one sample of the audio block being processed.
+ *
+ * No Arduino dependencies. See AudioAnalyzeEnvelope.h for the piece that
+ * connects this to the Teensy audio library.
+ ----------------------------------------------------------------------*/
+
+#ifndef EnvelopeFollower_h
+#define EnvelopeFollower_h 1
+
+#include <stdint.h>
+#include "TactileBasics.h"
+#include "SensorSource.h"
+
+enum EnvelopeType { rmsEnvelope, peakEnvelope };
+
+class EnvelopeFollower
+{
+ public:
+  EnvelopeFollower();
+
+  void     setType(EnvelopeType type);
+  void     setAttackRelease(int attackBlocks, int releaseBlocks);
+  uint16_t processBlock(const int16_t *samples, int numSamples);   // samples may be NULL (silence)
+  uint16_t getEnvelope();
+
+ private:
+  EnvelopeType      _type;
+  int               _attackShift;
+  int               _releaseShift;
+  int32_t           _envelope;        // Q16
+  volatile uint16_t _output;          // read from other interrupt contexts
+};
+
+
+class EnvelopeSensorSource : public SensorSource
+{
+ public:
+  EnvelopeSensorSource(SensorSource *source);
+
+  void     setSource(SensorSource *source);
+  void     setFollower(int channel, EnvelopeFollower *follower);   // NULL == use the sensor
+
+  void     begin();
+  uint16_t fullScale();
+  void     read(uint16_t values[]);
+  void     poll(uint32_t timeMicros);
+
+ private:
+  SensorSource     *_source;
+  EnvelopeFollower *_follower[NUM_CHANNELS];
+};
+
+#endif
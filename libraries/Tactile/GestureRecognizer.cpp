@@ -0,0 +1,186 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include "GestureRecognizer.h"
+
+// States of the per-channel state machine
+enum {
+  idleState,
+  pressedState,           // touched, not long enough for a long press yet
+  waitingState,           // one tap done, maybe a second one is coming
+  pressedAgainState,      // second touch of a possible double tap
+  heldState,              // long press reported; waiting for the release
+  cancelledState,         // part of a swipe; ignore until released
+  NUM_GESTURE_STATES
+};
+
+// Inputs
+enum { touchInputEvent, releaseInputEvent, timeoutInputEvent, NUM_GESTURE_INPUTS };
+
+// Timeout classes (see setTimes())
+enum { noTimeout, longPressTimeout, doubleTapTimeout };
+
+struct GestureTransition {
+  uint8_t     next;
+  GestureType emit;
+};
+
+static const uint8_t stateTimeout[NUM_GESTURE_STATES] = {
+  noTimeout,              // idle
+  longPressTimeout,       // pressed
+  doubleTapTimeout,       // waiting
+  longPressTimeout,       // pressedAgain
+  noTimeout,              // held
+  noTimeout,              // cancelled
+};
+
+static const GestureTransition transitions[NUM_GESTURE_STATES][NUM_GESTURE_INPUTS] = {
+  //   touch                           release                             timeout
+  { {pressedState,      noGesture}, {idleState, noGesture},           {idleState, noGesture}        },  // idle
+  { {pressedState,      noGesture}, {waitingState, noGesture},        {heldState, longPressGesture} },  // pressed
+  { {pressedAgainState, noGesture}, {waitingState, noGesture},        {idleState, tapGesture}       },  // waiting
+  { {pressedAgainState, noGesture}, {idleState, doubleTapGesture},    {heldState, longPressGesture} },  // pressedAgain
+  { {heldState,         noGesture}, {idleState, noGesture},           {heldState, noGesture}        },  // held
+  { {cancelledState,    noGesture}, {idleState, noGesture},           {cancelledState, noGesture}   },  // cancelled
+};
+
+GestureRecognizer::GestureRecognizer() {
+  setTimes(GESTURE_LONG_PRESS_MSEC, GESTURE_DOUBLE_TAP_MSEC, GESTURE_SWIPE_STEP_MSEC);
+  reset();
+}
+
+void GestureRecognizer::setTimes(int longPressMsec, int doubleTapMsec, int swipeStepMsec) {
+  _timeout[noTimeout] = 0;
+  _timeout[longPressTimeout] = (uint32_t)longPressMsec * 1000;
+  _timeout[doubleTapTimeout] = (uint32_t)doubleTapMsec * 1000;
+  _swipeStep = (uint32_t)swipeStepMsec * 1000;
+}
+
+void GestureRecognizer::reset() {
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    _state[channel] = idleState;
+    _stateTime[channel] = 0;
+  }
+  _swipeLast = -1;
+  _swipeDirection = 0;
+  _swipeLength = 0;
+  _swipeTime = 0;
+  _head = 0;
+  _tail = 0;
+  _dropCount = 0;
+}
+
+void GestureRecognizer::_input(int channel, int input, uint32_t timeMicros) {
+  const GestureTransition *t = &transitions[_state[channel]][input];
+  if (t->next != _state[channel])
+    _stateTime[channel] = timeMicros;
+  _state[channel] = t->next;
+  if (t->emit != noGesture)
+    _emit(channel, t->emit, timeMicros);
+}
+
+void GestureRecognizer::touch(int channel, uint32_t timeMicros) {
+  if (channel < 0 || channel >= NUM_CHANNELS)
+    return;
+  update(timeMicros);             // anything that timed out happened first
+  _input(channel, touchInputEvent, timeMicros);
+  _swipeTouch(channel, timeMicros);
+}
+
+void GestureRecognizer::release(int channel, uint32_t timeMicros) {
+  if (channel < 0 || channel >= NUM_CHANNELS)
+    return;
+  update(timeMicros);
+  _input(channel, releaseInputEvent, timeMicros);
+}
+
+void GestureRecognizer::update(uint32_t timeMicros) {
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    uint32_t timeout = _timeout[stateTimeout[_state[channel]]];
+    if (timeout == 0)
+      continue;
+    if (timeMicros - _stateTime[channel] >= timeout)
+      _input(channel, timeoutInputEvent, _stateTime[channel] + timeout);
+  }
+}
+
+// A touch on a neighbor of the previous one, soon enough and in the same
+// direction, continues the swipe. The second touch of a swipe cancels
+// the first channel's tap/press; from then on each new channel in the
+// swipe is cancelled as it's touched.
+
+void GestureRecognizer::_swipeTouch(int channel, uint32_t timeMicros) {
+  int step = channel - _swipeLast;
+  bool continues = _swipeLast >= 0
+    && (step == 1 || step == -1)
+    && (_swipeDirection == 0 || step == _swipeDirection)
+    && timeMicros - _swipeTime <= _swipeStep;
+
+  if (!continues) {
+    _swipeLast = channel;
+    _swipeDirection = 0;
+    _swipeLength = 1;
+    _swipeTime = timeMicros;
+    return;
+  }
+
+  if (_swipeLength == 1)
+    _cancel(_swipeLast);
+  _cancel(channel);
+  _swipeLast = channel;
+  _swipeDirection = step;
+  _swipeLength++;
+  _swipeTime = timeMicros;
+  if (_swipeLength == GESTURE_SWIPE_CHANNELS)
+    _emit(channel, step > 0 ? swipeUpGesture : swipeDownGesture, timeMicros);
+}
+
+void GestureRecognizer::_cancel(int channel) {
+  uint8_t state = _state[channel];
+  if (state == pressedState || state == pressedAgainState || state == heldState)
+    _state[channel] = cancelledState;
+  else if (state == waitingState)
+    _state[channel] = idleState;
+}
+
+void GestureRecognizer::_emit(int channel, GestureType type, uint32_t timeMicros) {
+  if (_head - _tail >= GESTURE_QUEUE_SIZE) {
+    _dropCount++;
+    return;
+  }
+  GestureEvent *event = &_queue[_head & (GESTURE_QUEUE_SIZE - 1)];
+  event->timeMicros = timeMicros;
+  event->channel = channel;
+  event->type = type;
+  _head++;
+}
+
+bool GestureRecognizer::getGesture(GestureEvent *event) {
+  if (_tail == _head)
+    return false;
+  *event = _queue[_tail & (GESTURE_QUEUE_SIZE - 1)];
+  _tail++;
+  return true;
+}
+
+uint32_t GestureRecognizer::getDropCount() {
+  return _dropCount;
+}
@@ -0,0 +1,99 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * Recognizes gestures from the touch/release events of the sensors:
+ *
+ *   tapGesture        -- a short touch (reported once it's clear it isn't
+ *                        the first half of a double tap)
+ *   doubleTapGesture  -- two short touches close together
+ *   longPressGesture  -- a touch held down (reported while still held)
+ *   swipeUpGesture    -- touches moving across neighboring sensors toward
+ *                        higher channel numbers (e.g. 1, 2, 3, 4)
+ *   swipeDownGesture  -- the same toward lower channel numbers
+ *
+ * Each channel has a small state machine; the transitions are in a table
+ * indexed by state and input (touch, release or timeout). The swipe
+ * detector watches the order in which channels are touched; once a
+ * touch continues a swipe, the channels in it stop producing taps and
+ * presses of their own. A swipe's channel is the one where it ended.
+ *
+ * Every call takes constant time, nothing is allocated, and all times are
+ * passed in by the caller, so a host program can drive it with a scripted
+ * timeline. No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef GestureRecognizer_h
+#define GestureRecognizer_h 1
+
+#include <stdint.h>
+#include "TactileBasics.h"
+
+#define GESTURE_LONG_PRESS_MSEC   600     // held at least this long
+#define GESTURE_DOUBLE_TAP_MSEC   300     // max gap between the taps
+#define GESTURE_SWIPE_STEP_MSEC   250     // max time from one sensor to the next
+#define GESTURE_SWIPE_CHANNELS    3       // sensors a swipe has to cross
+#define GESTURE_QUEUE_SIZE        16      // power of two
+
+struct GestureEvent {
+  uint32_t    timeMicros;
+  int         channel;
+  GestureType type;
+};
+
+class GestureRecognizer
+{
+ public:
+  GestureRecognizer();
+
+  void setTimes(int longPressMsec, int doubleTapMsec, int swipeStepMsec);
+  void reset();
+
+  void touch(int channel, uint32_t timeMicros);
+  void release(int channel, uint32_t timeMicros);
+  void update(uint32_t timeMicros);            // checks for timeouts; call often
+  bool getGesture(GestureEvent *event);
+  uint32_t getDropCount();
+
+ private:
+  uint8_t  _state[NUM_CHANNELS];
+  uint32_t _stateTime[NUM_CHANNELS];           // when the current state was entered
+  uint32_t _timeout[3];                        // by timeout class, in microseconds
+  uint32_t _swipeStep;
+
+  // Swipe detection
+  int      _swipeLast;                         // last channel of the swipe in progress, or -1
+  int      _swipeDirection;                    // +1, -1, or 0 (not known yet)
+  int      _swipeLength;
+  uint32_t _swipeTime;
+
+  GestureEvent _queue[GESTURE_QUEUE_SIZE];
+  uint32_t _head;
+  uint32_t _tail;
+  uint32_t _dropCount;
+
+  void _input(int channel, int input, uint32_t timeMicros);
+  void _swipeTouch(int channel, uint32_t timeMicros);
+  void _cancel(int channel);
+  void _emit(int channel, GestureType type, uint32_t timeMicros);
+};
+
+#endif
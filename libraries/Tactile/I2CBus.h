@@ -0,0 +1,47 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * The few I2C operations the sensor controllers need. WireI2CBus does
+ * them with the Teensy's Wire library; on a host, a simulated device can
+ * implement them instead (see SimulatedMpr121 in Mpr121SensorSource.h).
+ *
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef I2CBus_h
+#define I2CBus_h 1
+
+#include <stdint.h>
+
+class I2CBus
+{
+ public:
+  virtual ~I2CBus() {}
+
+  virtual void begin() {}
+  virtual bool writeRegister(uint8_t address, uint8_t reg, uint8_t value) = 0;
+
+  // Reads count consecutive registers starting at reg in one transaction.
+  virtual bool readRegisters(uint8_t address, uint8_t reg, uint8_t *buffer, int count) = 0;
+};
+
+#endif
@@ -0,0 +1,189 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+#include "ImaAdpcmDecoder.h"
+
+static const int16_t stepTable[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41,
+  45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190,
+  209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724,
+  796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272,
+  2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132,
+  7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500,
+  20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t indexTable[16] = {
+  -1, -1, -1, -1, 2, 4, 6, 8,
+  -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+ImaAdpcmDecoder::ImaAdpcmDecoder() {
+  begin(1, 256);
+}
+
+// A block is the headers and a whole number of groups.
+
+bool ImaAdpcmDecoder::isValidFormat(int channels, int blockAlign) {
+  return (channels == 1 || channels == 2) && blockAlign > 4 * channels
+         && (blockAlign - 4 * channels) % (4 * channels) == 0;
+}
+
+int ImaAdpcmDecoder::framesPerBlock(int channels, int blockAlign) {
+  return 1 + (blockAlign - 4 * channels) * 2 / channels;
+}
+
+void ImaAdpcmDecoder::begin(int channels, int blockAlign) {
+  _channels = channels;
+  _blockAlign = blockAlign;
+  _sample[0] = _sample[1] = 0;
+  _index[0] = _index[1] = 0;
+  _outPos = 0;
+  _outCount = 0;
+  restart();
+}
+
+void ImaAdpcmDecoder::restart() {
+  _blockPos = 0;
+  _groupBytes = 0;
+}
+
+bool ImaAdpcmDecoder::hasFrames() {
+  return _outPos < _outCount;
+}
+
+int ImaAdpcmDecoder::decode(const uint8_t *in, int bytes, int16_t *left, int16_t *right,
+                            int frames, int *used) {
+  int n = 0;
+  int taken = 0;
+  while (n < frames) {
+    if (_outPos < _outCount) {
+      int k = _outCount - _outPos;
+      if (k > frames - n)
+        k = frames - n;
+      for (int i = 0; i < k; i++, n++, _outPos++) {
+        left[n] = _left[_outPos];
+        right[n] = _right[_outPos];
+      }
+      continue;
+    }
+    if (taken == bytes)
+      break;
+
+    // The next header or group: straight from the input if it's all
+    // there, otherwise collected a few bytes at a time
+    int unit = _unit();
+    const uint8_t *p;
+    if (_groupBytes == 0 && bytes - taken >= unit) {
+      p = in + taken;
+      taken += unit;
+    } else {
+      int k = unit - _groupBytes;
+      if (k > bytes - taken)
+        k = bytes - taken;
+      for (int i = 0; i < k; i++)
+        _group[_groupBytes++] = in[taken++];
+      if (_groupBytes < unit)
+        break;
+      p = _group;
+      _groupBytes = 0;
+    }
+
+    // Whole groups of 8 frames that fit go straight to the output
+    bool header = _blockPos == 0;
+    _blockPos += unit;
+    if (_blockPos >= _blockAlign)
+      _blockPos = 0;
+    if (!header && frames - n >= IMA_ADPCM_GROUP_FRAMES) {
+      _decodeNibbles(p, 0, left + n);
+      if (_channels == 2)
+        _decodeNibbles(p + 4, 1, right + n);
+      else
+        for (int i = 0; i < IMA_ADPCM_GROUP_FRAMES; i++)
+          right[n + i] = left[n + i];
+      n += IMA_ADPCM_GROUP_FRAMES;
+    } else {
+      _decodeUnit(p, header);
+    }
+  }
+  *used = taken;
+  return n;
+}
+
+int ImaAdpcmDecoder::_unit() {
+  return 4 * _channels;
+}
+
+// Into _left/_right: a header is one frame, a group eight.
+
+void ImaAdpcmDecoder::_decodeUnit(const uint8_t *p, bool header) {
+  _outPos = 0;
+  if (header) {
+    for (int c = 0; c < _channels; c++, p += 4) {
+      _sample[c] = (int16_t)(p[0] | (p[1] << 8));
+      _index[c] = p[2] > 88 ? 88 : p[2];
+    }
+    _left[0] = _sample[0];
+    _right[0] = _sample[_channels - 1];
+    _outCount = 1;
+    return;
+  }
+  _decodeNibbles(p, 0, _left);
+  if (_channels == 2) {
+    _decodeNibbles(p + 4, 1, _right);
+  } else {
+    for (int i = 0; i < IMA_ADPCM_GROUP_FRAMES; i++)
+      _right[i] = _left[i];
+  }
+  _outCount = IMA_ADPCM_GROUP_FRAMES;
+}
+
+// 8 samples from 4 bytes, the low nibble of each byte first.
+
+void ImaAdpcmDecoder::_decodeNibbles(const uint8_t *p, int channel, int16_t *out) {
+  int32_t sample = _sample[channel];
+  int index = _index[channel];
+  for (int i = 0; i < IMA_ADPCM_GROUP_FRAMES; i++) {
+    int nibble = (i & 1) ? p[i >> 1] >> 4 : p[i >> 1] & 0x0F;
+    int step = stepTable[index];
+    int diff = step >> 3;
+    if (nibble & 4)
+      diff += step;
+    if (nibble & 2)
+      diff += step >> 1;
+    if (nibble & 1)
+      diff += step >> 2;
+    sample += (nibble & 8) ? -diff : diff;
+    if (sample > 32767)
+      sample = 32767;
+    else if (sample < -32768)
+      sample = -32768;
+    index += indexTable[nibble];
+    if (index < 0)
+      index = 0;
+    else if (index > 88)
+      index = 88;
+    out[i] = (int16_t)sample;
+  }
+  _sample[channel] = sample;
+  _index[channel] = index;
+}
@@ -0,0 +1,85 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+/*----------------------------------------------------------------------
+ * Decodes IMA-ADPCM, as in WAV files of format 0x11 ("IMA ADPCM" in
+ * sox, ffmpeg's adpcm_ima_wav): four bits per sample, so a track takes a
+ * quarter of the card space, and of the card time to stream it.
+ *
+ * The data is a series of blocks of blockAlign bytes. Each block starts
+ * with a 4-byte header per channel (the first sample, and the step
+ * index), then groups of 4 bytes per channel, 8 samples each (for
+ * stereo, 4 bytes of left, then 4 of right). Every block starts afresh,
+ * so a track can be decoded from any block start.
+ *
+ * The decoder takes the bytes as they come, however they're split up
+ * (a buffer refill, or the end of a pre-roll, can fall in the middle of
+ * a group), and gives out as many frames as are asked for; the rest of
+ * a group waits for the next call. restart() says the next byte is the
+ * start of a block, e.g. when a loop goes back to the start of the data.
+ *
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef ImaAdpcmDecoder_h
+#define ImaAdpcmDecoder_h 1
+
+#include <stdint.h>
+
+#define IMA_ADPCM_GROUP_FRAMES 8
+
+class ImaAdpcmDecoder
+{
+ public:
+  ImaAdpcmDecoder();
+
+  static bool isValidFormat(int channels, int blockAlign);
+  static int  framesPerBlock(int channels, int blockAlign);
+
+  void     begin(int channels, int blockAlign);   // at the start of the data
+  void     restart();                       // at a block start; decoded frames not yet given out are kept
+  bool     hasFrames();                     // decoded, not yet given out
+
+  // Decodes from in (bytes long) into left and right, at most frames.
+  // Returns the frames; *used is the bytes taken from in.
+  int      decode(const uint8_t *in, int bytes, int16_t *left, int16_t *right, int frames, int *used);
+
+ private:
+  int      _channels;
+  int      _blockAlign;
+  int      _blockPos;                       // bytes of the current block taken
+  int32_t  _sample[2];
+  int      _index[2];
+
+  uint8_t  _group[8];                       // a header or group, being collected
+  int      _groupBytes;
+  int16_t  _left[IMA_ADPCM_GROUP_FRAMES];   // decoded, _outPos.._outCount not given out yet
+  int16_t  _right[IMA_ADPCM_GROUP_FRAMES];
+  int      _outPos;
+  int      _outCount;
+
+  int      _unit();                         // bytes of the next header or group
+  void     _decodeUnit(const uint8_t *p, bool header);
+  void     _decodeNibbles(const uint8_t *p, int channel, int16_t *out);
+};
+
+#endif
@@ -0,0 +1,134 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include "LatencyProbe.h"
+
+#ifdef TACTILE_LATENCY_PROBE
+
+volatile uint32_t LatencyProbe::_touchTime[NUM_CHANNELS];
+volatile bool     LatencyProbe::_pending[NUM_CHANNELS][NUM_LATENCY_STAGES];
+uint32_t LatencyProbe::_count[NUM_CHANNELS][NUM_LATENCY_STAGES];
+uint32_t LatencyProbe::_min[NUM_CHANNELS][NUM_LATENCY_STAGES];
+uint32_t LatencyProbe::_max[NUM_CHANNELS][NUM_LATENCY_STAGES];
+uint32_t LatencyProbe::_histogram[NUM_CHANNELS][NUM_LATENCY_STAGES][LATENCY_BUCKETS];
+
+// Bucket N covers [bucketStart(N), bucketStart(N+1)). Below 4 usec each
+// bucket is one microsecond; above that there are four per octave.
+
+static int bucketOf(uint32_t micros) {
+  if (micros < 4)
+    return (int)micros;
+  int octave = 31 - __builtin_clz(micros);
+  int bucket = (octave - 1) * 4 + (int)((micros >> (octave - 2)) & 3);
+  if (bucket >= LATENCY_BUCKETS)
+    bucket = LATENCY_BUCKETS - 1;
+  return bucket;
+}
+
+static uint32_t bucketStart(int bucket) {
+  if (bucket < 4)
+    return (uint32_t)bucket;
+  int octave = bucket / 4 + 1;
+  return (uint32_t)(4 + (bucket & 3)) << (octave - 2);
+}
+
+void LatencyProbe::touch(int channel, uint32_t timeMicros) {
+  if (channel < 0 || channel >= NUM_CHANNELS)
+    return;
+  for (int stage = 0; stage < NUM_LATENCY_STAGES; stage++)
+    _pending[channel][stage] = false;
+  COMPILER_BARRIER();
+  _touchTime[channel] = timeMicros;
+  COMPILER_BARRIER();
+  for (int stage = 0; stage < NUM_LATENCY_STAGES; stage++)
+    _pending[channel][stage] = true;
+}
+
+// Only the first mark of each stage after a touch counts. Stages are
+// marked from different interrupt levels (the audio update vs. the loop),
+// so each has its own flag rather than sharing a bit mask.
+
+void LatencyProbe::mark(int channel, LatencyStage stage, uint32_t timeMicros) {
+  if (channel < 0 || channel >= NUM_CHANNELS)
+    return;
+  if (!_pending[channel][stage])
+    return;
+  _pending[channel][stage] = false;
+  COMPILER_BARRIER();
+  uint32_t latency = timeMicros - _touchTime[channel];
+  if (_count[channel][stage] == 0 || latency < _min[channel][stage])
+    _min[channel][stage] = latency;
+  if (latency > _max[channel][stage])
+    _max[channel][stage] = latency;
+  _count[channel][stage]++;
+  _histogram[channel][stage][bucketOf(latency)]++;
+}
+
+// Percentiles are the middle of the bucket they fall in, but never
+// outside of the actual min/max.
+
+uint32_t LatencyProbe::_percentile(int channel, LatencyStage stage, uint32_t percent) {
+  uint32_t count = _count[channel][stage];
+  uint32_t target = (count * percent + 99) / 100;
+  if (target < 1)
+    target = 1;
+  uint32_t sum = 0;
+  int bucket = 0;
+  for (; bucket < LATENCY_BUCKETS - 1; bucket++) {
+    sum += _histogram[channel][stage][bucket];
+    if (sum >= target)
+      break;
+  }
+  uint32_t start = bucketStart(bucket);
+  uint32_t value = start + (bucketStart(bucket + 1) - start) / 2;
+  if (value < _min[channel][stage])
+    value = _min[channel][stage];
+  if (value > _max[channel][stage])
+    value = _max[channel][stage];
+  return value;
+}
+
+void LatencyProbe::getStats(int channel, LatencyStage stage, LatencyStats *stats) {
+  stats->count = 0;
+  stats->minMicros = stats->p50Micros = stats->p99Micros = stats->maxMicros = 0;
+  if (channel < 0 || channel >= NUM_CHANNELS || _count[channel][stage] == 0)
+    return;
+  stats->count = _count[channel][stage];
+  stats->minMicros = _min[channel][stage];
+  stats->p50Micros = _percentile(channel, stage, 50);
+  stats->p99Micros = _percentile(channel, stage, 99);
+  stats->maxMicros = _max[channel][stage];
+}
+
+void LatencyProbe::reset() {
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    for (int stage = 0; stage < NUM_LATENCY_STAGES; stage++) {
+      _pending[channel][stage] = false;
+      _count[channel][stage] = 0;
+      _min[channel][stage] = 0;
+      _max[channel][stage] = 0;
+      for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++)
+        _histogram[channel][stage][bucket] = 0;
+    }
+  }
+}
+
+#endif
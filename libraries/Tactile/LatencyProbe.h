@@ -0,0 +1,94 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * Touch-to-output latency measurement. When TACTILE_LATENCY_PROBE is
+ * defined (see TactileBasics.h), each new touch is time-stamped at the
+ * sensor sample that crossed the touch threshold, and then the first of
+ * each of these that follows it is time-stamped too:
+ *
+ *   latencyPlay       -- the audio track's play() call
+ *   latencyAudioOut   -- the first audio update that sends the track's
+ *                        data on toward the I2S output
+ *   latencyVibration  -- the first PWM write to the vibrator
+ *
+ * The differences go into per-channel histograms from which the minimum,
+ * median, 99th percentile and maximum are reported. The buckets are a
+ * quarter-octave wide, so the percentiles are within about 10%.
+ *
+ * The probe points are the LATENCY_TOUCH() and LATENCY_MARK() macros,
+ * which compile to nothing when the probe is off (their arguments aren't
+ * even evaluated). All times are passed in by the caller, so on a host
+ * the probe can be driven by a simulated clock. It has no Arduino
+ * dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef LatencyProbe_h
+#define LatencyProbe_h 1
+
+#include <stdint.h>
+#include "TactileBasics.h"
+
+enum LatencyStage { latencyPlay, latencyAudioOut, latencyVibration };
+#define NUM_LATENCY_STAGES 3
+
+#define LATENCY_BUCKETS 96          // quarter octaves from 1 usec to ~16 sec
+
+struct LatencyStats {
+  uint32_t count;
+  uint32_t minMicros;
+  uint32_t p50Micros;
+  uint32_t p99Micros;
+  uint32_t maxMicros;
+};
+
+#ifdef TACTILE_LATENCY_PROBE
+
+class LatencyProbe
+{
+ public:
+  static void touch(int channel, uint32_t timeMicros);
+  static void mark(int channel, LatencyStage stage, uint32_t timeMicros);
+  static void getStats(int channel, LatencyStage stage, LatencyStats *stats);
+  static void reset();
+
+ private:
+  static volatile uint32_t _touchTime[NUM_CHANNELS];
+  static volatile bool     _pending[NUM_CHANNELS][NUM_LATENCY_STAGES];
+  static uint32_t _count[NUM_CHANNELS][NUM_LATENCY_STAGES];
+  static uint32_t _min[NUM_CHANNELS][NUM_LATENCY_STAGES];
+  static uint32_t _max[NUM_CHANNELS][NUM_LATENCY_STAGES];
+  static uint32_t _histogram[NUM_CHANNELS][NUM_LATENCY_STAGES][LATENCY_BUCKETS];
+
+  static uint32_t _percentile(int channel, LatencyStage stage, uint32_t percent);
+};
+
+#define LATENCY_TOUCH(channel, timeMicros)        LatencyProbe::touch(channel, timeMicros)
+#define LATENCY_MARK(channel, stage, timeMicros)  LatencyProbe::mark(channel, stage, timeMicros)
+
+#else
+
+#define LATENCY_TOUCH(channel, timeMicros)        do {} while (0)
+#define LATENCY_MARK(channel, stage, timeMicros)  do {} while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,136 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include "LinkSensorSource.h"
+
+LinkSensorSource::LinkSensorSource(SensorSource *fallback) {
+  _fallback = fallback;
+  _fallbackMultiplier = SENSOR_LINK_FULL_SCALE / fallback->fullScale();
+  if (_fallbackMultiplier < 1)
+    _fallbackMultiplier = 1;
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    _port[channel] = 0;
+    _lastFrameTime[channel] = 0;
+    _counts[channel] = 0;
+    _linked[channel] = false;
+  }
+}
+
+uint16_t LinkSensorSource::fullScale() {
+  return SENSOR_LINK_FULL_SCALE;
+}
+
+void LinkSensorSource::setPort(int channel, SerialPort *port) {
+  if (channel < 0 || channel >= NUM_CHANNELS)
+    return;
+  _linked[channel] = false;
+  _port[channel] = port;
+  _parser[channel].reset();
+  if (port)
+    port->begin();
+}
+
+bool LinkSensorSource::isLinked(int channel) {
+  return _linked[channel];
+}
+
+SensorLinkParser *LinkSensorSource::getParser(int channel) {
+  return &_parser[channel];
+}
+
+// Called from the sampling interrupt. The ADCs are only used if some
+// channel needs them.
+
+void LinkSensorSource::read(uint16_t values[]) {
+  bool analog = false;
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    if (!_linked[channel])
+      analog = true;
+  }
+  if (analog) {
+    _fallback->read(values);
+    for (int channel = 0; channel < NUM_CHANNELS; channel++)
+      values[channel] *= _fallbackMultiplier;
+  }
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    if (_linked[channel])
+      values[channel] = _counts[channel];
+  }
+}
+
+void LinkSensorSource::poll(uint32_t timeMicros) {
+  uint8_t buffer[64];
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    SerialPort *port = _port[channel];
+    if (!port)
+      continue;
+    int n;
+    while ((n = port->read(buffer, sizeof(buffer))) > 0) {
+      for (int i = 0; i < n; i++) {
+        SensorLinkFrame frame;
+        if (_parser[channel].addByte(buffer[i], &frame)) {
+          _counts[channel] = frame.counts;
+          _lastFrameTime[channel] = timeMicros;
+          _linked[channel] = true;
+        }
+      }
+    }
+    if (_linked[channel] && timeMicros - _lastFrameTime[channel] > SENSOR_LINK_TIMEOUT_USEC)
+      _linked[channel] = false;
+  }
+}
+
+/*----------------------------------------------------------------------
+ * LoopbackSerialPort
+ ----------------------------------------------------------------------*/
+
+LoopbackSerialPort::LoopbackSerialPort() {
+  _head = 0;
+  _tail = 0;
+}
+
+int LoopbackSerialPort::read(uint8_t *buffer, int maxBytes) {
+  int n = 0;
+  while (n < maxBytes && _tail != _head) {
+    buffer[n++] = _buffer[_tail];
+    _tail = (_tail + 1) % LOOPBACK_BUFFER_SIZE;
+  }
+  return n;
+}
+
+void LoopbackSerialPort::write(const uint8_t *data, int length) {
+  for (int i = 0; i < length; i++) {
+    int next = (_head + 1) % LOOPBACK_BUFFER_SIZE;
+    if (next == _tail)
+      return;
+    _buffer[_head] = data[i];
+    _head = next;
+  }
+}
+
+void LoopbackSerialPort::sendFrame(uint8_t sequence, uint32_t boardMicros, uint16_t counts) {
+  SensorLinkFrame frame;
+  frame.sequence = sequence;
+  frame.boardMicros = boardMicros;
+  frame.counts = counts;
+  uint8_t buffer[SENSOR_LINK_FRAME_BYTES];
+  write(buffer, SensorLinkParser::encode(&frame, buffer));
+}
@@ -0,0 +1,96 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * Sensor source for boards that send their readings digitally (see
+ * SensorLink.h), one board per serial port. A channel without a port,
+ * or whose board hasn't sent a good frame for SENSOR_LINK_TIMEOUT_USEC
+ * (unplugged, or still booting), is read from its analog pin instead,
+ * so an installation keeps working while boards are being swapped.
+ *
+ * The link carries 14-bit counts, so fullScale() is SENSOR_LINK_FULL_SCALE
+ * and the analog readings are scaled up to match. With much less noise
+ * on the linked channels, far less averaging is needed; that's where the
+ * latency goes down.
+ *
+ * The serial ports are read in poll() (from the loop); read() (in the
+ * sampling interrupt) just takes the latest reading of each channel.
+ *
+ * No Arduino dependencies; LoopbackSerialPort can stand in for a board.
+ ----------------------------------------------------------------------*/
+
+#ifndef LinkSensorSource_h
+#define LinkSensorSource_h 1
+
+#include <stdint.h>
+#include "TactileBasics.h"
+#include "SensorSource.h"
+#include "SerialPort.h"
+#include "SensorLink.h"
+
+#define SENSOR_LINK_TIMEOUT_USEC 50000
+
+class LinkSensorSource : public SensorSource
+{
+ public:
+  LinkSensorSource(SensorSource *fallback);
+
+  uint16_t fullScale();
+  void     read(uint16_t values[]);
+  void     poll(uint32_t timeMicros);
+
+  void     setPort(int channel, SerialPort *port);     // NULL == analog only
+  bool     isLinked(int channel);
+  SensorLinkParser *getParser(int channel);           // for its statistics
+
+ private:
+  SensorSource     *_fallback;
+  uint16_t          _fallbackMultiplier;
+  SerialPort       *_port[NUM_CHANNELS];
+  SensorLinkParser  _parser[NUM_CHANNELS];
+  uint32_t          _lastFrameTime[NUM_CHANNELS];
+  volatile uint16_t _counts[NUM_CHANNELS];
+  volatile bool     _linked[NUM_CHANNELS];
+};
+
+
+// A stand-in for a sensor board and its serial line: whatever is written
+// (or sent as a frame) comes out of read(). Bytes that don't fit in the
+// buffer are lost, as they would be on a real line.
+
+#define LOOPBACK_BUFFER_SIZE 256
+
+class LoopbackSerialPort : public SerialPort
+{
+ public:
+  LoopbackSerialPort();
+
+  int      read(uint8_t *buffer, int maxBytes);
+  void     write(const uint8_t *data, int length);
+  void     sendFrame(uint8_t sequence, uint32_t boardMicros, uint16_t counts);
+
+ private:
+  uint8_t  _buffer[LOOPBACK_BUFFER_SIZE];
+  int      _head;
+  int      _tail;
+};
+
+#endif
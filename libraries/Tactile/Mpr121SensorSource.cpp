@@ -0,0 +1,231 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include "Mpr121SensorSource.h"
+
+// Registers
+#define MPR121_FILTERED_DATA  0x04
+#define MPR121_MHDR           0x2B
+#define MPR121_TOUCH_TH       0x41
+#define MPR121_RELEASE_TH     0x42
+#define MPR121_DEBOUNCE       0x5B
+#define MPR121_CONFIG1        0x5C
+#define MPR121_CONFIG2        0x5D
+#define MPR121_ECR            0x5E
+#define MPR121_SOFT_RESET     0x80
+
+/*----------------------------------------------------------------------
+ * Mpr121SensorSource
+ ----------------------------------------------------------------------*/
+
+Mpr121SensorSource::Mpr121SensorSource(I2CBus *bus, int numChips) {
+  _bus = bus;
+  if (numChips < 1)
+    numChips = 1;
+  else if (numChips > MPR121_MAX_CHIPS)
+    numChips = MPR121_MAX_CHIPS;
+  _numChips = numChips;
+  _connected = false;
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    _electrodeMask[channel] = (uint32_t)1 << channel;
+    _values[0][channel] = 0;
+    _values[1][channel] = 0;
+  }
+  _current = 0;
+  _irq = false;
+  _lastRead = 0;
+  _readInterval = MPR121_READ_INTERVAL_USEC;
+  _readCount = 0;
+  _errorCount = 0;
+}
+
+// The usual MPR121 setup (as in the data sheet and application notes),
+// with all 12 electrodes enabled.
+
+bool Mpr121SensorSource::_setupChip(uint8_t address) {
+  static const uint8_t filterSettings[] = {
+    0x01, 0x01, 0x0E, 0x00,         // rising:  MHD, NHD, NCL, FDL
+    0x01, 0x05, 0x01, 0x00,         // falling: MHD, NHD, NCL, FDL
+    0x00, 0x00, 0x00                // touched: NHD, NCL, FDL
+  };
+
+  _bus->writeRegister(address, MPR121_SOFT_RESET, 0x63);
+  _bus->writeRegister(address, MPR121_ECR, 0x00);        // stop mode for configuration
+  uint8_t config2;
+  if (!_bus->readRegisters(address, MPR121_CONFIG2, &config2, 1) || config2 != 0x24)
+    return false;                                        // no chip, or not an MPR121
+
+  for (int e = 0; e < MPR121_ELECTRODES; e++) {
+    _bus->writeRegister(address, MPR121_TOUCH_TH + 2 * e, 12);
+    _bus->writeRegister(address, MPR121_RELEASE_TH + 2 * e, 6);
+  }
+  for (unsigned i = 0; i < sizeof(filterSettings); i++)
+    _bus->writeRegister(address, MPR121_MHDR + i, filterSettings[i]);
+  _bus->writeRegister(address, MPR121_DEBOUNCE, 0x00);
+  _bus->writeRegister(address, MPR121_CONFIG1, 0x10);    // 16 uA charge current
+  _bus->writeRegister(address, MPR121_CONFIG2, 0x20);    // 0.5 usec charge, 4 samples, 1 msec interval
+  return _bus->writeRegister(address, MPR121_ECR, 0x8C); // run, baseline from first reading, 12 electrodes
+}
+
+void Mpr121SensorSource::begin() {
+  _bus->begin();
+  _connected = true;
+  for (int chip = 0; chip < _numChips; chip++) {
+    if (!_setupChip(MPR121_ADDRESS + chip))
+      _connected = false;
+  }
+  if (_connected)
+    _burstRead();
+}
+
+bool Mpr121SensorSource::isConnected() {
+  return _connected;
+}
+
+uint16_t Mpr121SensorSource::fullScale() {
+  return 1024;
+}
+
+void Mpr121SensorSource::read(uint16_t values[]) {
+  const uint16_t *latest = _values[_current];
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    values[channel] = latest[channel];
+}
+
+void Mpr121SensorSource::interrupt() {
+  _irq = true;
+}
+
+void Mpr121SensorSource::poll(uint32_t timeMicros) {
+  if (!_connected)
+    return;
+  if (!_irq && timeMicros - _lastRead < _readInterval)
+    return;
+  _irq = false;
+  _lastRead = timeMicros;
+  _burstRead();
+}
+
+void Mpr121SensorSource::_burstRead() {
+  uint16_t electrode[MPR121_ELECTRODES * MPR121_MAX_CHIPS];
+  uint8_t buffer[MPR121_BURST_BYTES];
+  for (int chip = 0; chip < _numChips; chip++) {
+    if (!_bus->readRegisters(MPR121_ADDRESS + chip, 0x00, buffer, MPR121_BURST_BYTES)) {
+      _errorCount++;
+      return;                       // keep the previous values
+    }
+    for (int e = 0; e < MPR121_ELECTRODES; e++) {
+      const uint8_t *data = &buffer[MPR121_FILTERED_DATA + 2 * e];
+      uint16_t filtered = data[0] | ((data[1] & 0x03) << 8);
+      electrode[chip * MPR121_ELECTRODES + e] = 1023 - filtered;
+    }
+  }
+  _readCount++;
+
+  int next = 1 - _current;
+  int numElectrodes = _numChips * MPR121_ELECTRODES;
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    uint16_t strongest = 0;
+    uint32_t mask = _electrodeMask[channel];
+    for (int e = 0; mask != 0 && e < numElectrodes; e++, mask >>= 1) {
+      if ((mask & 1) && electrode[e] > strongest)
+        strongest = electrode[e];
+    }
+    _values[next][channel] = strongest;
+  }
+  COMPILER_BARRIER();               // buffer must be complete before read() can see it
+  _current = next;
+}
+
+void Mpr121SensorSource::setChannelElectrodes(int channel, uint32_t electrodeMask) {
+  if (channel < 0 || channel >= NUM_CHANNELS)
+    return;
+  _electrodeMask[channel] = electrodeMask;
+}
+
+void Mpr121SensorSource::setReadInterval(uint32_t micros) {
+  _readInterval = micros;
+}
+
+uint32_t Mpr121SensorSource::getReadCount() {
+  return _readCount;
+}
+
+uint32_t Mpr121SensorSource::getErrorCount() {
+  return _errorCount;
+}
+
+/*----------------------------------------------------------------------
+ * SimulatedMpr121
+ ----------------------------------------------------------------------*/
+
+SimulatedMpr121::SimulatedMpr121() {
+  for (int chip = 0; chip < MPR121_MAX_CHIPS; chip++) {
+    for (int reg = 0; reg < 128; reg++)
+      _registers[chip][reg] = 0;
+    _registers[chip][MPR121_CONFIG2] = 0x24;
+  }
+  _transactions = 0;
+  _bytes = 0;
+}
+
+bool SimulatedMpr121::writeRegister(uint8_t address, uint8_t reg, uint8_t value) {
+  int chip = address - MPR121_ADDRESS;
+  if (chip < 0 || chip >= MPR121_MAX_CHIPS)
+    return false;
+  _transactions++;
+  _bytes += 3;
+  if (reg == MPR121_SOFT_RESET && value == 0x63) {
+    _registers[chip][MPR121_CONFIG2] = 0x24;
+    return true;
+  }
+  if (reg < 128)
+    _registers[chip][reg] = value;
+  return true;
+}
+
+bool SimulatedMpr121::readRegisters(uint8_t address, uint8_t reg, uint8_t *buffer, int count) {
+  int chip = address - MPR121_ADDRESS;
+  if (chip < 0 || chip >= MPR121_MAX_CHIPS || reg + count > 128)
+    return false;
+  _transactions++;
+  _bytes += 3 + count;              // address+write, register, address+read, data
+  for (int i = 0; i < count; i++)
+    buffer[i] = _registers[chip][reg + i];
+  return true;
+}
+
+void SimulatedMpr121::setFilteredData(int electrode, uint16_t value) {
+  int chip = electrode / MPR121_ELECTRODES;
+  if (chip < 0 || chip >= MPR121_MAX_CHIPS)
+    return;
+  int e = electrode % MPR121_ELECTRODES;
+  _registers[chip][MPR121_FILTERED_DATA + 2 * e] = value & 0xFF;
+  _registers[chip][MPR121_FILTERED_DATA + 2 * e + 1] = (value >> 8) & 0x03;
+}
+
+uint32_t SimulatedMpr121::getTransactionCount() {
+  return _transactions;
+}
+
+uint32_t SimulatedMpr121::getByteCount() {
+  return _bytes;
+}
@@ -0,0 +1,122 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * Sensor source for MPR121 capacitive touch controllers on I2C. Each chip
+ * has 12 electrodes, and up to two chips (24 electrodes) can be used, at
+ * addresses 0x5A and 0x5B. This replaces the Gemma-M0 boards: the
+ * electrodes connect straight to the controller.
+ *
+ * All electrodes of a chip are read in one burst transaction: the touch
+ * status registers (which also clears the chip's IRQ output) followed by
+ * the filtered data of all 12 electrodes. A burst takes about 0.6 msec at
+ * 400 kHz, far too long for the sampling interrupt, so it's done in
+ * poll() from the loop: right away when the chip's IRQ pin signals a
+ * touch or release, and otherwise every few milliseconds to keep the
+ * proximity values fresh. read() just copies the latest results.
+ *
+ * There are more electrodes than channels, so each channel is fed by a
+ * set of electrodes (a bit mask) and reads the strongest of them. By
+ * default channel N uses electrode N. A large wall can be covered by
+ * several electrodes per channel.
+ *
+ * Raw values are (1023 - filtered data), so they go up as a hand comes
+ * closer, like the analog sensors. The chip's own touch thresholds only
+ * trigger the IRQ; touch/release decisions are still made by Sensors.
+ *
+ * No Arduino dependencies; SimulatedMpr121 can stand in for the chips.
+ ----------------------------------------------------------------------*/
+
+#ifndef Mpr121SensorSource_h
+#define Mpr121SensorSource_h 1
+
+#include <stdint.h>
+#include "TactileBasics.h"
+#include "SensorSource.h"
+#include "I2CBus.h"
+
+#define MPR121_ADDRESS            0x5A
+#define MPR121_ELECTRODES         12
+#define MPR121_MAX_CHIPS          2
+#define MPR121_READ_INTERVAL_USEC 5000
+#define MPR121_BURST_BYTES        0x1E   // registers 0x00..0x1D: status, out-of-range, filtered data
+
+class Mpr121SensorSource : public SensorSource
+{
+ public:
+  Mpr121SensorSource(I2CBus *bus, int numChips);
+
+  void     begin();
+  bool     isConnected();
+  uint16_t fullScale();
+  void     read(uint16_t values[]);
+  void     poll(uint32_t timeMicros);
+  void     interrupt();                                   // from the IRQ pin's interrupt
+
+  void     setChannelElectrodes(int channel, uint32_t electrodeMask);
+  void     setReadInterval(uint32_t micros);
+  uint32_t getReadCount();
+  uint32_t getErrorCount();
+
+ private:
+  I2CBus  *_bus;
+  int      _numChips;
+  bool     _connected;
+  uint32_t _electrodeMask[NUM_CHANNELS];
+
+  // Double buffer: poll() fills one while read() (in the interrupt) uses the other.
+  uint16_t _values[2][NUM_CHANNELS];
+  volatile int _current;
+
+  volatile bool _irq;
+  uint32_t _lastRead;
+  uint32_t _readInterval;
+  uint32_t _readCount;
+  uint32_t _errorCount;
+
+  bool     _setupChip(uint8_t address);
+  void     _burstRead();
+};
+
+
+// A stand-in for one or more MPR121 chips, for testing without hardware.
+// It keeps the register file of each chip, and counts the transactions
+// and bytes on the "bus".
+
+class SimulatedMpr121 : public I2CBus
+{
+ public:
+  SimulatedMpr121();
+
+  bool writeRegister(uint8_t address, uint8_t reg, uint8_t value);
+  bool readRegisters(uint8_t address, uint8_t reg, uint8_t *buffer, int count);
+
+  void     setFilteredData(int electrode, uint16_t value);    // electrode 0..23
+  uint32_t getTransactionCount();
+  uint32_t getByteCount();
+
+ private:
+  uint8_t  _registers[MPR121_MAX_CHIPS][128];
+  uint32_t _transactions;
+  uint32_t _bytes;
+};
+
+#endif
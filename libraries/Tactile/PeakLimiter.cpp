@@ -0,0 +1,158 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+#include <math.h>
+#include <stdlib.h>
+#include "PeakLimiter.h"
+
+#define LIMITER_MASK (LIMITER_LOOKAHEAD - 1)
+
+PeakLimiter::PeakLimiter(float sampleRate) {
+  _sampleRate = sampleRate;
+  _threshold  = 32767;
+  _shift      = 0;
+  setRelease(LIMITER_RELEASE_MSEC);
+  reset();
+}
+
+void PeakLimiter::setThreshold(int32_t peak) {
+  if (peak < 1)
+    peak = 1;
+  else if (peak > 32767)
+    peak = 32767;
+  _threshold = peak;
+}
+
+void PeakLimiter::setMakeupShift(int shift) {
+  _shift = shift < 0 ? 0 : (shift > 4 ? 4 : shift);
+}
+
+// The release covers about 63% of the way back in this time
+
+void PeakLimiter::setRelease(int milliseconds) {
+  float samples = (float)milliseconds * _sampleRate / 1000.0f;
+  float coef = samples > 1.0f ? 1.0f - expf(-1.0f / samples) : 1.0f;
+  _releaseCoef = coef >= 1.0f ? 0x7FFFFFFF : (int32_t)(coef * 2147483648.0f);
+}
+
+void PeakLimiter::reset() {
+  for (int i = 0; i < LIMITER_LOOKAHEAD; i++) {
+    _delay[0][i] = 0;
+    _delay[1][i] = 0;
+    _average[i]  = LIMITER_UNITY;
+  }
+  _averageSum  = LIMITER_UNITY * LIMITER_LOOKAHEAD;
+  _release     = LIMITER_UNITY << 15;
+  _position    = 0;
+  _queueFirst  = 0;
+  _queueLength = 0;
+  _minGain     = LIMITER_UNITY;
+}
+
+// Rounded down, so gain times peak is never over the threshold
+
+inline int32_t PeakLimiter::_gainFor(int32_t peak) {
+  if (peak <= _threshold)
+    return LIMITER_UNITY;
+  return (_threshold << LIMITER_GAIN_Q) / peak;
+}
+
+/*----------------------------------------------------------------------
+ * For sample t, the gain needed goes on the end of the queue, in place
+ * of any there that aren't lower, and the one from t-64 leaves; the queue's
+ * first entry is then the lowest over t-63..t. Its release, averaged
+ * over the last 64 samples, is the gain for sample t-63, so every one of
+ * the 64 gains averaged is at or under what t-63 needs.
+ ----------------------------------------------------------------------*/
+
+void PeakLimiter::process(const int16_t *left, const int16_t *right,
+                          int16_t *outLeft, int16_t *outRight, int n) {
+  int32_t minGain = _minGain;
+  for (int i = 0; i < n; i++) {
+    int32_t l = left  ? (int32_t)left[i]  * (1 << _shift) : 0;
+    int32_t r = right ? (int32_t)right[i] * (1 << _shift) : 0;
+    int32_t peak = abs(l) > abs(r) ? abs(l) : abs(r);
+    int32_t need = _gainFor(peak);
+
+    if (_queueLength > 0 && _queueEnd[_queueFirst] == _position) {
+      _queueFirst = (_queueFirst + 1) & LIMITER_MASK;
+      _queueLength--;
+    }
+    int last = (_queueFirst + _queueLength - 1) & LIMITER_MASK;
+    while (_queueLength > 0 && _queueGain[last] >= need) {
+      _queueLength--;
+      last = (last - 1) & LIMITER_MASK;
+    }
+    last = (last + 1) & LIMITER_MASK;
+    _queueGain[last] = need;
+    _queueEnd[last] = _position + LIMITER_LOOKAHEAD;
+    _queueLength++;
+    int32_t lowest = _queueGain[_queueFirst] << 15;
+
+    if (lowest < _release)
+      _release = lowest;
+    else
+      _release += (int32_t)(((int64_t)(lowest - _release) * _releaseCoef) >> 31);
+
+    int slot = _position & LIMITER_MASK;
+    int32_t released = _release >> 15;
+    _averageSum += released - _average[slot];
+    _average[slot] = released;
+    int32_t gain = _averageSum >> LIMITER_LOOKAHEAD_LOG2;
+    if (gain < minGain)
+      minGain = gain;
+
+    _delay[0][slot] = l;
+    _delay[1][slot] = r;
+    int oldest = (slot + 1) & LIMITER_MASK;
+    l = (int32_t)(((int64_t)_delay[0][oldest] * gain) >> LIMITER_GAIN_Q);
+    r = (int32_t)(((int64_t)_delay[1][oldest] * gain) >> LIMITER_GAIN_Q);
+    outLeft[i]  = l > 32767 ? 32767 : (l < -32768 ? -32768 : l);
+    outRight[i] = r > 32767 ? 32767 : (r < -32768 ? -32768 : r);
+    _position++;
+  }
+  _minGain = minGain;
+}
+
+// The gain a limiter would need for this block's peak, if the makeup
+// and limiting are done after it
+
+void PeakLimiter::measure(const int16_t *left, const int16_t *right, int n) {
+  int32_t peak = 0;
+  for (int i = 0; i < n; i++) {
+    int32_t l = left  ? abs(left[i])  : 0;
+    int32_t r = right ? abs(right[i]) : 0;
+    if (l > peak)
+      peak = l;
+    if (r > peak)
+      peak = r;
+  }
+  int32_t gain = _gainFor(peak << _shift);
+  if (gain < _minGain)
+    _minGain = gain;
+}
+
+int32_t PeakLimiter::takeMinGain() {
+  int32_t gain = _minGain;
+  _minGain = LIMITER_UNITY;
+  return gain;
+}
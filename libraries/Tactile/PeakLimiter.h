@@ -0,0 +1,96 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+/*----------------------------------------------------------------------
+ * A look-ahead peak limiter for the master bus, in fixed point. The mix
+ * is made with headroom (the voices at a quarter of their gain, say), so
+ * that nothing clips while it's summed; the limiter puts the level back
+ * (setMakeupShift()) and keeps the peaks of the result at or under the
+ * threshold.
+ *
+ * Left and right share one gain, so the stereo image doesn't move. For
+ * each sample, the gain that would bring it to the threshold is worked
+ * out; the gain used is the lowest of those over the next
+ * LIMITER_LOOKAHEAD samples, smoothed by a moving average of the same
+ * length, so it has come down in a straight line by the time the peak
+ * comes out (the output is LIMITER_LOOKAHEAD - 1 samples late). Then it
+ * recovers with an exponential release. Nothing gets past the threshold,
+ * and below it the signal is untouched, bit for bit.
+ *
+ * takeMinGain() is the meter: the most the gain came down since it was
+ * last called. measure() works the same meter out without processing,
+ * for when something else (the audio codec) does the limiting.
+ *
+ * No Arduino dependencies. See AudioEffectLimiter.h for the piece that
+ * connects this to the Teensy audio library.
+ ----------------------------------------------------------------------*/
+
+#ifndef PeakLimiter_h
+#define PeakLimiter_h 1
+
+#include <stdint.h>
+
+#define LIMITER_LOOKAHEAD     64           // samples, about 1.5 msec; a power of 2
+#define LIMITER_LOOKAHEAD_LOG2 6
+#define LIMITER_GAIN_Q        15
+#define LIMITER_UNITY         (1 << LIMITER_GAIN_Q)
+#define LIMITER_RELEASE_MSEC  100
+
+class PeakLimiter
+{
+ public:
+  PeakLimiter(float sampleRate = 44100.0);
+
+  void    setThreshold(int32_t peak);      // the largest output sample, up to 32767
+  void    setMakeupShift(int shift);       // input times 2^shift, 0 to 4
+  void    setRelease(int milliseconds);
+  void    reset();
+
+  // NULL inputs are silence. The outputs may be the inputs.
+  void    process(const int16_t *left, const int16_t *right, int16_t *outLeft, int16_t *outRight, int n);
+  void    measure(const int16_t *left, const int16_t *right, int n);
+
+  int32_t takeMinGain();                   // Q15; LIMITER_UNITY == no limiting
+
+ private:
+  float    _sampleRate;
+  int32_t  _threshold;
+  int      _shift;
+  int32_t  _releaseCoef;                   // Q31, per sample
+  int32_t  _release;                       // the released gain, Q30
+  int32_t  _delay[2][LIMITER_LOOKAHEAD];   // with the makeup
+  int32_t  _average[LIMITER_LOOKAHEAD];    // the released gains being averaged, Q15
+  int32_t  _averageSum;
+  uint32_t _position;                      // samples so far
+  int32_t  _minGain;
+
+  // The lowest gain over the look-ahead: a queue of gains, each lower
+  // than the ones before it, and when each has to leave
+  int32_t  _queueGain[LIMITER_LOOKAHEAD];
+  uint32_t _queueEnd[LIMITER_LOOKAHEAD];
+  int      _queueFirst;
+  int      _queueLength;
+
+  int32_t  _gainFor(int32_t peak);
+};
+
+#endif
@@ -0,0 +1,124 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+#include <string.h>
+#include "PrerollCache.h"
+
+static uint32_t align4(uint32_t n) {
+  return (n + 3) & ~3;
+}
+
+PrerollCache::PrerollCache() {
+  _pool = 0;
+  _poolBytes = 0;
+  clear();
+}
+
+void PrerollCache::setPool(uint8_t *pool, uint32_t bytes) {
+  _pool = pool;
+  _poolBytes = pool ? bytes : 0;
+  clear();
+}
+
+void PrerollCache::clear() {
+  _used = 0;
+  _first = 0;
+  _last = 0;
+  _numTracks = 0;
+  _numSkipped = 0;
+}
+
+bool PrerollCache::add(SampleFile *file, const char *path, uint32_t milliseconds) {
+  if (!path || !path[0] || find(path))
+    return false;
+  if (!file->open(path))
+    return false;
+  WavFormat format;
+  if (!WavStream::readHeader(file, &format, true) || !file->seek(format.dataOffset)) {
+    file->close();
+    return false;
+  }
+  uint32_t frameBytes = 2 * format.channels;
+  uint32_t bytes = (uint32_t)((uint64_t)milliseconds * format.bytesPerSecond / 1000);
+  if (bytes > format.dataBytes)
+    bytes = format.dataBytes;
+  bytes -= bytes % frameBytes;
+
+  uint32_t pathBytes = strlen(path) + 1;
+  uint32_t needed = align4(sizeof(PrerollEntry)) + align4(pathBytes) + align4(bytes);
+  if (bytes == 0 || needed > _poolBytes - _used) {
+    file->close();
+    _numSkipped++;
+    return false;
+  }
+
+  uint8_t *p = _pool + _used;
+  PrerollEntry *entry = (PrerollEntry *)p;
+  char *entryPath = (char *)(p + align4(sizeof(PrerollEntry)));
+  uint8_t *data = (uint8_t *)entryPath + align4(pathBytes);
+  int n = file->read(data, bytes);
+  file->close();
+  if (n <= 0)
+    return false;
+  bytes = n - n % frameBytes;
+
+  memcpy(entryPath, path, pathBytes);
+  entry->next = 0;
+  entry->format = format;
+  entry->data = data;
+  entry->bytes = bytes;
+  entry->path = entryPath;
+  if (_last)
+    _last->next = entry;
+  else
+    _first = entry;
+  _last = entry;
+  _used += align4(sizeof(PrerollEntry)) + align4(pathBytes) + align4(bytes);
+  _numTracks++;
+  return true;
+}
+
+const PrerollEntry *PrerollCache::find(const char *path) {
+  if (!path)
+    return 0;
+  for (PrerollEntry *entry = _first; entry; entry = entry->next) {
+    if (strcmp(entry->path, path) == 0)
+      return entry;
+  }
+  return 0;
+}
+
+uint32_t PrerollCache::getPoolBytes() {
+  return _poolBytes;
+}
+
+uint32_t PrerollCache::getUsedBytes() {
+  return _used;
+}
+
+int PrerollCache::getNumTracks() {
+  return _numTracks;
+}
+
+int PrerollCache::getNumSkipped() {
+  return _numSkipped;
+}
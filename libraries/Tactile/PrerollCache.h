@@ -0,0 +1,82 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+/*----------------------------------------------------------------------
+ * The first part of each track, kept in memory (on a Teensy 4.1, the
+ * optional PSRAM chip) so a touch can start the sound without waiting
+ * for the SD card: see WavStream::startPreroll().
+ *
+ * The cache is a simple stack in a memory pool supplied by the caller:
+ * each track's entry, its path and its samples go one after another,
+ * until the pool is full. Tracks that don't fit are skipped (and
+ * counted), so the budget is never exceeded. Tracks are never removed
+ * one at a time, only all together by clear().
+ *
+ * add() reads the card for a long time (a third of a second of stereo
+ * is over a hundred sectors), so it's meant for startup, or for when
+ * nothing is playing.
+ *
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef PrerollCache_h
+#define PrerollCache_h 1
+
+#include <stdint.h>
+#include "SampleFile.h"
+#include "WavStream.h"
+
+struct PrerollEntry {
+  PrerollEntry  *next;
+  WavFormat      format;
+  const uint8_t *data;
+  uint32_t       bytes;                     // whole frames
+  const char    *path;
+};
+
+class PrerollCache
+{
+ public:
+  PrerollCache();
+
+  void     setPool(uint8_t *pool, uint32_t bytes);    // and clear()
+  void     clear();
+
+  bool     add(SampleFile *file, const char *path, uint32_t milliseconds);
+  const PrerollEntry *find(const char *path);
+
+  uint32_t getPoolBytes();
+  uint32_t getUsedBytes();
+  int      getNumTracks();
+  int      getNumSkipped();                 // didn't fit
+
+ private:
+  uint8_t      *_pool;
+  uint32_t      _poolBytes;
+  uint32_t      _used;
+  PrerollEntry *_first;
+  PrerollEntry *_last;
+  int           _numTracks;
+  int           _numSkipped;
+};
+
+#endif
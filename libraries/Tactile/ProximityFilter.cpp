@@ -0,0 +1,148 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include "ProximityFilter.h"
+
+// One-euro tuning. The speed estimate is itself smoothed by an EMA of
+// 2^ONE_EURO_SPEED_SHIFT samples, and the speed (in Q16 counts on a 10-bit
+// scale) adds speed>>ONE_EURO_BETA_SHIFT to alpha.
+
+#define ONE_EURO_SPEED_SHIFT 4
+#define ONE_EURO_BETA_SHIFT  8
+
+ProximityFilter::ProximityFilter() {
+  _value = 0;
+  configure(emaFilter, 1, 1024);
+}
+
+void ProximityFilter::configure(FilterType type, int samples, uint16_t fullScale) {
+  if (samples < 1)
+    samples = 1;
+  _type = type;
+  _samples = samples;
+
+  // Round the averaging strength to the nearest power of two.
+  _shift = 0;
+  while (_shift < 15 && (3 << _shift) < 2 * samples)  // i.e. 2^shift < samples/1.5
+    _shift++;
+
+  _speedShift = 0;
+  while ((fullScale >> _speedShift) > 1024)
+    _speedShift++;
+
+  _windowSize = samples | 1;
+  if (_windowSize > MEDIAN_FILTER_MAX_WINDOW)
+    _windowSize = MEDIAN_FILTER_MAX_WINDOW;
+
+  reset((uint16_t)(_value >> 16));
+}
+
+FilterType ProximityFilter::getType() {
+  return _type;
+}
+
+int ProximityFilter::getSamples() {
+  return _samples;
+}
+
+void ProximityFilter::reset(uint16_t raw) {
+  _value = (int32_t)raw << 16;
+  _stage1 = _value;
+  _speed = 0;
+  _windowPos = 0;
+  _windowCount = 0;
+}
+
+int32_t ProximityFilter::getValue() {
+  return _value;
+}
+
+int32_t ProximityFilter::filter(uint16_t raw) {
+  int32_t x = (int32_t)raw << 16;
+  switch (_type) {
+  case emaFilter:
+    _value += (x - _value) >> _shift;
+    break;
+  case cascadedEmaFilter: {
+    int shift = _shift > 0 ? _shift - 1 : 0;
+    _stage1 += (x - _stage1) >> shift;
+    _value  += (_stage1 - _value) >> shift;
+    break;
+  }
+  case medianFilter:
+    _value = _filterMedian(raw);
+    break;
+  case oneEuroFilter:
+    _value = _filterOneEuro(x);
+    break;
+  }
+  return _value;
+}
+
+/*----------------------------------------------------------------------
+ * Sliding median. _sorted[] holds the current window in order; each new
+ * sample replaces the oldest one, which is found and removed, then the new
+ * one is inserted in place. Both steps are a short shift within the array.
+ ----------------------------------------------------------------------*/
+
+int32_t ProximityFilter::_filterMedian(uint16_t raw) {
+  int n = _windowCount;
+  if (n == _windowSize) {
+    uint16_t oldest = _window[_windowPos];
+    int i = 0;
+    while (i < n - 1 && _sorted[i] != oldest)
+      i++;
+    for (; i < n - 1; i++)
+      _sorted[i] = _sorted[i+1];
+    n--;
+  } else {
+    _windowCount++;
+  }
+  int i = n;
+  while (i > 0 && _sorted[i-1] > raw) {
+    _sorted[i] = _sorted[i-1];
+    i--;
+  }
+  _sorted[i] = raw;
+  _window[_windowPos] = raw;
+  if (++_windowPos >= _windowSize)
+    _windowPos = 0;
+
+  return (int32_t)_sorted[_windowCount >> 1] << 16;
+}
+
+/*----------------------------------------------------------------------
+ * One-euro: alpha = 2^-shift (the "minimum cutoff") plus a term that
+ * grows with the smoothed speed. alpha is Q16, so 65536 is "no smoothing".
+ ----------------------------------------------------------------------*/
+
+int32_t ProximityFilter::_filterOneEuro(int32_t x) {
+  // The speed is the smoothed *signed* difference between the input and
+  // the current estimate, so noise averages out but real motion doesn't.
+  int32_t dx = (x - _value) >> _speedShift;
+  _speed += (dx - _speed) >> ONE_EURO_SPEED_SHIFT;
+  int32_t speed = _speed < 0 ? -_speed : _speed;
+
+  int32_t alpha = (65536 >> _shift) + (speed >> ONE_EURO_BETA_SHIFT);
+  if (alpha > 65536)
+    alpha = 65536;
+  return _value + (int32_t)(((int64_t)(x - _value) * alpha) >> 16);
+}
@@ -0,0 +1,100 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * Smoothing filters for the raw sensor readings, one ProximityFilter per
+ * channel. Everything is integer arithmetic in Q16 fixed point (16 bits
+ * of fraction), so a 10-bit ADC reading of 512 is 512<<16 internally.
+ * This keeps the full resolution of the average instead of truncating to
+ * whole ADC counts, and there are no divides: the averaging "strength"
+ * is rounded to a power of two and applied with a shift.
+ *
+ * Raw inputs must fit in 15 bits (0..32767) so that the Q16 values fit
+ * in an int32_t.
+ *
+ * Kernels (see FilterType in TactileBasics.h):
+ *
+ *   emaFilter
+ *     y += (x - y) / 2^k, where 2^k is about the averaging strength.
+ *
+ *   cascadedEmaFilter
+ *     Two EMA stages, each at half the time constant. About the same
+ *     delay as a single EMA, but it rolls off noise much more steeply.
+ *
+ *   medianFilter
+ *     Median of the last N samples (N is the averaging strength, odd,
+ *     at most MEDIAN_FILTER_MAX_WINDOW). Throws away spikes completely.
+ *
+ *   oneEuroFilter
+ *     An EMA whose strength depends on how fast the signal is changing
+ *     (after Casiez et al., "1 Euro Filter"). When the hand is still it
+ *     averages heavily; when the hand is moving it follows quickly, so
+ *     there's little added latency on a real touch.
+ *
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef ProximityFilter_h
+#define ProximityFilter_h 1
+
+#include <stdint.h>
+#include "TactileBasics.h"
+
+#define MEDIAN_FILTER_MAX_WINDOW 15
+
+class ProximityFilter
+{
+ public:
+  ProximityFilter();
+
+  void       configure(FilterType type, int samples, uint16_t fullScale);
+  FilterType getType();
+  int        getSamples();
+
+  void       reset(uint16_t raw);
+  int32_t    filter(uint16_t raw);    // returns the new filtered value, Q16
+  int32_t    getValue();              // latest filtered value, Q16
+
+ private:
+  FilterType _type;
+  int        _samples;
+  int        _shift;                  // EMA strength is 2^_shift samples
+  int        _speedShift;             // normalizes one-euro speed to a 10-bit scale
+  int32_t    _value;
+
+  // EMA and cascaded EMA
+  int32_t    _stage1;
+
+  // Sliding median
+  int        _windowSize;
+  int        _windowPos;
+  int        _windowCount;
+  uint16_t   _window[MEDIAN_FILTER_MAX_WINDOW];   // in arrival order
+  uint16_t   _sorted[MEDIAN_FILTER_MAX_WINDOW];   // same samples, sorted
+
+  // One-euro
+  int32_t    _speed;                  // smoothed (input - output), Q16
+
+  int32_t    _filterMedian(uint16_t raw);
+  int32_t    _filterOneEuro(int32_t x);
+};
+
+#endif
@@ -0,0 +1,268 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+#include <string.h>
+#include "RampMixer.h"
+
+#define RAMP_DONE ((uint32_t)1 << 30)
+
+// Fade-in curves, Q15, at x = 0, 1/64, ... 1. Linear needs no table.
+static const uint16_t equalPowerCurve[FADE_TABLE_SEGMENTS + 1] = {
+  0, 804, 1608, 2411, 3212, 4011, 4808, 5602, 6393, 7180, 7962, 8740, 9512,
+  10279, 11039, 11793, 12540, 13279, 14010, 14733, 15447, 16151, 16846, 17531,
+  18205, 18868, 19520, 20160, 20788, 21403, 22006, 22595, 23170, 23732, 24279,
+  24812, 25330, 25833, 26320, 26791, 27246, 27684, 28106, 28511, 28899, 29269,
+  29622, 29957, 30274, 30572, 30853, 31114, 31357, 31581, 31786, 31972, 32138,
+  32286, 32413, 32522, 32610, 32679, 32729, 32758, 32768};
+
+// (10^(3x) - 1) / 999: 60 dB, then straight to zero
+static const uint16_t exponentialCurve[FADE_TABLE_SEGMENTS + 1] = {
+  0, 4, 8, 13, 18, 23, 30, 37, 45, 54, 64, 75, 87, 101, 116, 133, 152, 173,
+  196, 222, 251, 284, 320, 360, 405, 454, 510, 572, 641, 718, 803, 898, 1004,
+  1123, 1254, 1401, 1564, 1747, 1949, 2175, 2427, 2707, 3020, 3367, 3755,
+  4187, 4668, 5203, 5800, 6465, 7205, 8030, 8949, 9973, 11114, 12384, 13799,
+  15376, 17132, 19088, 21267, 23695, 26399, 29412, 32768};
+
+static const int16_t silence[MIXER_BLOCK_SAMPLES] __attribute__((aligned(4))) = {0};
+
+RampMixer::RampMixer(float sampleRate) {
+  _samplesPerMsec = sampleRate / 1000.0;
+  for (int voice = 0; voice < MIXER_VOICES; voice++) {
+    _start[voice]    = 0;
+    _target[voice]   = 0;
+    _gain[voice]     = 0;
+    _position[voice] = RAMP_DONE;
+    _step[voice]     = 0;
+    _curve[voice]    = fadeLinear;
+    _ramping[voice]  = false;
+    _filled[voice]   = false;
+  }
+}
+
+/*----------------------------------------------------------------------
+ * Control side: post a target. A new ramp starts from wherever the old
+ * one had got to, so interrupting a fade never jumps.
+ ----------------------------------------------------------------------*/
+
+void RampMixer::setGain(int voice, int32_t gain, int rampMsec, FadeCurve curve) {
+  if (voice < 0 || voice >= MIXER_VOICES)
+    return;
+  if (gain < 0)
+    gain = 0;
+  else if (gain > MIXER_MAX_GAIN)
+    gain = MIXER_MAX_GAIN;
+  int32_t samples = rampMsec > 0 ? (int32_t)((float)rampMsec * _samplesPerMsec + 0.5) : 0;
+
+  _target[voice] = gain;
+  _curve[voice]  = curve;
+  if (samples <= 1 || gain == getGain(voice)) {
+    _gain[voice]     = gain << 16;
+    _start[voice]    = gain;
+    _position[voice] = RAMP_DONE;
+    _ramping[voice]  = false;
+    _filled[voice]   = false;
+    return;
+  }
+  _start[voice]    = getGain(voice);
+  _position[voice] = 0;
+  _step[voice]     = RAMP_DONE / samples;
+  _ramping[voice]  = true;
+}
+
+int32_t RampMixer::getGain(int voice) {
+  return _gain[voice] >> 16;
+}
+
+int32_t RampMixer::getTarget(int voice) {
+  return _target[voice];
+}
+
+bool RampMixer::isRamping(int voice) {
+  return _ramping[voice];
+}
+
+int32_t RampMixer::curve(FadeCurve curve, uint32_t x) {
+  if (x >= 65536)
+    return 32768;
+  if (curve == fadeLinear)
+    return x >> 1;
+  const uint16_t *table = (curve == fadeEqualPower) ? equalPowerCurve : exponentialCurve;
+  int segment = x >> 10;                  // 64 segments of 1024
+  int32_t frac = x & 1023;
+  int32_t y0 = table[segment];
+  return y0 + (((table[segment + 1] - y0) * frac) >> 10);
+}
+
+int32_t RampMixer::_gainAt(int voice, uint32_t position) {
+  uint32_t x = position >> 14;            // Q30 to Q16
+  int32_t start  = _start[voice];
+  int32_t target = _target[voice];
+  if (target >= start)
+    return start + (((target - start) * curve(_curve[voice], x)) >> 15);
+  return target + (((start - target) * curve(_curve[voice], 65536 - x)) >> 15);
+}
+
+// Fills in the per-sample gains for the next n samples: the curve gives
+// the gain at the end of the block, and the samples step evenly to it.
+// Steady voices are only written once.
+
+void RampMixer::_nextGains(int n) {
+  for (int voice = 0; voice < MIXER_VOICES; voice++) {
+    int16_t *g = &_gains[voice >> 1][voice & 1];
+    if (!_ramping[voice]) {
+      if (!_filled[voice]) {
+        int16_t gain = _gain[voice] >> 16;
+        for (int i = 0; i < MIXER_BLOCK_SAMPLES; i++)
+          g[2 * i] = gain;
+        _filled[voice] = true;
+      }
+      continue;
+    }
+    uint64_t end = (uint64_t)_position[voice] + (uint64_t)_step[voice] * n;
+    if (end >= RAMP_DONE)
+      end = RAMP_DONE;
+    int32_t endGain = _gainAt(voice, end) << 16;
+    int32_t gain = _gain[voice];
+    int32_t increment = (endGain - gain) / n;
+    for (int i = 0; i < n; i++) {
+      gain += increment;
+      g[2 * i] = gain >> 16;
+    }
+    g[2 * (n - 1)] = endGain >> 16;       // no rounding error left over
+    _gain[voice] = endGain;
+    _position[voice] = end;
+    if (end == RAMP_DONE) {
+      _start[voice]   = _target[voice];
+      _ramping[voice] = false;
+      _filled[voice]  = false;            // the next block is all at the target
+    }
+  }
+}
+
+/*----------------------------------------------------------------------
+ * The mix. For each sample, the two voices of a pair are packed into one
+ * word (PKHBT/PKHTB take a half of each of two words) and SMLAD multiplies
+ * them by the pair's gains and adds both products at once. Samples and
+ * gains are loaded two at a time; memcpy() of a pair is a single 32-bit
+ * load, without breaking the compiler's aliasing rules.
+ ----------------------------------------------------------------------*/
+
+static inline int32_t smlad(uint32_t x, uint32_t y, int32_t acc) {
+#if defined(__ARM_FEATURE_DSP)
+  int32_t result;
+  asm ("smlad %0, %1, %2, %3" : "=r" (result) : "r" (x), "r" (y), "r" (acc));
+  return result;
+#else
+  return acc + (int32_t)(int16_t)(x & 0xFFFF) * (int16_t)(y & 0xFFFF)
+             + (int32_t)(int16_t)(x >> 16) * (int16_t)(y >> 16);
+#endif
+}
+
+// low halves of x and y: (x.low, y.low)
+static inline uint32_t packLow(uint32_t x, uint32_t y) {
+#if defined(__ARM_FEATURE_DSP)
+  uint32_t result;
+  asm ("pkhbt %0, %1, %2, lsl #16" : "=r" (result) : "r" (x), "r" (y));
+  return result;
+#else
+  return (x & 0xFFFF) | (y << 16);
+#endif
+}
+
+// high halves of x and y: (x.high, y.high)
+static inline uint32_t packHigh(uint32_t x, uint32_t y) {
+#if defined(__ARM_FEATURE_DSP)
+  uint32_t result;
+  asm ("pkhtb %0, %1, %2, asr #16" : "=r" (result) : "r" (y), "r" (x));
+  return result;
+#else
+  return (x >> 16) | (y & 0xFFFF0000);
+#endif
+}
+
+static inline int32_t saturate16(int32_t x) {
+#if defined(__ARM_FEATURE_DSP)
+  int32_t result;
+  asm ("ssat %0, #16, %1" : "=r" (result) : "r" (x));
+  return result;
+#else
+  if (x > 32767)
+    return 32767;
+  if (x < -32768)
+    return -32768;
+  return x;
+#endif
+}
+
+static inline uint32_t load2(const int16_t *p) {
+  uint32_t pair;
+  memcpy(&pair, p, sizeof(pair));
+  return pair;
+}
+
+static void mixSide(const int16_t *const in[], const int16_t *gains01, const int16_t *gains23,
+                    int16_t *out, int n) {
+  const int16_t *in0 = in[0] ? in[0] : silence;
+  const int16_t *in1 = in[1] ? in[1] : silence;
+  const int16_t *in2 = in[2] ? in[2] : silence;
+  const int16_t *in3 = in[3] ? in[3] : silence;
+  for (int i = 0; i < n; i += 2) {
+    uint32_t x0 = load2(in0 + i);          // voice 0, samples i and i+1
+    uint32_t x1 = load2(in1 + i);
+    uint32_t x2 = load2(in2 + i);
+    uint32_t x3 = load2(in3 + i);
+    int32_t a = smlad(packLow(x0, x1),  load2(gains01 + 2 * i), MIXER_UNITY / 2);
+    a         = smlad(packLow(x2, x3),  load2(gains23 + 2 * i), a);
+    int32_t b = smlad(packHigh(x0, x1), load2(gains01 + 2 * i + 2), MIXER_UNITY / 2);
+    b         = smlad(packHigh(x2, x3), load2(gains23 + 2 * i + 2), b);
+    uint32_t pair = packLow(saturate16(a >> MIXER_GAIN_Q), saturate16(b >> MIXER_GAIN_Q));
+    memcpy(out + i, &pair, sizeof(pair));
+  }
+}
+
+void RampMixer::mix(const int16_t *const left[], const int16_t *const right[],
+                    int16_t *outLeft, int16_t *outRight, int n) {
+  _nextGains(n);
+  mixSide(left,  _gains[0], _gains[1], outLeft,  n);
+  mixSide(right, _gains[0], _gains[1], outRight, n);
+}
+
+// Summed in 64 bits, so that it doesn't share an overflow with the kernel
+// it checks.
+
+void RampMixer::mixReference(const int16_t *const left[], const int16_t *const right[],
+                             int16_t *outLeft, int16_t *outRight, int n) {
+  _nextGains(n);
+  for (int side = 0; side < 2; side++) {
+    const int16_t *const *in = side ? right : left;
+    int16_t *out = side ? outRight : outLeft;
+    for (int i = 0; i < n; i++) {
+      int64_t acc = MIXER_UNITY / 2;
+      for (int voice = 0; voice < MIXER_VOICES; voice++) {
+        if (in[voice])
+          acc += (int64_t)in[voice][i] * _gains[voice >> 1][2 * i + (voice & 1)];
+      }
+      acc >>= MIXER_GAIN_Q;
+      out[i] = acc > 32767 ? 32767 : (acc < -32768 ? -32768 : (int16_t)acc);
+    }
+  }
+}
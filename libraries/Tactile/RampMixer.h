@@ -0,0 +1,109 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+/*----------------------------------------------------------------------
+ * A stereo mixer for the players' voices whose gains change smoothly.
+ * The caller posts a target gain and how long to take getting there;
+ * mix() then moves the gain a little on every sample, so a fade is as
+ * smooth at the end of a slow loop() as at the start, and changing the
+ * volume doesn't step (the "zipper" noise of setting a mixer gain from
+ * the loop).
+ *
+ * The ramp follows a fade curve, taken from a table at the end of each
+ * block and interpolated linearly in between:
+ *
+ *   fadeLinear        straight line
+ *   fadeEqualPower    sin(x*pi/2): a fade-in and a fade-out played
+ *                     together keep the loudness constant (crossfades)
+ *   fadeExponential   60 dB in equal steps of dB per msec: sounds like an
+ *                     even fade to the ear; most of the change is at the
+ *                     loud end
+ *
+ * A ramp down is the same curve played backwards, so a fade-out mirrors
+ * the fade-in.
+ *
+ * Gains are Q13 (MIXER_UNITY == 1.0), up to just under 2.0: four
+ * full-scale 16-bit samples times that, plus the rounding, still fit in
+ * the 32-bit sum (at 2.0 and above they wouldn't). For each sample the
+ * gains of a pair of voices sit in one 32-bit word, which on a Cortex-M4
+ * or M7 lets SMLAD do both multiply-accumulates in one instruction.
+ * mixReference() is the plain C version that the fast one has to match
+ * exactly; elsewhere (on a host) SMLAD is emulated in C.
+ *
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef RampMixer_h
+#define RampMixer_h 1
+
+#include <stdint.h>
+
+#define MIXER_VOICES          4
+#define MIXER_BLOCK_SAMPLES   128          // same as AUDIO_BLOCK_SAMPLES
+#define MIXER_GAIN_Q          13
+#define MIXER_UNITY           (1 << MIXER_GAIN_Q)
+#define MIXER_MAX_GAIN        (2 * MIXER_UNITY - 1)   // see above; setGain() clamps to it
+#define MIXER_DEZIPPER_MSEC   10           // for volume changes that aren't fades
+
+#define FADE_TABLE_SEGMENTS   64
+
+enum FadeCurve {fadeLinear, fadeEqualPower, fadeExponential};
+
+class RampMixer
+{
+ public:
+  RampMixer(float sampleRate = 44100.0);
+
+  void    setGain(int voice, int32_t gain, int rampMsec, FadeCurve curve = fadeLinear);
+  int32_t getGain(int voice);              // where the ramp is now
+  int32_t getTarget(int voice);
+  bool    isRamping(int voice);
+
+  // n is even, at most MIXER_BLOCK_SAMPLES. A NULL input is silence.
+  void mix(const int16_t *const left[], const int16_t *const right[],
+           int16_t *outLeft, int16_t *outRight, int n);
+  void mixReference(const int16_t *const left[], const int16_t *const right[],
+                    int16_t *outLeft, int16_t *outRight, int n);
+
+  static int32_t curve(FadeCurve curve, uint32_t x);   // x is Q16 (0 to 65536), result Q15
+
+ private:
+  float     _samplesPerMsec;
+  int32_t   _start[MIXER_VOICES];
+  int32_t   _target[MIXER_VOICES];
+  int32_t   _gain[MIXER_VOICES];           // Q13 << 16, for the per-sample steps
+  uint32_t  _position[MIXER_VOICES];       // how far along the ramp, Q30 (RAMP_DONE == finished)
+  uint32_t  _step[MIXER_VOICES];           // ... per sample
+  FadeCurve _curve[MIXER_VOICES];
+  bool      _ramping[MIXER_VOICES];
+  bool      _filled[MIXER_VOICES];         // _gains holds this voice's (steady) gain
+
+  // Per-sample gains for the block, voices interleaved in pairs: the word
+  // at [pair][2*i] is voice 2*pair's gain in the low half and voice
+  // 2*pair+1's in the high half.
+  int16_t   _gains[MIXER_VOICES / 2][2 * MIXER_BLOCK_SAMPLES] __attribute__((aligned(4)));
+
+  int32_t _gainAt(int voice, uint32_t position);
+  void    _nextGains(int n);
+};
+
+#endif
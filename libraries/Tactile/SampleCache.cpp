@@ -0,0 +1,217 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+#include <string.h>
+#include "SampleCache.h"
+
+// Entry memory is the samples followed by the path.
+
+static uint32_t entryBytes(uint32_t dataBytes, const char *path) {
+  return ((dataBytes + 3) & ~3) + strlen(path) + 1;
+}
+
+SampleCache::SampleCache() {
+  for (int i = 0; i < SAMPLE_CACHE_MAX_TRACKS; i++) {
+    _entries[i].path = 0;
+    _entries[i].data = 0;
+    _entries[i].users = 0;
+    _entries[i].ready = false;
+  }
+  _alloc = 0;
+  _free = 0;
+  _budget = 0;
+  _maxTrackBytes = 0;
+  _used = 0;
+  _clock = 0;
+  resetStats();
+}
+
+void SampleCache::setBudget(uint32_t bytes, uint32_t maxTrackBytes, SampleCacheAlloc alloc, SampleCacheFree free) {
+  clear();
+  _budget = bytes;
+  _maxTrackBytes = maxTrackBytes;
+  _alloc = alloc;
+  _free = free;
+}
+
+void SampleCache::clear() {
+  for (int i = 0; i < SAMPLE_CACHE_MAX_TRACKS; i++) {
+    if (_entries[i].path && _entries[i].users == 0)
+      _freeEntry(&_entries[i]);
+  }
+}
+
+SampleCacheEntry *SampleCache::_find(const char *path) {
+  for (int i = 0; i < SAMPLE_CACHE_MAX_TRACKS; i++) {
+    if (_entries[i].path && strcmp(_entries[i].path, path) == 0)
+      return &_entries[i];
+  }
+  return 0;
+}
+
+SampleCacheEntry *SampleCache::lookup(const char *path) {
+  if (!path || _budget == 0)
+    return 0;
+  SampleCacheEntry *entry = _find(path);
+  if (!entry || !entry->ready) {
+    _misses++;
+    return 0;
+  }
+  _hits++;
+  entry->users++;
+  entry->lastUsed = ++_clock;
+  return entry;
+}
+
+bool SampleCache::isCached(const char *path) {
+  if (!path)
+    return false;
+  SampleCacheEntry *entry = _find(path);
+  return entry && entry->ready;
+}
+
+// Makes room by evicting least-recently-used entries that aren't in use.
+// The allocator can still fail (a fragmented heap), so that evicts more
+// too.
+
+SampleCacheEntry *SampleCache::allocate(const char *path, const WavFormat *format) {
+  if (!path || _budget == 0 || _find(path))
+    return 0;
+  uint32_t bytes = entryBytes(format->dataBytes, path);
+  if (format->dataBytes == 0 || format->dataBytes > _maxTrackBytes || bytes > _budget) {
+    _tooLarge++;
+    return 0;
+  }
+  SampleCacheEntry *entry = 0;
+  for (int i = 0; i < SAMPLE_CACHE_MAX_TRACKS && !entry; i++) {
+    if (!_entries[i].path)
+      entry = &_entries[i];
+  }
+  while (!entry || _used + bytes > _budget) {
+    if (!_evictOne())
+      return 0;
+    for (int i = 0; i < SAMPLE_CACHE_MAX_TRACKS && !entry; i++) {
+      if (!_entries[i].path)
+        entry = &_entries[i];
+    }
+  }
+  uint8_t *memory;
+  while (!(memory = (uint8_t *)_alloc(bytes))) {
+    if (!_evictOne())
+      return 0;
+  }
+  entry->data = memory;
+  entry->path = (char *)memory + ((format->dataBytes + 3) & ~3);
+  strcpy(entry->path, path);
+  entry->format = *format;
+  entry->lastUsed = ++_clock;
+  entry->users = 1;                         // the loader
+  entry->ready = false;
+  _used += bytes;
+  return entry;
+}
+
+void SampleCache::complete(SampleCacheEntry *entry) {
+  entry->ready = true;
+  release(entry);
+}
+
+void SampleCache::discard(SampleCacheEntry *entry) {
+  _freeEntry(entry);
+}
+
+void SampleCache::release(SampleCacheEntry *entry) {
+  if (entry->users > 0)
+    entry->users--;
+}
+
+bool SampleCache::_evictOne() {
+  SampleCacheEntry *oldest = 0;
+  for (int i = 0; i < SAMPLE_CACHE_MAX_TRACKS; i++) {
+    SampleCacheEntry *entry = &_entries[i];
+    if (entry->path && entry->users == 0 && (!oldest || entry->lastUsed < oldest->lastUsed))
+      oldest = entry;
+  }
+  if (!oldest)
+    return false;
+  _freeEntry(oldest);
+  _evictions++;
+  return true;
+}
+
+void SampleCache::_freeEntry(SampleCacheEntry *entry) {
+  if (!entry->path)
+    return;
+  _used -= entryBytes(entry->format.dataBytes, entry->path);
+  _free(entry->data);
+  entry->path = 0;
+  entry->data = 0;
+  entry->users = 0;
+  entry->ready = false;
+}
+
+uint32_t SampleCache::getHits() {
+  return _hits;
+}
+
+uint32_t SampleCache::getMisses() {
+  return _misses;
+}
+
+uint32_t SampleCache::getTooLarge() {
+  return _tooLarge;
+}
+
+uint32_t SampleCache::getEvictions() {
+  return _evictions;
+}
+
+int SampleCache::getHitRatePercent() {
+  uint32_t cacheable = _hits + _misses - _tooLarge;
+  if (_misses < _tooLarge || cacheable == 0)
+    return 0;
+  return (int)((uint64_t)_hits * 100 / cacheable);
+}
+
+void SampleCache::resetStats() {
+  _hits = 0;
+  _misses = 0;
+  _tooLarge = 0;
+  _evictions = 0;
+}
+
+int SampleCache::getNumTracks() {
+  int n = 0;
+  for (int i = 0; i < SAMPLE_CACHE_MAX_TRACKS; i++) {
+    if (_entries[i].path && _entries[i].ready)
+      n++;
+  }
+  return n;
+}
+
+uint32_t SampleCache::getUsedBytes() {
+  return _used;
+}
+
+uint32_t SampleCache::getBudget() {
+  return _budget;
+}
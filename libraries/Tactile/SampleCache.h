@@ -0,0 +1,112 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+/*----------------------------------------------------------------------
+ * Whole short tracks, kept in memory so that a track that's played over
+ * and over (a short clip retriggered every few seconds) only comes from
+ * the SD card once. The cache has a byte budget; when a new track
+ * doesn't fit, the least recently used ones are evicted to make room.
+ *
+ * A track gets in by being played: allocate() makes an entry, the
+ * player copies the samples into it as it streams them from the card
+ * (see WavStream::setCapture()), and complete() makes it available, or
+ * discard() drops it if the track was stopped before the end. After
+ * that, lookup() finds it and the player plays it from memory.
+ *
+ * An entry that's being loaded or played is "in use" and isn't evicted;
+ * release() ends a use. Memory comes from the allocator the caller
+ * supplies (on a Teensy, extmem_malloc(): PSRAM if there is any,
+ * otherwise the regular heap).
+ *
+ * Hits and misses are counted by lookup(); tracks that are too large to
+ * be cached are counted separately, so the hit rate is of the tracks
+ * that could have been hits.
+ *
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef SampleCache_h
+#define SampleCache_h 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include "WavStream.h"
+
+#define SAMPLE_CACHE_MAX_TRACKS 64
+
+struct SampleCacheEntry {
+  char       *path;                         // NULL == free slot
+  WavFormat   format;
+  uint8_t    *data;                         // format.dataBytes long
+  uint32_t    lastUsed;
+  uint8_t     users;
+  bool        ready;
+};
+
+typedef void *(*SampleCacheAlloc)(size_t bytes);
+typedef void  (*SampleCacheFree)(void *memory);
+
+class SampleCache
+{
+ public:
+  SampleCache();
+
+  void setBudget(uint32_t bytes, uint32_t maxTrackBytes, SampleCacheAlloc alloc, SampleCacheFree free);
+  void clear();                             // drops every entry that isn't in use
+
+  SampleCacheEntry *lookup(const char *path);       // ready entry (in use until release()), or NULL
+  bool isCached(const char *path);                  // same, but doesn't count or use it
+  SampleCacheEntry *allocate(const char *path, const WavFormat *format);
+  void complete(SampleCacheEntry *entry);
+  void discard(SampleCacheEntry *entry);
+  void release(SampleCacheEntry *entry);
+
+  uint32_t getHits();
+  uint32_t getMisses();
+  uint32_t getTooLarge();
+  uint32_t getEvictions();
+  int      getHitRatePercent();
+  void     resetStats();
+
+  int      getNumTracks();
+  uint32_t getUsedBytes();
+  uint32_t getBudget();
+
+ private:
+  SampleCacheEntry _entries[SAMPLE_CACHE_MAX_TRACKS];
+  SampleCacheAlloc _alloc;
+  SampleCacheFree  _free;
+  uint32_t _budget;
+  uint32_t _maxTrackBytes;
+  uint32_t _used;
+  uint32_t _clock;                          // for least-recently-used
+  uint32_t _hits;
+  uint32_t _misses;
+  uint32_t _tooLarge;
+  uint32_t _evictions;
+
+  SampleCacheEntry *_find(const char *path);
+  bool _evictOne();
+  void _freeEntry(SampleCacheEntry *entry);
+};
+
+#endif
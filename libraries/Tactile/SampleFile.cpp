@@ -0,0 +1,134 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include <string.h>
+#include "SampleFile.h"
+
+SimulatedSd::SimulatedSd() {
+  _numFiles = 0;
+  _busyMicros = 0;
+}
+
+bool SimulatedSd::addFile(const char *path, const uint8_t *data, uint32_t size) {
+  if (_numFiles >= SIMULATED_SD_MAX_FILES)
+    return false;
+  _path[_numFiles] = path;
+  _data[_numFiles] = data;
+  _size[_numFiles] = size;
+  _numFiles++;
+  return true;
+}
+
+uint32_t SimulatedSd::getBusyMicros() {
+  return _busyMicros;
+}
+
+void SimulatedSd::resetBusyMicros() {
+  _busyMicros = 0;
+}
+
+SimulatedSdFile::SimulatedSdFile(SimulatedSd *sd) {
+  _sd = sd;
+  _file = -1;
+  _position = 0;
+}
+
+bool SimulatedSdFile::open(const char *path) {
+  close();
+  _sd->_busyMicros += SIMULATED_SD_OPEN_USEC;
+  for (int i = 0; i < _sd->_numFiles; i++) {
+    if (strcmp(path, _sd->_path[i]) == 0) {
+      _file = i;
+      _position = 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+void SimulatedSdFile::close() {
+  _file = -1;
+}
+
+bool SimulatedSdFile::isOpen() {
+  return _file >= 0;
+}
+
+// Each sector touched costs a sector read.
+
+int SimulatedSdFile::read(uint8_t *buffer, int length) {
+  if (_file < 0)
+    return 0;
+  uint32_t size = _sd->_size[_file];
+  if ((uint32_t)length > size - _position)
+    length = size - _position;
+  if (length <= 0)
+    return 0;
+  uint32_t sectors = (_position + length + 511) / 512 - _position / 512;
+  _sd->_busyMicros += sectors * SIMULATED_SD_SECTOR_USEC;
+  memcpy(buffer, _sd->_data[_file] + _position, length);
+  _position += length;
+  return length;
+}
+
+bool SimulatedSdFile::seek(uint32_t position) {
+  if (_file < 0 || position > _sd->_size[_file])
+    return false;
+  _position = position;
+  return true;
+}
+
+uint32_t SimulatedSdFile::size() {
+  return (_file < 0) ? 0 : _sd->_size[_file];
+}
+
+/*----------------------------------------------------------------------
+ * WAV files for the simulated card
+ ----------------------------------------------------------------------*/
+
+void wavPut16(uint8_t *p, uint16_t value) {
+  p[0] = value;
+  p[1] = value >> 8;
+}
+
+void wavPut32(uint8_t *p, uint32_t value) {
+  p[0] = value;
+  p[1] = value >> 8;
+  p[2] = value >> 16;
+  p[3] = value >> 24;
+}
+
+int makeWavHeader(uint8_t *file, int channels, uint32_t sampleRate, uint32_t dataBytes) {
+  int frameBytes = channels * 2;
+  memcpy(file, "RIFF", 4);
+  wavPut32(file + 4, WAV_PCM_HEADER_BYTES - 8 + dataBytes);
+  memcpy(file + 8, "WAVEfmt ", 8);
+  wavPut32(file + 16, 16);
+  wavPut16(file + 20, 1);                   // PCM
+  wavPut16(file + 22, channels);
+  wavPut32(file + 24, sampleRate);
+  wavPut32(file + 28, sampleRate * frameBytes);
+  wavPut16(file + 32, frameBytes);
+  wavPut16(file + 34, 16);
+  memcpy(file + 36, "data", 4);
+  wavPut32(file + 40, dataBytes);
+  return WAV_PCM_HEADER_BYTES;
+}
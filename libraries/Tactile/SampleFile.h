@@ -0,0 +1,107 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * Where the audio players get their data. A SampleFile is one open file;
+ * each player owns one and reuses it for every track, so nothing is
+ * allocated while the exhibit runs. SdSampleFile reads the SD card.
+ *
+ * SimulatedSd and SimulatedSdFile stand in for the card on a host. They
+ * keep whole files in memory and add up how long a real card would have
+ * taken (SIMULATED_SD_OPEN_USEC per open, for the directory lookup, and
+ * SIMULATED_SD_SECTOR_USEC per 512-byte sector read), so the effect of
+ * when the card is read can be measured without hardware. The numbers
+ * are typical for the audio shield's SPI card slot. makeWavHeader() and
+ * wavPut16()/wavPut32() build the files for it.
+ *
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef SampleFile_h
+#define SampleFile_h 1
+
+#include <stdint.h>
+
+class SampleFile
+{
+ public:
+  virtual ~SampleFile() {}
+
+  virtual bool     open(const char *path) = 0;
+  virtual void     close() = 0;
+  virtual bool     isOpen() = 0;
+  virtual int      read(uint8_t *buffer, int length) = 0;    // bytes read, fewer at the end
+  virtual bool     seek(uint32_t position) = 0;
+  virtual uint32_t size() = 0;
+};
+
+
+#define SIMULATED_SD_MAX_FILES   8
+#define SIMULATED_SD_OPEN_USEC   6000
+#define SIMULATED_SD_SECTOR_USEC 250
+
+class SimulatedSd
+{
+ public:
+  SimulatedSd();
+
+  bool     addFile(const char *path, const uint8_t *data, uint32_t size);
+  uint32_t getBusyMicros();                 // simulated card time so far
+  void     resetBusyMicros();
+
+ private:
+  friend class SimulatedSdFile;
+  const char    *_path[SIMULATED_SD_MAX_FILES];
+  const uint8_t *_data[SIMULATED_SD_MAX_FILES];
+  uint32_t       _size[SIMULATED_SD_MAX_FILES];
+  int            _numFiles;
+  uint32_t       _busyMicros;
+};
+
+// WAV files for the simulated card. Values are little-endian, as in the
+// file. makeWavHeader() writes the header of a 16-bit PCM file whose
+// samples (dataBytes of them) follow it, and returns its size.
+
+#define WAV_PCM_HEADER_BYTES 44
+
+void     wavPut16(uint8_t *p, uint16_t value);
+void     wavPut32(uint8_t *p, uint32_t value);
+int      makeWavHeader(uint8_t *file, int channels, uint32_t sampleRate, uint32_t dataBytes);
+
+class SimulatedSdFile : public SampleFile
+{
+ public:
+  SimulatedSdFile(SimulatedSd *sd);
+
+  bool     open(const char *path);
+  void     close();
+  bool     isOpen();
+  int      read(uint8_t *buffer, int length);
+  bool     seek(uint32_t position);
+  uint32_t size();
+
+ private:
+  SimulatedSd *_sd;
+  int          _file;                       // -1 when closed
+  uint32_t     _position;
+};
+
+#endif
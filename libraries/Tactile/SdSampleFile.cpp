@@ -0,0 +1,52 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include "SdSampleFile.h"
+
+bool SdSampleFile::open(const char *path) {
+  close();
+  _file = SD.open(path, FILE_READ);
+  return (bool)_file;
+}
+
+void SdSampleFile::close() {
+  if (_file)
+    _file.close();
+}
+
+bool SdSampleFile::isOpen() {
+  return (bool)_file;
+}
+
+int SdSampleFile::read(uint8_t *buffer, int length) {
+  if (!_file)
+    return 0;
+  int n = _file.read(buffer, length);
+  return (n < 0) ? 0 : n;
+}
+
+bool SdSampleFile::seek(uint32_t position) {
+  return _file && _file.seek(position);
+}
+
+uint32_t SdSampleFile::size() {
+  return _file ? _file.size() : 0;
+}
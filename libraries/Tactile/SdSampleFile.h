@@ -0,0 +1,49 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * SampleFile on the SD card (SD library). The players read from their
+ * audio interrupt; anything else that reads the card from the loop must
+ * turn audio interrupts off around it (see AudioPlaySdWavPR::prepare()).
+ ----------------------------------------------------------------------*/
+
+#ifndef SdSampleFile_h
+#define SdSampleFile_h 1
+
+#include <Arduino.h>
+#include <SD.h>
+#include "SampleFile.h"
+
+class SdSampleFile : public SampleFile
+{
+ public:
+  bool     open(const char *path);
+  void     close();
+  bool     isOpen();
+  int      read(uint8_t *buffer, int length);
+  bool     seek(uint32_t position);
+  uint32_t size();
+
+ private:
+  File     _file;
+};
+
+#endif
@@ -0,0 +1,101 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include <math.h>
+#include "SensorCalibrator.h"
+
+SensorCalibrator::SensorCalibrator() {
+  reset();
+}
+
+void SensorCalibrator::reset() {
+  _offset = 0;
+  _sum = 0;
+  _sumSquares = 0;
+  _count = 0;
+  _peak = INT32_MIN;
+  _idleLimit = INT32_MAX;
+}
+
+// The sums are of Q8 values relative to the first one. The noise of an
+// idle sensor is a few counts, so they can't overflow in any realistic
+// calibration time.
+
+void SensorCalibrator::add(int32_t value) {
+  if (value > _peak)
+    _peak = value;
+  if (value > _idleLimit)
+    return;
+  if (_count == 0)
+    _offset = value;
+  int64_t d = (value - _offset) >> 8;
+  _sum += d;
+  _sumSquares += d * d;
+  _count++;
+  if (_count >= CALIBRATION_MIN_SAMPLES && (_count & (CALIBRATION_MIN_SAMPLES - 1)) == 0)
+    _updateIdleLimit();
+}
+
+void SensorCalibrator::_updateIdleLimit() {
+  _idleLimit = getMean() + CALIBRATION_OUTLIER_SIGMAS * getSigma() + 65536;    // at least a count
+}
+
+uint32_t SensorCalibrator::getCount() {
+  return _count;
+}
+
+int32_t SensorCalibrator::getMean() {
+  if (_count == 0)
+    return 0;
+  return _offset + (int32_t)((_sum * 256) / (int64_t)_count);
+}
+
+int32_t SensorCalibrator::getSigma() {
+  if (_count < 2)
+    return 0;
+  double n = (double)_count;
+  double variance = ((double)_sumSquares - (double)_sum * (double)_sum / n) / (n - 1.0);
+  if (variance <= 0.0)
+    return 0;
+  return (int32_t)(sqrt(variance) * 256.0 + 0.5);
+}
+
+int32_t SensorCalibrator::getPeak() {
+  return _count > 0 ? _peak : 0;
+}
+
+// Solves P(Z > k) = p for k by bisection; it's only done at calibration.
+
+float SensorCalibrator::sigmasForFalseTouches(float falseTouchesPerHour, float independentPerSecond) {
+  if (independentPerSecond < 1.0)
+    independentPerSecond = 1.0;
+  double p = (double)falseTouchesPerHour / (3600.0 * (double)independentPerSecond);
+  double low = 1.0;
+  double high = 10.0;
+  for (int i = 0; i < 40; i++) {
+    double k = (low + high) / 2.0;
+    if (0.5 * erfc(k / sqrt(2.0)) > p)
+      low = k;
+    else
+      high = k;
+  }
+  return (float)high;
+}
@@ -0,0 +1,72 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * Statistics for auto-calibration: the idle level (mean) of a sensor, its
+ * noise (standard deviation) and the highest reading seen. Values are
+ * added one at a time and only running sums are kept, so the memory used
+ * doesn't depend on how long calibration runs.
+ *
+ * If somebody touches the sensor during calibration, the touch shouldn't
+ * count as idle noise. Once there are enough samples for a rough
+ * estimate, readings more than CALIBRATION_OUTLIER_SIGMAS above the mean
+ * only count toward the peak.
+ *
+ * Values are Q16 fixed point, like ProximityFilter's output.
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef SensorCalibrator_h
+#define SensorCalibrator_h 1
+
+#include <stdint.h>
+
+#define CALIBRATION_OUTLIER_SIGMAS 8
+#define CALIBRATION_MIN_SAMPLES    64
+
+class SensorCalibrator
+{
+ public:
+  SensorCalibrator();
+
+  void     reset();
+  void     add(int32_t value);
+  uint32_t getCount();            // idle samples
+  int32_t  getMean();             // Q16
+  int32_t  getSigma();            // Q16
+  int32_t  getPeak();             // Q16
+
+  // How many sigmas above the mean a touch threshold has to be for
+  // Gaussian noise to cause no more than this many false touches per
+  // hour, given how many independent readings there are per second.
+  static float sigmasForFalseTouches(float falseTouchesPerHour, float independentPerSecond);
+
+ private:
+  int32_t  _offset;               // first value; keeps the sums small
+  int64_t  _sum;                  // of (value - offset), Q8
+  int64_t  _sumSquares;
+  uint32_t _count;
+  int32_t  _peak;
+  int32_t  _idleLimit;            // above this it's not idle
+  void     _updateIdleLimit();
+};
+
+#endif
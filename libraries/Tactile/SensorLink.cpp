@@ -0,0 +1,126 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include "SensorLink.h"
+
+SensorLinkParser::SensorLinkParser() {
+  reset();
+}
+
+void SensorLinkParser::reset() {
+  _length = 0;
+  _haveSequence = false;
+  _lastSequence = 0;
+  _frameCount = 0;
+  _crcErrorCount = 0;
+  _lostFrameCount = 0;
+}
+
+uint32_t SensorLinkParser::getFrameCount() {
+  return _frameCount;
+}
+
+uint32_t SensorLinkParser::getCrcErrorCount() {
+  return _crcErrorCount;
+}
+
+uint32_t SensorLinkParser::getLostFrameCount() {
+  return _lostFrameCount;
+}
+
+// CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF), four bits at a
+// time from a 16-entry table.
+
+static const uint16_t crcTable[16] = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+  0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+uint16_t SensorLinkParser::crc(const uint8_t *data, int length) {
+  uint16_t crc = 0xFFFF;
+  for (int i = 0; i < length; i++) {
+    crc = (crc << 4) ^ crcTable[(crc >> 12) ^ (data[i] >> 4)];
+    crc = (crc << 4) ^ crcTable[(crc >> 12) ^ (data[i] & 0x0F)];
+  }
+  return crc;
+}
+
+int SensorLinkParser::encode(const SensorLinkFrame *frame, uint8_t *buffer) {
+  buffer[0] = SENSOR_LINK_SYNC1;
+  buffer[1] = SENSOR_LINK_SYNC2;
+  buffer[2] = frame->sequence;
+  buffer[3] = frame->boardMicros;
+  buffer[4] = frame->boardMicros >> 8;
+  buffer[5] = frame->boardMicros >> 16;
+  buffer[6] = frame->boardMicros >> 24;
+  buffer[7] = frame->counts;
+  buffer[8] = frame->counts >> 8;
+  uint16_t c = crc(buffer + 2, 7);
+  buffer[9] = c;
+  buffer[10] = c >> 8;
+  return SENSOR_LINK_FRAME_BYTES;
+}
+
+bool SensorLinkParser::addByte(uint8_t b, SensorLinkFrame *frame) {
+  _buffer[_length++] = b;
+  if ((_length == 1 && b != SENSOR_LINK_SYNC1) || (_length == 2 && b != SENSOR_LINK_SYNC2)) {
+    _resync();
+    return false;
+  }
+  if (_length < SENSOR_LINK_FRAME_BYTES)
+    return false;
+
+  uint16_t c = _buffer[9] | (_buffer[10] << 8);
+  uint16_t counts = _buffer[7] | (_buffer[8] << 8);
+  if (c != crc(_buffer + 2, 7) || counts >= SENSOR_LINK_FULL_SCALE) {
+    _crcErrorCount++;
+    _resync();
+    return false;
+  }
+  _length = 0;
+
+  frame->sequence = _buffer[2];
+  frame->boardMicros = (uint32_t)_buffer[3] | ((uint32_t)_buffer[4] << 8)
+                       | ((uint32_t)_buffer[5] << 16) | ((uint32_t)_buffer[6] << 24);
+  frame->counts = counts;
+  if (_haveSequence)
+    _lostFrameCount += (uint8_t)(frame->sequence - _lastSequence - 1);
+  _lastSequence = frame->sequence;
+  _haveSequence = true;
+  _frameCount++;
+  return true;
+}
+
+// Drops the first byte, then everything up to the next possible start
+// of a frame (a SYNC1, followed by SYNC2 if there's a byte after it).
+
+void SensorLinkParser::_resync() {
+  int start = 1;
+  while (start < _length) {
+    if (_buffer[start] == SENSOR_LINK_SYNC1
+        && (start + 1 == _length || _buffer[start + 1] == SENSOR_LINK_SYNC2))
+      break;
+    start++;
+  }
+  for (int i = start; i < _length; i++)
+    _buffer[i - start] = _buffer[i];
+  _length -= start;
+}
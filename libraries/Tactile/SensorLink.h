@@ -0,0 +1,90 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * The digital link from a sensor board to the Teensy. Instead of turning
+ * its capacitance reading into a voltage for the Teensy to digitize
+ * again (at 10 bits, with the noise of both conversions), a board sends
+ * the reading itself as a small frame on a serial line:
+ *
+ *     byte 0-1   0xA5 0x5A        sync
+ *     byte 2     sequence         +1 per frame, wraps at 255
+ *     byte 3-6   board micros     when the reading was taken
+ *     byte 7-8   counts           the reading, 0..SENSOR_LINK_FULL_SCALE-1
+ *     byte 9-10  CRC              CRC-16/CCITT of bytes 2-8
+ *
+ * All multi-byte fields are little-endian. At SENSOR_LINK_BAUD a frame
+ * takes 110 usec, so a board can send several thousand per second.
+ *
+ * SensorLinkParser takes the bytes one at a time as they arrive. A frame
+ * with a bad CRC is dropped and the parser looks for the next sync
+ * inside what it already has, so it gets back in step right away after
+ * noise or a board reset. Gaps in the sequence numbers count as lost
+ * frames. encode() is the board's side, also used for testing.
+ *
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef SensorLink_h
+#define SensorLink_h 1
+
+#include <stdint.h>
+
+#define SENSOR_LINK_SYNC1        0xA5
+#define SENSOR_LINK_SYNC2        0x5A
+#define SENSOR_LINK_FRAME_BYTES  11
+#define SENSOR_LINK_FULL_SCALE   16384       // 14-bit counts; raw values must fit in 15 bits
+#define SENSOR_LINK_BAUD         1000000
+
+struct SensorLinkFrame {
+  uint8_t  sequence;
+  uint32_t boardMicros;
+  uint16_t counts;
+};
+
+class SensorLinkParser
+{
+ public:
+  SensorLinkParser();
+
+  void     reset();
+  bool     addByte(uint8_t b, SensorLinkFrame *frame);   // true: a good frame is in *frame
+
+  uint32_t getFrameCount();
+  uint32_t getCrcErrorCount();
+  uint32_t getLostFrameCount();
+
+  static uint16_t crc(const uint8_t *data, int length);
+  static int      encode(const SensorLinkFrame *frame, uint8_t *buffer);  // returns SENSOR_LINK_FRAME_BYTES
+
+ private:
+  uint8_t  _buffer[SENSOR_LINK_FRAME_BYTES];
+  int      _length;
+  bool     _haveSequence;
+  uint8_t  _lastSequence;
+  uint32_t _frameCount;
+  uint32_t _crcErrorCount;
+  uint32_t _lostFrameCount;
+
+  void     _resync();
+};
+
+#endif
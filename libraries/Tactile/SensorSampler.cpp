@@ -0,0 +1,149 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include "SensorSampler.h"
+
+SensorSampler::SensorSampler(SensorSource *source) {
+  _source = source;
+  _head = 0;
+  _tail = 0;
+  resetStats();
+}
+
+void SensorSampler::setSource(SensorSource *source) {
+  _source = source;
+}
+
+SensorSource *SensorSampler::getSource() {
+  return _source;
+}
+
+/*----------------------------------------------------------------------
+ * Producer. Reads all channels straight into the next ring slot.
+ ----------------------------------------------------------------------*/
+
+void SensorSampler::sampleNow(uint32_t timeMicros) {
+
+  if (_sampleCount > 0) {
+    uint32_t interval = timeMicros - _lastTime;
+    if (interval < _minInterval)
+      _minInterval = interval;
+    if (interval > _maxInterval)
+      _maxInterval = interval;
+    _intervalSum += interval;
+    _intervalCount++;
+  }
+  _lastTime = timeMicros;
+  _sampleCount++;
+
+  if (!_source)
+    return;
+
+  uint32_t head = _head;
+  if (head - _tail >= SAMPLER_RING_SIZE) {      // consumer fell behind
+    _overrunCount++;
+    return;
+  }
+  uint32_t slot = head & (SAMPLER_RING_SIZE - 1);
+  _source->read(_values[slot]);
+  _times[slot] = timeMicros;
+
+  COMPILER_BARRIER();         // slot must be complete before the consumer can see it
+  _head = head + 1;
+}
+
+// Adds a sample that didn't come from the source (e.g. a trace being
+// replayed). The caller takes the producer's place, so the timer must
+// not be calling sampleNow() at the same time. Returns false if the ring
+// is full; nothing is counted as an overrun, the caller just tries again
+// later.
+
+bool SensorSampler::pushSample(uint32_t timeMicros, const uint16_t values[]) {
+  uint32_t head = _head;
+  if (head - _tail >= SAMPLER_RING_SIZE)
+    return false;
+  uint32_t slot = head & (SAMPLER_RING_SIZE - 1);
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    _values[slot][channel] = values[channel];
+  _times[slot] = timeMicros;
+
+  COMPILER_BARRIER();
+  _head = head + 1;
+  return true;
+}
+
+/*----------------------------------------------------------------------
+ * Consumer.
+ ----------------------------------------------------------------------*/
+
+int SensorSampler::available() {
+  return (int)(_head - _tail);
+}
+
+bool SensorSampler::getSample(uint32_t *timeMicros, uint16_t values[]) {
+  uint32_t tail = _tail;
+  if (tail == _head)
+    return false;
+  COMPILER_BARRIER();
+  uint32_t slot = tail & (SAMPLER_RING_SIZE - 1);
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    values[channel] = _values[slot][channel];
+  *timeMicros = _times[slot];
+  COMPILER_BARRIER();         // done reading the slot before handing it back
+  _tail = tail + 1;
+  return true;
+}
+
+/*----------------------------------------------------------------------
+ * Statistics
+ ----------------------------------------------------------------------*/
+
+void SensorSampler::resetStats() {
+  _sampleCount = 0;
+  _overrunCount = 0;
+  _lastTime = 0;
+  _minInterval = 0xFFFFFFFF;
+  _maxInterval = 0;
+  _intervalSum = 0;
+  _intervalCount = 0;
+}
+
+uint32_t SensorSampler::getSampleCount() {
+  return _sampleCount;
+}
+
+uint32_t SensorSampler::getOverrunCount() {
+  return _overrunCount;
+}
+
+uint32_t SensorSampler::getMinInterval() {
+  return _intervalCount > 0 ? _minInterval : 0;
+}
+
+uint32_t SensorSampler::getMaxInterval() {
+  return _maxInterval;
+}
+
+uint32_t SensorSampler::getMeanInterval() {
+  if (_intervalCount == 0)
+    return 0;
+  return (uint32_t)(_intervalSum / _intervalCount);
+}
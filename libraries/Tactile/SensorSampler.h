@@ -0,0 +1,93 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * The SensorSampler reads all sensor channels at a fixed rate and keeps
+ * the results in a ring buffer. The idea is that sampleNow() is called
+ * from a timer interrupt (see Sensors.cpp), and the main loop later takes
+ * the samples out with getSample(). That way the sample rate doesn't
+ * depend on how long the loop takes to do audio and vibration work.
+ *
+ * There is exactly one producer (the timer) and one consumer (the loop),
+ * so no locking is needed: the producer only writes _head and the consumer
+ * only writes _tail. If the loop falls behind by more than the ring size,
+ * the newest samples are dropped and counted as overruns.
+ *
+ * Every sample carries its timestamp (microseconds), and the sampler keeps
+ * simple interval statistics so the actual rate and jitter can be checked.
+ *
+ * No Arduino dependencies; the caller supplies the time.
+ ----------------------------------------------------------------------*/
+
+#ifndef SensorSampler_h
+#define SensorSampler_h 1
+
+#include <stdint.h>
+#include "TactileBasics.h"
+#include "SensorSource.h"
+
+// Must be a power of two. At 2000 samples/sec, 64 samples is 32 msec of slack.
+#define SAMPLER_RING_SIZE 64
+
+#define DEFAULT_SAMPLE_RATE 2000
+
+class SensorSampler
+{
+ public:
+  SensorSampler(SensorSource *source);
+
+  void setSource(SensorSource *source);
+  SensorSource *getSource();
+
+  // Producer side (timer interrupt)
+  void sampleNow(uint32_t timeMicros);
+  bool pushSample(uint32_t timeMicros, const uint16_t values[]);   // only while the timer is off
+
+  // Consumer side (main loop)
+  int  available();
+  bool getSample(uint32_t *timeMicros, uint16_t values[]);
+
+  // Rate and jitter statistics, all times in microseconds
+  void     resetStats();
+  uint32_t getSampleCount();
+  uint32_t getOverrunCount();
+  uint32_t getMinInterval();
+  uint32_t getMaxInterval();
+  uint32_t getMeanInterval();
+
+ private:
+  SensorSource *_source;
+
+  uint16_t _values[SAMPLER_RING_SIZE][NUM_CHANNELS];
+  uint32_t _times[SAMPLER_RING_SIZE];
+  volatile uint32_t _head;        // free-running; written only by sampleNow()
+  volatile uint32_t _tail;        // free-running; written only by getSample()
+
+  volatile uint32_t _sampleCount;
+  volatile uint32_t _overrunCount;
+  volatile uint32_t _lastTime;
+  volatile uint32_t _minInterval;
+  volatile uint32_t _maxInterval;
+  volatile uint64_t _intervalSum;
+  volatile uint32_t _intervalCount;
+};
+
+#endif
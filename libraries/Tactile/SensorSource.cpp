@@ -0,0 +1,60 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include "SensorSource.h"
+
+SimulatedSensorSource::SimulatedSensorSource(uint16_t fullScale) {
+  _fullScale = fullScale;
+  _noise = 0;
+  _randomState = 12345;
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    _level[channel] = 0;
+}
+
+uint16_t SimulatedSensorSource::fullScale() {
+  return _fullScale;
+}
+
+void SimulatedSensorSource::setLevel(int channel, uint16_t level) {
+  if (channel < 0 || channel >= NUM_CHANNELS)
+    return;
+  _level[channel] = level;
+}
+
+void SimulatedSensorSource::setNoise(uint16_t amplitude) {
+  _noise = amplitude;
+}
+
+void SimulatedSensorSource::read(uint16_t values[]) {
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    int v = _level[channel];
+    if (_noise > 0) {
+      // Simple linear-congruential generator; we only need cheap, repeatable noise.
+      _randomState = _randomState * 1664525 + 1013904223;
+      v += (int)((_randomState >> 16) % (2 * _noise + 1)) - _noise;
+    }
+    if (v < 0)
+      v = 0;
+    else if (v > _fullScale)
+      v = _fullScale;
+    values[channel] = (uint16_t)v;
+  }
+}
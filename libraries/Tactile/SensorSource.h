@@ -0,0 +1,79 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * A SensorSource is where raw sensor readings come from. The Sensors
+ * class doesn't care whether the numbers come from the Teensy's ADCs
+ * or from somewhere else; it just asks the source to read all channels
+ * at once, and gets back one raw value per channel in the range
+ * 0..fullScale().
+ *
+ * read() is called from the sampling interrupt, so it has to be quick.
+ * Sources that need slow work to get their data (e.g. a transaction on
+ * a bus) do that in poll(), which is called from the loop, and read()
+ * just returns the latest results.
+ *
+ * This file has no Arduino dependencies, so the sampling and filtering
+ * code can be compiled and exercised on a regular computer by using the
+ * SimulatedSensorSource below instead of the real hardware.
+ ----------------------------------------------------------------------*/
+
+#ifndef SensorSource_h
+#define SensorSource_h 1
+
+#include <stdint.h>
+#include "TactileBasics.h"
+
+class SensorSource
+{
+ public:
+  virtual ~SensorSource() {}
+
+  virtual void     begin() {}
+  virtual uint16_t fullScale() = 0;              // raw value that corresponds to 100%
+  virtual void     read(uint16_t values[]) = 0;  // one raw value per channel
+  virtual void     poll(uint32_t timeMicros) {}  // loop-time work, if any
+};
+
+
+// A stand-in for the hardware. Each channel reads a fixed level plus
+// optional pseudo-random noise. The caller changes the levels over time
+// to simulate touches.
+
+class SimulatedSensorSource : public SensorSource
+{
+ public:
+  SimulatedSensorSource(uint16_t fullScale);
+
+  uint16_t fullScale();
+  void     read(uint16_t values[]);
+
+  void     setLevel(int channel, uint16_t level);
+  void     setNoise(uint16_t amplitude);
+
+ private:
+  uint16_t _fullScale;
+  uint16_t _level[NUM_CHANNELS];
+  uint16_t _noise;
+  uint32_t _randomState;
+};
+
+#endif
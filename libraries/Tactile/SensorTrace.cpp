@@ -0,0 +1,233 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include <string.h>
+#include "SensorTrace.h"
+
+#define TRACE_RING_BYTES (TRACE_SECTOR_SIZE * TRACE_RING_SECTORS)
+
+static uint32_t zigzag(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+/*----------------------------------------------------------------------
+ * TraceWriter
+ ----------------------------------------------------------------------*/
+
+TraceWriter::TraceWriter() {
+  _head = 0;
+  _tail = 0;
+  _absolute = true;
+  _lastTime = 0;
+  _sampleCount = 0;
+  _dropCount = 0;
+}
+
+void TraceWriter::begin(uint16_t fullScale, uint32_t sampleRate) {
+  _head = 0;
+  _tail = 0;
+  _absolute = true;
+  _lastTime = 0;
+  _sampleCount = 0;
+  _dropCount = 0;
+
+  const char *magic = "TTRC";
+  for (int i = 0; i < 4; i++)
+    _putByte((uint8_t)magic[i]);
+  _putByte(TRACE_VERSION);
+  _putByte(NUM_CHANNELS);
+  _putByte(fullScale & 0xFF);
+  _putByte(fullScale >> 8);
+  for (int i = 0; i < 4; i++)
+    _putByte((sampleRate >> (8 * i)) & 0xFF);
+  for (int i = 0; i < 4; i++)
+    _putByte(0);
+}
+
+void TraceWriter::_putByte(uint8_t b) {
+  _ring[_head & (TRACE_RING_BYTES - 1)] = b;
+  _head++;
+}
+
+void TraceWriter::_putVarint(uint32_t v) {
+  while (v >= 0x80) {
+    _putByte((uint8_t)(v | 0x80));
+    v >>= 7;
+  }
+  _putByte((uint8_t)v);
+}
+
+bool TraceWriter::addSample(uint32_t timeMicros, const uint16_t values[]) {
+  if (TRACE_RING_BYTES - (_head - _tail) < TRACE_MAX_RECORD) {
+    _dropCount++;
+    _absolute = true;
+    return false;
+  }
+  if (_sampleCount == 0)
+    _lastTime = timeMicros;               // trace times start at zero
+  uint32_t delta = timeMicros - _lastTime;
+  if (delta > 0x7FFFFFFF)                 // clock went backwards?
+    delta = 0;
+  _putVarint((delta << 1) | (_absolute ? 1 : 0));
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    if (_absolute)
+      _putVarint(values[channel]);
+    else
+      _putVarint(zigzag((int32_t)values[channel] - (int32_t)_lastValue[channel]));
+    _lastValue[channel] = values[channel];
+  }
+  _lastTime = _lastTime + delta;
+  _absolute = false;
+  _sampleCount++;
+  return true;
+}
+
+// Sectors start at multiples of the sector size and the ring is a whole
+// number of sectors, so a sector is never split by the wrap-around.
+
+const uint8_t *TraceWriter::getSector() {
+  if (_head - _tail < TRACE_SECTOR_SIZE)
+    return 0;
+  return &_ring[_tail & (TRACE_RING_BYTES - 1)];
+}
+
+void TraceWriter::releaseSector() {
+  if (_head - _tail >= TRACE_SECTOR_SIZE)
+    _tail += TRACE_SECTOR_SIZE;
+}
+
+const uint8_t *TraceWriter::getTail(int *numBytes) {
+  uint32_t n = _head - _tail;
+  if (n > TRACE_SECTOR_SIZE)
+    n = TRACE_SECTOR_SIZE;
+  *numBytes = (int)n;
+  return &_ring[_tail & (TRACE_RING_BYTES - 1)];
+}
+
+uint32_t TraceWriter::getSampleCount() {
+  return _sampleCount;
+}
+
+uint32_t TraceWriter::getDropCount() {
+  return _dropCount;
+}
+
+/*----------------------------------------------------------------------
+ * TraceReader
+ ----------------------------------------------------------------------*/
+
+TraceReader::TraceReader() {
+  _pos = 0;
+  _len = 0;
+  _numChannels = 0;
+  _fullScale = 0;
+  _sampleRate = 0;
+  _time = 0;
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    _value[channel] = 0;
+}
+
+int TraceReader::_getByte() {
+  if (_pos >= _len) {
+    _len = readData(_buffer, TRACE_SECTOR_SIZE);
+    _pos = 0;
+    if (_len <= 0) {
+      _len = 0;
+      return -1;
+    }
+  }
+  return _buffer[_pos++];
+}
+
+bool TraceReader::_getVarint(uint32_t *v) {
+  uint32_t result = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    int b = _getByte();
+    if (b < 0)
+      return false;
+    result |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      *v = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TraceReader::begin() {
+  uint8_t header[TRACE_HEADER_SIZE];
+  for (int i = 0; i < TRACE_HEADER_SIZE; i++) {
+    int b = _getByte();
+    if (b < 0)
+      return false;
+    header[i] = (uint8_t)b;
+  }
+  if (memcmp(header, "TTRC", 4) != 0 || header[4] != TRACE_VERSION)
+    return false;
+  _numChannels = header[5];
+  _fullScale = header[6] | (header[7] << 8);
+  _sampleRate = (uint32_t)header[8] | ((uint32_t)header[9] << 8)
+    | ((uint32_t)header[10] << 16) | ((uint32_t)header[11] << 24);
+  _time = 0;
+  return _numChannels > 0;
+}
+
+// Traces with more channels than this build has are read, but the extra
+// channels are discarded; missing channels read as zero.
+
+bool TraceReader::next(uint32_t *timeMicros, uint16_t values[]) {
+  uint32_t v;
+  if (!_getVarint(&v))
+    return false;
+  bool absolute = v & 1;
+  _time += v >> 1;
+  for (int channel = 0; channel < _numChannels; channel++) {
+    uint32_t x;
+    if (!_getVarint(&x))
+      return false;
+    if (channel >= NUM_CHANNELS)
+      continue;
+    if (absolute)
+      _value[channel] = (uint16_t)x;
+    else
+      _value[channel] = (uint16_t)((int32_t)_value[channel] + unzigzag(x));
+  }
+  *timeMicros = _time;
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    values[channel] = _value[channel];
+  return true;
+}
+
+int TraceReader::getNumChannels() {
+  return _numChannels;
+}
+
+uint16_t TraceReader::getFullScale() {
+  return _fullScale;
+}
+
+uint32_t TraceReader::getSampleRate() {
+  return _sampleRate;
+}
@@ -0,0 +1,126 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * Sensor traces: a compact recording of the raw sensor samples, so that
+ * what the sensors saw on site can be replayed later through the same
+ * filters and touch/release logic with different settings.
+ *
+ * File format (all numbers little-endian):
+ *
+ *   header (16 bytes): "TTRC", version (1 byte), number of channels
+ *     (1 byte), full scale (2 bytes), sample rate (4 bytes), 4 reserved
+ *   one record per sample:
+ *     varint: (microseconds since the previous sample << 1) | absolute;
+ *       the first sample is at time zero
+ *     per channel: if absolute, varint of the value; otherwise varint of
+ *       the zigzag-encoded change from the previous sample
+ *
+ * Varints are 7 bits per byte, low bits first, high bit set on all but
+ * the last byte. A quiet sensor changes by a count or two per sample, so
+ * a typical 4-channel record is 5 or 6 bytes.
+ *
+ * TraceWriter encodes into a ring of 512-byte sectors; the caller writes
+ * out full sectors whenever it's convenient, one at a time. If the ring
+ * fills up (the SD card is slow), samples are dropped rather than
+ * blocking, and the next one is written with absolute values so the
+ * trace stays decodable. TraceReader decodes; subclasses supply the
+ * bytes (SD file on the Teensy, stdio on a host).
+ *
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef SensorTrace_h
+#define SensorTrace_h 1
+
+#include <stdint.h>
+#include "TactileBasics.h"
+
+#define TRACE_VERSION       1
+#define TRACE_HEADER_SIZE   16
+#define TRACE_SECTOR_SIZE   512
+#define TRACE_RING_SECTORS  8          // power of two; 4 KB is ~1/3 sec at 2000 samples/sec
+#define TRACE_MAX_RECORD    (5 + 3 * NUM_CHANNELS)
+
+class TraceWriter
+{
+ public:
+  TraceWriter();
+
+  void     begin(uint16_t fullScale, uint32_t sampleRate);
+  bool     addSample(uint32_t timeMicros, const uint16_t values[]);   // false == dropped
+
+  // Full sectors, oldest first. Write one, then release it.
+  const uint8_t *getSector();         // NULL if there isn't a full one
+  void     releaseSector();
+
+  // When recording stops: what's left after the last full sector.
+  const uint8_t *getTail(int *numBytes);
+
+  uint32_t getSampleCount();
+  uint32_t getDropCount();
+
+ private:
+  uint8_t  _ring[TRACE_SECTOR_SIZE * TRACE_RING_SECTORS];
+  uint32_t _head;             // free-running byte counts
+  uint32_t _tail;
+  bool     _absolute;         // next record has absolute values
+  uint32_t _lastTime;
+  uint16_t _lastValue[NUM_CHANNELS];
+  uint32_t _sampleCount;
+  uint32_t _dropCount;
+
+  void     _putByte(uint8_t b);
+  void     _putVarint(uint32_t v);
+};
+
+
+class TraceReader
+{
+ public:
+  TraceReader();
+  virtual ~TraceReader() {}
+
+  bool     begin();                   // reads the header; false if it isn't a trace
+  bool     next(uint32_t *timeMicros, uint16_t values[]);   // false at the end
+
+  int      getNumChannels();
+  uint16_t getFullScale();
+  uint32_t getSampleRate();
+
+ protected:
+  virtual int readData(uint8_t *buffer, int size) = 0;    // bytes read, 0 at the end
+
+ private:
+  uint8_t  _buffer[TRACE_SECTOR_SIZE];
+  int      _pos;
+  int      _len;
+  int      _numChannels;
+  uint16_t _fullScale;
+  uint32_t _sampleRate;
+  uint32_t _time;
+  uint16_t _value[NUM_CHANNELS];
+
+  int      _getByte();                // -1 at the end
+  bool     _getVarint(uint32_t *v);
+};
+
+#endif
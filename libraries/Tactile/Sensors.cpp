@@ -19,7 +19,14 @@
 */
 
 #include "Arduino.h"
+#include <Audio.h>
 #include "Sensors.h"
+#include "AnalogSensorSource.h"
+#include "WireI2CBus.h"
+#include "UartSerialPort.h"
+#include "LatencyProbe.h"
+
+Sensors *Sensors::_timerInstance = NULL;
 
 /*----------------------------------------------------------------------
  * Initialization.
@@ -42,20 +49,253 @@ Sensors* Sensors::setup(TeensyUtils *tc) {
   for (int channel = 0; channel < NUM_CHANNELS; channel++) {
     t->_lastActionTime[channel] = 0;
     t->_lastSensorStatus[channel] = IS_RELEASED;
-    t->_lastSensorPseudoStatus[channel] = IS_RELEASED;
-    t->_filteredSensorValue[channel] = 0.0;
+    t->_prearmThreshold[channel] = 0.0;
+    t->_armed[channel] = false;
+    t->_sensorStatus[channel] = IS_RELEASED;
+    t->_reportedStatus[channel] = IS_RELEASED;
     t->_ignoreSensor[channel] = false;
     t->_touchToggleMode[channel] = false;
+    t->_useBaseline[channel] = false;
+    t->_touchSigmas[channel] = BASELINE_TOUCH_SIGMAS;
+    t->_releaseSigmas[channel] = BASELINE_RELEASE_SIGMAS;
+    t->_inputSource[channel] = touchInput;
+    t->_linkPort[channel] = NULL;
+  }
+  t->_lastSensorTouched = -1;
+  t->_traceWriter = NULL;
+  t->_traceReader = NULL;
+  t->_controller = NULL;
+  t->_link = NULL;
+  t->_useCrosstalk = false;
+  t->_audioEnvelope[0] = NULL;
+  t->_audioEnvelope[1] = NULL;
+
+  t->_analogSource = new AnalogSensorSource();
+  t->_envelopeSource = new EnvelopeSensorSource(t->_analogSource);
+  t->_source = t->_envelopeSource;
+  t->_source->begin();
+
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
     t->setProximityMultiplier(channel, 1.0);
     t->setTouchReleaseThresholds(channel, 95.0, 65.0);
+    t->setAveragingStrength(channel, 200, emaFilter);
+    t->_baseline[channel].setTrackingSamples((int32_t)BASELINE_TRACKING_MSEC * DEFAULT_SAMPLE_RATE / 1000);
   }
-  t->_lastSensorTouched = -1;
 
-  t->setAveragingStrength(200);
+  // Start background sampling of the sensors
+  t->_sampler = new SensorSampler(t->_source);
+  t->_sampleRate = 0;
+  t->setSampleRate(DEFAULT_SAMPLE_RATE);
 
   return t;
 }
 
+/*----------------------------------------------------------------------
+ * Background sampling. A timer interrupt reads all of the sensors at a
+ * fixed rate into the SensorSampler's ring buffer. Everything else
+ * (filtering, touch detection) happens in the loop, one sample at a time,
+ * in _processSamples().
+ ----------------------------------------------------------------------*/
+
+void Sensors::_sampleTimerInterrupt() {
+  _timerInstance->_sampler->sampleNow(micros());
+}
+
+void Sensors::setSampleRate(int samplesPerSecond) {
+  if (samplesPerSecond < 100)
+    samplesPerSecond = 100;
+  else if (samplesPerSecond > 10000)
+    samplesPerSecond = 10000;
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    _baseline[channel].setTrackingSamples((int32_t)BASELINE_TRACKING_MSEC * samplesPerSecond / 1000);
+  if (_sampleRate > 0)
+    _sampleTimer.end();
+  _sampleRate = samplesPerSecond;
+  _timerInstance = this;
+  _sampler->resetStats();
+  if (!_traceReader)                    // a replay takes the timer's place
+    _sampleTimer.begin(_sampleTimerInterrupt, 1000000.0 / (float)_sampleRate);
+  _tu->logAction2("Sensors: sample rate: ", _sampleRate);
+}
+
+int Sensors::getSampleRate() {
+  return _sampleRate;
+}
+
+void Sensors::printSamplerStats() {
+  Serial.print("Sensors: samples: ");
+  Serial.print(_sampler->getSampleCount());
+  Serial.print(", overruns: ");
+  Serial.print(_sampler->getOverrunCount());
+  Serial.print(", interval usec min/mean/max: ");
+  Serial.print(_sampler->getMinInterval());
+  Serial.print("/");
+  Serial.print(_sampler->getMeanInterval());
+  Serial.print("/");
+  Serial.println(_sampler->getMaxInterval());
+}
+
+// Each sample is recorded (if a trace is being recorded), corrected for
+// cross-talk (if that's on), filtered, added to the baseline statistics
+// (if it's idle), and checked against the touch/release thresholds.
+
+void Sensors::_processSamples() {
+  uint32_t timeMicros;
+  uint16_t raw[NUM_CHANNELS];
+  while (_sampler->getSample(&timeMicros, raw)) {
+    if (_traceWriter)
+      _traceWriter->addSample(timeMicros, raw);
+    if (_useCrosstalk)
+      _crosstalk.apply(raw, _source->fullScale());
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+      int32_t value = _filter[channel].filter(raw[channel]);
+      _velocity[channel].update(raw[channel]);
+
+      // The idle level is only learned while the sensor isn't touched.
+      if (_useBaseline[channel] && _lastSensorStatus[channel] == IS_RELEASED) {
+        if (_baseline[channel].update(value))
+          _calculatePercentPerCount(channel);
+      }
+
+      _updateTouchStatus(channel, timeMicros);
+    }
+  }
+}
+
+/*----------------------------------------------------------------------
+ * Trace recording and replay. Recording encodes every raw sample as it's
+ * processed and writes at most one 512-byte sector to the SD card per
+ * update(), so a slow card never holds up the loop for long; if the card
+ * falls too far behind, samples are dropped (and counted) instead.
+ *
+ * Replay stops the sampling timer and feeds the trace's samples into the
+ * sampler at the pace they were recorded, so everything downstream
+ * (filters, baseline, thresholds, touch events) sees exactly what the
+ * sensors saw. SD access is done with audio interrupts off because the
+ * audio library reads the card from its interrupt too.
+ ----------------------------------------------------------------------*/
+
+class SdTraceReader : public TraceReader
+{
+ public:
+  SdTraceReader(File *file) { _file = file; }
+ protected:
+  int readData(uint8_t *buffer, int size) {
+    AudioNoInterrupts();
+    int n = _file->read(buffer, size);
+    AudioInterrupts();
+    return n;
+  }
+ private:
+  File *_file;
+};
+
+bool Sensors::startRecording(const char *fileName) {
+  stopRecording();
+  AudioNoInterrupts();
+  SD.remove(fileName);
+  _traceFile = SD.open(fileName, FILE_WRITE);
+  AudioInterrupts();
+  if (!_traceFile) {
+    Serial.print("Sensors: can't create trace file ");
+    Serial.println(fileName);
+    return false;
+  }
+  _traceWriter = new TraceWriter();
+  _traceWriter->begin(_source->fullScale(), _sampleRate);
+  _tu->log("Sensors: recording started");
+  return true;
+}
+
+void Sensors::stopRecording() {
+  if (!_traceWriter)
+    return;
+  while (_traceWriter->getSector())
+    _writeTraceSector();
+  int numBytes;
+  const uint8_t *tail = _traceWriter->getTail(&numBytes);
+  AudioNoInterrupts();
+  if (numBytes > 0)
+    _traceFile.write(tail, numBytes);
+  _traceFile.close();
+  AudioInterrupts();
+  if (getLogLevel() > 0) {
+    Serial.print("Sensors: recording stopped, samples: ");
+    Serial.print(_traceWriter->getSampleCount());
+    Serial.print(", dropped: ");
+    Serial.println(_traceWriter->getDropCount());
+  }
+  delete _traceWriter;
+  _traceWriter = NULL;
+}
+
+void Sensors::_writeTraceSector() {
+  const uint8_t *sector = _traceWriter->getSector();
+  if (!sector)
+    return;
+  AudioNoInterrupts();
+  _traceFile.write(sector, TRACE_SECTOR_SIZE);
+  AudioInterrupts();
+  _traceWriter->releaseSector();
+}
+
+bool Sensors::startReplay(const char *fileName) {
+  stopReplay();
+  AudioNoInterrupts();
+  _replayFile = SD.open(fileName, FILE_READ);
+  AudioInterrupts();
+  if (!_replayFile) {
+    Serial.print("Sensors: can't open trace file ");
+    Serial.println(fileName);
+    return false;
+  }
+  _traceReader = new SdTraceReader(&_replayFile);
+  if (!_traceReader->begin() || _traceReader->getFullScale() != _source->fullScale()) {
+    Serial.print("Sensors: not a trace from these sensors: ");
+    Serial.println(fileName);
+    stopReplay();
+    return false;
+  }
+  _sampleTimer.end();
+  _replayPending = false;
+  _replayStart = micros();
+  _tu->log("Sensors: replay started");
+  return true;
+}
+
+void Sensors::stopReplay() {
+  if (!_traceReader)
+    return;
+  delete _traceReader;
+  _traceReader = NULL;
+  AudioNoInterrupts();
+  _replayFile.close();
+  AudioInterrupts();
+  setSampleRate(_sampleRate);           // restarts the timer
+  _tu->log("Sensors: replay stopped");
+}
+
+bool Sensors::isReplaying() {
+  return _traceReader != NULL;
+}
+
+void Sensors::_replaySamples() {
+  uint32_t elapsed = micros() - _replayStart;
+  while (true) {
+    if (!_replayPending) {
+      if (!_traceReader->next(&_replayTime, _replayValues)) {
+        stopReplay();
+        return;
+      }
+      _replayPending = true;
+    }
+    if ((int32_t)(_replayTime - elapsed) > 0)
+      return;                           // not due yet
+    if (!_sampler->pushSample(_replayStart + _replayTime, _replayValues))
+      return;                           // sampler is full; next time
+    _replayPending = false;
+  }
+}
 
 /*----------------------------------------------------------------------
  * Touch system: was a key touched or released?
@@ -80,6 +320,16 @@ void Sensors::setTouchReleaseThresholds(float touchThreshold, float releaseThres
     setTouchReleaseThresholds(ch, touchThreshold, releaseThreshold);
 }
 
+void Sensors::setPrearmThreshold(int channel, float percent) {
+  channel = _checkSensorRange(channel);
+  if (percent < 0.0)
+    percent = 0.0;
+  else if (percent > 100.0)
+    percent = 100.0;
+  _prearmThreshold[channel] = percent;
+  _armed[channel] = false;
+}
+
 void Sensors::setTouchReleaseThresholds(int channel, float touchThreshold, float releaseThreshold) {
 
   if (touchThreshold < 0)
@@ -123,7 +373,101 @@ void Sensors::setTouchToggleMode(int channel, bool on) {
   }
 }
 
-/* Returns number of changes since the last call.
+/*----------------------------------------------------------------------
+ * Touch detection runs once per sample (see _processSamples()), so
+ * touches and releases are detected at the sample rate and time-stamped
+ * with the time of the sample that crossed the threshold. Each change is
+ * published as a TouchEvent on the event queue.
+ *
+ * Touch-toggle mode. This uses touch-on-touch-off rather than the standard
+ * touch-on-release-off, i.e. each touch toggles the touched/released state.
+ * So we ignore releases, and we convert touches alternately to
+ * touch/release. _lastSensorStatus[] is the actual state of the sensor;
+ * _sensorStatus[] is the state that's reported, after toggling.
+ ----------------------------------------------------------------------*/
+
+void Sensors::_updateTouchStatus(int channel, uint32_t timeMicros) {
+  float prox = _proximityPercent(channel);
+  float touchThreshold, releaseThreshold;
+  _getThresholds(channel, &touchThreshold, &releaseThreshold);
+  if (_prearmThreshold[channel] > 0.0)
+    _updatePrearm(channel, prox, timeMicros);
+
+  int status = _lastSensorStatus[channel];
+  if (prox >= touchThreshold)
+    status = IS_TOUCHED;
+  else if (prox < releaseThreshold)
+    status = IS_RELEASED;
+  if (status == _lastSensorStatus[channel])
+    return;
+  _lastSensorStatus[channel] = status;
+  if (status == IS_RELEASED)
+    _velocity[channel].resetPeak();           // the next approach starts now
+  _lastActionTime[channel] = millis();
+
+  int change = (status == IS_TOUCHED) ? NEW_TOUCH : NEW_RELEASE;
+  if (_touchToggleMode[channel]) {
+    if (change == NEW_RELEASE)
+      return;                                   // ignore all releases
+    change = (_sensorStatus[channel] == IS_TOUCHED) ? NEW_RELEASE : NEW_TOUCH;
+  }
+  _sensorStatus[channel] = (change == NEW_TOUCH) ? IS_TOUCHED : IS_RELEASED;
+  if (change == NEW_TOUCH)
+    LATENCY_TOUCH(channel, timeMicros);
+  _pushEvent(channel, change, prox, timeMicros);
+}
+
+// Pre-arm: an early warning, while proximity is still rising toward the
+// touch threshold, so the outputs can get ready. The disarm comes when
+// proximity has fallen well below the pre-arm threshold again with the
+// sensor released, whether it was touched in between or not.
+
+void Sensors::_updatePrearm(int channel, float prox, uint32_t timeMicros) {
+  if (!_armed[channel]) {
+    if (prox >= _prearmThreshold[channel] && _lastSensorStatus[channel] == IS_RELEASED) {
+      _armed[channel] = true;
+      _pushEvent(channel, NEW_PREARM, prox, timeMicros);
+    }
+  } else if (prox < _prearmThreshold[channel] * (PREARM_HYSTERESIS_PERCENT / 100.0)
+             && _lastSensorStatus[channel] == IS_RELEASED) {
+    _armed[channel] = false;
+    _pushEvent(channel, NEW_DISARM, prox, timeMicros);
+  }
+}
+
+void Sensors::_pushEvent(int channel, int type, float prox, uint32_t timeMicros) {
+  TouchEvent event;
+  event.timeMicros = timeMicros;
+  event.channel = channel;
+  event.type = type;
+  event.proximity = prox;
+  event.velocity = (type == NEW_TOUCH) ? _velocityPercent(channel) : 0.0;
+  _events.push(event);
+}
+
+void Sensors::update() {
+  _source->poll(micros());
+  if (_traceReader)
+    _replaySamples();
+  _processSamples();
+  if (_traceWriter)
+    _writeTraceSector();
+}
+
+bool Sensors::getTouchEvent(TouchEvent *event) {
+  return _events.pop(event);
+}
+
+bool Sensors::isTouched(int channel) {
+  return _sensorStatus[channel] == IS_TOUCHED;
+}
+
+uint32_t Sensors::getDroppedEventCount() {
+  return _events.getDropCount();
+}
+
+/* An older polling interface; new code should use getTouchEvent().
+ * Returns number of changes since the last call.
  *   - Array sensorChanges is filled with NEW_TOUCH, NEW_RELEASE, or TOUCH_NO_CHANGE.
  *   - Array sensorStatus[] is filled with true/false (1/0) indicating if the sensor it touched or not
  */
@@ -132,54 +476,16 @@ int Sensors::getTouchStatus(float proximityValues[], int sensorStatus[], int sen
 
   int numChanges = 0;
 
+  _processSamples();
+
   for (int i = 0; i < NUM_CHANNELS; i++) {
+    proximityValues[i] = _proximityPercent(i);
+    sensorStatus[i] = _sensorStatus[i];
     sensorChanges[i] = TOUCH_NO_CHANGE;
-    float prox = getProximityPercent(i);
-    proximityValues[i] = prox;
-    if (prox >= _touchThreshold[i]) {
-      sensorStatus[i] = IS_TOUCHED;
-      if (_lastSensorStatus[i] != sensorStatus[i]) {
-        sensorChanges[i] = NEW_TOUCH;
-        numChanges++;
-        _lastActionTime[i] = millis();
-      }
-    } else if (prox < _releaseThreshold[i]) {
-      sensorStatus[i] = IS_RELEASED;
-      if (_lastSensorStatus[i] != sensorStatus[i]) {
-        sensorChanges[i] = NEW_RELEASE;
-        numChanges++;
-        _lastActionTime[i] = millis();
-      }
-    } else {
-      sensorStatus[i] = _lastSensorStatus[i];
-    }
-    
-    // Record for next time. Note that this is *before* the touch-toggle
-    // mode below since we need to know the actual status, not the "pseudo"
-    // status of the touch-toggle mode (see below).
-    _lastSensorStatus[i] = sensorStatus[i];
-    
-    // Touch-toggle mode. This uses touch-on-touch-off rather than the standard
-    // touch-on-release-off, i.e. each touch toggles the touched/released state.
-    // So we convert releases to no-change, and we convert touches alternately
-    // to touch/release.
-
-    if (_touchToggleMode[i]) {
-      if (sensorChanges[i] == NEW_RELEASE) {
-        sensorStatus[i] = _lastSensorPseudoStatus[i];
-        sensorChanges[i] = TOUCH_NO_CHANGE;             // ignore all releases
-        numChanges--;
-      } else if (sensorChanges[i] == NEW_TOUCH) {
-        if (_lastSensorPseudoStatus[i] == IS_TOUCHED) { // alternate touches converted to toggle on/off
-          sensorChanges[i] = NEW_RELEASE;
-          sensorStatus[i] = IS_RELEASED;
-          _lastSensorPseudoStatus[i] = IS_RELEASED;
-        } else {
-          sensorChanges[i] = NEW_TOUCH;
-          sensorStatus[i] = IS_TOUCHED;
-          _lastSensorPseudoStatus[i] = IS_TOUCHED;
-        }
-      }
+    if (_sensorStatus[i] != _reportedStatus[i]) {
+      sensorChanges[i] = (_sensorStatus[i] == IS_TOUCHED) ? NEW_TOUCH : NEW_RELEASE;
+      _reportedStatus[i] = _sensorStatus[i];
+      numChanges++;
     }
   }
 
@@ -204,35 +510,706 @@ int Sensors::getTouchStatus(float proximityValues[], int sensorStatus[], int sen
  ----------------------------------------------------------------------*/
 
 void Sensors::setAveragingStrength(int samples) {
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    setAveragingStrength(channel, samples, _filter[channel].getType());
+}
+
+// The "samples" is the strength of the filter; see ProximityFilter.h for
+// what it means for each type of filter.
+
+void Sensors::setAveragingStrength(int channel, int samples, FilterType type) {
+  channel = _checkSensorRange(channel);
   if (samples < 0)
     samples = 0;
-  _averagingSamples = samples;
-  _tu->logAction2("Sensors: averaging: ", _averagingSamples);
+  _filter[channel].configure(type, samples, _source->fullScale());
+  _tu->logAction2("Sensors: averaging: ", samples);
 }
 
 void Sensors::setProximityMultiplier(int channel, float m) {
   channel = _checkSensorRange(channel);
   _proximityMultiplier[channel] = m;
+  _calculatePercentPerCount(channel);
+}
+
+void Sensors::_calculatePercentPerCount(int channel) {
+  float fullScale = (float)_source->fullScale() * 65536.0;
+  _percentPerCount[channel] = 100.0 * _proximityMultiplier[channel] / fullScale;
+  float range = fullScale - (float)_baseline[channel].getBaseline();
+  if (range < 65536.0)
+    range = 65536.0;
+  _relativePercentPerCount[channel] = 100.0 * _proximityMultiplier[channel] / range;
+}
+
+/*----------------------------------------------------------------------
+ * I2C touch controller. Replaces the analog sensors with one or two
+ * MPR121 chips (see Mpr121SensorSource.h). The chip's IRQ pin asks for an
+ * immediate read when it sees a touch or release; between those, the
+ * electrodes are read every few milliseconds from update().
+ ----------------------------------------------------------------------*/
+
+void Sensors::_controllerInterrupt() {
+  _timerInstance->_controller->interrupt();
+}
+
+bool Sensors::useTouchController(int numChips, int irqPin) {
+  if (_controller)
+    return true;
+  if (_link) {
+    _tu->log("Sensors: can't use a touch controller with the sensor boards' digital link");
+    return false;
+  }
+  Mpr121SensorSource *controller = new Mpr121SensorSource(new WireI2CBus(400000), numChips);
+  controller->begin();
+  if (!controller->isConnected()) {
+    _tu->log("Sensors: no touch controller found, still using the analog sensors");
+    return false;
+  }
+  _controller = controller;
+  _changeSource(controller);
+  if (irqPin >= 0) {
+    pinMode(irqPin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(irqPin), _controllerInterrupt, FALLING);
+  }
+  _tu->logAction("Sensors: using touch controller chips: ", numChips);
+  return true;
+}
+
+// Everything measured on the old sensors (filter state, baseline,
+// cross-talk) is meaningless on the new ones, and the full scale can
+// change.
+
+void Sensors::_changeSource(SensorSource *source) {
+  noInterrupts();
+  _envelopeSource->setSource(source);
+  interrupts();
+  _useCrosstalk = false;
+  _crosstalk.reset();
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    _filter[channel].configure(_filter[channel].getType(), _filter[channel].getSamples(), _source->fullScale());
+    _filter[channel].reset(0);
+    _velocity[channel].reset(0);
+    if (_useBaseline[channel])
+      _baseline[channel].reset(0);
+    _calculatePercentPerCount(channel);
+  }
+}
+
+void Sensors::setChannelElectrodes(int channel, uint32_t electrodeMask) {
+  channel = _checkSensorRange(channel);
+  if (_controller)
+    _controller->setChannelElectrodes(channel, electrodeMask);
+}
+
+/*----------------------------------------------------------------------
+ * Digital link from the sensor boards. The first channel that uses it
+ * switches the source over to a LinkSensorSource, which reads the other
+ * channels (and any linked channel whose board goes quiet) from the
+ * analog pins as before. The link's counts have a larger full scale, so
+ * the analog readings are scaled up to match.
+ ----------------------------------------------------------------------*/
+
+bool Sensors::useSensorLink(int channel, int serialPort) {
+  channel = _checkSensorRange(channel);
+  if (_controller) {
+    _tu->log("Sensors: can't use the sensor boards' digital link with a touch controller");
+    return false;
+  }
+  if (serialPort < 0 || serialPort > 8) {
+    _tu->logAction("Sensors: no such serial port: ", serialPort);
+    return false;
+  }
+  if (!_link) {
+    if (serialPort == 0)
+      return true;
+    _link = new LinkSensorSource(_analogSource);
+    _changeSource(_link);
+  }
+  SerialPort *port = serialPort ? new UartSerialPort(serialPort, SENSOR_LINK_BAUD) : NULL;
+  _link->setPort(channel, port);
+  delete _linkPort[channel];
+  _linkPort[channel] = port;
+  _tu->logAction2("Sensors: digital link on serial port: ", serialPort);
+  return true;
+}
+
+void Sensors::printSensorLinkStats() {
+  if (!_link) {
+    Serial.println("Sensors: no digital link");
+    return;
+  }
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    if (!_linkPort[channel])
+      continue;
+    SensorLinkParser *parser = _link->getParser(channel);
+    Serial.print("Sensors: channel ");
+    Serial.print(channel + 1);
+    Serial.print(_link->isLinked(channel) ? ": linked" : ": analog");
+    Serial.print(", frames: ");
+    Serial.print(parser->getFrameCount());
+    Serial.print(", CRC errors: ");
+    Serial.print(parser->getCrcErrorCount());
+    Serial.print(", lost: ");
+    Serial.println(parser->getLostFrameCount());
+  }
+}
+
+/*----------------------------------------------------------------------
+ * Audio input. The envelope followers run in the audio library's update
+ * (see AudioAnalyzeEnvelope.h); the sampling interrupt substitutes their
+ * latest value for the sensor reading, so from here on an audio channel
+ * goes through the same touch/release logic as a touch sensor.
+ *
+ * The follower already smooths the level with its attack and release, so
+ * the channel's ProximityFilter is turned down to AUDIO_INPUT_FILTER_SAMPLES
+ * while it listens to audio; the sensor's averaging would add over 100 ms to
+ * a response that's otherwise one audio block. The sensor's settings come
+ * back when the channel returns to it. (setAveragingStrength() still
+ * works on an audio channel, for a noisy source.)
+ ----------------------------------------------------------------------*/
+
+void Sensors::setAudioEnvelopes(EnvelopeFollower *left, EnvelopeFollower *right) {
+  _audioEnvelope[0] = left;
+  _audioEnvelope[1] = right;
+}
+
+void Sensors::setInputSource(int channel, InputSource source) {
+  channel = _checkSensorRange(channel);
+  if (source == audioInput && !_audioEnvelope[channel & 1]) {
+    _tu->log("Sensors: no audio input available");
+    source = noInput;
+  }
+  _envelopeSource->setFollower(channel, source == audioInput ? _audioEnvelope[channel & 1] : NULL);
+  if (source != _inputSource[channel]) {
+    if (source == audioInput) {
+      _sensorFilterType[channel] = _filter[channel].getType();
+      _sensorFilterSamples[channel] = _filter[channel].getSamples();
+      _filter[channel].configure(emaFilter, AUDIO_INPUT_FILTER_SAMPLES, _source->fullScale());
+    } else if (_inputSource[channel] == audioInput) {
+      _filter[channel].configure(_sensorFilterType[channel], _sensorFilterSamples[channel], _source->fullScale());
+    }
+    _filter[channel].reset(0);
+    _velocity[channel].reset(0);
+    if (_useBaseline[channel])
+      _baseline[channel].reset(0);
+  }
+  _inputSource[channel] = source;
+  _tu->logAction2("Sensors: input source: ", source);
+}
+
+/*----------------------------------------------------------------------
+ * Baseline tracking. When this is on, proximity is measured from the
+ * sensor's idle level rather than from zero, as a percent of the range
+ * between the idle level and full scale. The idle level follows slow
+ * drift (humidity, temperature) while the sensor isn't touched, so the
+ * thresholds don't need retuning as conditions change. The thresholds are
+ * also kept clear of the idle noise; see BASELINE_TOUCH_SIGMAS.
+ ----------------------------------------------------------------------*/
+
+void Sensors::setBaselineTracking(int channel, bool on) {
+  channel = _checkSensorRange(channel);
+  if (on && !_useBaseline[channel])
+    _baseline[channel].reset(_filter[channel].getValue());
+  _useBaseline[channel] = on;
+  _calculatePercentPerCount(channel);
+  _tu->logAction2("Sensors: baseline tracking: ", on);
+}
+
+void Sensors::_getThresholds(int channel, float *touch, float *release) {
+  *touch = _touchThreshold[channel];
+  *release = _releaseThreshold[channel];
+  if (!_useBaseline[channel])
+    return;
+  float sigma = (float)_baseline[channel].getNoise() * _relativePercentPerCount[channel];
+  if (*touch < _touchSigmas[channel] * sigma)
+    *touch = _touchSigmas[channel] * sigma;
+  if (*release < _releaseSigmas[channel] * sigma)
+    *release = _releaseSigmas[channel] * sigma;
+}
+
+/*----------------------------------------------------------------------
+ * Auto-calibration. Each sensor is watched for a few seconds while
+ * nobody touches it, giving its idle level and noise. From those:
+ *
+ *   - baseline tracking is turned on, starting from the measured idle
+ *     level and noise (so there's no warm-up)
+ *   - the touch threshold is set as low as it can be while keeping noise
+ *     from causing more than the requested number of false touches, which
+ *     gives the fastest response; the release threshold is half as far
+ *     above the idle level
+ *   - if somebody does touch a sensor firmly during calibration, the
+ *     proximity multiplier is set so that touch reads as 100%
+ *
+ * The measurements are saved in CALIBRATION_FILE along with the settings
+ * they depend on (sample rate, filter), and reused on later boots as long
+ * as those settings haven't changed.
+ ----------------------------------------------------------------------*/
+
+bool Sensors::calibrate(int milliseconds, float falseTouchesPerHour, bool useSavedCalibration) {
+  int32_t mean[NUM_CHANNELS];
+  int32_t sigma[NUM_CHANNELS];
+  int32_t peak[NUM_CHANNELS];
+
+  bool loaded = useSavedCalibration && _loadCalibration(mean, sigma, peak);
+  if (!loaded) {
+    _tu->log("Sensors: calibrating, don't touch the sensors...");
+    SensorCalibrator calibrator[NUM_CHANNELS];
+    uint32_t start = millis();
+    uint32_t settle = milliseconds / 4;           // let the filters settle first
+    uint32_t timeMicros;
+    uint16_t raw[NUM_CHANNELS];
+    while (millis() - start < (uint32_t)milliseconds) {
+      if (_traceReader)
+        _replaySamples();
+      while (_sampler->getSample(&timeMicros, raw)) {
+        if (_useCrosstalk)
+          _crosstalk.apply(raw, _source->fullScale());
+        bool settled = (millis() - start >= settle);
+        for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+          int32_t value = _filter[channel].filter(raw[channel]);
+          if (settled)
+            calibrator[channel].add(value);
+        }
+      }
+    }
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+      if (calibrator[channel].getCount() < CALIBRATION_MIN_SAMPLES) {
+        _tu->log("Sensors: calibration failed, too few samples");
+        return false;
+      }
+      mean[channel] = calibrator[channel].getMean();
+      sigma[channel] = calibrator[channel].getSigma();
+      peak[channel] = calibrator[channel].getPeak();
+    }
+    _saveCalibration(mean, sigma, peak);
+  }
+
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    if (_ignoreSensor[channel] || _inputSource[channel] != touchInput)
+      continue;
+    _applyCalibration(channel, mean[channel], sigma[channel], peak[channel], falseTouchesPerHour);
+  }
+  _tu->log(loaded ? "Sensors: saved calibration loaded" : "Sensors: calibration done");
+  return true;
+}
+
+void Sensors::_applyCalibration(int channel, int32_t mean, int32_t sigma, int32_t peak, float falseTouchesPerHour) {
+
+  // A very quiet source (or a simulated one) can measure no noise at all;
+  // the readings are whole counts, so take that as the least there is.
+  if (sigma < 65536)
+    sigma = 65536;
+
+  // A touch stands out clearly from the noise and covers a useful part
+  // of the range; anything less is ignored.
+  float fullScale = (float)_source->fullScale() * 65536.0;
+  float rise = (float)(peak - mean);
+  if (rise > 20.0 * (float)sigma && rise > fullScale / 50.0) {
+    float m = (fullScale - (float)mean) / rise;
+    if (m < 1.0)
+      m = 1.0;
+    else if (m > 20.0)
+      m = 20.0;
+    _proximityMultiplier[channel] = m;
+  }
+
+  _baseline[channel].reset(mean, sigma);
+  _useBaseline[channel] = true;
+  _calculatePercentPerCount(channel);
+
+  // The filter averages over about this many samples, so that's how many
+  // independent chances per second the noise has to cause a false touch.
+  int samples = _filter[channel].getSamples();
+  if (samples < 1)
+    samples = 1;
+  float k = SensorCalibrator::sigmasForFalseTouches(falseTouchesPerHour, (float)_sampleRate / (float)samples);
+  _touchSigmas[channel] = k;
+  _releaseSigmas[channel] = k / 2.0;
+  float sigmaPercent = (float)sigma * _relativePercentPerCount[channel];
+  float touch = k * sigmaPercent;
+  if (touch < 1.0)
+    touch = 1.0;
+  else if (touch > 100.0)
+    touch = 100.0;
+  setTouchReleaseThresholds(channel, touch, touch / 2.0);
+
+  if (getLogLevel() > 0) {
+    Serial.print("Sensors: channel ");
+    Serial.print(channel + 1);
+    Serial.print(": idle ");
+    Serial.print((float)mean / 65536.0);
+    Serial.print(", noise ");
+    Serial.print((float)sigma / 65536.0);
+    Serial.print(", multiplier ");
+    Serial.print(_proximityMultiplier[channel]);
+    Serial.print(", touch/release ");
+    Serial.print(_touchThreshold[channel]);
+    Serial.print("/");
+    Serial.println(_releaseThreshold[channel]);
+  }
+}
+
+// The file has a header line, a line with the settings the measurements
+// depend on (including which kind of sensors), and a line per channel:
+// the channel's filter settings and then the idle level, noise and peak
+// (Q16).
+
+static int _parseNumbers(const char *line, long numbers[], int maxNumbers) {
+  const char *p = line;
+  int count = 0;
+  while (count < maxNumbers) {
+    char *end;
+    numbers[count] = strtol(p, &end, 10);
+    if (end == p)
+      break;
+    p = end;
+    count++;
+  }
+  return count;
+}
+
+bool Sensors::_loadCalibration(int32_t mean[], int32_t sigma[], int32_t peak[]) {
+  AudioNoInterrupts();
+  File file = SD.open(CALIBRATION_FILE, FILE_READ);
+  AudioInterrupts();
+  if (!file)
+    return false;
+
+  char line[100];
+  long numbers[5];
+  int lineNumber = 0;
+  bool ok = true;
+  while (ok && lineNumber < NUM_CHANNELS + 2) {
+    AudioNoInterrupts();
+    int n = file.readBytesUntil('\n', line, sizeof(line) - 1);
+    AudioInterrupts();
+    if (n <= 0) {
+      ok = false;
+      break;
+    }
+    line[n] = 0;
+    if (lineNumber == 0) {
+      ok = (strncmp(line, "TactileAudio calibration 1", 26) == 0);
+    } else {
+      int count = _parseNumbers(line, numbers, 5);
+      if (lineNumber == 1) {
+        ok = (count == 4 && numbers[0] == NUM_CHANNELS && numbers[1] == _source->fullScale()
+              && numbers[2] == _sampleRate && numbers[3] == (_controller ? 1 : 0));
+      } else {
+        int channel = lineNumber - 2;
+        ok = (count == 5 && numbers[0] == _filter[channel].getType()
+              && numbers[1] == _filter[channel].getSamples());
+        mean[channel] = numbers[2];
+        sigma[channel] = numbers[3];
+        peak[channel] = numbers[4];
+      }
+    }
+    lineNumber++;
+  }
+  AudioNoInterrupts();
+  file.close();
+  AudioInterrupts();
+  return ok;
+}
+
+void Sensors::_saveCalibration(int32_t mean[], int32_t sigma[], int32_t peak[]) {
+  AudioNoInterrupts();
+  SD.remove(CALIBRATION_FILE);
+  File file = SD.open(CALIBRATION_FILE, FILE_WRITE);
+  bool saved = file;
+  if (saved) {
+    file.println("TactileAudio calibration 1");
+    file.print(NUM_CHANNELS);
+    file.print(" ");
+    file.print(_source->fullScale());
+    file.print(" ");
+    file.print(_sampleRate);
+    file.print(" ");
+    file.println(_controller ? 1 : 0);
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+      file.print((int)_filter[channel].getType());
+      file.print(" ");
+      file.print(_filter[channel].getSamples());
+      file.print(" ");
+      file.print(mean[channel]);
+      file.print(" ");
+      file.print(sigma[channel]);
+      file.print(" ");
+      file.println(peak[channel]);
+    }
+    file.close();
+  }
+  AudioInterrupts();
+  if (!saved)
+    _tu->log("Sensors: can't save the calibration");
+}
+
+/*----------------------------------------------------------------------
+ * Cross-talk correction. With the sensors close together, touching one
+ * raises its neighbors too. calibrateCrosstalk() measures by how much:
+ * first the idle levels (nobody touching), then, for each touch sensor in
+ * turn, the visitor is asked to touch and hold it, and every channel's
+ * rise is averaged and divided by the touched one's. The inverse of that
+ * coupling matrix is then applied to every raw sample before filtering
+ * (see CrosstalkMatrix.h), so the thresholds only see the sensor that's
+ * really touched.
+ *
+ * Only the raw samples are used, so the filters don't slow the
+ * measurement down; they're still fed, to be up to date afterward. The
+ * couplings are saved in CROSSTALK_FILE for useCrosstalkCorrection().
+ ----------------------------------------------------------------------*/
+
+bool Sensors::calibrateCrosstalk(int holdMilliseconds) {
+  bool wasOn = _useCrosstalk;
+  _useCrosstalk = false;                      // learn from what the sensors really read
+  uint16_t fullScale = _source->fullScale();
+
+  Serial.println("Sensors: measuring cross-talk, don't touch the sensors...");
+  uint16_t idle[NUM_CHANNELS];
+  if (_averageRaw(CALIBRATION_MSEC, -1, 0, idle) < CALIBRATION_MIN_SAMPLES) {
+    _tu->log("Sensors: cross-talk calibration failed, too few samples");
+    _useCrosstalk = wasOn;
+    return false;
+  }
+  CrosstalkMatrix learned;
+  learned.setIdle(idle);
+
+  for (int touched = 0; touched < NUM_CHANNELS; touched++) {
+    if (_ignoreSensor[touched] || _inputSource[touched] != touchInput)
+      continue;
+    uint16_t level = idle[touched] + (uint32_t)(fullScale - idle[touched]) * CROSSTALK_TOUCH_PERCENT / 100;
+    Serial.print("Sensors: touch and hold sensor ");
+    Serial.println(touched + 1);
+    uint16_t average[NUM_CHANNELS];
+    if (!_waitForRaw(touched, level, true, CROSSTALK_WAIT_MSEC)
+        || _averageRaw(holdMilliseconds, touched, level, average) < CALIBRATION_MIN_SAMPLES) {
+      _tu->logAction("Sensors: cross-talk calibration failed, no steady touch on sensor ", touched + 1);
+      _useCrosstalk = wasOn;
+      return false;
+    }
+    Serial.println("Sensors: let go");
+    float rise = (float)(average[touched] - idle[touched]);
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+      if (channel == touched || _ignoreSensor[channel] || _inputSource[channel] != touchInput)
+        continue;
+      float coupling = ((float)average[channel] - (float)idle[channel]) / rise;
+      learned.setCoupling(touched, channel, coupling > 0.0 ? coupling : 0.0);
+    }
+    _waitForRaw(touched, level, false, CROSSTALK_WAIT_MSEC);
+  }
+
+  if (!learned.invert()) {
+    _tu->log("Sensors: cross-talk is too strong to correct");
+    _useCrosstalk = wasOn;
+    return false;
+  }
+  _crosstalk = learned;
+  _useCrosstalk = true;
+  _saveCrosstalk();
+
+  if (getLogLevel() > 0) {
+    for (int touched = 0; touched < NUM_CHANNELS; touched++) {
+      Serial.print("Sensors: touching ");
+      Serial.print(touched + 1);
+      Serial.print(" raises (percent):");
+      for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+        Serial.print(" ");
+        Serial.print(100.0 * _crosstalk.getCoupling(touched, channel));
+      }
+      Serial.println();
+    }
+  }
+  _tu->log("Sensors: cross-talk calibration done");
+  return true;
+}
+
+bool Sensors::useCrosstalkCorrection(bool on) {
+  if (on && _crosstalk.isIdentity() && !_loadCrosstalk()) {
+    _tu->log("Sensors: no saved cross-talk calibration");
+    return false;
+  }
+  _useCrosstalk = on;
+  return true;
+}
+
+// The next raw sample, if there is one; it still goes through the filters.
+
+bool Sensors::_nextRawSample(uint16_t raw[]) {
+  uint32_t timeMicros;
+  if (_traceReader)
+    _replaySamples();
+  if (!_sampler->getSample(&timeMicros, raw))
+    return false;
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    _filter[channel].filter(raw[channel]);
+  return true;
+}
+
+// Averages each channel's raw readings for the given time. If touched
+// isn't -1, only samples where that channel reads at least level count.
+// Returns how many samples were averaged.
+
+uint32_t Sensors::_averageRaw(int milliseconds, int touched, uint16_t level, uint16_t average[]) {
+  uint32_t sum[NUM_CHANNELS];
+  uint32_t count = 0;
+  uint16_t raw[NUM_CHANNELS];
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    sum[channel] = 0;
+  uint32_t start = millis();
+  while (millis() - start < (uint32_t)milliseconds) {
+    while (_nextRawSample(raw)) {
+      if (touched >= 0 && raw[touched] < level)
+        continue;
+      for (int channel = 0; channel < NUM_CHANNELS; channel++)
+        sum[channel] += raw[channel];
+      count++;
+    }
+  }
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    average[channel] = count ? (sum[channel] + count / 2) / count : 0;
+  return count;
+}
+
+// Waits until the channel's raw reading is at or above (or below) level.
+
+bool Sensors::_waitForRaw(int channel, uint16_t level, bool above, int milliseconds) {
+  uint16_t raw[NUM_CHANNELS];
+  uint32_t start = millis();
+  while (millis() - start < (uint32_t)milliseconds) {
+    while (_nextRawSample(raw)) {
+      if ((raw[channel] >= level) == above)
+        return true;
+    }
+  }
+  return false;
+}
+
+// Same layout as the calibration file: a header line, the settings the
+// measurement depends on, the idle levels, then a line per touched
+// channel with the couplings (Q14).
+
+bool Sensors::_loadCrosstalk() {
+  AudioNoInterrupts();
+  File file = SD.open(CROSSTALK_FILE, FILE_READ);
+  AudioInterrupts();
+  if (!file)
+    return false;
+
+  CrosstalkMatrix loaded;
+  char line[100];
+  long numbers[NUM_CHANNELS];
+  int lineNumber = 0;
+  bool ok = true;
+  while (ok && lineNumber < NUM_CHANNELS + 3) {
+    AudioNoInterrupts();
+    int n = file.readBytesUntil('\n', line, sizeof(line) - 1);
+    AudioInterrupts();
+    if (n <= 0) {
+      ok = false;
+      break;
+    }
+    line[n] = 0;
+    if (lineNumber == 0) {
+      ok = (strncmp(line, "TactileAudio crosstalk 1", 24) == 0);
+    } else {
+      int count = _parseNumbers(line, numbers, NUM_CHANNELS);
+      if (lineNumber == 1) {
+        ok = (count == 3 && numbers[0] == NUM_CHANNELS && numbers[1] == _source->fullScale()
+              && numbers[2] == (_controller ? 1 : 0));
+      } else if (lineNumber == 2) {
+        uint16_t idle[NUM_CHANNELS];
+        for (int channel = 0; channel < count; channel++)
+          idle[channel] = numbers[channel];
+        ok = (count == NUM_CHANNELS);
+        if (ok)
+          loaded.setIdle(idle);
+      } else {
+        int touched = lineNumber - 3;
+        ok = (count == NUM_CHANNELS);
+        for (int channel = 0; ok && channel < NUM_CHANNELS; channel++)
+          loaded.setCoupling(touched, channel, (float)numbers[channel] / (float)CROSSTALK_ONE);
+      }
+    }
+    lineNumber++;
+  }
+  AudioNoInterrupts();
+  file.close();
+  AudioInterrupts();
+  if (!ok || !loaded.invert())
+    return false;
+  _crosstalk = loaded;
+  return true;
+}
+
+void Sensors::_saveCrosstalk() {
+  AudioNoInterrupts();
+  SD.remove(CROSSTALK_FILE);
+  File file = SD.open(CROSSTALK_FILE, FILE_WRITE);
+  bool saved = file;
+  if (saved) {
+    file.println("TactileAudio crosstalk 1");
+    file.print(NUM_CHANNELS);
+    file.print(" ");
+    file.print(_source->fullScale());
+    file.print(" ");
+    file.println(_controller ? 1 : 0);
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+      file.print(_crosstalk.getIdle(channel));
+      file.print(channel < NUM_CHANNELS - 1 ? " " : "\n");
+    }
+    for (int touched = 0; touched < NUM_CHANNELS; touched++) {
+      for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+        file.print((long)floorf(_crosstalk.getCoupling(touched, channel) * (float)CROSSTALK_ONE + 0.5));
+        file.print(channel < NUM_CHANNELS - 1 ? " " : "\n");
+      }
+    }
+    file.close();
+  }
+  AudioInterrupts();
+  if (!saved)
+    _tu->log("Sensors: can't save the cross-talk calibration");
 }
 
 float Sensors::getProximityPercent(int channel) {
-  if (_ignoreSensor[channel])
-    return 0.0;
   channel = _checkSensorRange(channel);
-  int p = analogRead(_channelToPinNumber[channel]);
-  if (_averagingSamples > 0) {
-    // Simple infinite-impulse-response filter, e.g. if averaging "strength" is 10 and "p"
-    // is the new value, then new average "pavg" value is (9*(pavg) + p)/10.
-    _filteredSensorValue[channel] =
-      (_filteredSensorValue[channel] * (_averagingSamples - 1) + (float)p) / (float)_averagingSamples;
-    p = (int)_filteredSensorValue[channel];
-  }
-  p = p * 100.0 * _proximityMultiplier[channel] / 1024;  // convert digital signal to percent
+  _processSamples();
+  return _proximityPercent(channel);
+}
+
+// Note that this isn't rounded to whole percents; small changes in
+// proximity are still visible as fractions of a percent.
+
+float Sensors::_proximityPercent(int channel) {
+  if (_ignoreSensor[channel] || _inputSource[channel] == noInput)
+    return 0.0;
+  float p;
+  if (_useBaseline[channel]) {
+    p = (float)(_filter[channel].getValue() - _baseline[channel].getBaseline()) * _relativePercentPerCount[channel];
+    if (p < 0.0)
+      p = 0.0;
+  } else {
+    p = (float)_filter[channel].getValue() * _percentPerCount[channel];
+  }
   if (p > 100.0)
     p = 100.0;
   return p;
 }
 
+float Sensors::getVelocityPercent(int channel) {
+  channel = _checkSensorRange(channel);
+  _processSamples();
+  return _velocityPercent(channel);
+}
+
+// The slope is in Q16 raw counts per sample, the same units as the
+// filter output, so the same conversion to percent applies.
+
+float Sensors::_velocityPercent(int channel) {
+  if (_ignoreSensor[channel] || _inputSource[channel] == noInput)
+    return 0.0;
+  float perCount = _useBaseline[channel] ? _relativePercentPerCount[channel] : _percentPerCount[channel];
+  return (float)_velocity[channel].getPeakSlope() * perCount * (float)_sampleRate;
+}
+
 int Sensors::_checkSensorRange(int channel) {
   if (channel < 0)
     return 0;
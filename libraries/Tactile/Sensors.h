@@ -21,7 +21,21 @@
 #ifndef Sensors_h
 #define Sensors_h 1
 
+#include <Arduino.h>
+#include <SD.h>
 #include "TeensyUtils.h"
+#include "SensorSource.h"
+#include "SensorSampler.h"
+#include "ProximityFilter.h"
+#include "BaselineTracker.h"
+#include "TouchEventQueue.h"
+#include "EnvelopeFollower.h"
+#include "SensorTrace.h"
+#include "SensorCalibrator.h"
+#include "Mpr121SensorSource.h"
+#include "LinkSensorSource.h"
+#include "VelocityEstimator.h"
+#include "CrosstalkMatrix.h"
 
 // Touches to the electrodes
 #define IS_TOUCHED 1
@@ -29,14 +43,49 @@
 #define TOUCH_NO_CHANGE 0
 #define NEW_TOUCH 1
 #define NEW_RELEASE 2
+#define NEW_PREARM 3          // getTouchEvent() only: a hand is coming (see setPrearmThreshold())
+#define NEW_DISARM 4          // ... and went away again (or was released)
 
-// Specify an unused analog input. It can't be one of
-// the ones used below for _channelToPinNumber, and shouldn't
+// Pre-arm: the event for a hand going away again comes when proximity
+// drops below this percent of the pre-arm threshold.
+
+#define PREARM_HYSTERESIS_PERCENT 70
+
+// Specify an unused analog input. It can't be one of the ones
+// used for the sensors (see AnalogSensorSource.h), and shouldn't
 // be connected to anything. This is used by the Tactile
 // class to seed random numbers.
 
 #define UNUSED_ANALOG_INPUT A13
 
+// With baseline tracking, the touch and release thresholds are also kept
+// at least this many standard deviations of the idle noise above the
+// baseline, and the baseline follows drift with this time constant.
+
+#define BASELINE_TOUCH_SIGMAS   6
+#define BASELINE_RELEASE_SIGMAS 3
+#define BASELINE_TRACKING_MSEC  8000
+
+// A channel that follows audio input is already smoothed by its envelope
+// follower, so its proximity filter is turned down to this.
+
+#define AUDIO_INPUT_FILTER_SAMPLES 1
+
+// Auto-calibration: how long the sensors are watched, and where the
+// results are saved so the next boot doesn't have to wait. (Files whose
+// names start with "_" aren't mistaken for audio tracks.)
+
+#define CALIBRATION_MSEC 3000
+#define CALIBRATION_FILE "/_CALIB.TXT"
+
+// Cross-talk calibration: a sensor counts as touched once it has risen
+// this far (percent of its range above idle), and the visitor has this
+// long to touch it (and let go) when asked.
+
+#define CROSSTALK_TOUCH_PERCENT 20
+#define CROSSTALK_WAIT_MSEC     20000
+#define CROSSTALK_FILE          "/_XTALK.TXT"
+
 
 class Sensors
 {
@@ -49,19 +98,84 @@ class Sensors
   // Touch and proximity sensing
   void  setTouchReleaseThresholds(float touchThreshold, float releaseThreshold);
   void  setTouchReleaseThresholds(int channel, float touchThreshold, float releaseThreshold);
+  void  setPrearmThreshold(int channel, float percent);   // 0 == off
   void  ignoreSensor(int channel, bool ignore);
   void  setTouchToggleMode(int channel, bool on);
+  void  update();                                   // process new samples, publish events
+  bool  getTouchEvent(TouchEvent *event);
+  bool  isTouched(int channel);
+  uint32_t getDroppedEventCount();
   int   getTouchStatus(float proximityValues[], int sensorStatus[], int sensorChanges[]);
   float getProximityPercent(int channel);
+  float getVelocityPercent(int channel);            // percent per second, fastest rise since release
   void  setAveragingStrength(int samples);
+  void  setAveragingStrength(int channel, int samples, FilterType type);
   void  setProximityMultiplier(int channel, float m);
+  void  setBaselineTracking(int channel, bool on);
+  bool  calibrate(int milliseconds, float falseTouchesPerHour, bool useSavedCalibration);
+  bool  calibrateCrosstalk(int holdMilliseconds);    // guided: asks for one sensor at a time
+  bool  useCrosstalkCorrection(bool on);             // on: with the saved matrix unless just calibrated
+
+  // I2C touch controller instead of the analog sensors
+  bool  useTouchController(int numChips, int irqPin);
+  void  setChannelElectrodes(int channel, uint32_t electrodeMask);
+
+  // Digital link from the sensor boards (see SensorLink.h) instead of
+  // their analog voltage; serialPort is 1..8 for Serial1..Serial8, 0 == analog
+  bool  useSensorLink(int channel, int serialPort);
+  void  printSensorLinkStats();
+
+  // Audio input: a channel can follow the loudness of line-in/mic instead
+  // of its touch sensor. Channels 0 and 2 use the left input, 1 and 3 the
+  // right.
+  void  setAudioEnvelopes(EnvelopeFollower *left, EnvelopeFollower *right);
+  void  setInputSource(int channel, InputSource source);
+
+  // Background sampling
+  void  setSampleRate(int samplesPerSecond);
+  int   getSampleRate();
+  void  printSamplerStats();
+
+  // Recording the raw samples to the SD card, and playing them back in
+  // place of the sensors (see SensorTrace.h)
+  bool  startRecording(const char *fileName);
+  void  stopRecording();
+  bool  startReplay(const char *fileName);
+  void  stopReplay();
+  bool  isReplaying();
 
  private:
 
-  const int _channelToPinNumber[NUM_CHANNELS] = {A14, A15, A16, A17};
-
   TeensyUtils *_tu;
+
+  // Sensors are read by a timer interrupt at a fixed rate; the loop
+  // processes whatever samples have accumulated since the last call.
+  SensorSource  *_source;                    // the touch sensors plus audio input
+  EnvelopeSensorSource *_envelopeSource;
+  SensorSource  *_analogSource;
+  Mpr121SensorSource *_controller;            // NULL unless an I2C controller is used
+  LinkSensorSource *_link;                    // NULL unless a sensor board's digital link is used
+  SerialPort    *_linkPort[NUM_CHANNELS];
+  static void    _controllerInterrupt();
+  EnvelopeFollower *_audioEnvelope[2];
+  SensorSampler *_sampler;
+  IntervalTimer  _sampleTimer;
+  int            _sampleRate;
+  static Sensors *_timerInstance;
+  static void    _sampleTimerInterrupt();
   
+  // Trace recording and replay
+  TraceWriter *_traceWriter;                  // NULL unless recording
+  File         _traceFile;
+  TraceReader *_traceReader;                  // NULL unless replaying
+  File         _replayFile;
+  uint32_t     _replayStart;                  // micros() when the replay started
+  bool         _replayPending;                // _replayValues not yet handed to the sampler
+  uint32_t     _replayTime;
+  uint16_t     _replayValues[NUM_CHANNELS];
+  void         _writeTraceSector();
+  void         _replaySamples();
+
   // General controls
   bool _touchToggleMode[NUM_CHANNELS];        // touch-on-touch-off rather than touch-on-release-off
 
@@ -70,16 +184,56 @@ class Sensors
   float _touchThreshold[NUM_CHANNELS];          // Percent, 0..100
   float _releaseThreshold[NUM_CHANNELS];
   bool  _ignoreSensor[NUM_CHANNELS];
-  int   _lastSensorStatus[NUM_CHANNELS];
-  int   _lastSensorPseudoStatus[NUM_CHANNELS];    // for touchToggleMode only
+  InputSource _inputSource[NUM_CHANNELS];
+  int   _lastSensorStatus[NUM_CHANNELS];        // actual state of the sensor
+  float _prearmThreshold[NUM_CHANNELS];         // Percent, 0 == off
+  bool  _armed[NUM_CHANNELS];
+  int   _sensorStatus[NUM_CHANNELS];            // reported state (differs in touchToggleMode)
+  int   _reportedStatus[NUM_CHANNELS];          // for getTouchStatus()
+  TouchEventQueue _events;
   unsigned long _lastActionTime[NUM_CHANNELS];
   float _proximityMultiplier[NUM_CHANNELS];
 
   // Proximity detection and smoothing
-  float _filteredSensorValue[NUM_CHANNELS];
-  int   _averagingSamples;
-
-  int _checkSensorRange(int channel);
+  ProximityFilter _filter[NUM_CHANNELS];
+  FilterType _sensorFilterType[NUM_CHANNELS];  // put back when an audio channel returns to its sensor
+  int   _sensorFilterSamples[NUM_CHANNELS];
+  float _percentPerCount[NUM_CHANNELS];      // converts Q16 filter output to percent
+
+  // How fast the reading rises (from the raw samples)
+  VelocityEstimator _velocity[NUM_CHANNELS];
+
+  // Baseline (idle level) tracking
+  bool  _useBaseline[NUM_CHANNELS];
+  BaselineTracker _baseline[NUM_CHANNELS];
+  float _relativePercentPerCount[NUM_CHANNELS];   // same, but for the range above the baseline
+  float _touchSigmas[NUM_CHANNELS];               // thresholds are at least this far above the noise
+  float _releaseSigmas[NUM_CHANNELS];
+
+  // Cross-talk correction, applied to the raw samples
+  CrosstalkMatrix _crosstalk;
+  bool  _useCrosstalk;
+  bool  _nextRawSample(uint16_t raw[]);
+  uint32_t _averageRaw(int milliseconds, int touched, uint16_t level, uint16_t average[]);
+  bool  _waitForRaw(int channel, uint16_t level, bool above, int milliseconds);
+  bool  _loadCrosstalk();
+  void  _saveCrosstalk();
+
+  // Auto-calibration
+  void  _applyCalibration(int channel, int32_t mean, int32_t sigma, int32_t peak, float falseTouchesPerHour);
+  bool  _loadCalibration(int32_t mean[], int32_t sigma[], int32_t peak[]);
+  void  _saveCalibration(int32_t mean[], int32_t sigma[], int32_t peak[]);
+
+  int   _checkSensorRange(int channel);
+  void  _changeSource(SensorSource *source);
+  void  _processSamples();
+  float _proximityPercent(int channel);
+  float _velocityPercent(int channel);
+  void  _calculatePercentPerCount(int channel);
+  void  _getThresholds(int channel, float *touch, float *release);
+  void  _updateTouchStatus(int channel, uint32_t timeMicros);
+  void  _updatePrearm(int channel, float prox, uint32_t timeMicros);
+  void  _pushEvent(int channel, int type, float prox, uint32_t timeMicros);
 
 };
 
@@ -0,0 +1,45 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * The byte stream side of a serial port: whatever has arrived so far,
+ * without waiting. UartSerialPort reads one of the Teensy's hardware
+ * UARTs; on a host, a LoopbackSerialPort (see LinkSensorSource.h) can
+ * stand in for it.
+ *
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef SerialPort_h
+#define SerialPort_h 1
+
+#include <stdint.h>
+
+class SerialPort
+{
+ public:
+  virtual ~SerialPort() {}
+
+  virtual void begin() {}
+  virtual int  read(uint8_t *buffer, int maxBytes) = 0;   // bytes read, 0 if none
+};
+
+#endif
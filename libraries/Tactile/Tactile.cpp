@@ -72,6 +72,11 @@ void Tactile::setInputSource(int channel, InputSource source) {
   } else if (source == audioInput) {
     _useAudioInput[channel] = true;
   }
+  _ts->setInputSource(channel, source);
+}
+
+void Tactile::useMicrophoneInput(bool on) {
+  _ta->useMicrophoneInput(on);
 }
 
 const char *Tactile::getTrackName(int channel) {
@@ -79,8 +84,112 @@ const char *Tactile::getTrackName(int channel) {
   return _ta->getTrackName(channel);
 }
 
+bool Tactile::usePreroll(int milliseconds, int budgetKB, bool lazy) {
+  bool ok = _ta->usePreroll(milliseconds, budgetKB, lazy);
+  if (ok && milliseconds > 0 && !lazy)
+    printPrerollReport();
+  return ok;
+}
+
+void Tactile::printPrerollReport() {
+  int tracks, skipped;
+  uint32_t used, budget;
+  _ta->getPrerollUsage(&tracks, &skipped, &used, &budget);
+  Serial.print("Tactile: pre-roll: ");
+  Serial.print(tracks);
+  Serial.print(" tracks in ");
+  Serial.print(used / 1024);
+  Serial.print(" of ");
+  Serial.print(budget / 1024);
+  Serial.print(" KB, ");
+  Serial.print(skipped);
+  Serial.println(" didn't fit");
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    uint32_t hits, underruns;
+    _ta->getPrerollStats(channel, &hits, &underruns);
+    Serial.print("Tactile: channel ");
+    Serial.print(channel + 1);
+    Serial.print(": started from pre-roll: ");
+    Serial.print(hits);
+    Serial.print(", blocks of silence waiting for the card: ");
+    Serial.println(underruns);
+  }
+}
+
+void Tactile::useSampleCache(int budgetKB, int maxTrackMillis) {
+  _ta->useSampleCache(budgetKB, maxTrackMillis);
+}
+
+void Tactile::printSampleCacheStats() {
+  SampleCache *cache = _ta->getSampleCache();
+  Serial.print("Tactile: sample cache: ");
+  Serial.print(cache->getNumTracks());
+  Serial.print(" tracks in ");
+  Serial.print(cache->getUsedBytes() / 1024);
+  Serial.print(" of ");
+  Serial.print(cache->getBudget() / 1024);
+  Serial.println(" KB");
+  Serial.print("Tactile: sample cache: hits: ");
+  Serial.print(cache->getHits());
+  Serial.print(", misses: ");
+  Serial.print(cache->getMisses());
+  Serial.print(" (");
+  Serial.print(cache->getTooLarge());
+  Serial.print(" too long to cache), hit rate: ");
+  Serial.print(cache->getHitRatePercent());
+  Serial.print("%, evictions: ");
+  Serial.println(cache->getEvictions());
+}
+
+void Tactile::setVoiceStealing(VoiceStealPolicy policy) {
+  _ta->setVoiceStealing(policy);
+}
+
+void Tactile::setVoicePriority(int channel, int priority) {
+  channel = channelExtern2Intern(channel);
+  _ta->setVoicePriority(channel, priority);
+}
+
+void Tactile::setLayering(int channel, bool on) {
+  channel = channelExtern2Intern(channel);
+  _ta->setLayering(channel, on);
+}
+
+void Tactile::setLayering(bool on) {
+  for (int ch = 1; ch <= NUM_CHANNELS; ch++)
+    setLayering(ch, on);
+}
+
+void Tactile::printVoiceStats() {
+  VoicePool *pool = _ta->getVoicePool();
+  Serial.print("Tactile: voices: ");
+  Serial.print(pool->getNumInUse());
+  Serial.print(" of ");
+  Serial.print(pool->getNumVoices());
+  Serial.print(" in use, most at once: ");
+  Serial.print(pool->getPeakInUse());
+  Serial.print(", stolen: ");
+  Serial.print(pool->getSteals());
+  Serial.print(", cut off: ");
+  Serial.println(pool->getCuts());
+}
+
+void Tactile::useLimiter(LimiterMode mode, float thresholdDb) {
+  _ta->useLimiter(mode, thresholdDb);
+}
+
+void Tactile::printLimiterStats() {
+  LimiterMode mode = _ta->getLimiterMode();
+  Serial.print("Tactile: limiter: ");
+  Serial.print(mode == limiterChip ? "SGTL5000" : (mode == limiterCpu ? "CPU" : "off"));
+  Serial.print(", most gain reduction since last time: ");
+  Serial.print(_ta->takeLimiterReduction(), 1);
+  Serial.println(" dB");
+}
+
 void Tactile::setVolume(int channel, int percent) {
   channel = channelExtern2Intern(channel);
+  _volume[channel] = percent;
   _ta->setVolume(channel, percent);
 }
 
@@ -101,6 +210,19 @@ void Tactile::setPlayTrackAction(playTrackActionType playAction) {
     setPlayTrackAction(ch, playAction);
 }
 
+void Tactile::setNoRepeatWindow(int channel, int tracks) {
+  channel = channelExtern2Intern(channel);
+  _ta->setNoRepeatWindow(channel, tracks);
+}
+void Tactile::setNoRepeatWindow(int tracks) {
+  for (int ch = 1; ch <= NUM_CHANNELS; ch++)
+    setNoRepeatWindow(ch, tracks);
+}
+
+void Tactile::rememberTrackOrder(bool on) {
+  _ta->rememberTrackOrder(on);
+}
+
 void Tactile::useRandomTracks(int channel, bool on) {           // obsolete, backwards compatible
   setPlayTrackAction(channel, on ? playRandom : playSingle);
 }
@@ -112,6 +234,7 @@ void Tactile::useRandomTracks(bool on) {                        // obsolete, bac
 void Tactile::useProximityAsVolume(int channel, bool on) {
   channel = channelExtern2Intern(channel);
   _useProximityAsVolume[channel] = on;
+  _updateContinuousControlMask(channel);
   if (on) {
     _ta->setFadeInTime(channel, 0);        // Fade in/out isn't compatible with proximity-as-volume
     _ta->setFadeOutTime(channel, 0);
@@ -123,6 +246,24 @@ void Tactile::useProximityAsVolume(bool on) {
     useProximityAsVolume(ch, on);
 }
 
+// The approach velocity at the moment of touch scales the volume set by
+// setVolume(): fullVelocity (percent per second) or faster gives the full
+// volume, slower approaches get proportionally less, down to a fifth.
+
+void Tactile::useVelocityAsVolume(int channel, bool on, int fullVelocity) {
+  channel = channelExtern2Intern(channel);
+  if (fullVelocity < 1)
+    fullVelocity = 1;
+  _fullVelocityVolume[channel] = on ? fullVelocity : 0;
+  if (!on)
+    _ta->setVolume(channel, _volume[channel]);
+}
+
+void Tactile::useVelocityAsVolume(bool on, int fullVelocity) {
+  for (int ch = 1; ch <= NUM_CHANNELS; ch++)
+    useVelocityAsVolume(ch, on, fullVelocity);
+}
+
 void Tactile::setFadeInTime(int channel, int milliseconds) {
   channel = channelExtern2Intern(channel);
   if (milliseconds > 0 && _useProximityAsVolume[channel]) {
@@ -157,6 +298,16 @@ void Tactile::setFadeOutTime(int milliseconds) {
     setFadeOutTime(ch, milliseconds);
 }
 
+void Tactile::setFadeCurve(int channel, FadeCurve curve) {
+  channel = channelExtern2Intern(channel);
+  _ta->setFadeCurve(channel, curve);
+}
+
+void Tactile::setFadeCurve(FadeCurve curve) {
+  for (int ch = 1; ch <= NUM_CHANNELS; ch++)
+    setFadeCurve(ch, curve);
+}
+
 /*---------- Input sensor controls ----------*/
 
 void Tactile::ignoreSensor(int channel, bool ignore) {
@@ -168,6 +319,10 @@ void Tactile::setMultiTrackMode(bool on) {
   _multiTrack = on;
 }
 
+void Tactile::setCrossfadeTime(int milliseconds) {
+  _ta->setCrossfadeTime(milliseconds);
+}
+
 void Tactile::setTouchReleaseThresholds(int channel, int touch, int release) {
   channel = channelExtern2Intern(channel);
   if (touch > 100)
@@ -188,6 +343,40 @@ void Tactile::setTouchReleaseThresholds(int touch, int release) {
     setTouchReleaseThresholds(ch, touch, release);
 }
 
+void Tactile::setPrearmThreshold(int channel, int percent) {
+  channel = channelExtern2Intern(channel);
+  _ts->setPrearmThreshold(channel, (float)percent);
+}
+
+void Tactile::setPrearmThreshold(int percent) {
+  for (int ch = 1; ch <= NUM_CHANNELS; ch++)
+    setPrearmThreshold(ch, percent);
+}
+
+void Tactile::printPrearmStats() {
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    uint32_t hits, misses;
+    _ta->getPrepareStats(channel, &hits, &misses);
+    Serial.print("Tactile: channel ");
+    Serial.print(channel + 1);
+    Serial.print(": pre-armed tracks played: ");
+    Serial.print(hits);
+    Serial.print(", cancelled: ");
+    Serial.println(misses);
+  }
+  int numOpen;
+  uint32_t recycled;
+  _ta->getPreopenStats(&numOpen, &recycled);
+  Serial.print("Tactile: pre-opened tracks: ");
+  Serial.print(numOpen);
+  Serial.print(" open now, closed to free a voice: ");
+  Serial.println(recycled);
+}
+
+void Tactile::usePreopen(int maxTracks, bool fill) {
+  _ta->usePreopen(maxTracks, fill);
+}
+
 void Tactile::setTouchToStop(int channel, bool on) {
   channel = channelExtern2Intern(channel);
   _touchToStop[channel] = on;
@@ -211,14 +400,14 @@ void Tactile::setContinueTrackMode(bool on) {
     setContinueTrackMode(ch, on);
 }
 
-void Tactile::setLoopMode(int channel, bool on) {
+void Tactile::setLoopMode(int channel, bool on, int crossfadeMsec) {
   channel = channelExtern2Intern(channel);
-  _ta->setLoopMode(channel, on);
+  _ta->setLoopMode(channel, on, crossfadeMsec);
 }
 
-void Tactile::setLoopMode(bool on) {
+void Tactile::setLoopMode(bool on, int crossfadeMsec) {
   for (int ch = 1; ch <= NUM_CHANNELS; ch++)
-    setLoopMode(ch, on);
+    setLoopMode(ch, on, crossfadeMsec);
 }
 
 void Tactile::setInactivityTimeout(int seconds) {
@@ -236,6 +425,75 @@ void Tactile::setAveragingStrength(int samples) {
   _ts->setAveragingStrength(samples);
 }
 
+void Tactile::setAveragingStrength(int channel, int samples, FilterType type) {
+  channel = channelExtern2Intern(channel);
+  _ts->setAveragingStrength(channel, samples, type);
+}
+
+void Tactile::setSensorSampleRate(int samplesPerSecond) {
+  _ts->setSampleRate(samplesPerSecond);
+}
+
+void Tactile::useBaselineTracking(int channel, bool on) {
+  channel = channelExtern2Intern(channel);
+  _ts->setBaselineTracking(channel, on);
+}
+
+void Tactile::useBaselineTracking(bool on) {
+  for (int ch = 1; ch <= NUM_CHANNELS; ch++)
+    useBaselineTracking(ch, on);
+}
+
+bool Tactile::useTouchController(int numChips, int irqPin) {
+  return _ts->useTouchController(numChips, irqPin);
+}
+
+void Tactile::setChannelElectrodes(int channel, uint32_t electrodes) {
+  channel = channelExtern2Intern(channel);
+  _ts->setChannelElectrodes(channel, electrodes);
+}
+
+bool Tactile::useSensorLink(int channel, int serialPort) {
+  channel = channelExtern2Intern(channel);
+  return _ts->useSensorLink(channel, serialPort);
+}
+
+void Tactile::printSensorLinkStats() {
+  _ts->printSensorLinkStats();
+}
+
+bool Tactile::calibrateSensors(float falseTouchesPerHour) {
+  return _ts->calibrate(CALIBRATION_MSEC, falseTouchesPerHour, true);
+}
+
+bool Tactile::recalibrateSensors(float falseTouchesPerHour) {
+  return _ts->calibrate(CALIBRATION_MSEC, falseTouchesPerHour, false);
+}
+
+bool Tactile::calibrateCrosstalk(int holdMsec) {
+  return _ts->calibrateCrosstalk(holdMsec);
+}
+
+bool Tactile::useCrosstalkCorrection(bool on) {
+  return _ts->useCrosstalkCorrection(on);
+}
+
+bool Tactile::startSensorRecording(const char *fileName) {
+  return _ts->startRecording(fileName);
+}
+
+void Tactile::stopSensorRecording() {
+  _ts->stopRecording();
+}
+
+bool Tactile::startSensorReplay(const char *fileName) {
+  return _ts->startReplay(fileName);
+}
+
+void Tactile::stopSensorReplay() {
+  _ts->stopReplay();
+}
+
 /*-------------------- vibration controls --------------------*/
 
 void Tactile::addCustomVibrationEnvelope(VibrationEnvelope &ve) {
@@ -255,7 +513,8 @@ void Tactile::setVibrationFrequency(int channel, int frequency) {
 }
 void Tactile::setVibrationIntensity(int channel, int intensityPercent) {
   channel = channelExtern2Intern(channel);
-  _v->setIntensity(intensityPercent);
+  _vibrationIntensity[channel] = intensityPercent;
+  _v->setIntensity(channel, intensityPercent);
 }
 void Tactile::overrideVibrationEnvelopeDuration(int channel, int msec) {
   channel = channelExtern2Intern(channel);
@@ -272,6 +531,16 @@ void Tactile::useProximityAsIntensity(int channel, bool on) {
     _proximityControlsSpeed[channel] = false;
     _speedMultiplierPercent[channel] = 100;
   }
+  _updateContinuousControlMask(channel);
+}
+
+void Tactile::useVelocityAsIntensity(int channel, bool on, int fullVelocity) {
+  channel = channelExtern2Intern(channel);
+  if (fullVelocity < 1)
+    fullVelocity = 1;
+  _fullVelocityIntensity[channel] = on ? fullVelocity : 0;
+  if (!on)
+    _v->setIntensity(channel, _vibrationIntensity[channel]);
 }
 
 // Vibration speed factor to speedup. sf is the amount to speed up, e.g. 50
@@ -301,6 +570,83 @@ void Tactile::useProximityAsSpeed(int channel, bool on, int multiplierPercent) {
     _speedMultiplierPercent[channel] = 100;
     _proximityControlsSpeed[channel] = false;
   }
+  _updateContinuousControlMask(channel);
+}
+
+/*-------------------- gestures --------------------*/
+
+void Tactile::setGestureAction(int channel, GestureType gesture, GestureAction action) {
+  channel = channelExtern2Intern(channel);
+  if (gesture <= noGesture || gesture >= NUM_GESTURE_TYPES)
+    return;
+  _gestureAction[channel][gesture] = action;
+}
+
+void Tactile::setGestureCallback(GestureCallback callback) {
+  _gestureCallback = callback;
+}
+
+void Tactile::setGestureTimes(int longPressMsec, int doubleTapMsec, int swipeStepMsec) {
+  _gestures.setTimes(longPressMsec, doubleTapMsec, swipeStepMsec);
+}
+
+void Tactile::useGesturesOnly(int channel, bool on) {
+  channel = channelExtern2Intern(channel);
+  _gesturesOnly[channel] = on;
+}
+
+/*-------------------- latency measurement --------------------*/
+
+bool Tactile::getLatencyStats(int channel, LatencyStage stage, LatencyStats *stats) {
+#ifdef TACTILE_LATENCY_PROBE
+  channel = channelExtern2Intern(channel);
+  LatencyProbe::getStats(channel, stage, stats);
+  return true;
+#else
+  stats->count = 0;
+  stats->minMicros = stats->p50Micros = stats->p99Micros = stats->maxMicros = 0;
+  return false;
+#endif
+}
+
+// Times are in microseconds, from the sensor sample that crossed the
+// touch threshold.
+
+void Tactile::printLatencyReport() {
+#ifdef TACTILE_LATENCY_PROBE
+  static const char *stageNames[NUM_LATENCY_STAGES] = {"play", "audio", "vibration"};
+  Serial.println("Latency (usec): channel stage count min/p50/p99/max");
+  for (int c = 1; c <= NUM_CHANNELS; c++) {
+    for (int stage = 0; stage < NUM_LATENCY_STAGES; stage++) {
+      LatencyStats stats;
+      getLatencyStats(c, (LatencyStage)stage, &stats);
+      if (stats.count == 0)
+        continue;
+      Serial.print("  ");
+      Serial.print(c);
+      Serial.print(" ");
+      Serial.print(stageNames[stage]);
+      Serial.print(" ");
+      Serial.print(stats.count);
+      Serial.print(" ");
+      Serial.print(stats.minMicros);
+      Serial.print("/");
+      Serial.print(stats.p50Micros);
+      Serial.print("/");
+      Serial.print(stats.p99Micros);
+      Serial.print("/");
+      Serial.println(stats.maxMicros);
+    }
+  }
+#else
+  Serial.println("Latency: not measured (TACTILE_LATENCY_PROBE isn't defined)");
+#endif
+}
+
+void Tactile::resetLatencyStats() {
+#ifdef TACTILE_LATENCY_PROBE
+  LatencyProbe::reset();
+#endif
 }
 
 /*-------------------- main functions --------------------*/
@@ -308,16 +654,33 @@ void Tactile::useProximityAsSpeed(int channel, bool on, int multiplierPercent) {
 Tactile* Tactile::setup() {
 
   Tactile *t = new(Tactile);
-
-  for (int c = 1; c <= NUM_CHANNELS; c++) {
-    t->setInputSource(c, touchInput);
-    t->setOutputDestination(c, audioOutput, vibrationOutput);
+  t->_touchedMask = 0;
+  t->_handOffFrom = -1;
+  t->_preopenNext = 0;
+  t->_continuousControlMask = 0;
+  t->_gestureCallback = NULL;
+  for (int c = 0; c < NUM_CHANNELS; c++) {
+    t->_gesturesOnly[c] = false;
+    for (int g = 0; g < NUM_GESTURE_TYPES; g++)
+      t->_gestureAction[c][g] = noAction;
   }
 
   t->_tu = TeensyUtils::setup();
+
+  // Generate a "random" seed for the random() function. See
+  // Sensors.h for the definition of the unused analog pin. This
+  // has to happen before the Sensors module takes over the ADCs.
+  randomSeed(analogRead(UNUSED_ANALOG_INPUT));
+
   t->_ts = Sensors::setup(t->_tu);
   t->_ta = AudioPlayer::setup(t->_tu);
   t->_v  = Vibrate::setup(t->_tu);
+  t->_ts->setAudioEnvelopes(t->_ta->getInputEnvelope(0), t->_ta->getInputEnvelope(1));
+
+  for (int c = 1; c <= NUM_CHANNELS; c++) {
+    t->setInputSource(c, touchInput);
+    t->setOutputDestination(c, audioOutput, vibrationOutput);
+  }
   
   // Audio initialization
   for (int c = 1; c <= NUM_CHANNELS; c++) {
@@ -328,11 +691,17 @@ Tactile* Tactile::setup() {
   }
   t->setInactivityTimeout(0);
   t->setMultiTrackMode(false);
+  for (int c = 1; c <= NUM_CHANNELS; c++) {
+    t->setVolume(c, 100);
+    t->useVelocityAsVolume(c, false);
+  }
 
   // Vibration initialization
   for (int c = 1; c <= NUM_CHANNELS; c++) {
     t->useProximityAsSpeed(c, false, 100);
     t->useProximityAsIntensity(c, false);
+    t->setVibrationIntensity(c, 100);
+    t->useVelocityAsIntensity(c, false);
   }
 
   // Bookkeeping
@@ -340,11 +709,8 @@ Tactile* Tactile::setup() {
   t->_lastActionTime = millis();
   for (int c = 0; c < NUM_CHANNELS; c++) {
     t->_isPlaying[c] = false;
+    t->_touchVelocity[c] = 0.0;
   }
-  
-  // Generate a "random" seed for the random() function. See
-  // Sensors.h for the definition of the unused analog pin.
-  randomSeed(analogRead(UNUSED_ANALOG_INPUT));
 
   return t;
 }
@@ -352,6 +718,11 @@ Tactile* Tactile::setup() {
 /*----------------------------------------------------------------------
  * TOUCH-MODE LOOP
  *
+ * The Sensors module publishes a queue of touch and release events. The
+ * loop only has to do work when there's an event, or for channels where
+ * proximity continuously controls something (volume, vibration speed or
+ * intensity); those are kept in _continuousControlMask.
+ *
  * MULTI-TRACK MODE. Simple: if a sensor is touched, start playing the
  * track; if it's released, stop playing. Multiple tracks can go at
  * the same time.
@@ -367,139 +738,270 @@ Tactile* Tactile::setup() {
  *     is released, select the lowest, and consider it a "new touch",
  *     that is, start that track.
  ----------------------------------------------------------------------*/
-    
-void Tactile::_touchLoop() {
-  float proximityValues[NUM_CHANNELS];
-  int sensorStatus[NUM_CHANNELS];
-  int sensorChanged[NUM_CHANNELS];
 
-  int numChanged = _ts->getTouchStatus(proximityValues, sensorStatus, sensorChanged);
+void Tactile::_stopChannel(int channel) {
 
-  int numTouched = 0;
-  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
-    if (sensorStatus[channel] == IS_TOUCHED)
-      numTouched++;
+  _tu->logAction2("stop: continueTrack = ", _continueTrack[channel]);
+
+  // Stop audio (unless it's to fade out under the next track)
+  if (_useAudioOutput[channel] && _handOffFrom != channel) {
+    if (_isPlaying[channel]) {
+      if (_continueTrack[channel]) {
+        _tu->logAction("pause audio ", channel+1);
+        _ta->pauseTrack(channel);
+      } else {
+        _tu->logAction("stop audio ", channel+1);
+        _ta->stopTrack(channel);
+      }
+    }
   }
-  if (numTouched > 0 || numChanged > 0)
-    _lastActionTime = millis();
 
-  if (numTouched > 0)
-    _tu->turnLedOn();
-  else
-    _tu->turnLedOff();
+  // Stop vibration
+  if (_useVibrationOutput[channel]) {
+    _tu->logAction("stop vibrator ", channel+1);
+    _v->stop(channel);
+  }
+
+  _isPlaying[channel] = false;
+}
+
+// Scale percent by how fast the sensor was approached; a slow approach
+// still gets a fifth, so that it's never silent.
+
+int Tactile::_velocityScaled(int channel, int percent, int fullVelocity) {
+  float factor = _touchVelocity[channel] / (float)fullVelocity;
+  if (factor > 1.0)
+    factor = 1.0;
+  else if (factor < 0.2)
+    factor = 0.2;
+  return (int)(0.5 + factor * (float)percent);
+}
 
-  if (numChanged > 0) {
+void Tactile::_startChannel(int channel, bool nextTrack) {
+
+  // Start or resume audio
+  if (_useAudioOutput[channel]) {
+    if (_fullVelocityVolume[channel] && !_useProximityAsVolume[channel])
+      _ta->setVolume(channel, _velocityScaled(channel, _volume[channel], _fullVelocityVolume[channel]));
+    if (_continueTrack[channel]) {
+      if (_ta->isPaused(channel) && !nextTrack) {
+        _tu->logAction("resume audio track ", channel+1);
+        _ta->resumeTrack(channel);
+      } else {
+        _tu->logAction("restart audio track ", channel+1);
+        _ta->startTrack(channel);
+      }
+    } else {
+      if (!_isPlaying[channel] && _handOffFrom >= 0) {
+        _tu->logAction("crossfade to audio track ", channel+1);
+        _ta->crossfade(_handOffFrom, channel);
+        _handOffFrom = -1;
+      } else if (!_isPlaying[channel]) {
+        _tu->logAction("start audio track ", channel+1);
+        _ta->cancelFades(channel);
+        _ta->startTrack(channel);
+      }
+    }
+  }
+  _tu->logAction2("start: continueTrack = ", _continueTrack[channel]);
 
-    // Process releases first (makes bookkeeping easier for single-track mode).
-    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+  // Start vibration. This is much simpler.
+  if (_useVibrationOutput[channel]) {
+    if (_fullVelocityIntensity[channel] && !_proximityControlsIntensity[channel]) {
+      int intensity = _velocityScaled(channel, _vibrationIntensity[channel], _fullVelocityIntensity[channel]);
+      _v->setIntensity(channel, intensity);
+    }
+    _tu->logAction("start vibrator ", channel+1);
+    _v->start(channel);
+  }
 
-      if (sensorChanged[channel] == NEW_RELEASE) {
+  _isPlaying[channel] = true;
+}
 
-        _tu->logAction2("stop: continueTrack = ", _continueTrack[channel]);
+// A track can be got ready ahead of a touch if a touch would start it.
 
-        // Stop audio
-        if (_useAudioOutput[channel]) {
-          if (_isPlaying[channel]) {
-            if (_continueTrack[channel]) {
-              _tu->logAction("pause audio ", channel+1);
-              _ta->pauseTrack(channel);
-            } else {
-              _tu->logAction("stop audio ", channel+1);
-              _ta->stopTrack(channel);
-            }
-          }
-        }
+bool Tactile::_canPrepare(int channel) {
+  return _useAudioOutput[channel] && !_gesturesOnly[channel]
+         && (_multiTrack || _nothingIsPlaying() || _ta->getCrossfadeTime() > 0);
+}
 
-        // Stop vibration
-        if (_useVibrationOutput[channel]) {
-          _tu->logAction("stop vibrator ", channel+1);
-          _v->stop(channel);
-        }
+// One channel per pass through the loop: opening a track takes a few
+// msec of card time. (AudioPlayer::preopenTrack() does nothing if the
+// channel isn't idle, has its track open already, or pre-open is off.)
 
-        _isPlaying[channel] = false;
-      }
+void Tactile::_preopenTracks() {
+  int channel = _preopenNext;
+  _preopenNext = (_preopenNext + 1) % NUM_CHANNELS;
+  if (!_isPlaying[channel] && _canPrepare(channel))
+    _ta->preopenTrack(channel);
+}
+
+bool Tactile::_nothingIsPlaying() {
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    if (_isPlaying[channel])
+      return false;
+  }
+  return true;
+}
+
+// Single-track mode with a crossfade time: when the playing channel is
+// released while another sensor is touched, its track isn't stopped but
+// handed off, fading out as the next one fades in (see _startChannel()).
+
+bool Tactile::_canHandOff(int channel) {
+  return !_multiTrack && _ta->getCrossfadeTime() > 0
+    && _isPlaying[channel] && _useAudioOutput[channel] && !_continueTrack[channel]
+    && (_touchedMask & ~(1 << channel)) != 0;
+}
+
+void Tactile::_updateContinuousControlMask(int channel) {
+  if (_useProximityAsVolume[channel] || _proximityControlsSpeed[channel] || _proximityControlsIntensity[channel])
+    _continuousControlMask |= (1 << channel);
+  else
+    _continuousControlMask &= ~(1 << channel);
+}
+
+void Tactile::_touchLoop() {
+
+  _ts->update();
+
+  bool changed = false;
+  TouchEvent event;
+  while (_ts->getTouchEvent(&event)) {
+    int channel = event.channel;
+
+    // Pre-arm: get the track ready in case this turns into a touch.
+    // A hand coming near counts as activity, so the inactivity timeout
+    // doesn't reset the channels under it.
+    if (event.type == NEW_PREARM) {
+      _lastActionTime = millis();
+      if (_canPrepare(channel))
+        _ta->prepareTrack(channel);
+      continue;
+    }
+    if (event.type == NEW_DISARM) {
+      _ta->cancelPreparedTrack(channel);
+      continue;
     }
 
-    // Now that we've processed releases, are there any still playing?
-    // Need to know this for single-track mode.
-    bool nothingIsPlaying = true;
-    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
-      if (_isPlaying[channel])
-        nothingIsPlaying = false;
+    changed = true;
+    _tu->logAction2("touch event, usec since threshold crossed: ", micros() - event.timeMicros);
+
+    if (event.type == NEW_RELEASE) {
+      _touchedMask &= ~(1 << channel);
+      _gestures.release(channel, event.timeMicros);
+      if (!_gesturesOnly[channel]) {
+        if (_canHandOff(channel))
+          _handOffFrom = channel;
+        _stopChannel(channel);
+      }
+    } else {
+      _touchedMask |= (1 << channel);
+      _touchVelocity[channel] = event.velocity;
+      _gestures.touch(channel, event.timeMicros);
+      // In single-track mode, a touch is ignored while another track is playing.
+      if (!_gesturesOnly[channel] && (_multiTrack || _nothingIsPlaying()))
+        _startChannel(channel);
     }
+  }
+  _gestures.update(micros());
+  _gestureLoop();
 
-    // Process new touches
-    if (_multiTrack | nothingIsPlaying) {
+  if (changed) {
 
+    // Single-track mode: if the playing track was released while another
+    // sensor is still being touched, the lowest such sensor takes over.
+    if (!_multiTrack && _touchedMask != 0 && _nothingIsPlaying()) {
       for (int channel = 0; channel < NUM_CHANNELS; channel++) {
-
-        // For multi-track, a "Touch" is simply a new touch.
-        // For single-track, it can also include an existing touch if the
-        // track isn't playing (i.e. the new touch came while another track
-        // was playing).
-        if (sensorChanged[channel] == NEW_TOUCH
-            || (!_multiTrack && ((sensorStatus[channel] == IS_TOUCHED) && !_isPlaying[channel]))) {
-
-          // Start or resume audio
-          if (_useAudioOutput[channel]) {
-            if (_continueTrack[channel]) {
-              if (_ta->isPaused(channel)) {
-                _tu->logAction("resume audio track ", channel+1);
-                _ta->resumeTrack(channel);
-              } else {
-                _tu->logAction("restart audio track ", channel+1);
-                _ta->startTrack(channel);
-              }
-            } else {
-              if (!_isPlaying[channel]) {
-                _tu->logAction("start audio track ", channel+1);
-                _ta->cancelFades(channel);
-                _ta->startTrack(channel);
-              }
-            }
-          }
-          _tu->logAction2("start: continueTrack = ", _continueTrack[channel]);
-
-
-          // Start vibration. This is much simpler.
-          if (_useVibrationOutput[channel]) {
-            _tu->logAction("start vibrator ", channel+1);
-            _v->start(channel);
-          }
-
-          _isPlaying[channel] = true;
-
-          // If single-track mode, stop at the first NEW_TOUCH
-          if (!_multiTrack)
-            break;
+        if ((_touchedMask & (1 << channel)) && !_isPlaying[channel] && !_gesturesOnly[channel]) {
+          _startChannel(channel);
+          break;
         }
       }
     }
 
-  }     // end of "if (numChanges > 0)"
+    // A hand-off that no channel took up (none could start): just stop.
+    if (_handOffFrom >= 0) {
+      _ta->stopTrack(_handOffFrom);
+      _handOffFrom = -1;
+    }
 
-  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    if (_touchedMask != 0)
+      _tu->turnLedOn();
+    else
+      _tu->turnLedOff();
+  }
+
+  if (_touchedMask != 0 || changed)
+    _lastActionTime = millis();
+
+  // Only channels where proximity controls an output need the proximity value.
+  uint32_t mask = _continuousControlMask;
+  for (int channel = 0; mask != 0; channel++, mask >>= 1) {
+    if (!(mask & 1))
+      continue;
+
+    float proximity = _ts->getProximityPercent(channel);
 
     // Proximity-as-volume for audio
     if (_isPlaying[channel] && _useAudioOutput[channel] && _useProximityAsVolume[channel]) {
-      _ta->setVolume(channel, proximityValues[channel]);
+      _ta->setVolume(channel, proximity);
     }
 
     if (_v->isPlaying(channel) && _useVibrationOutput[channel]) {
       // Proximity-as-speed for vibration: adjust speed
       if (_proximityControlsSpeed[channel]) {
-        int multiplier = (int)(0.499 + (float)_speedMultiplierPercent[channel]/100.0 * proximityValues[channel]);
+        int multiplier = (int)(0.499 + (float)_speedMultiplierPercent[channel]/100.0 * proximity);
         _v->setSpeedMultiplier(channel, multiplier);
       }
       // Proximity-as-intensity for vibration: adjust intensity
       else if (_proximityControlsIntensity[channel]) {
-        _v->setIntensity(channel, proximityValues[channel]);
+        _v->setIntensity(channel, proximity);
       }
     }
   }
-
 }
     
+// Gesture actions happen in addition to the normal touch/release
+// behavior, unless useGesturesOnly() is set for the channel.
+
+void Tactile::_gestureLoop() {
+  GestureEvent gesture;
+  while (_gestures.getGesture(&gesture)) {
+    int channel = gesture.channel;
+    _tu->logAction2("gesture: ", gesture.type);
+    switch (_gestureAction[channel][gesture.type]) {
+    case nextTrackAction:
+      // Like a touch: in single-track mode it's ignored while another
+      // channel is playing.
+      if (_isPlaying[channel]) {
+        if (_useAudioOutput[channel]) {
+          _tu->logAction("next audio track ", channel+1);
+          _ta->cancelFades(channel);
+          _ta->startTrack(channel);
+        }
+      } else if (_multiTrack || _nothingIsPlaying()) {
+        _startChannel(channel, true);
+      }
+      break;
+    case stopTrackAction:
+      _stopChannel(channel);
+      break;
+    case vibrateAction:
+      if (_useVibrationOutput[channel]) {
+        _tu->logAction("start vibrator ", channel+1);
+        _v->start(channel);
+      }
+      break;
+    default:
+      break;
+    }
+    if (_gestureCallback)
+      _gestureCallback(channel + 1, gesture.type);
+    _lastActionTime = millis();
+  }
+}
+
 void Tactile::loop() {
 
   // Respond to sensor touch/proximity
@@ -507,6 +1009,9 @@ void Tactile::loop() {
 
   // Do fade-in/out
   _ta->doTimerTasks();
+
+  // Get idle channels' next tracks ready
+  _preopenTracks();
   
   // Do vibrator tasks
   _v->doTimerTasks();
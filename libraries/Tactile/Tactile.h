@@ -26,6 +26,11 @@
 #include "Sensors.h"
 #include "AudioPlayer.h"
 #include "Vibrate.h"
+#include "LatencyProbe.h"
+#include "GestureRecognizer.h"
+
+// Called when a gesture is recognized; channel is 1..NUM_CHANNELS.
+typedef void (*GestureCallback)(int channel, GestureType gesture);
 
 #define TOUCH_MODE 1
 #define PROXIMITY_MODE 2
@@ -41,6 +46,7 @@ class Tactile
 
   // Input source: touchInput or audioInput (mutually exclusive)
   void setInputSource(int channel, InputSource iSource);
+  void useMicrophoneInput(bool on);          // audioInput from the mic rather than line-in
 
   // Output destination: audio or vibration. Can be both.
   void setOutputDestination(int channel, OutputDest dest1, OutputDest dest2 = noOutput);
@@ -51,28 +57,67 @@ class Tactile
 
   /*---------- These are forwarded to the Sensors class ----------*/
   void setMultiTrackMode(bool on);             // true == enable multiple simultaneous tracks
+  void setCrossfadeTime(int milliseconds);      // single-track mode: released track fades into the next
   void ignoreSensor(int channel, bool ignore);
   void setTouchReleaseThresholds(int touch, int release);
   void setTouchReleaseThresholds(int channel, int touch, int release);
+  void setPrearmThreshold(int channel, int percent);   // track is made ready at this proximity, 0 == off
+  void setPrearmThreshold(int percent);
+  void printPrearmStats();
+  void usePreopen(int maxTracks, bool fill = true);    // idle channels keep their next track open
   void setTouchToStop(int channel, bool on);            // true == touch-on-touch-off (normally touch-on-release-off)
   void setTouchToStop(bool on);
   void setAveragingStrength(int samples);             // more smooths signal, default is 200
+  void setAveragingStrength(int channel, int samples, FilterType type);
+  void setSensorSampleRate(int samplesPerSecond);     // default is 2000
+  void useBaselineTracking(int channel, bool on);     // thresholds relative to the drifting idle level
+  void useBaselineTracking(bool on);
+  bool useTouchController(int numChips, int irqPin);  // MPR121 on I2C instead of the analog sensors
+  void setChannelElectrodes(int channel, uint32_t electrodes);  // bit mask of the controller's electrodes
+  bool useSensorLink(int channel, int serialPort);    // sensor board's reading over Serial1..8 (0 == analog)
+  void printSensorLinkStats();
+  bool calibrateSensors(float falseTouchesPerHour = 0.1);    // uses the saved calibration if there is one
+  bool recalibrateSensors(float falseTouchesPerHour = 0.1);  // always measures (and saves)
+  bool calibrateCrosstalk(int holdMsec = 3000);     // guided: touch each sensor when asked (and saves)
+  bool useCrosstalkCorrection(bool on);             // with the saved cross-talk calibration
+  bool startSensorRecording(const char *fileName);  // raw sensor data to the SD card
+  void stopSensorRecording();
+  bool startSensorReplay(const char *fileName);     // recorded data in place of the sensors
+  void stopSensorReplay();
 
   /*---------- These are forwarded to the AudioPlayer module ----------*/
   void setVolume(int channel, int percent);
   void setVolume(int percent);
   void useProximityAsVolume(int channel, bool on);    // Proximity controls volume, or fixed volume
   void useProximityAsVolume(bool on);
+  void useVelocityAsVolume(int channel, bool on, int fullVelocity = 1000);     // percent per second
+  void useVelocityAsVolume(bool on, int fullVelocity = 1000);
   void setProximityMultiplier(int channel, float m);  // 1.0 is no amplification, more increases sensitivity
   void setFadeInTime(int channel, int milliseconds);
   void setFadeInTime(int milliseconds);
   void setFadeOutTime(int channel, int milliseconds);
   void setFadeOutTime(int milliseconds);
-  void setLoopMode(int channel, bool on);             // true == track restarts (loops) when end reached
-  void setLoopMode(bool on);
+  void setFadeCurve(int channel, FadeCurve curve);    // fadeLinear, fadeEqualPower, fadeExponential
+  void setFadeCurve(FadeCurve curve);
+  void setLoopMode(int channel, bool on, int crossfadeMsec = 0);   // true == track loops, with no gap
+  void setLoopMode(bool on, int crossfadeMsec = 0);
   void setPlayTrackAction(int channel, playTrackActionType playAction);
   void setPlayTrackAction(playTrackActionType playAction);
+  void setNoRepeatWindow(int channel, int tracks);    // playRandom: not one of the last few again
+  void setNoRepeatWindow(int tracks);
+  void rememberTrackOrder(bool on);                   // shuffles carry on after a restart
   const char *getTrackName(int channel);
+  bool usePreroll(int milliseconds, int budgetKB = 0, bool lazy = false);   // needs PSRAM
+  void printPrerollReport();
+  void useSampleCache(int budgetKB, int maxTrackMillis = 3000);   // short tracks played from memory
+  void printSampleCacheStats();
+  void setVoiceStealing(VoiceStealPolicy policy);     // stealOldest, stealQuietest, stealLowestPriority
+  void setVoicePriority(int channel, int priority);   // higher is stolen last
+  void setLayering(int channel, bool on);             // restarted track plays on under the new one
+  void setLayering(bool on);
+  void printVoiceStats();
+  void useLimiter(LimiterMode mode, float thresholdDb = LIMITER_THRESHOLD_DB);   // limiterAuto, limiterChip, limiterCpu, limiterOff
+  void printLimiterStats();
 
   // renamed -- use #define so that Tactile v1 sketches will work
 #define setProximityAsVolumeMode useProximityAsVolume
@@ -90,10 +135,22 @@ class Tactile
   void setVibrationEnvelopeFile(int channel, const char *fileName);
   void useProximityAsIntensity(int channel, bool on);
   void useProximityAsSpeed(int channel, bool on, int multiplierPercent);
+  void useVelocityAsIntensity(int channel, bool on, int fullVelocity = 1000);  // percent per second
   void overrideVibrationEnvelopeDuration(int channel, int msec);
   void overrideVibrationEnvelopeRepeats(int channel, bool repeat);
   void setVibrationFrequency(int channel, int frequency);
 
+  /*---------- Gestures (see GestureRecognizer.h) ----------*/
+  void setGestureAction(int channel, GestureType gesture, GestureAction action);
+  void setGestureCallback(GestureCallback callback);
+  void setGestureTimes(int longPressMsec, int doubleTapMsec, int swipeStepMsec);
+  void useGesturesOnly(int channel, bool on);         // touch/release alone don't start/stop anything
+
+  /*---------- Latency measurement (needs TACTILE_LATENCY_PROBE, see LatencyProbe.h) ----------*/
+  bool getLatencyStats(int channel, LatencyStage stage, LatencyStats *stats);
+  void printLatencyReport();
+  void resetLatencyStats();
+
  private:
   TeensyUtils      *_tu;
   Sensors          *_ts;
@@ -114,16 +171,38 @@ class Tactile
   bool     _proximityControlsIntensity[NUM_CHANNELS];
   bool     _proximityControlsSpeed[NUM_CHANNELS];
   int      _speedMultiplierPercent[NUM_CHANNELS];
+  int      _volume[NUM_CHANNELS];
+  int      _vibrationIntensity[NUM_CHANNELS];
+  int      _fullVelocityVolume[NUM_CHANNELS];     // 0 == velocity doesn't control volume
+  int      _fullVelocityIntensity[NUM_CHANNELS];  // 0 == velocity doesn't control intensity
   bool     _multiTrack;
   playTrackActionType _playAction[NUM_CHANNELS];
+  GestureAction _gestureAction[NUM_CHANNELS][NUM_GESTURE_TYPES];
+  GestureCallback _gestureCallback;
+  bool     _gesturesOnly[NUM_CHANNELS];
 
   // Bookkeeping while playing
   bool     _isPlaying[NUM_CHANNELS];
+  float    _touchVelocity[NUM_CHANNELS];  // from the last NEW_TOUCH event
+  uint32_t _touchedMask;               // bit per channel
+  int      _handOffFrom;               // released, to crossfade into the next track started (-1 == none)
+  int      _preopenNext;               // channel whose turn it is (see _preopenTracks())
+  uint32_t _continuousControlMask;     // channels where proximity controls volume/speed/intensity
   uint32_t _restartTimeout;
   uint32_t _lastActionTime;
   int      _ledCycle;
+  GestureRecognizer _gestures;
   
   void _touchLoop();
+  void _gestureLoop();
+  void _startChannel(int channel, bool nextTrack = false);    // nextTrack: never resume a paused one
+  int  _velocityScaled(int channel, int percent, int fullVelocity);
+  void _stopChannel(int channel);
+  bool _nothingIsPlaying();
+  bool _canHandOff(int channel);
+  bool _canPrepare(int channel);
+  void _preopenTracks();
+  void _updateContinuousControlMask(int channel);
   void _proximityLoop();
   void _doVolumeFadeInAndOut();
   void _startTrackIfStartDelayReached();
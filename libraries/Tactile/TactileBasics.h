@@ -27,6 +27,16 @@
 
 #define NUM_CHANNELS 4
 
+// Number of audio players ("voices") shared by the channels. A channel
+// can have more than one sounding at a time (a retriggered track fading
+// out under the new one, or layered sounds). A multiple of 4, up to 16;
+// each voice costs two audio blocks, and its share of the CPU and of the
+// SD card's bandwidth while it plays (see sketches/test/test_voice_count).
+
+#ifndef NUM_VOICES
+#define NUM_VOICES 8
+#endif
+
 // Where does the input come from?
 
 enum InputSource { noInput, touchInput, audioInput };
@@ -54,4 +64,33 @@ enum VibratorType { motorVibrator, linearVibrator };
 
 enum playTrackActionType {playSingle, playRandom, playShuffled, playReshuffled};
 
+// How are the raw sensor readings smoothed? (See ProximityFilter.h)
+//  emaFilter          -- exponential moving average (the classic)
+//  cascadedEmaFilter  -- two EMAs in a row; less noise for the same delay
+//  medianFilter       -- sliding median; ignores spikes, keeps sharp edges
+//  oneEuroFilter      -- heavy smoothing when still, light when moving
+
+enum FilterType { emaFilter, cascadedEmaFilter, medianFilter, oneEuroFilter };
+
+// Gestures (see GestureRecognizer.h), and what Tactile can do when one
+// is recognized. A swipe "up" goes toward higher channel numbers.
+
+enum GestureType { noGesture, tapGesture, doubleTapGesture, longPressGesture,
+                   swipeUpGesture, swipeDownGesture };
+#define NUM_GESTURE_TYPES 6
+
+enum GestureAction { noAction, nextTrackAction, stopTrackAction, vibrateAction };
+
+// Uncomment to measure the touch-to-output latency (see LatencyProbe.h and
+// Tactile::printLatencyReport()). When it's commented out, the
+// measurements aren't compiled at all.
+
+// #define TACTILE_LATENCY_PROBE
+
+// Keeps the compiler from moving memory accesses across this point. Used
+// where an interrupt handler and the main loop share a buffer (the Teensy
+// has a single core, so a compiler barrier is all that's needed).
+
+#define COMPILER_BARRIER() __atomic_signal_fence(__ATOMIC_SEQ_CST)
+
 #endif
@@ -0,0 +1,64 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include "TouchEventQueue.h"
+
+TouchEventQueue::TouchEventQueue() {
+  _head = 0;
+  _tail = 0;
+  _dropCount = 0;
+}
+
+bool TouchEventQueue::push(const TouchEvent &event) {
+  uint32_t head = _head;
+  if (head - _tail >= TOUCH_EVENT_QUEUE_SIZE) {
+    _dropCount++;
+    return false;
+  }
+  _events[head & (TOUCH_EVENT_QUEUE_SIZE - 1)] = event;
+  COMPILER_BARRIER();
+  _head = head + 1;
+  return true;
+}
+
+bool TouchEventQueue::pop(TouchEvent *event) {
+  uint32_t tail = _tail;
+  if (tail == _head)
+    return false;
+  COMPILER_BARRIER();
+  *event = _events[tail & (TOUCH_EVENT_QUEUE_SIZE - 1)];
+  COMPILER_BARRIER();
+  _tail = tail + 1;
+  return true;
+}
+
+int TouchEventQueue::available() {
+  return (int)(_head - _tail);
+}
+
+// Consumer side only.
+void TouchEventQueue::clear() {
+  _tail = _head;
+}
+
+uint32_t TouchEventQueue::getDropCount() {
+  return _dropCount;
+}
@@ -0,0 +1,73 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * A fixed-size queue of touch events, passed from the Sensors class to
+ * whoever is listening (normally the Tactile class). Each event says
+ * which channel was touched or released, exactly when (in microseconds,
+ * the time of the sensor sample that crossed the threshold, not when
+ * the loop got around to noticing), and the proximity at that moment.
+ *
+ * The queue is single-producer, single-consumer and lock-free: push()
+ * only writes _head, pop() only writes _tail. So the producer and the
+ * consumer can safely be in different contexts (e.g. an interrupt
+ * handler and the main loop). If the queue is full, new events are
+ * dropped and counted.
+ *
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef TouchEventQueue_h
+#define TouchEventQueue_h 1
+
+#include <stdint.h>
+#include "TactileBasics.h"
+
+// Must be a power of two
+#define TOUCH_EVENT_QUEUE_SIZE 32
+
+struct TouchEvent {
+  uint32_t timeMicros;    // when the threshold was crossed
+  int      channel;       // 0..NUM_CHANNELS-1
+  int      type;          // NEW_TOUCH, NEW_RELEASE, NEW_PREARM or NEW_DISARM (see Sensors.h)
+  float    proximity;     // percent, at timeMicros
+  float    velocity;      // NEW_TOUCH: how fast it approached, percent per second
+};
+
+class TouchEventQueue
+{
+ public:
+  TouchEventQueue();
+
+  bool     push(const TouchEvent &event);
+  bool     pop(TouchEvent *event);
+  int      available();
+  void     clear();
+  uint32_t getDropCount();
+
+ private:
+  TouchEvent        _events[TOUCH_EVENT_QUEUE_SIZE];
+  volatile uint32_t _head;
+  volatile uint32_t _tail;
+  volatile uint32_t _dropCount;
+};
+
+#endif
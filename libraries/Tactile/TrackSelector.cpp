@@ -0,0 +1,345 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "TrackSelector.h"
+
+TrackSelector::TrackSelector() {
+  _rng = 2463534242u;                      // Marsaglia's; see setSeed()
+  _noRepeat = 1;
+  setTracks(0);
+}
+
+void TrackSelector::setTracks(int numTracks) {
+  if (numTracks < 0)
+    numTracks = 0;
+  else if (numTracks > TRACK_SELECTOR_MAX_TRACKS)
+    numTracks = TRACK_SELECTOR_MAX_TRACKS;
+  _numTracks = numTracks;
+  for (int i = 0; i < numTracks; i++)
+    _order[i] = i;
+  _position = 0;
+  _shuffled = false;
+  _historyHead = 0;
+  _historyCount = 0;
+  _weighted = false;
+  _totalWeight = 0;
+  _rebuildWindow();
+}
+
+int TrackSelector::getNumTracks() {
+  return _numTracks;
+}
+
+void TrackSelector::setSeed(uint32_t seed) {
+  _rng = seed ? seed : 1;                  // xorshift never leaves 0
+}
+
+void TrackSelector::mixSeed(uint32_t entropy) {
+  setSeed(_rng ^ entropy);
+}
+
+void TrackSelector::setNoRepeat(int tracks) {
+  _noRepeat = tracks < 0 ? 0 : tracks;
+  _rebuildWindow();
+}
+
+// Vose's construction of the alias table, in integers: each weight is
+// scaled by numTracks so that a full column is exactly the total weight.
+// A short column is topped up from a tall one, which then counts as
+// short or tall by what it has left.
+
+bool TrackSelector::setWeights(const uint16_t *weights) {
+  _weighted = false;
+  if (weights && _numTracks > 1) {
+    uint32_t total = 0;
+    bool same = true;
+    for (int i = 0; i < _numTracks; i++) {
+      total += weights[i];
+      if (weights[i] != weights[0])
+        same = false;
+    }
+    if (total == 0) {
+      _rebuildWindow();
+      return false;
+    }
+    if (!same) {
+      uint32_t scaled[TRACK_SELECTOR_MAX_TRACKS];
+      uint8_t small[TRACK_SELECTOR_MAX_TRACKS], large[TRACK_SELECTOR_MAX_TRACKS];
+      int numSmall = 0, numLarge = 0;
+      for (int i = 0; i < _numTracks; i++) {
+        scaled[i] = (uint32_t)weights[i] * _numTracks;
+        if (scaled[i] < total)
+          small[numSmall++] = i;
+        else
+          large[numLarge++] = i;
+      }
+      while (numSmall > 0 && numLarge > 0) {
+        int s = small[--numSmall];
+        int l = large[--numLarge];
+        _threshold[s] = scaled[s];
+        _alias[s] = l;
+        scaled[l] -= total - scaled[s];
+        if (scaled[l] < total)
+          small[numSmall++] = l;
+        else
+          large[numLarge++] = l;
+      }
+      while (numLarge > 0) {
+        int l = large[--numLarge];
+        _threshold[l] = total;
+        _alias[l] = l;
+      }
+      while (numSmall > 0) {                // only from rounding, which integers don't have
+        int s = small[--numSmall];
+        _threshold[s] = total;
+        _alias[s] = s;
+      }
+      _totalWeight = total;
+      _weighted = true;
+    }
+  }
+  _rebuildWindow();
+  return true;
+}
+
+/*----------------------------------------------------------------------
+ * Choosing
+ ----------------------------------------------------------------------*/
+
+// One step of the Fisher-Yates shuffle: a random one of the tracks not
+// yet played this pass is swapped into the next place. After the first
+// pass the order is complete, and without reshuffle it's simply played
+// again.
+
+int TrackSelector::nextShuffled(bool reshuffle) {
+  if (_numTracks == 0)
+    return -1;
+  int p = _position;
+  if (!_shuffled || reshuffle) {
+    int count = _numTracks - p;
+    if (p == 0 && _shuffled && _numTracks > 1)
+      count--;                              // not the track that ended the last pass
+    int j = p + _below(count);
+    uint8_t t = _order[p];
+    _order[p] = _order[j];
+    _order[j] = t;
+  }
+  if (++_position == _numTracks) {
+    _position = 0;
+    _shuffled = true;
+  }
+  return _order[p];
+}
+
+int TrackSelector::nextRandom() {
+  if (_numTracks == 0)
+    return -1;
+  int window = _window();
+  int track = 0;
+  if (_weighted) {
+    for (int tries = 0; tries < 8; tries++) {
+      int column = _below(_numTracks);
+      track = _below(_totalWeight) < _threshold[column] ? column : _alias[column];
+      if (_inWindow[track] == 0)
+        break;
+    }
+  } else {
+    int j = _below(_poolSize);
+    track = _pool[j];
+    _pool[j] = _pool[--_poolSize];
+  }
+
+  // It joins the window, and the oldest pick in it leaves
+  _remember(track);
+  if (window > 0) {
+    _inWindow[track]++;
+    if (_historyCount > window) {
+      int old = _recent(window);
+      if (--_inWindow[old] == 0 && !_weighted)
+        _pool[_poolSize++] = old;
+    }
+  } else if (!_weighted) {
+    _pool[_poolSize++] = track;
+  }
+  return track;
+}
+
+/*----------------------------------------------------------------------
+ * State, as a line of numbers:
+ *
+ *   numTracks rng position shuffled order... historyCount history...
+ *   poolSize pool...
+ *
+ * with the history oldest first. The pool is the same tracks as the
+ * history says, but its order decides what a random number chooses.
+ ----------------------------------------------------------------------*/
+
+static bool append(char *text, int size, int *length, unsigned long number) {
+  int n = snprintf(text + *length, size - *length, *length ? " %lu" : "%lu", number);
+  if (n < 0 || *length + n >= size)
+    return false;
+  *length += n;
+  return true;
+}
+
+int TrackSelector::saveState(char *text, int size) {
+  int length = 0;
+  bool ok = append(text, size, &length, _numTracks)
+            && append(text, size, &length, _rng)
+            && append(text, size, &length, _position)
+            && append(text, size, &length, _shuffled ? 1 : 0);
+  for (int i = 0; ok && i < _numTracks; i++)
+    ok = append(text, size, &length, _order[i]);
+  ok = ok && append(text, size, &length, _historyCount);
+  for (int depth = _historyCount - 1; ok && depth >= 0; depth--)
+    ok = append(text, size, &length, _recent(depth));
+  ok = ok && append(text, size, &length, _poolSize);
+  for (int i = 0; ok && i < _poolSize; i++)
+    ok = append(text, size, &length, _pool[i]);
+  return ok ? length : 0;
+}
+
+bool TrackSelector::loadState(const char *text) {
+  unsigned long numbers[4 + 3 * TRACK_SELECTOR_MAX_TRACKS + 2];
+  int count = 0;
+  const char *p = text;
+  while (count < (int)(sizeof(numbers) / sizeof(numbers[0]))) {
+    char *end;
+    numbers[count] = strtoul(p, &end, 10);
+    if (end == p)
+      break;
+    p = end;
+    count++;
+  }
+
+  // Has to be for the same number of tracks, and make sense
+  int n = _numTracks;
+  if (count < 5 + n || (int)numbers[0] != n || numbers[1] == 0 || (int)numbers[2] >= (n > 0 ? n : 1)
+      || numbers[3] > 1)
+    return false;
+  bool seen[TRACK_SELECTOR_MAX_TRACKS];
+  memset(seen, 0, sizeof(seen));
+  for (int i = 0; i < n; i++) {
+    if (numbers[4 + i] >= (unsigned long)n || seen[numbers[4 + i]])
+      return false;
+    seen[numbers[4 + i]] = true;
+  }
+  int historyCount = numbers[4 + n];
+  if (historyCount > TRACK_SELECTOR_MAX_TRACKS || count < 6 + n + historyCount)
+    return false;
+  for (int i = 0; i < historyCount; i++) {
+    if (numbers[5 + n + i] >= (unsigned long)n)
+      return false;
+  }
+  const unsigned long *pool = numbers + 6 + n + historyCount;
+  int poolSize = pool[-1];
+  if (poolSize > n || count != 6 + n + historyCount + poolSize)
+    return false;
+
+  _rng = numbers[1];
+  _position = numbers[2];
+  _shuffled = numbers[3];
+  for (int i = 0; i < n; i++)
+    _order[i] = numbers[4 + i];
+  _historyHead = 0;
+  _historyCount = 0;
+  for (int i = 0; i < historyCount; i++)
+    _remember(numbers[5 + n + i]);
+  _rebuildWindow();
+
+  // The saved pool's order, if it's still the same tracks (it isn't if
+  // the no-repeat window has changed since)
+  bool same = poolSize == _poolSize;
+  memset(seen, 0, sizeof(seen));
+  for (int i = 0; same && i < poolSize; i++) {
+    same = pool[i] < (unsigned long)n && _inWindow[pool[i]] == 0 && !seen[pool[i]];
+    seen[pool[i]] = true;
+  }
+  if (same) {
+    for (int i = 0; i < poolSize; i++)
+      _pool[i] = pool[i];
+  }
+  return true;
+}
+
+/*----------------------------------------------------------------------
+ * Private
+ ----------------------------------------------------------------------*/
+
+uint32_t TrackSelector::_next() {
+  _rng ^= _rng << 13;
+  _rng ^= _rng >> 17;
+  _rng ^= _rng << 5;
+  return _rng;
+}
+
+// 0..n-1, all equally likely (Lemire's multiply-and-shift, which redraws
+// in the rare case that would favor some values).
+
+uint32_t TrackSelector::_below(uint32_t n) {
+  uint64_t m = (uint64_t)_next() * n;
+  uint32_t low = (uint32_t)m;
+  if (low < n) {
+    uint32_t floor = (uint32_t)(-n) % n;
+    while (low < floor) {
+      m = (uint64_t)_next() * n;
+      low = (uint32_t)m;
+    }
+  }
+  return (uint32_t)(m >> 32);
+}
+
+int TrackSelector::_window() {
+  if (_numTracks <= 1)
+    return 0;
+  return _noRepeat < _numTracks ? _noRepeat : _numTracks - 1;
+}
+
+int TrackSelector::_recent(int depth) {
+  return _history[(_historyHead - 1 - depth + 2 * TRACK_SELECTOR_MAX_TRACKS) % TRACK_SELECTOR_MAX_TRACKS];
+}
+
+void TrackSelector::_remember(int track) {
+  _history[_historyHead] = track;
+  _historyHead = (_historyHead + 1) % TRACK_SELECTOR_MAX_TRACKS;
+  if (_historyCount < TRACK_SELECTOR_MAX_TRACKS)
+    _historyCount++;
+}
+
+// The window and the pool from the history, after anything changes it.
+
+void TrackSelector::_rebuildWindow() {
+  int window = _window();
+  memset(_inWindow, 0, sizeof(_inWindow));
+  for (int depth = 0; depth < window && depth < _historyCount; depth++)
+    _inWindow[_recent(depth)]++;
+  _poolSize = 0;
+  for (int t = 0; t < _numTracks; t++) {
+    if (_inWindow[t] == 0)
+      _pool[_poolSize++] = t;
+  }
+}
@@ -0,0 +1,115 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+/*----------------------------------------------------------------------
+ * Chooses the next track from a folder of numTracks, in constant time
+ * per choice:
+ *
+ *   nextShuffled()  every track once, in a random order, then again.
+ *                   The order is a Fisher-Yates shuffle done one step
+ *                   per track played, so each order is equally likely.
+ *                   With reshuffle each pass has a new order, and it
+ *                   never starts with the track that ended the last one.
+ *
+ *   nextRandom()    any track, except the last "no-repeat" ones (see
+ *                   setNoRepeat(); 1 is just not the same one twice in
+ *                   a row). The tracks that may be chosen are kept in a
+ *                   pool: a track leaves it when it's chosen, and comes
+ *                   back when it drops out of the no-repeat window.
+ *
+ * With weights (setWeights()), nextRandom() chooses each track in
+ * proportion to its weight, from an alias table (Walker's method: one
+ * random column, then one random threshold). Those in the no-repeat
+ * window are skipped by drawing again, a few times at most. Weights
+ * don't change the shuffle: that plays every track once.
+ *
+ * The random numbers are a xorshift32 generator of the selector's own,
+ * so its whole state -- generator, shuffle order and position, recent
+ * tracks -- fits in one line of text (saveState()), and loadState()
+ * carries on from there after a restart.
+ *
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef TrackSelector_h
+#define TrackSelector_h 1
+
+#include <stdint.h>
+
+#define TRACK_SELECTOR_MAX_TRACKS 100       // == NUM_FILES_IN_SUBDIR
+#define TRACK_SELECTOR_STATE_CHARS 1024     // enough for saveState() of the most tracks
+
+class TrackSelector
+{
+ public:
+  TrackSelector();
+
+  void     setTracks(int numTracks);        // starts over; the generator carries on
+  int      getNumTracks();
+  void     setSeed(uint32_t seed);
+  void     mixSeed(uint32_t entropy);       // stir in some more randomness
+  void     setNoRepeat(int tracks);         // at most numTracks - 1
+  bool     setWeights(const uint16_t *weights);   // numTracks of them, NULL == all the same
+
+  int      nextShuffled(bool reshuffle);    // -1 if there are no tracks
+  int      nextRandom();
+
+  int      saveState(char *text, int size); // length, 0 if it doesn't fit
+  bool     loadState(const char *text);     // false (and nothing changed) if it doesn't match
+
+ private:
+  int      _numTracks;
+  uint32_t _rng;
+
+  // Shuffle: _order[0.._position) have been played this pass. On the
+  // first pass the rest aren't in order yet; _shuffled is set after it.
+  uint8_t  _order[TRACK_SELECTOR_MAX_TRACKS];
+  int      _position;
+  bool     _shuffled;
+
+  // Random: the last picks, most recent at _history[_historyHead - 1].
+  // _pool[0.._poolSize) may be chosen; _inWindow counts each track's
+  // picks among the last _noRepeat.
+  uint8_t  _history[TRACK_SELECTOR_MAX_TRACKS];
+  int      _historyHead;
+  int      _historyCount;
+  int      _noRepeat;
+  uint8_t  _pool[TRACK_SELECTOR_MAX_TRACKS];
+  int      _poolSize;
+  uint8_t  _inWindow[TRACK_SELECTOR_MAX_TRACKS];
+
+  // Alias table, when weighted: column i is track i below _threshold[i]
+  // (out of _totalWeight), otherwise track _alias[i].
+  bool     _weighted;
+  uint32_t _totalWeight;
+  uint32_t _threshold[TRACK_SELECTOR_MAX_TRACKS];
+  uint8_t  _alias[TRACK_SELECTOR_MAX_TRACKS];
+
+  uint32_t _next();
+  uint32_t _below(uint32_t n);
+  int      _window();                       // the no-repeat window that fits
+  int      _recent(int depth);              // 0 == the last pick
+  void     _remember(int track);
+  void     _rebuildWindow();
+};
+
+#endif
@@ -0,0 +1,61 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include "UartSerialPort.h"
+
+UartSerialPort::UartSerialPort(int portNumber, uint32_t baud) {
+  _portNumber = portNumber;
+  _baud = baud;
+  _stream = NULL;
+}
+
+// The ports are separate objects, so each one is started by name.
+
+#define BEGIN_UART(n)                                          \
+  case n:                                                      \
+    Serial##n.begin(_baud);                                    \
+    Serial##n.addMemoryForRead(_rxBuffer, sizeof(_rxBuffer));  \
+    _stream = &Serial##n;                                      \
+    break;
+
+void UartSerialPort::begin() {
+  switch (_portNumber) {
+    BEGIN_UART(1)
+    BEGIN_UART(2)
+    BEGIN_UART(3)
+    BEGIN_UART(4)
+    BEGIN_UART(5)
+    BEGIN_UART(6)
+    BEGIN_UART(7)
+    BEGIN_UART(8)
+  default:
+    _stream = NULL;
+  }
+}
+
+int UartSerialPort::read(uint8_t *buffer, int maxBytes) {
+  if (!_stream)
+    return 0;
+  int n = 0;
+  while (n < maxBytes && _stream->available() > 0)
+    buffer[n++] = (uint8_t)_stream->read();
+  return n;
+}
@@ -0,0 +1,60 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * SerialPort on one of the Teensy's hardware UARTs (Serial1..Serial8).
+ *
+ * The Teensy core receives into a buffer from the UART's interrupt (the
+ * UART has a small FIFO, so there's one interrupt per few bytes, not per
+ * byte). That buffer is only 64 bytes, which at 1 Mbaud fills in half a
+ * millisecond; a loop iteration can take longer than that while it reads
+ * audio from the SD card. So each port gets SERIAL_PORT_RX_BUFFER more
+ * bytes of receive buffer.
+ *
+ * On the Teensy 4.1, the receive pins that aren't used by the audio
+ * shield or the vibrators are Serial3 (pin 15), Serial4 (pin 16) and
+ * Serial8 (pin 34).
+ ----------------------------------------------------------------------*/
+
+#ifndef UartSerialPort_h
+#define UartSerialPort_h 1
+
+#include <Arduino.h>
+#include "SerialPort.h"
+
+#define SERIAL_PORT_RX_BUFFER 512
+
+class UartSerialPort : public SerialPort
+{
+ public:
+  UartSerialPort(int portNumber, uint32_t baud);
+
+  void begin();
+  int  read(uint8_t *buffer, int maxBytes);
+
+ private:
+  int      _portNumber;
+  uint32_t _baud;
+  Stream  *_stream;
+  uint8_t  _rxBuffer[SERIAL_PORT_RX_BUFFER];
+};
+
+#endif
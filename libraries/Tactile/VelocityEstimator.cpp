@@ -0,0 +1,87 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include "VelocityEstimator.h"
+
+// For x = 0..N-1, the least-squares slope is
+//
+//     (N * sum(x * y) - sum(x) * sum(y)) / (N * sum(x^2) - sum(x)^2)
+//
+// and the denominator is the constant N^2 (N^2 - 1) / 12.
+
+#define VELOCITY_SUM_X        ((int32_t)VELOCITY_WINDOW * (VELOCITY_WINDOW - 1) / 2)
+#define VELOCITY_DENOMINATOR  ((int64_t)VELOCITY_WINDOW * VELOCITY_WINDOW \
+                               * (VELOCITY_WINDOW * VELOCITY_WINDOW - 1) / 12)
+
+VelocityEstimator::VelocityEstimator() {
+  reset(0);
+}
+
+void VelocityEstimator::reset(uint16_t raw) {
+  for (int i = 0; i < VELOCITY_WINDOW; i++)
+    _window[i] = raw;
+  _pos = 0;
+  _sum = (int32_t)raw * VELOCITY_WINDOW;
+  _weightedSum = (int32_t)raw * VELOCITY_SUM_X;
+  _numerator = 0;
+  _peakNumerator = 0;
+  _peakSum = _sum;
+}
+
+// Sliding the window: every sample gets one younger (the weighted sum
+// drops by the sum of the samples that stay), the oldest leaves, and the
+// new one comes in with the highest weight.
+//
+// Once the window's average is back below where it was at the steepest
+// rise, whatever rose (a spike, or a hand that turned away) has gone
+// again, so the peak is forgotten and the next approach starts afresh.
+
+void VelocityEstimator::update(uint16_t raw) {
+  int32_t oldest = _window[_pos];
+  _window[_pos] = raw;
+  _pos = (_pos + 1) & (VELOCITY_WINDOW - 1);
+  _weightedSum += (VELOCITY_WINDOW - 1) * (int32_t)raw - (_sum - oldest);
+  _sum += (int32_t)raw - oldest;
+  _numerator = VELOCITY_WINDOW * _weightedSum - VELOCITY_SUM_X * _sum;
+  if (_numerator > _peakNumerator) {
+    _peakNumerator = _numerator;
+    _peakSum = _sum;
+  } else if (_sum < _peakSum) {
+    _peakNumerator = 0;
+  }
+}
+
+int32_t VelocityEstimator::_toSlope(int32_t numerator) {
+  return (int32_t)(((int64_t)numerator << 16) / VELOCITY_DENOMINATOR);
+}
+
+int32_t VelocityEstimator::getSlope() {
+  return _toSlope(_numerator);
+}
+
+int32_t VelocityEstimator::getPeakSlope() {
+  return _toSlope(_peakNumerator);
+}
+
+void VelocityEstimator::resetPeak() {
+  _peakNumerator = 0;
+  _peakSum = _sum;
+}
@@ -0,0 +1,71 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * Estimates how fast a sensor's reading is changing, so that a fast slap
+ * can sound (or vibrate) different from a slow approach. The heavy
+ * averaging used for touch detection is far too slow for this, so the
+ * estimate is made from the raw samples: the slope of a least-squares
+ * straight line through the last VELOCITY_WINDOW samples.
+ *
+ * The sums that the slope needs are updated as each sample slides into
+ * the window (a handful of adds and a multiply, no loops), and the
+ * steepest slope since the last resetPeak() is kept. By the time the
+ * filtered value crosses the touch threshold, the hand has usually
+ * stopped moving, so it's the peak that tells how fast it came in.
+ * The peak is dropped when the reading falls back below its level at
+ * the peak, so a spike or an approach that turned away doesn't set the
+ * velocity of the next touch.
+ *
+ * Slopes are in raw counts per sample, Q16. No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef VelocityEstimator_h
+#define VelocityEstimator_h 1
+
+#include <stdint.h>
+
+#define VELOCITY_WINDOW 32          // power of two; 16 msec at 2000 samples/sec
+
+class VelocityEstimator
+{
+ public:
+  VelocityEstimator();
+
+  void    reset(uint16_t raw);
+  void    update(uint16_t raw);
+  int32_t getSlope();               // now
+  int32_t getPeakSlope();           // steepest rise since resetPeak()
+  void    resetPeak();
+
+ private:
+  uint16_t _window[VELOCITY_WINDOW];
+  int      _pos;                    // oldest sample
+  int32_t  _sum;                    // of the samples in the window
+  int32_t  _weightedSum;            // of age-weighted samples, oldest weighs 0
+  int32_t  _numerator;              // slope * VELOCITY_DENOMINATOR
+  int32_t  _peakNumerator;
+  int32_t  _peakSum;                // _sum at the peak
+
+  int32_t  _toSlope(int32_t numerator);
+};
+
+#endif
@@ -21,6 +21,7 @@
 #include "Arduino.h"
 #include "Vibrate.h"
 #include "VibrationEnvelopes.h"
+#include "LatencyProbe.h"
 
 #define DEFAULT_PWM_FREQUENCY 100000
 #define DEFAULT_VIBRATOR_FREQUENCY 180
@@ -101,6 +102,7 @@ void Vibrate::doTimerTasks() {
             int pin2 = _convertChannelToPin2(channel);
             analogWrite(pin1, 127 + _actualIntensity[channel]);
             analogWrite(pin2, 128 - _actualIntensity[channel]);
+            LATENCY_MARK(channel, latencyVibration, micros());
             if (channel == 0)
               analogWrite(33, HIGH);        // oscilloscope trigger
           }
@@ -111,6 +113,7 @@ void Vibrate::doTimerTasks() {
             int pin2 = _convertChannelToPin2(channel);
             analogWrite(pin1, 128 - _actualIntensity[channel]);
             analogWrite(pin2, 127 + _actualIntensity[channel]);
+            LATENCY_MARK(channel, latencyVibration, micros());
             if (channel == 0)
               analogWrite(33, LOW);        // oscilloscope trigger
           }
@@ -126,6 +129,7 @@ void Vibrate::doTimerTasks() {
           int pin2 = _convertChannelToPin2(channel);
           analogWrite(pin1, 127 + _actualIntensity[channel]);
           analogWrite(pin2, 128 - _actualIntensity[channel]);
+          LATENCY_MARK(channel, latencyVibration, micros());
         }
       }
 
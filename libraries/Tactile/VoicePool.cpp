@@ -0,0 +1,196 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+#include "VoicePool.h"
+
+VoicePool::VoicePool(int numVoices) {
+  if (numVoices > VOICE_POOL_MAX)
+    numVoices = VOICE_POOL_MAX;
+  _numVoices = numVoices;
+  _policy = stealOldest;
+  for (int v = 0; v < VOICE_POOL_MAX; v++) {
+    _channel[v] = -1;
+    _priority[v] = 0;
+    _level[v] = 0;
+    _started[v] = 0;
+    _released[v] = false;
+    _armed[v] = false;
+  }
+  _clock = 0;
+  resetStats();
+}
+
+void VoicePool::setPolicy(VoiceStealPolicy policy) {
+  _policy = policy;
+}
+
+VoiceStealPolicy VoicePool::getPolicy() {
+  return _policy;
+}
+
+int VoicePool::getNumVoices() {
+  return _numVoices;
+}
+
+int VoicePool::allocate(int channel, int priority, bool steal, int *cutFrom) {
+  *cutFrom = -1;
+  int voice = -1;
+  for (int v = 0; v < _numVoices; v++) {
+    if (_channel[v] < 0) {
+      voice = v;
+      break;
+    }
+  }
+  if (voice < 0) {
+    if (!steal)
+      return -1;
+    voice = _choose(true, -1);
+    if (voice < 0)
+      voice = _choose(false, -1);
+    if (voice < 0)
+      return -1;
+    *cutFrom = _channel[voice];
+    _cuts++;
+  }
+  _channel[voice] = channel;
+  _priority[voice] = priority;
+  _level[voice] = 0;
+  _started[voice] = ++_clock;
+  _released[voice] = false;
+  _armed[voice] = false;
+  int inUse = getNumInUse();
+  if (inUse > _peak)
+    _peak = inUse;
+  return voice;
+}
+
+int VoicePool::findVictim(int exclude) {
+  for (int v = 0; v < _numVoices; v++) {
+    if (_channel[v] < 0 || _released[v])
+      return -1;                           // the next sound has somewhere to go
+  }
+  return _choose(false, exclude);
+}
+
+void VoicePool::steal(int voice) {
+  if (voice < 0 || voice >= _numVoices || _channel[voice] < 0)
+    return;
+  _released[voice] = true;
+  _armed[voice] = false;
+  _steals++;
+}
+
+void VoicePool::release(int voice) {
+  if (voice < 0 || voice >= _numVoices || _channel[voice] < 0)
+    return;
+  _released[voice] = true;
+  _armed[voice] = false;
+}
+
+void VoicePool::free(int voice) {
+  if (voice < 0 || voice >= _numVoices)
+    return;
+  _channel[voice] = -1;
+  _released[voice] = false;
+  _armed[voice] = false;
+}
+
+void VoicePool::setLevel(int voice, int32_t level) {
+  if (voice >= 0 && voice < _numVoices)
+    _level[voice] = level;
+}
+
+void VoicePool::setArmed(int voice, bool armed) {
+  if (voice >= 0 && voice < _numVoices && _channel[voice] >= 0)
+    _armed[voice] = armed;
+}
+
+int VoicePool::getChannel(int voice) {
+  if (voice < 0 || voice >= _numVoices)
+    return -1;
+  return _channel[voice];
+}
+
+bool VoicePool::isReleased(int voice) {
+  if (voice < 0 || voice >= _numVoices)
+    return false;
+  return _released[voice];
+}
+
+bool VoicePool::isArmed(int voice) {
+  if (voice < 0 || voice >= _numVoices)
+    return false;
+  return _armed[voice];
+}
+
+int VoicePool::getNumInUse() {
+  int n = 0;
+  for (int v = 0; v < _numVoices; v++) {
+    if (_channel[v] >= 0)
+      n++;
+  }
+  return n;
+}
+
+int VoicePool::getPeakInUse() {
+  return _peak;
+}
+
+uint32_t VoicePool::getSteals() {
+  return _steals;
+}
+
+uint32_t VoicePool::getCuts() {
+  return _cuts;
+}
+
+void VoicePool::resetStats() {
+  _peak = getNumInUse();
+  _steals = 0;
+  _cuts = 0;
+}
+
+// Among the voices in use that are (or aren't) released, the best one to
+// take. Released voices are already on their way out, so the one nearest
+// to silence goes first, whatever the policy.
+
+int VoicePool::_choose(bool released, int exclude) {
+  int best = -1;
+  for (int v = 0; v < _numVoices; v++) {
+    if (v == exclude || _channel[v] < 0 || _released[v] != released)
+      continue;
+    if (best < 0 || _before(v, best, released))
+      best = v;
+  }
+  return best;
+}
+
+bool VoicePool::_before(int a, int b, bool released) {
+  if (released || _policy == stealQuietest) {
+    if (_level[a] != _level[b])
+      return _level[a] < _level[b];
+  } else if (_policy == stealLowestPriority) {
+    if (_priority[a] != _priority[b])
+      return _priority[a] < _priority[b];
+  }
+  return (int32_t)(_started[a] - _started[b]) < 0;       // older
+}
@@ -0,0 +1,108 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+/*----------------------------------------------------------------------
+ * Voices (players) handed out to the channels as they start sounds, in
+ * place of one fixed player per channel. A channel can have more than
+ * one voice: a retriggered sound fades out on its own voice while the
+ * new one starts on another, or the sounds of a channel can be layered.
+ *
+ * When every voice is busy, one is stolen, chosen by the policy:
+ *
+ *   stealOldest           the one that started first
+ *   stealQuietest         the one with the lowest level (see setLevel())
+ *   stealLowestPriority   the one with the lowest priority; among equals,
+ *                         the oldest
+ *
+ * A stolen voice needs a few msec to fade out (a tail) rather than be
+ * cut off with a click, so the pool steals ahead: when allocate() takes
+ * the last free voice, findVictim() names one to start fading out now,
+ * and that's the voice the next sound gets. A voice that's fading out
+ * (released) is always taken before one that isn't. Only when sounds
+ * start faster than tails end does allocate() have to take a voice that
+ * is still sounding (a "cut").
+ *
+ * A voice can be armed: it holds a track that's ready (prepared) for
+ * its channel's next touch, and isn't sounding yet. Taking the voice
+ * for anything else, or freeing it, disarms it.
+ *
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef VoicePool_h
+#define VoicePool_h 1
+
+#include <stdint.h>
+
+#define VOICE_POOL_MAX 16
+
+enum VoiceStealPolicy {stealOldest, stealQuietest, stealLowestPriority};
+
+class VoicePool
+{
+ public:
+  VoicePool(int numVoices = VOICE_POOL_MAX);
+
+  void setPolicy(VoiceStealPolicy policy);
+  VoiceStealPolicy getPolicy();
+  int  getNumVoices();
+
+  // A free voice, or (if steal) the released one nearest to silence, or
+  // the victim by the policy. -1 if there's none. *cutFrom is the channel
+  // the voice was taken from while still sounding, -1 if it was free.
+  int  allocate(int channel, int priority, bool steal, int *cutFrom);
+  int  findVictim(int exclude);            // when no voice is free or released: the one to steal
+  void steal(int voice);                   // release(), counted as a steal
+  void release(int voice);                 // fading out, first to be reused
+  void free(int voice);
+
+  void    setLevel(int voice, int32_t level);   // for stealQuietest, any scale
+  void    setArmed(int voice, bool armed); // see above
+  int     getChannel(int voice);           // -1 == free
+  bool    isReleased(int voice);
+  bool    isArmed(int voice);
+
+  int      getNumInUse();
+  int      getPeakInUse();
+  uint32_t getSteals();
+  uint32_t getCuts();
+  void     resetStats();
+
+ private:
+  int              _numVoices;
+  VoiceStealPolicy _policy;
+  int8_t   _channel[VOICE_POOL_MAX];
+  int      _priority[VOICE_POOL_MAX];
+  int32_t  _level[VOICE_POOL_MAX];
+  uint32_t _started[VOICE_POOL_MAX];
+  bool     _released[VOICE_POOL_MAX];
+  bool     _armed[VOICE_POOL_MAX];
+  uint32_t _clock;                         // for oldest
+  int      _peak;
+  uint32_t _steals;
+  uint32_t _cuts;
+
+  int  _choose(bool released, int exclude);
+  bool _before(int a, int b, bool released);
+};
+
+#endif
@@ -0,0 +1,319 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "WavConverter.h"
+#include "ImaAdpcmDecoder.h"
+
+static uint32_t get32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t get16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static void put16(uint8_t *p, uint16_t v) {
+  p[0] = v; p[1] = v >> 8;
+}
+
+WavConverter::WavConverter() {
+  memset(&_source, 0, sizeof(_source));
+  _channels = 2;
+  _phase = 0;
+  _primed = 0;
+  memset(_history, 0, sizeof(_history));
+}
+
+/*----------------------------------------------------------------------
+ * What a file is. Like WavStream::readHeader(), but it takes any format
+ * and leaves it to isNative() and canConvert() to say what to do.
+ ----------------------------------------------------------------------*/
+
+bool WavConverter::readSourceHeader(SampleFile *file, WavSource *source) {
+  uint8_t h[8 + 40];
+  memset(source, 0, sizeof(*source));
+  if (file->read(h, 12) != 12 || memcmp(h, "RIFF", 4) != 0 || memcmp(h + 8, "WAVE", 4) != 0)
+    return false;
+  uint32_t position = 12;
+  bool haveFormat = false;
+  for (int chunks = 0; chunks < 32; chunks++) {
+    if (file->read(h, 8) != 8)
+      return false;
+    uint32_t size = get32(h + 4);
+    position += 8;
+    if (memcmp(h, "fmt ", 4) == 0) {
+      int n = size < 40 ? size : 40;
+      if (size < 16 || file->read(h + 8, n) != n)
+        return false;
+      source->formatTag = get16(h + 8);
+      source->encoding = source->formatTag;
+      source->channels = get16(h + 10);
+      source->sampleRate = get32(h + 12);
+      source->frameBytes = get16(h + 20);
+      source->bits = get16(h + 22);
+      if (source->formatTag == 0xFFFE && size >= 40)
+        source->encoding = get16(h + 8 + 24);   // the first two bytes of the subformat GUID
+      haveFormat = true;
+    } else if (memcmp(h, "data", 4) == 0) {
+      if (!haveFormat)
+        return false;
+      source->dataOffset = position;
+      source->dataBytes = size;
+      if (source->dataBytes > file->size() - position)
+        source->dataBytes = file->size() - position;
+      return true;
+    }
+    position += size + (size & 1);
+    if (!file->seek(position))
+      return false;
+  }
+  return false;
+}
+
+// What WavStream plays as it is.
+
+bool WavConverter::isNative(const WavSource *source) {
+  if (source->sampleRate != WAV_NATIVE_RATE || source->channels < 1 || source->channels > 2)
+    return false;
+  if (source->formatTag == 1)
+    return source->bits == 16;
+  if (source->formatTag == 0x11)
+    return source->bits == 4 && ImaAdpcmDecoder::isValidFormat(source->channels, source->frameBytes);
+  return false;
+}
+
+bool WavConverter::canConvert(const WavSource *source) {
+  if (isNative(source) || source->channels < 1 || source->channels > WAV_CONVERTER_MAX_CHANNELS
+      || source->sampleRate < 8000 || source->sampleRate > 192000)
+    return false;
+  bool pcm = source->encoding == 1
+             && (source->bits == 8 || source->bits == 16 || source->bits == 24 || source->bits == 32);
+  bool floats = source->encoding == 3 && source->bits == 32;
+  return (pcm || floats) && source->frameBytes == source->channels * source->bits / 8;
+}
+
+/*----------------------------------------------------------------------
+ * Converting. Samples are kept at 24 bits (the 16-bit value times 256)
+ * until they're output, so 24-bit files are only rounded once.
+ *
+ * The output between input frames n and n+1 is interpolated from the
+ * four frames n-1..n+2 in _history. _phase is how far past frame n it
+ * is, in steps of 1/WAV_NATIVE_RATE of a frame: each output moves it on
+ * by the input's rate, and when it gets to a whole frame, the next
+ * input frame comes in. At the start the first frame is repeated, so
+ * the first output is exactly the first input frame.
+ ----------------------------------------------------------------------*/
+
+void WavConverter::begin(const WavSource *source) {
+  _source = *source;
+  _channels = source->channels == 1 ? 1 : 2;
+  _phase = 0;
+  _primed = 0;
+  memset(_history, 0, sizeof(_history));
+}
+
+int WavConverter::getChannels() {
+  return _channels;
+}
+
+int WavConverter::convert(const uint8_t *in, int frames, int16_t *out, int maxFrames, int *outFrames) {
+  return _run(in, frames, out, maxFrames, outFrames);
+}
+
+// The last input frame again, twice: enough for the outputs up to it
+// and for those after it, up to where the next frame would have been.
+
+int WavConverter::finish(int16_t *out, int maxFrames) {
+  int n;
+  _run(0, 2, out, maxFrames, &n);
+  return n;
+}
+
+int WavConverter::_run(const uint8_t *in, int frames, int16_t *out, int maxFrames, int *outFrames) {
+  int used = 0;
+  int n = 0;
+  int sampleBytes = _source.bits / 8;
+  while (1) {
+    while (_primed == 3 && _phase < WAV_NATIVE_RATE) {
+      if (n == maxFrames) {
+        *outFrames = n;
+        return used;
+      }
+      for (int c = 0; c < _channels; c++) {
+        const int32_t *h = _history[c];
+        int32_t y = h[1];
+        if (_phase > 0) {
+          float t = (float)_phase / WAV_NATIVE_RATE;
+          float c1 = 0.5f * (h[2] - h[0]);
+          float c2 = h[0] - 2.5f * h[1] + 2.0f * h[2] - 0.5f * h[3];
+          float c3 = 0.5f * (h[3] - h[0]) + 1.5f * (h[1] - h[2]);
+          y = (int32_t)floorf(((c3 * t + c2) * t + c1) * t + h[1] + 0.5f);
+        }
+        y = (y + 128) >> 8;
+        if (y > 32767)
+          y = 32767;
+        else if (y < -32768)
+          y = -32768;
+        *out++ = (int16_t)y;
+      }
+      n++;
+      _phase += _source.sampleRate;
+    }
+    if (used == frames)
+      break;
+
+    int32_t frame[2];
+    if (in) {
+      const uint8_t *p = in + used * _source.frameBytes;
+      frame[0] = _sample(p);
+      frame[1] = _channels == 2 ? _sample(p + sampleBytes) : frame[0];
+    } else {
+      frame[0] = _history[0][3];
+      frame[1] = _history[1][3];
+    }
+    _push(frame);
+    used++;
+  }
+  *outFrames = n;
+  return used;
+}
+
+int32_t WavConverter::_sample(const uint8_t *p) {
+  switch (_source.bits) {
+  case 8:
+    return ((int32_t)p[0] - 128) * 65536;
+  case 16:
+    return (int32_t)(int16_t)get16(p) * 256;
+  case 24:
+    return (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) >> 8;
+  default:
+    if (_source.encoding == 3) {
+      float f;
+      memcpy(&f, p, 4);
+      if (!(f > -1.0f))                     // NaN too
+        return f > 0 ? 8388607 : -8388608;
+      if (f >= 1.0f)
+        return 8388607;
+      return (int32_t)(f * 8388608.0f);
+    }
+    return (int32_t)get32(p) >> 8;
+  }
+}
+
+void WavConverter::_push(const int32_t *frame) {
+  for (int c = 0; c < _channels; c++) {
+    int32_t *h = _history[c];
+    if (_primed == 0) {
+      h[0] = h[1] = h[2] = frame[c];
+    } else {
+      h[0] = h[1];
+      h[1] = h[2];
+      h[2] = h[3];
+    }
+    h[3] = frame[c];
+  }
+  if (_primed < 3)
+    _primed++;
+  else
+    _phase -= WAV_NATIVE_RATE;
+}
+
+/*----------------------------------------------------------------------
+ * State, as a line of numbers: phase primed channels history...
+ ----------------------------------------------------------------------*/
+
+int WavConverter::saveState(char *text, int size) {
+  int length = snprintf(text, size, "%lu %lu %d", (unsigned long)_phase, (unsigned long)_primed, _channels);
+  for (int c = 0; c < _channels && length < size; c++) {
+    for (int i = 0; i < 4 && length < size; i++)
+      length += snprintf(text + length, size - length, " %ld", (long)_history[c][i]);
+  }
+  return length < size ? length : 0;
+}
+
+bool WavConverter::loadState(const char *text) {
+  long numbers[3 + 2 * 4];
+  int count = 0;
+  const char *p = text;
+  while (count < 3 + 2 * 4) {
+    char *end;
+    numbers[count] = strtol(p, &end, 10);
+    if (end == p)
+      break;
+    p = end;
+    count++;
+  }
+  if (count != 3 + 4 * _channels || numbers[2] != _channels || numbers[1] < 0 || numbers[1] > 3
+      || numbers[0] < 0 || numbers[0] >= (long)(WAV_NATIVE_RATE + _source.sampleRate))
+    return false;
+  _phase = numbers[0];
+  _primed = numbers[1];
+  for (int c = 0; c < _channels; c++) {
+    for (int i = 0; i < 4; i++)
+      _history[c][i] = numbers[3 + 4*c + i];
+  }
+  return true;
+}
+
+/*----------------------------------------------------------------------
+ * The converted file's header: RIFF, "fmt ", "TAsr" (the source's size
+ * and date), "data".
+ ----------------------------------------------------------------------*/
+
+void WavConverter::makeHeader(uint8_t *header, int channels, uint32_t dataBytes,
+                              uint32_t sourceSize, uint32_t sourceDate) {
+  memcpy(header, "RIFF", 4);
+  put32(header + 4, dataBytes ? WAV_CONVERTED_HEADER_BYTES - 8 + dataBytes : 0);
+  memcpy(header + 8, "WAVEfmt ", 8);
+  put32(header + 16, 16);
+  put16(header + 20, 1);
+  put16(header + 22, channels);
+  put32(header + 24, WAV_NATIVE_RATE);
+  put32(header + 28, WAV_NATIVE_RATE * 2 * channels);
+  put16(header + 32, 2 * channels);
+  put16(header + 34, 16);
+  memcpy(header + 36, "TAsr", 4);
+  put32(header + 40, 8);
+  put32(header + 44, sourceSize);
+  put32(header + 48, sourceDate);
+  memcpy(header + 52, "data", 4);
+  put32(header + 56, dataBytes);
+}
+
+bool WavConverter::readKey(const uint8_t *header, uint32_t *sourceSize, uint32_t *sourceDate,
+                           uint32_t *dataBytes) {
+  if (memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVEfmt ", 8) != 0
+      || memcmp(header + 36, "TAsr", 4) != 0 || memcmp(header + 52, "data", 4) != 0)
+    return false;
+  *sourceSize = get32(header + 44);
+  *sourceDate = get32(header + 48);
+  *dataBytes = get32(header + 56);
+  return true;
+}
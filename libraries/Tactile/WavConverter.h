@@ -0,0 +1,112 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+
+/*----------------------------------------------------------------------
+ * Converts WAV files the players can't stream as they are into the
+ * native format: 44.1 kHz, 16-bit PCM, mono or stereo (IMA-ADPCM at
+ * 44.1 kHz is native too, see ImaAdpcmDecoder). Any other rate from 8 to
+ * 192 kHz, 8/24/32-bit PCM, 32-bit float, WAVE_FORMAT_EXTENSIBLE headers
+ * and more than two channels (the first two are kept) are converted.
+ *
+ * readSourceHeader() says what a file is. convert() then takes its
+ * frames, as many at a time as the caller has read, and gives out
+ * native frames, as many as fit; finish() gives the last few after the
+ * end. The rate is changed by cubic (Catmull-Rom) interpolation, which
+ * at the same rate is exact, so a file that only needed a new header or
+ * channels comes out sample for sample.
+ *
+ * The converter stops between input frames, never with output waiting,
+ * so its state after a convert() that used up the input is small and
+ * complete: saveState() writes it as a line of text, and loadState()
+ * carries on from there after a restart, with the same samples as if
+ * there had been none (see AudioFileManager, which keeps the converted
+ * copies).
+ *
+ * A converted file has a fixed header of WAV_CONVERTED_HEADER_BYTES
+ * (makeHeader()), with a chunk that records the size and date of the
+ * file it came from, so a changed file is converted again. Its data
+ * size is 0 until the conversion is complete.
+ *
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef WavConverter_h
+#define WavConverter_h 1
+
+#include <stdint.h>
+#include "SampleFile.h"
+
+#define WAV_NATIVE_RATE 44100
+#define WAV_CONVERTER_MAX_CHANNELS 8
+#define WAV_CONVERTER_FINISH_FRAMES 16      // finish() needs room for this many
+#define WAV_CONVERTED_HEADER_BYTES 60
+#define WAV_CONVERTER_STATE_CHARS 200
+
+struct WavSource {
+  uint16_t formatTag;                       // as in the header: 1 PCM, 3 float, 0x11 IMA-ADPCM, 0xFFFE extensible
+  uint16_t encoding;                        // the same, but an extensible header's subformat
+  uint16_t channels;
+  uint32_t sampleRate;
+  uint16_t bits;
+  uint16_t frameBytes;
+  uint32_t dataOffset;
+  uint32_t dataBytes;
+};
+
+class WavConverter
+{
+ public:
+  WavConverter();
+
+  static bool readSourceHeader(SampleFile *file, WavSource *source);   // false if it's not a WAV file at all
+  static bool isNative(const WavSource *source);
+  static bool canConvert(const WavSource *source);
+
+  void     begin(const WavSource *source);
+  int      getChannels();                   // of the output, 1 or 2
+
+  // Takes up to frames input frames, gives out up to maxFrames output
+  // frames (interleaved) in *outFrames. Returns the input frames used.
+  int      convert(const uint8_t *in, int frames, int16_t *out, int maxFrames, int *outFrames);
+  int      finish(int16_t *out, int maxFrames); // output frames
+
+  int      saveState(char *text, int size); // length, 0 if it doesn't fit
+  bool     loadState(const char *text);     // after begin() with the same source
+
+  static void makeHeader(uint8_t *header, int channels, uint32_t dataBytes,
+                         uint32_t sourceSize, uint32_t sourceDate);
+  static bool readKey(const uint8_t *header, uint32_t *sourceSize, uint32_t *sourceDate,
+                      uint32_t *dataBytes);
+
+ private:
+  WavSource _source;
+  int      _channels;                       // out
+  uint32_t _phase;                          // in 1/WAV_NATIVE_RATE of an input frame, past _history[1]
+  uint32_t _primed;                         // input frames taken, up to 3
+  int32_t  _history[2][4];                  // 24-bit scale; the output is between [1] and [2]
+
+  int      _run(const uint8_t *in, int frames, int16_t *out, int maxFrames, int *outFrames);
+  int32_t  _sample(const uint8_t *p);
+  void     _push(const int32_t *frame);
+};
+
+#endif
@@ -0,0 +1,575 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include <string.h>
+#include "WavStream.h"
+
+static uint32_t get32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t get16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+WavStream::WavStream() {
+  _file = 0;
+  _state = wavIdle;
+  _format.channels = 2;
+  _format.bytesPerSecond = 44100 * 4;
+  _format.dataOffset = 0;
+  _format.dataBytes = 0;
+  _format.loopStart = 0;
+  _format.loopEnd = 0;
+  _format.blockAlign = 0;
+  _dataRemaining = 0;
+  _bytesPlayed = 0;
+  _dataPos = 0;
+  _bufferPos = 0;
+  _bufferLength = 0;
+  _preroll = 0;
+  _prerollBytes = 0;
+  _fileReady = false;
+  _underruns = 0;
+  _capture = 0;
+  _captureBytes = 0;
+  _looping = false;
+  _loopFrames = 0;
+  _wrapped = false;
+  _readError = false;
+  _end = 0;
+  _resume = 0;
+  _seamAt = 0;
+  _seamFrom = 0;
+  _seamFrames = 0;
+  _seamReady = false;
+}
+
+bool WavStream::open(SampleFile *file, const char *path, bool fill) {
+  stop();
+  _file = file;
+  if (!_file->open(path))
+    return false;
+  if (!readHeader(_file, &_format, _looping)) {
+    _file->close();
+    return false;
+  }
+  _setLoopPoints(0);
+  if (_format.blockAlign)
+    _adpcm.begin(_format.channels, _format.blockAlign);
+  _dataRemaining = _end;
+  _bytesPlayed = 0;
+  _dataPos = 0;
+  _wrapped = false;
+  _readError = false;
+  _bufferPos = 0;
+  _bufferLength = 0;
+  _preroll = 0;
+  _prerollBytes = 0;
+  _capture = 0;
+  if (fill)
+    _fill();
+  _fileReady = true;
+  _state = wavArmed;
+  return true;
+}
+
+void WavStream::start() {
+  if (_state == wavArmed)
+    _state = wavPlaying;
+}
+
+void WavStream::stop() {
+  _state = wavIdle;
+  _fileReady = false;
+  if (_file)
+    _file->close();
+}
+
+bool WavStream::isArmed() {
+  return _state == wavArmed;
+}
+
+bool WavStream::isPlaying() {
+  return _state == wavPlaying;
+}
+
+int WavStream::getChannels() {
+  return _format.channels;
+}
+
+uint32_t WavStream::positionMillis() {
+  return (uint32_t)((uint64_t)_bytesPlayed * 1000 / _format.bytesPerSecond);
+}
+
+uint32_t WavStream::lengthMillis() {
+  return (uint32_t)((uint64_t)_format.dataBytes * 1000 / _format.bytesPerSecond);
+}
+
+uint32_t WavStream::getUnderruns() {
+  return _underruns;
+}
+
+const WavFormat *WavStream::getFormat() {
+  return &_format;
+}
+
+// Only from the very start of the data: what open() has read so far is
+// in the buffer, and _fill() copies everything after it. Not when the
+// file will never be read to its end, or already went round a loop.
+
+bool WavStream::setCapture(uint8_t *destination) {
+  if (_state != wavArmed || _prerollBytes > 0 || _bytesPlayed > 0 || _bufferPos > 0
+      || _end < _format.dataBytes || _wrapped)
+    return false;
+  memcpy(destination, _buffer, _bufferLength);
+  _captureBytes = _bufferLength;
+  _capture = destination;
+  return true;
+}
+
+bool WavStream::isCaptured() {
+  return _capture && _captureBytes == _format.dataBytes;
+}
+
+/*----------------------------------------------------------------------
+ * Pre-roll. The first bytes of the data are in memory; the file has to
+ * supply the rest, starting right after them. A track that fits entirely
+ * in its pre-roll never needs the file at all.
+ ----------------------------------------------------------------------*/
+
+void WavStream::startPreroll(const WavFormat *format, const uint8_t *preroll, uint32_t bytes) {
+  stop();
+  _format = *format;
+  if (bytes > _format.dataBytes)
+    bytes = _format.dataBytes;
+  _preroll = preroll;
+  _prerollBytes = bytes;
+  _capture = 0;
+  _setLoopPoints(0);
+  if (_format.blockAlign)
+    _adpcm.begin(_format.channels, _format.blockAlign);
+  _dataRemaining = _end > bytes ? _end - bytes : 0;    // a loop can be all in memory
+  _bytesPlayed = 0;
+  _dataPos = 0;
+  _wrapped = false;
+  _readError = false;
+  _bufferPos = 0;
+  _bufferLength = 0;
+  _fileReady = (_dataRemaining == 0);
+  _state = wavPlaying;
+}
+
+bool WavStream::needsFile() {
+  return _state == wavPlaying && !_fileReady;
+}
+
+bool WavStream::readsFile() {
+  return _state == wavPlaying && _fileReady && (_dataRemaining > 0 || (_looping && _end > _prerollBytes));
+}
+
+// Called from the loop while readBlock() (in the audio interrupt) plays
+// the pre-roll. readBlock() doesn't touch the file or the buffer until
+// _fileReady is set, which is done last.
+
+bool WavStream::openRest(SampleFile *file, const char *path) {
+  if (!needsFile())
+    return false;
+  _file = file;
+  bool ok = _file->open(path) && _file->seek(_format.dataOffset + _prerollBytes);
+  if (ok) {
+    _fill();
+  } else {
+    _dataRemaining = 0;                     // play the pre-roll, then end
+    _readError = true;
+  }
+  __sync_synchronize();
+  _fileReady = true;
+  return ok;
+}
+
+/*----------------------------------------------------------------------
+ * Looping. The seam crossfade takes N frames off the end of the loop and
+ * blends them with the N frames before the loop start, so the loop goes
+ * on at exactly the loop start. If the loop start is less than N frames
+ * into the data, the frames before it aren't there: then the blend is
+ * with the first N frames of the loop, and it goes on after them.
+ ----------------------------------------------------------------------*/
+
+void WavStream::setLoop(bool on, int crossfadeFrames) {
+  if (crossfadeFrames < 0)
+    crossfadeFrames = 0;
+  else if (crossfadeFrames > WAV_SEAM_MAX_FRAMES)
+    crossfadeFrames = WAV_SEAM_MAX_FRAMES;
+  if (on == _looping && crossfadeFrames == _loopFrames)
+    return;
+  _looping = on;
+  _loopFrames = crossfadeFrames;
+  if (_state == wavIdle)
+    return;
+
+  // While playing, the loop is worked out again from where the stream
+  // has got to, and what was read ahead is dropped: the file goes on from
+  // there. A capture can't survive that.
+  _setLoopPoints(_dataPos);
+  _capture = 0;
+  uint32_t from = _dataPos > _prerollBytes ? _dataPos : _prerollBytes;
+  _dataRemaining = _end > from ? _end - from : 0;
+  if (_fileReady && _prerollBytes < _format.dataBytes) {
+    _bufferPos = 0;
+    _bufferLength = 0;
+    if (!_file->seek(_format.dataOffset + from))
+      _dataRemaining = 0;
+  }
+}
+
+bool WavStream::isLooping() {
+  return _looping;
+}
+
+// from: where in the data the stream has got to; a loop that ends before
+// that can't be used, so the whole track loops instead.
+
+void WavStream::_setLoopPoints(uint32_t from) {
+  uint32_t frameBytes = 2 * _format.channels;
+  _end = _format.dataBytes;
+  _resume = 0;
+  _seamAt = _end;
+  _seamFrom = 0;
+  _seamFrames = 0;
+  _seamReady = false;
+  if (!_looping || _format.blockAlign)
+    return;                                 // IMA-ADPCM loops the whole track
+
+  uint32_t start = _format.loopStart;
+  uint32_t end = _format.loopEnd;
+  if (end == 0 || end > _format.dataBytes || start >= end || end < from) {
+    start = 0;
+    end = _format.dataBytes;
+  }
+  _end = end;
+  _resume = start;
+  _seamAt = end;
+
+  uint32_t n = _loopFrames;
+  if (n > (end - start) / 2 / frameBytes)
+    n = (end - start) / 2 / frameBytes;
+  if (n == 0)
+    return;
+  _seamFrames = n;
+  _seamAt = end - n * frameBytes;
+  if (start >= n * frameBytes) {
+    _seamFrom = start - n * frameBytes;
+  } else {
+    _seamFrom = start;
+    _resume = start + n * frameBytes;
+  }
+}
+
+// Seam frames are kept as they go by the first time, then blended in as
+// the end of the loop goes by. A chunk never spans _seamAt (see
+// readBlock()).
+
+void WavStream::_seam(int16_t *left, int16_t *right, int frames) {
+  if (_seamFrames == 0)
+    return;
+  int frameBytes = 2 * _format.channels;
+  uint32_t from = _dataPos;
+  uint32_t to = _dataPos + frames * frameBytes;
+
+  uint32_t keepEnd = _seamFrom + _seamFrames * frameBytes;
+  if (!_seamReady && from < keepEnd && to > _seamFrom) {
+    uint32_t first = from > _seamFrom ? from : _seamFrom;
+    uint32_t last = to < keepEnd ? to : keepEnd;
+    for (uint32_t pos = first; pos < last; pos += frameBytes) {
+      int i = (pos - from) / frameBytes;
+      int k = (pos - _seamFrom) / frameBytes;
+      _seamLeft[k] = left[i];
+      _seamRight[k] = right[i];
+    }
+    if (to >= keepEnd)
+      _seamReady = true;
+  }
+
+  if (_seamReady && from >= _seamAt) {
+    int n = _seamFrames;
+    int k = (from - _seamAt) / frameBytes;
+    for (int i = 0; i < frames; i++, k++) {
+      left[i]  = (int16_t)(((int32_t)left[i] * (n - k) + (int32_t)_seamLeft[k] * (k + 1)) / (n + 1));
+      right[i] = (int16_t)(((int32_t)right[i] * (n - k) + (int32_t)_seamRight[k] * (k + 1)) / (n + 1));
+    }
+  }
+}
+
+// RIFF header, then chunks: "fmt " has to come before "data", and
+// anything else (LIST, ...) is skipped. Chunks are padded to an even
+// length. With loopPoints, the first loop of a "smpl" chunk, which is
+// often after the data, so then the chunks after the data are read too.
+// Either way the file is left at the start of the data.
+
+static bool readSmpl(SampleFile *file, uint32_t size, uint32_t *start, uint32_t *end) {
+  uint8_t s[36 + 24];
+  if (size < sizeof(s) || file->read(s, sizeof(s)) != (int)sizeof(s) || get32(s + 28) == 0)
+    return false;
+  *start = get32(s + 36 + 8);               // frames; the end frame is played
+  *end = get32(s + 36 + 12) + 1;
+  return true;
+}
+
+bool WavStream::readHeader(SampleFile *file, WavFormat *format, bool loopPoints) {
+  uint8_t h[24];
+  if (file->read(h, 12) != 12 || memcmp(h, "RIFF", 4) != 0 || memcmp(h + 8, "WAVE", 4) != 0)
+    return false;
+  uint32_t position = 12;
+  bool haveFormat = false;
+  bool haveData = false;
+  bool haveLoop = false;
+  uint32_t loopStart = 0, loopEnd = 0;
+  format->loopStart = 0;
+  format->loopEnd = 0;
+  for (int chunks = 0; chunks < 32; chunks++) {
+    if (haveData && position + 8 > file->size())
+      break;
+    if (file->read(h, 8) != 8) {
+      if (haveData)
+        break;
+      return false;
+    }
+    uint32_t size = get32(h + 4);
+    position += 8;
+    if (memcmp(h, "fmt ", 4) == 0) {
+      if (size < 16 || file->read(h + 8, 16) != 16)
+        return false;
+      uint16_t type = get16(h + 8);
+      format->channels = get16(h + 10);
+      format->bytesPerSecond = get32(h + 16);
+      uint16_t blockAlign = get16(h + 20);
+      uint16_t bits = get16(h + 22);
+      format->blockAlign = 0;
+      if (type == 0x11 && bits == 4 && ImaAdpcmDecoder::isValidFormat(format->channels, blockAlign))
+        format->blockAlign = blockAlign;
+      else if (type != 1 || bits != 16)
+        return false;
+      if (format->channels < 1 || format->channels > 2 || format->bytesPerSecond == 0)
+        return false;
+      haveFormat = true;
+    } else if (memcmp(h, "data", 4) == 0 && !haveData) {
+      if (!haveFormat)
+        return false;
+      format->dataOffset = position;
+      format->dataBytes = size;
+      if (format->dataBytes > file->size() - position)
+        format->dataBytes = file->size() - position;
+      haveData = true;
+      if (!loopPoints || haveLoop)
+        break;
+    } else if (loopPoints && memcmp(h, "smpl", 4) == 0 && !haveLoop) {
+      haveLoop = readSmpl(file, size, &loopStart, &loopEnd);
+      if (haveData)
+        break;
+    }
+    position += size + (size & 1);
+    if (!file->seek(position)) {
+      if (haveData)
+        break;
+      return false;
+    }
+  }
+  if (!haveData)
+    return false;
+  if (haveLoop && format->blockAlign == 0) {
+    uint32_t frameBytes = 2 * format->channels;
+    format->loopStart = loopStart * frameBytes;
+    format->loopEnd = loopEnd * frameBytes;
+  }
+  return loopPoints ? file->seek(format->dataOffset) : true;
+}
+
+// Moves what's left to the front of the buffer and reads as much as
+// fits. A looping stream goes back to the loop and carries on filling.
+
+void WavStream::_fill() {
+  int left = _bufferLength - _bufferPos;
+  if (left > 0 && _bufferPos > 0)
+    memmove(_buffer, _buffer + _bufferPos, left);
+  _bufferPos = 0;
+  _bufferLength = left;
+  uint32_t space = WAV_BUFFER_BYTES - left;
+  while (space > 0) {
+    if (_dataRemaining == 0 && (!_looping || _readError || !_wrapFile()))
+      return;
+    uint32_t want = space < _dataRemaining ? space : _dataRemaining;
+    int n = _file->read(_buffer + _bufferLength, want);
+    if (n <= 0) {
+      _dataRemaining = 0;                  // read error: treat it as the end,
+      _readError = true;                   // even when looping
+      return;
+    }
+    if (_capture && !_wrapped) {
+      memcpy(_capture + _captureBytes, _buffer + _bufferLength, n);
+      _captureBytes += n;
+    }
+    _bufferLength += n;
+    _dataRemaining -= n;
+    space -= n;
+  }
+}
+
+// The file goes on from the loop start, or from the end of the
+// pre-roll, if the loop starts inside it: readBlock() takes that part
+// from memory again.
+
+bool WavStream::_wrapFile() {
+  uint32_t target = _resume > _prerollBytes ? _resume : _prerollBytes;
+  if (target >= _end || !_file->seek(_format.dataOffset + target))
+    return false;
+  _dataRemaining = _end - target;
+  _wrapped = true;
+  return true;
+}
+
+int WavStream::_copyFrames(const uint8_t *p, int frames, int16_t *left, int16_t *right) {
+  if (_format.channels == 2) {
+    for (int i = 0; i < frames; i++, p += 4) {
+      left[i] = (int16_t)get16(p);
+      right[i] = (int16_t)get16(p + 2);
+    }
+  } else {
+    for (int i = 0; i < frames; i++, p += 2)
+      left[i] = right[i] = (int16_t)get16(p);
+  }
+  return frames;
+}
+
+// Frames come from the pre-roll while there is any, then from the
+// buffer. A block is made of chunks that stop at the pre-roll's end, the
+// seam and the loop end, so a block can have some of each, and a loop
+// goes round within it.
+
+bool WavStream::readBlock(int16_t *left, int16_t *right) {
+  if (_state != wavPlaying)
+    return false;
+  if (_format.blockAlign)
+    return _readCompressed(left, right);
+  int frameBytes = 2 * _format.channels;
+  int i = 0;
+  bool ended = false;
+
+  while (i < WAV_BLOCK_SAMPLES) {
+    uint32_t limit = _dataPos < _seamAt ? _seamAt : _end;
+    int frames = (limit - _dataPos) / frameBytes;
+    if (frames > WAV_BLOCK_SAMPLES - i)
+      frames = WAV_BLOCK_SAMPLES - i;
+
+    if (_dataPos < _prerollBytes) {
+      int inMemory = (_prerollBytes - _dataPos) / frameBytes;
+      if (frames > inMemory)
+        frames = inMemory;
+      _copyFrames(_preroll + _dataPos, frames, left + i, right + i);
+    } else if (!_fileReady) {
+      for (; i < WAV_BLOCK_SAMPLES; i++)      // the card is late: silence, and
+        left[i] = right[i] = 0;               // carry on from here next time
+      _underruns++;
+      return true;
+    } else {
+      if (_bufferLength - _bufferPos < frames * frameBytes && (_dataRemaining > 0 || _looping))
+        _fill();
+      int inBuffer = (_bufferLength - _bufferPos) / frameBytes;
+      if (frames > inBuffer)
+        frames = inBuffer;
+      _copyFrames(_buffer + _bufferPos, frames, left + i, right + i);
+      _bufferPos += frames * frameBytes;
+    }
+    if (frames <= 0) {
+      ended = true;
+      break;
+    }
+
+    _seam(left + i, right + i, frames);
+    i += frames;
+    _dataPos += frames * frameBytes;
+    _bytesPlayed += frames * frameBytes;
+    if (_looping && _dataPos >= _end)
+      _dataPos = _resume;
+  }
+  for (; i < WAV_BLOCK_SAMPLES; i++)
+    left[i] = right[i] = 0;
+
+  if (ended || (!_looping && _dataPos >= _end))
+    stop();                                 // that was the last block
+  return true;
+}
+
+// IMA-ADPCM: the same, but in bytes, which the decoder takes however
+// many there are. It can still have frames from the last group when the
+// data is all taken (or the file is late), so the track only ends when
+// those are out too. A loop is always the whole track, back to a block
+// start.
+
+bool WavStream::_readCompressed(int16_t *left, int16_t *right) {
+  int i = 0;
+  bool ended = false;
+
+  while (i < WAV_BLOCK_SAMPLES) {
+    int frames = WAV_BLOCK_SAMPLES - i;
+    uint32_t bytes = _end > _dataPos ? _end - _dataPos : 0;
+    int used = 0;
+    int decoded;
+    if (_dataPos < _prerollBytes) {
+      if (bytes > _prerollBytes - _dataPos)
+        bytes = _prerollBytes - _dataPos;
+      decoded = _adpcm.decode(_preroll + _dataPos, bytes, left + i, right + i, frames, &used);
+    } else if (_fileReady) {
+      if (_bufferPos == _bufferLength && (_dataRemaining > 0 || _looping))
+        _fill();
+      if (bytes > (uint32_t)(_bufferLength - _bufferPos))
+        bytes = _bufferLength - _bufferPos;
+      decoded = _adpcm.decode(_buffer + _bufferPos, bytes, left + i, right + i, frames, &used);
+      _bufferPos += used;
+    } else {
+      decoded = _adpcm.decode(0, 0, left + i, right + i, frames, &used);
+      if (decoded == 0) {
+        for (; i < WAV_BLOCK_SAMPLES; i++)    // the card is late: silence, and
+          left[i] = right[i] = 0;             // carry on from here next time
+        _underruns++;
+        return true;
+      }
+    }
+    if (decoded == 0 && used == 0) {
+      ended = true;
+      break;
+    }
+
+    i += decoded;
+    _dataPos += used;
+    _bytesPlayed += used;
+    if (_looping && _dataPos >= _end) {
+      _dataPos = _resume;
+      _adpcm.restart();
+    }
+  }
+  for (; i < WAV_BLOCK_SAMPLES; i++)
+    left[i] = right[i] = 0;
+
+  if (ended || (!_looping && _dataPos >= _end && !_adpcm.hasFrames()))
+    stop();
+  return true;
+}
@@ -0,0 +1,173 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * Streams a WAV file's samples from a SampleFile, one audio block at a
+ * time. Opening a track is split in two so it can be done ahead of time:
+ *
+ *   open()       opens the file, parses the header and fills the buffer
+ *                (all the slow card access); nothing is heard yet. The
+ *                fill can be left to the first readBlock(), to keep many
+ *                tracks open at less card time.
+ *   start()      from then on readBlock() returns the samples
+ *
+ * Between the two the stream is "armed", and stop() cancels it without
+ * any more card access. play-on-touch then costs only start(), instead
+ * of a directory lookup and two or three sector reads.
+ *
+ * Or a track can start from a pre-roll: its first samples, already in
+ * memory (see PrerollCache). startPreroll() plays them right away, with
+ * no card access at all; openRest() then opens the file at the first
+ * byte after them and the stream carries on from the card without a
+ * seam. If the pre-roll runs out before openRest() the stream outputs
+ * silence (counted as underruns) and carries on where it left off.
+ * A whole track in memory plays the same way, and never needs a file.
+ *
+ * While a file is streamed, its samples can also be copied ("captured")
+ * to memory as they're read: setCapture() between open() and start().
+ * That's how a short track gets into the SampleCache at no extra card
+ * cost; isCaptured() says when the copy is complete.
+ *
+ * A stream can loop (setLoop()), with no gap: at the end of the data,
+ * or at the loop end of a "smpl" chunk if the file has one, it goes on
+ * at the loop start in the same block, without closing the file. The
+ * seam can be smoothed with a short crossfade: the last frames before
+ * the loop end are blended with the frames that lead up to the point
+ * where the loop goes on (kept from the first time through), so the
+ * waveform arrives at that point as if it had got there by itself.
+ * Loop points are read by readHeader(..., true); the file's "smpl"
+ * chunk can be after the data, which costs a seek.
+ *
+ * 16-bit PCM, mono or stereo. Like the Teensy's own WAV player, the
+ * sample rate isn't converted; files should be 44.1 kHz.
+ *
+ * Or IMA-ADPCM (WAV format 0x11, see ImaAdpcmDecoder), a quarter of the
+ * size: everything above works the same, in bytes of the compressed
+ * data, which readBlock() decodes as it goes. Looping is of the whole
+ * track; loop points and the seam crossfade are for PCM only.
+ *
+ * readBlock() is meant to be called from the audio interrupt; it reads
+ * more of the file when the buffer runs low. Everything else is called
+ * from the loop, with the audio interrupt off when the stream could be
+ * playing (see AudioPlaySdWavPR).
+ *
+ * No Arduino dependencies.
+ ----------------------------------------------------------------------*/
+
+#ifndef WavStream_h
+#define WavStream_h 1
+
+#include <stdint.h>
+#include "SampleFile.h"
+#include "ImaAdpcmDecoder.h"
+
+#define WAV_BLOCK_SAMPLES 128               // same as AUDIO_BLOCK_SAMPLES
+#define WAV_BUFFER_BYTES  1024              // two sectors
+#define WAV_SEAM_MAX_FRAMES 256             // loop crossfade, about 5.8 msec
+
+enum WavStreamState {wavIdle, wavArmed, wavPlaying};
+
+struct WavFormat {
+  uint16_t channels;
+  uint32_t bytesPerSecond;
+  uint32_t dataOffset;                      // where the samples start in the file
+  uint32_t dataBytes;
+  uint32_t loopStart;                       // bytes into the data; loopEnd 0 == the whole track
+  uint32_t loopEnd;
+  uint16_t blockAlign;                      // IMA-ADPCM: bytes per block; 0 == 16-bit PCM
+};
+
+class WavStream
+{
+ public:
+  WavStream();
+
+  bool     open(SampleFile *file, const char *path, bool fill = true);
+  void     start();
+  void     stop();
+  bool     isArmed();
+  bool     isPlaying();
+
+  void     startPreroll(const WavFormat *format, const uint8_t *preroll, uint32_t bytes);
+  bool     needsFile();                     // playing a pre-roll, and openRest() hasn't been called
+  bool     openRest(SampleFile *file, const char *path);
+  bool     readsFile();                     // readBlock() may read the card
+  uint32_t getUnderruns();
+
+  void     setLoop(bool on, int crossfadeFrames = 0);   // stays set for the next tracks
+  bool     isLooping();
+
+  bool     setCapture(uint8_t *destination);    // dataBytes long
+  bool     isCaptured();
+  const WavFormat *getFormat();
+
+  static bool readHeader(SampleFile *file, WavFormat *format, bool loopPoints = false);
+
+  bool     readBlock(int16_t *left, int16_t *right);    // false if not playing; the last block is zero-padded
+
+  int      getChannels();
+  uint32_t positionMillis();                // time played (goes on counting when looping)
+  uint32_t lengthMillis();
+
+ private:
+  SampleFile *_file;
+  volatile uint8_t _state;
+  WavFormat _format;
+  uint32_t _dataRemaining;                  // not yet read from the file
+  volatile uint32_t _bytesPlayed;
+  uint32_t _dataPos;                        // where in the data the next frame comes from
+  uint8_t  _buffer[WAV_BUFFER_BYTES] __attribute__((aligned(4)));
+  int      _bufferPos;
+  int      _bufferLength;
+  const uint8_t *_preroll;
+  uint32_t _prerollBytes;
+  volatile bool _fileReady;                 // _buffer and _file are in use
+  uint32_t _underruns;
+  uint8_t *_capture;
+  volatile uint32_t _captureBytes;
+
+  // Looping. Byte positions in the data: _dataPos goes from _end back to
+  // _resume; the seam crossfade is over [_seamAt, _end), with the frames
+  // from _seamFrom kept in _seamLeft/_seamRight.
+  volatile bool _looping;
+  int      _loopFrames;                     // seam crossfade asked for
+  bool     _wrapped;                        // the file has gone round at least once
+  bool     _readError;
+  uint32_t _end;
+  uint32_t _resume;
+  uint32_t _seamAt;
+  uint32_t _seamFrom;
+  int      _seamFrames;
+  bool     _seamReady;
+  int16_t  _seamLeft[WAV_SEAM_MAX_FRAMES];
+  int16_t  _seamRight[WAV_SEAM_MAX_FRAMES];
+
+  ImaAdpcmDecoder _adpcm;
+
+  void     _fill();
+  bool     _wrapFile();
+  void     _setLoopPoints(uint32_t from);
+  void     _seam(int16_t *left, int16_t *right, int frames);
+  int      _copyFrames(const uint8_t *p, int frames, int16_t *left, int16_t *right);
+  bool     _readCompressed(int16_t *left, int16_t *right);
+};
+
+#endif
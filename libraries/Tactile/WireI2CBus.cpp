@@ -0,0 +1,53 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+#include "WireI2CBus.h"
+
+WireI2CBus::WireI2CBus(uint32_t clockHz) {
+  _clockHz = clockHz;
+}
+
+void WireI2CBus::begin() {
+  Wire.begin();
+  Wire.setClock(_clockHz);
+}
+
+bool WireI2CBus::writeRegister(uint8_t address, uint8_t reg, uint8_t value) {
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  Wire.write(value);
+  return Wire.endTransmission() == 0;
+}
+
+// Repeated start between the register address and the read, so it's all
+// one transaction.
+
+bool WireI2CBus::readRegisters(uint8_t address, uint8_t reg, uint8_t *buffer, int count) {
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  if (Wire.endTransmission(false) != 0)
+    return false;
+  if (Wire.requestFrom(address, (uint8_t)count) != count)
+    return false;
+  for (int i = 0; i < count; i++)
+    buffer[i] = Wire.read();
+  return true;
+}
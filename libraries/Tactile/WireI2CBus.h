@@ -0,0 +1,47 @@
+/* -*-C-*-
++======================================================================
+| Copyright (c) 2025, Craig A. James
+|
+| This file is part of of the "TactileAudio" library.
+|
+| TactileAudio is free software: you can redistribute it and/or modify it under
+| the terms of the GNU Lesser General Public License (LGPL) as published by
+| the Free Software Foundation, either version 3 of the License, or (at
+| your option) any later version.
+|
+| TactileAudio is distributed in the hope that it will be useful, but WITHOUT
+| ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+| FITNESS FOR A PARTICULAR PURPOSE. See the LGPL for more details.
+|
+| You should have received a copy of the LGPL along with TactileAudio. If not,
+| see <https://www.gnu.org/licenses/>.
++======================================================================
+*/
+
+
+/*----------------------------------------------------------------------
+ * I2CBus on the Teensy's Wire library (pins 18 and 19, shared with the
+ * audio shield's control interface, which doesn't mind).
+ ----------------------------------------------------------------------*/
+
+#ifndef WireI2CBus_h
+#define WireI2CBus_h 1
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "I2CBus.h"
+
+class WireI2CBus : public I2CBus
+{
+ public:
+  WireI2CBus(uint32_t clockHz);
+
+  void begin();
+  bool writeRegister(uint8_t address, uint8_t reg, uint8_t value);
+  bool readRegisters(uint8_t address, uint8_t reg, uint8_t *buffer, int count);
+
+ private:
+  uint32_t _clockHz;
+};
+
+#endif
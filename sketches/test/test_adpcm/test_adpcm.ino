@@ -0,0 +1,350 @@
+/*----------------------------------------------------------------------
+ * Checks IMA-ADPCM tracks (no card or audio shield needed; it can be
+ * built on a regular computer too). A test signal is encoded here, then
+ * decoded by a plain block-at-a-time reference decoder (the algorithm
+ * as the IMA recommendation gives it), and by the WavStream:
+ *
+ *   known values  the first samples of a hand-worked block
+ *   header        format 0x11 recognized, past a "fact" chunk
+ *   chunks        the ImaAdpcmDecoder given the bytes in odd-sized
+ *                 pieces: the same samples as the reference, bit for bit
+ *   stream        stereo and mono, played from the simulated card
+ *   pre-roll      an odd number of bytes in memory, then the card
+ *   loop          end to start, and again
+ *   card time     compared with the same sound as 16-bit PCM
+ *   quality       signal to noise ratio against the original
+ *
+ * and prints the CPU cycles per audio block, decoding, against PCM.
+ * Each check prints "ok" or "FAILED".
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include <math.h>
+#include "WavStream.h"
+
+#define NUM_FRAMES     22050                // 0.5 sec
+#define STEREO_ALIGN   1024                 // 1017 frames per block
+#define MONO_ALIGN     512                  // 1017 frames per block
+#define FRAMES_PER_BLOCK 1017
+#define NUM_BLOCKS     ((NUM_FRAMES + FRAMES_PER_BLOCK - 1) / FRAMES_PER_BLOCK)
+#define HEADER_BYTES   (12 + 28 + 12 + 8)   // RIFF, fmt, fact, data
+
+static const int16_t steps[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41,
+  45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190,
+  209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724,
+  796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272,
+  2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132,
+  7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500,
+  20350, 22385, 24623, 27086, 29794, 32767
+};
+static const int indexSteps[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+int16_t original[2][NUM_FRAMES];
+int16_t reference[2][NUM_FRAMES + 8];     // and the padding of the last group
+uint32_t decodedFrames;
+uint8_t stereoFile[HEADER_BYTES + NUM_BLOCKS * STEREO_ALIGN];
+uint8_t monoFile[HEADER_BYTES + NUM_BLOCKS * MONO_ALIGN];
+uint8_t pcmFile[44 + NUM_FRAMES * 4];
+uint32_t stereoSize, monoSize;
+
+/*---- The reference: one sample at a time, straight from the recommendation ----*/
+
+struct Channel {
+  int32_t predicted;
+  int index;
+};
+
+static int16_t expand(Channel *c, int nibble) {
+  int step = steps[c->index];
+  int32_t diff = step >> 3;
+  if (nibble & 4) diff += step;
+  if (nibble & 2) diff += step >> 1;
+  if (nibble & 1) diff += step >> 2;
+  if (nibble & 8)
+    c->predicted -= diff;
+  else
+    c->predicted += diff;
+  if (c->predicted > 32767) c->predicted = 32767;
+  if (c->predicted < -32768) c->predicted = -32768;
+  c->index += indexSteps[nibble & 7];
+  if (c->index < 0) c->index = 0;
+  if (c->index > 88) c->index = 88;
+  return c->predicted;
+}
+
+static int compress(Channel *c, int16_t sample) {
+  int32_t diff = sample - c->predicted;
+  int nibble = 0;
+  if (diff < 0) {
+    nibble = 8;
+    diff = -diff;
+  }
+  int step = steps[c->index];
+  for (int bit = 4; bit > 0; bit >>= 1, step >>= 1) {
+    if (diff >= step) {
+      nibble |= bit;
+      diff -= step;
+    }
+  }
+  expand(c, nibble);                        // keep in step with the decoder
+  return nibble;
+}
+
+// Whole blocks, the last one cut short after the last group it needs.
+// Returns the data bytes.
+static uint32_t encode(uint8_t *data, int channels) {
+  Channel state[2] = {{0, 0}, {0, 0}};
+  uint8_t *p = data;
+  for (int start = 0; start < NUM_FRAMES; start += FRAMES_PER_BLOCK) {
+    for (int c = 0; c < channels; c++) {
+      state[c].predicted = original[c][start];
+      wavPut16(p, state[c].predicted);
+      p[2] = state[c].index;
+      p[3] = 0;
+      p += 4;
+    }
+    for (int f = start + 1; f < start + FRAMES_PER_BLOCK && f < NUM_FRAMES; f += 8) {
+      for (int c = 0; c < channels; c++) {
+        for (int i = 0; i < 8; i += 2) {
+          int a = f + i < NUM_FRAMES ? original[c][f + i] : 0;
+          int b = f + i + 1 < NUM_FRAMES ? original[c][f + i + 1] : 0;
+          int low = compress(&state[c], a);
+          *p++ = low | (compress(&state[c], b) << 4);
+        }
+      }
+    }
+  }
+  return p - data;
+}
+
+static void referenceDecode(const uint8_t *data, uint32_t bytes, int channels, int blockAlign) {
+  int frame = 0;
+  for (uint32_t block = 0; block < bytes; block += blockAlign) {
+    const uint8_t *p = data + block;
+    const uint8_t *end = data + (bytes - block < (uint32_t)blockAlign ? bytes : block + blockAlign);
+    Channel state[2];
+    for (int c = 0; c < channels; c++, p += 4) {
+      state[c].predicted = (int16_t)(p[0] | (p[1] << 8));
+      state[c].index = p[2];
+      reference[c][frame] = state[c].predicted;
+    }
+    frame++;
+    for (; p < end; p += 4 * channels, frame += 8) {
+      for (int c = 0; c < channels; c++) {
+        for (int i = 0; i < 8; i++) {
+          int nibble = (p[4*c + i/2] >> (4 * (i & 1))) & 0x0F;
+          reference[c][frame + i] = expand(&state[c], nibble);
+        }
+      }
+    }
+  }
+  decodedFrames = frame;
+}
+
+static uint32_t makeAdpcm(uint8_t *file, int channels, int blockAlign) {
+  uint8_t *data = file + HEADER_BYTES;
+  uint32_t bytes = encode(data, channels);
+  memcpy(file, "RIFF", 4);
+  wavPut32(file + 4, HEADER_BYTES - 8 + bytes);
+  memcpy(file + 8, "WAVEfmt ", 8);
+  wavPut32(file + 16, 20);
+  wavPut16(file + 20, 0x11);
+  wavPut16(file + 22, channels);
+  wavPut32(file + 24, 44100);
+  wavPut32(file + 28, (uint32_t)44100 * blockAlign / FRAMES_PER_BLOCK);
+  wavPut16(file + 32, blockAlign);
+  wavPut16(file + 34, 4);
+  wavPut16(file + 36, 2);
+  wavPut16(file + 38, FRAMES_PER_BLOCK);
+  memcpy(file + 40, "fact", 4);
+  wavPut32(file + 44, 4);
+  wavPut32(file + 48, NUM_FRAMES);
+  memcpy(file + 52, "data", 4);
+  wavPut32(file + 56, bytes);
+  return HEADER_BYTES + bytes;
+}
+
+static void makePcm() {
+  makeWavHeader(pcmFile, 2, 44100, NUM_FRAMES * 4);
+  for (int i = 0; i < NUM_FRAMES; i++) {
+    wavPut16(pcmFile + 44 + 4*i, original[0][i]);
+    wavPut16(pcmFile + 46 + 4*i, original[1][i]);
+  }
+}
+
+/*---- Checks ----*/
+
+static void check(const char *what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? ": ok" : ": FAILED");
+}
+
+SimulatedSd sd;
+SimulatedSdFile file(&sd);
+int16_t left[WAV_BLOCK_SAMPLES], right[WAV_BLOCK_SAMPLES];
+
+// Plays the stream to its end (or for maxBlocks), comparing with the
+// reference from frame "from" on, round again at the end when looping.
+// Returns the frames that differ; *frames is how many came out.
+static int play(WavStream *stream, int channels, int maxBlocks, uint32_t from, uint32_t *frames) {
+  int wrong = 0;
+  uint32_t n = from;
+  for (int b = 0; b < maxBlocks && stream->readBlock(left, right); b++) {
+    for (int i = 0; i < WAV_BLOCK_SAMPLES; i++, n++) {
+      if (n >= decodedFrames && !stream->isLooping())
+        continue;                           // the zeros after the end
+      uint32_t f = n % decodedFrames;
+      if (left[i] != reference[0][f] || right[i] != reference[channels - 1][f])
+        wrong++;
+    }
+  }
+  *frames = n - from;
+  return wrong;
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+
+  // Two tones and a little noise, a different mix on each side
+  for (int i = 0; i < NUM_FRAMES; i++) {
+    float t = i / 44100.0;
+    original[0][i] = 9000 * sin(2 * M_PI * 440 * t) + 3000 * sin(2 * M_PI * 3100 * t) + random(401) - 200;
+    original[1][i] = 6000 * sin(2 * M_PI * 660 * t) + 5000 * sin(2 * M_PI * 1250 * t) + random(401) - 200;
+  }
+
+  // Known values: sample 0, step index 0; nibbles 7 then 0:
+  // +(7/8 + 7 + 7/2 + 7/4) = 11, then index 8 (step 16): +16/8 = 13
+  {
+    uint8_t block[8] = {0, 0, 0, 0, 0x07, 0, 0, 0};
+    ImaAdpcmDecoder decoder;
+    decoder.begin(1, 8);
+    int used;
+    int n = decoder.decode(block, 8, left, right, 9, &used);
+    check("known values", n == 9 && used == 8 && left[0] == 0 && left[1] == 11 && left[2] == 13
+          && right[1] == 11);
+  }
+
+  stereoSize = makeAdpcm(stereoFile, 2, STEREO_ALIGN);
+  monoSize = makeAdpcm(monoFile, 1, MONO_ALIGN);
+  makePcm();
+  sd.addFile("/E1/STEREO.WAV", stereoFile, stereoSize);
+  sd.addFile("/E1/MONO.WAV", monoFile, monoSize);
+  sd.addFile("/E1/PCM.WAV", pcmFile, sizeof(pcmFile));
+
+  WavFormat format;
+  file.open("/E1/STEREO.WAV");
+  bool header = WavStream::readHeader(&file, &format) && format.blockAlign == STEREO_ALIGN
+                && format.channels == 2 && format.dataOffset == HEADER_BYTES
+                && format.dataBytes == stereoSize - HEADER_BYTES;
+  file.close();
+  check("header", header);
+
+  // The decoder by itself, fed 1 to 13 bytes at a time, asked for 1 to 20 frames
+  const uint8_t *data = stereoFile + HEADER_BYTES;
+  uint32_t dataBytes = stereoSize - HEADER_BYTES;
+  referenceDecode(data, dataBytes, 2, STEREO_ALIGN);
+  ImaAdpcmDecoder decoder;
+  decoder.begin(2, STEREO_ALIGN);
+  uint32_t pos = 0;
+  int frame = 0, wrong = 0;
+  for (int k = 0; frame < NUM_FRAMES; k++) {
+    int bytes = 1 + k % 13;
+    if (bytes > (int)(dataBytes - pos))
+      bytes = dataBytes - pos;
+    int used;
+    int n = decoder.decode(data + pos, bytes, left, right, 1 + k % 20, &used);
+    pos += used;
+    for (int i = 0; i < n && frame < NUM_FRAMES; i++, frame++)
+      if (left[i] != reference[0][frame] || right[i] != reference[1][frame])
+        wrong++;
+    if (n == 0 && used == 0)
+      break;
+  }
+  check("decoded in odd-sized pieces, bit for bit", wrong == 0 && frame == NUM_FRAMES);
+
+  // From the card, to the end
+  WavStream stream;
+  uint32_t frames;
+  stream.open(&file, "/E1/STEREO.WAV");
+  stream.start();
+  sd.resetBusyMicros();
+  wrong = play(&stream, 2, 1000, 0, &frames);
+  uint32_t adpcmMicros = sd.getBusyMicros();
+  check("stereo from the card, bit for bit, to the end",
+        wrong == 0 && frames >= NUM_FRAMES && frames < NUM_FRAMES + WAV_BLOCK_SAMPLES + 8
+        && !stream.isPlaying());
+
+  referenceDecode(monoFile + HEADER_BYTES, monoSize - HEADER_BYTES, 1, MONO_ALIGN);
+  stream.open(&file, "/E1/MONO.WAV");
+  stream.start();
+  wrong = play(&stream, 1, 1000, 0, &frames);
+  check("mono from the card, bit for bit", wrong == 0 && frames >= NUM_FRAMES);
+  referenceDecode(data, dataBytes, 2, STEREO_ALIGN);
+
+  // 1001 bytes in memory: the card goes on in the middle of a group
+  stream.startPreroll(&format, data, 1001);
+  wrong = play(&stream, 2, 3, 0, &frames);
+  stream.openRest(&file, "/E1/STEREO.WAV");
+  uint32_t more;
+  wrong += play(&stream, 2, 1000, frames, &more);
+  check("pre-roll, then the card", wrong == 0 && frames + more >= NUM_FRAMES
+        && stream.getUnderruns() == 0);
+
+  stream.setLoop(true);
+  stream.open(&file, "/E1/STEREO.WAV");
+  stream.start();
+  wrong = play(&stream, 2, 3 * NUM_FRAMES / WAV_BLOCK_SAMPLES, 0, &frames);
+  check("loops end to start", wrong == 0 && stream.isPlaying());
+  stream.setLoop(false);
+  stream.stop();
+
+  // Card time for the same sound
+  stream.open(&file, "/E1/PCM.WAV");
+  stream.start();
+  sd.resetBusyMicros();
+  while (stream.readBlock(left, right))
+    ;
+  uint32_t pcmMicros = sd.getBusyMicros();
+  Serial.print("card time, usec: PCM ");
+  Serial.print(pcmMicros);
+  Serial.print(", IMA-ADPCM ");
+  Serial.println(adpcmMicros);
+  check("a quarter of the card time", adpcmMicros * 3 < pcmMicros);
+
+  double signal = 0, noise = 0;
+  for (int c = 0; c < 2; c++) {
+    for (int i = 0; i < NUM_FRAMES; i++) {
+      double d = reference[c][i] - original[c][i];
+      signal += (double)original[c][i] * original[c][i];
+      noise += d * d;
+    }
+  }
+  double snr = 10 * log10(signal / noise);
+  Serial.print("signal to noise, dB: ");
+  Serial.println(snr, 1);
+  check("quality", snr > 25);
+
+  // Cycles per audio block, all in memory so it's only the decoding
+  int blocks = 0;
+  stream.startPreroll(&format, data, dataBytes);
+  uint32_t start = ARM_DWT_CYCCNT;
+  while (stream.readBlock(left, right))
+    blocks++;
+  uint32_t adpcmCycles = (ARM_DWT_CYCCNT - start) / blocks;
+  WavFormat pcmFormat = {2, 44100 * 4, 44, NUM_FRAMES * 4};
+  blocks = 0;
+  stream.startPreroll(&pcmFormat, pcmFile + 44, NUM_FRAMES * 4);
+  start = ARM_DWT_CYCCNT;
+  while (stream.readBlock(left, right))
+    blocks++;
+  uint32_t pcmCycles = (ARM_DWT_CYCCNT - start) / blocks;
+  Serial.print("cycles per block: PCM ");
+  Serial.print(pcmCycles);
+  Serial.print(", IMA-ADPCM ");
+  Serial.println(adpcmCycles);
+}
+
+void loop() {
+}
@@ -0,0 +1,122 @@
+/*----------------------------------------------------------------------
+ * Checks the BaselineTracker on synthetic traces (no hardware needed; it
+ * can be built on a regular computer too). The traces are what Sensors
+ * feeds it: the filtered reading, Q16, at 2000 samples/sec, and nothing
+ * while the sensor is touched.
+ *
+ *   warm-up     after 2^k updates it averages over 2^k samples, and is
+ *               settled after the tracking time
+ *   drift       an hour in which the idle level creeps up by 15% of
+ *               full scale, with touches now and then: the baseline
+ *               stays within a few noise sigmas of the true level
+ *   noise       the noise sigma comes out right
+ *   drop        a sudden drop is followed faster than a rise
+ *
+ * and prints the cycles per update. Each check prints "ok" or "FAILED".
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include <math.h>
+#include "BaselineTracker.h"
+
+#define RATE          2000
+#define TRACKING      16000               // samples: BASELINE_TRACKING_MSEC at 2 kHz
+#define Q16(x)        ((int32_t)((x) * 65536.0))
+#define NOISE_COUNTS  2.0                 // sigma, in ADC counts of 1023
+
+static uint32_t randomState = 12345;
+
+// Roughly normal, sigma 1: the sum of four uniform numbers
+static float noise() {
+  float sum = 0;
+  for (int i = 0; i < 4; i++) {
+    randomState = randomState * 1664525 + 1013904223;
+    sum += (float)(randomState >> 8) / 16777216.0 - 0.5;
+  }
+  return sum * 1.7320508;
+}
+
+static void check(const char *what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? ": ok" : ": FAILED");
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+  BaselineTracker tracker;
+
+  // Warm-up: a step after 2^k updates moves the mean by 1/2^k of it
+  tracker.setTrackingSamples(1024);
+  bool warmup = true;
+  for (int k = 0; k <= 10; k++) {
+    tracker.reset(0);
+    for (int i = 0; i < (1 << k) - 1; i++)
+      tracker.update(0);
+    tracker.update(Q16(1024));              // the 2^k-th update
+    if (tracker.getBaseline() != Q16(1024) >> k)
+      warmup = false;
+    if (tracker.isSettled() != (k == 10))
+      warmup = false;
+  }
+  check("warm-up: 2^k samples after 2^k updates", warmup);
+
+  // An hour of drift, with a touch of 5 sec every minute
+  tracker.setTrackingSamples(TRACKING);
+  float level = 300.0;
+  tracker.reset(Q16(level));
+  const float drift = 0.15 * 1023.0 / (3600.0 * RATE);
+  float worst = 0;
+  uint32_t updates = 0;
+  for (uint32_t i = 0; i < 3600UL * RATE; i++) {
+    level += drift;
+    bool touched = (i % (60 * RATE)) >= 55UL * RATE;
+    if (touched)
+      continue;                             // Sensors doesn't update while touched
+    tracker.update(Q16(level + NOISE_COUNTS * noise()));
+    updates++;
+    if (i > 10UL * RATE) {
+      float error = fabs(tracker.getBaseline() / 65536.0 - level);
+      if (error > worst)
+        worst = error;
+    }
+  }
+  float sigma = tracker.getNoise() / 65536.0;
+  Serial.print("an hour of drift, 153 counts: worst baseline error ");
+  Serial.print(worst, 2);
+  Serial.print(" counts, noise sigma ");
+  Serial.print(sigma, 2);
+  Serial.print(" counts (really ");
+  Serial.print(NOISE_COUNTS, 2);
+  Serial.println(")");
+  check("drift followed to within 3 sigmas", worst < 3 * NOISE_COUNTS);
+  check("noise sigma within 20%", fabs(sigma - NOISE_COUNTS) < 0.2 * NOISE_COUNTS);
+
+  // A drop of 20 sigmas, and the same rise: samples to get halfway
+  int halfway[2];
+  for (int direction = 0; direction < 2; direction++) {
+    float start = 500.0;
+    float end = direction == 0 ? start - 20 * NOISE_COUNTS : start + 20 * NOISE_COUNTS;
+    tracker.reset(Q16(start), Q16(NOISE_COUNTS));
+    halfway[direction] = 0;
+    while (fabs(tracker.getBaseline() / 65536.0 - start) < 10 * NOISE_COUNTS && halfway[direction] < 10 * TRACKING) {
+      tracker.update(Q16(end + NOISE_COUNTS * noise()));
+      halfway[direction]++;
+    }
+  }
+  Serial.print("samples to follow a step halfway: drop ");
+  Serial.print(halfway[0]);
+  Serial.print(", rise ");
+  Serial.println(halfway[1]);
+  check("drops followed faster than rises", halfway[0] * 4 < halfway[1]);
+
+  // Cost
+  uint32_t start = ARM_DWT_CYCCNT;
+  for (int i = 0; i < 1000000; i++)
+    tracker.update(Q16(500) + (i & 255));
+  Serial.print("cycles per update: ");
+  Serial.println((ARM_DWT_CYCCNT - start) / 1000000);
+}
+
+void loop() {
+}
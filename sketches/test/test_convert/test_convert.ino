@@ -0,0 +1,240 @@
+/*----------------------------------------------------------------------
+ * Checks the WavConverter (no card or audio shield needed; it can be
+ * built on a regular computer too). Test files are made here and their
+ * headers read from the simulated card:
+ *
+ *   headers     native files left alone; other rates, depths, float,
+ *               extensible headers and many channels to convert
+ *   identity    an extensible 44.1 kHz 16-bit file: sample for sample
+ *   depths      8-bit, 24-bit and float to 16 bits, rounded
+ *   channels    six channels to the first two
+ *   rates       48 and 22.05 kHz sines to 44.1 kHz: the right number of
+ *               frames, and the signal to noise ratio
+ *   resume      converted a piece at a time, starting afresh from the
+ *               saved state after each: the same as all at once
+ *   header      the converted file's key read back
+ *
+ * and prints the CPU cycles per audio block of output, converting 48 kHz
+ * stereo. Each check prints "ok" or "FAILED".
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include <math.h>
+#include "WavConverter.h"
+
+#define NUM_FRAMES   12000
+#define MAX_OUT      (NUM_FRAMES * 2 + WAV_CONVERTER_FINISH_FRAMES)
+#define SINE_HZ      1000
+#define AMPLITUDE    16384
+
+uint8_t wavFile[68 + NUM_FRAMES * 6 * 3];  // up to 6 channels of 24 bits
+int16_t out[MAX_OUT * 2];
+int16_t other[MAX_OUT * 2];
+
+// A header for frames of the format; returns the data offset
+static int makeHeader(int tag, int channels, uint32_t rate, int bits, int frames, bool extensible) {
+  int frameBytes = tag == 0x11 ? 1024 : channels * bits / 8;
+  int fmtSize = extensible ? 40 : 16;
+  int offset = 12 + 8 + fmtSize + 8;
+  uint32_t dataBytes = tag == 0x11 ? 1024 : (uint32_t)frames * frameBytes;
+  memset(wavFile, 0, offset);
+  memcpy(wavFile, "RIFF", 4);
+  wavPut32(wavFile + 4, offset - 8 + dataBytes);
+  memcpy(wavFile + 8, "WAVEfmt ", 8);
+  wavPut32(wavFile + 16, fmtSize);
+  wavPut16(wavFile + 20, extensible ? 0xFFFE : tag);
+  wavPut16(wavFile + 22, channels);
+  wavPut32(wavFile + 24, rate);
+  wavPut32(wavFile + 28, rate * frameBytes);
+  wavPut16(wavFile + 32, frameBytes);
+  wavPut16(wavFile + 34, bits);
+  if (extensible) {
+    wavPut16(wavFile + 36, 22);
+    wavPut16(wavFile + 38, bits);
+    wavPut16(wavFile + 44, tag);               // the subformat GUID starts with the tag
+  }
+  memcpy(wavFile + offset - 8, "data", 4);
+  wavPut32(wavFile + offset - 4, dataBytes);
+  return offset;
+}
+
+// Puts the file on a card and reads its header back
+static bool readBack(int offset, WavSource *source) {
+  SimulatedSd sd;
+  SimulatedSdFile file(&sd);
+  uint32_t size = offset + (uint32_t)((wavFile[offset - 4]) | (wavFile[offset - 3] << 8)
+                                      | ((uint32_t)wavFile[offset - 2] << 16));
+  bool ok = sd.addFile("/TEST.WAV", wavFile, size) && file.open("/TEST.WAV") && WavConverter::readSourceHeader(&file, source);
+  file.close();
+  return ok && source->dataOffset == (uint32_t)offset;
+}
+
+// Converts all the data, chunk input frames and room output frames at a
+// time. With restart, each chunk is converted by a new converter, from
+// the state the last one saved. Returns the output frames.
+static int convertAll(const WavSource *source, int chunk, int room, bool restart, int16_t *o) {
+  WavConverter converter;
+  converter.begin(source);
+  int channels = converter.getChannels();
+  const uint8_t *data = wavFile + source->dataOffset;
+  int frames = source->dataBytes / source->frameBytes;
+  int used = 0, total = 0;
+  char state[WAV_CONVERTER_STATE_CHARS];
+  while (used < frames) {
+    int n = frames - used < chunk ? frames - used : chunk;
+    while (n > 0) {
+      int made;
+      int u = converter.convert(data + used * source->frameBytes, n, o + total * channels, room, &made);
+      used += u;
+      n -= u;
+      total += made;
+    }
+    if (restart) {
+      if (converter.saveState(state, sizeof(state)) == 0)
+        return -1;
+      WavConverter next;
+      next.begin(source);
+      if (!next.loadState(state))
+        return -1;
+      converter = next;
+    }
+  }
+  return total + converter.finish(o + total * channels, WAV_CONVERTER_FINISH_FRAMES);
+}
+
+static void check(const char *what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? ": ok" : ": FAILED");
+}
+
+static void checkRate(uint32_t rate, float minSnr) {
+  int offset = makeHeader(1, 1, rate, 16, NUM_FRAMES, false);
+  for (int i = 0; i < NUM_FRAMES; i++)
+    wavPut16(wavFile + offset + 2*i, (int16_t)lrint(AMPLITUDE * sin(2 * M_PI * SINE_HZ * i / rate)));
+  WavSource source;
+  bool ok = readBack(offset, &source) && WavConverter::canConvert(&source);
+  int frames = convertAll(&source, 1000, MAX_OUT, false, out);
+  int expected = (int)ceil((double)NUM_FRAMES * WAV_NATIVE_RATE / rate);
+  double signal = 0, noise = 0;
+  for (int k = 0; k < frames && k < expected - 2; k++) {
+    double ideal = AMPLITUDE * sin(2 * M_PI * SINE_HZ * k / (double)WAV_NATIVE_RATE);
+    signal += ideal * ideal;
+    noise += (out[k] - ideal) * (out[k] - ideal);
+  }
+  double snr = 10 * log10(signal / noise);
+  Serial.print(rate);
+  Serial.print(" Hz: ");
+  Serial.print(frames);
+  Serial.print(" frames for ");
+  Serial.print(expected);
+  Serial.print(", signal to noise ");
+  Serial.print(snr, 1);
+  Serial.println(" dB");
+  check(rate == 48000 ? "48 kHz to 44.1 kHz" : "22.05 kHz to 44.1 kHz",
+        ok && abs(frames - expected) <= 1 && snr > minSnr);
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+  WavSource source;
+
+  // Headers
+  bool ok = readBack(makeHeader(1, 2, 44100, 16, 10, false), &source)
+            && WavConverter::isNative(&source) && !WavConverter::canConvert(&source);
+  ok = ok && readBack(makeHeader(1, 1, 44100, 16, 10, false), &source) && WavConverter::isNative(&source);
+  ok = ok && readBack(makeHeader(1, 2, 48000, 16, 10, false), &source) && WavConverter::canConvert(&source);
+  ok = ok && readBack(makeHeader(1, 2, 44100, 24, 10, false), &source) && WavConverter::canConvert(&source);
+  ok = ok && readBack(makeHeader(3, 2, 96000, 32, 10, false), &source) && WavConverter::canConvert(&source);
+  ok = ok && readBack(makeHeader(1, 2, 44100, 16, 10, true), &source)
+       && !WavConverter::isNative(&source) && WavConverter::canConvert(&source);
+  ok = ok && readBack(makeHeader(1, 6, 48000, 24, 10, true), &source) && WavConverter::canConvert(&source);
+  ok = ok && readBack(makeHeader(0x11, 2, 44100, 4, 10, false), &source) && WavConverter::isNative(&source);
+  ok = ok && readBack(makeHeader(0x11, 2, 22050, 4, 10, false), &source)
+       && !WavConverter::isNative(&source) && !WavConverter::canConvert(&source);
+  ok = ok && readBack(makeHeader(1, 2, 4000, 16, 10, false), &source) && !WavConverter::canConvert(&source);
+  check("headers", ok);
+
+  // Identity
+  int offset = makeHeader(1, 2, 44100, 16, NUM_FRAMES, true);
+  int16_t *samples = (int16_t *)(wavFile + offset);   // little-endian, like the file
+  for (int i = 0; i < NUM_FRAMES * 2; i++)
+    samples[i] = (int16_t)(i * 7919);
+  ok = readBack(offset, &source) && convertAll(&source, 333, 100, false, out) == NUM_FRAMES
+       && memcmp(out, samples, NUM_FRAMES * 4) == 0;
+  check("extensible 44.1 kHz 16-bit: sample for sample", ok);
+
+  // Depths
+  static const uint8_t bytes8[] = {0x80, 0xFF, 0x00, 0x81};
+  static const int16_t want8[] = {0, 32512, -32768, 256};
+  offset = makeHeader(1, 1, 44100, 8, 4, false);
+  memcpy(wavFile + offset, bytes8, sizeof(bytes8));
+  ok = readBack(offset, &source) && convertAll(&source, 4, 4, false, out) == 4
+       && memcmp(out, want8, sizeof(want8)) == 0;
+  static const uint8_t bytes24[] = {0x56, 0x34, 0x12, 0xC0, 0x34, 0x12, 0x00, 0x00, 0x80, 0xFF, 0xFF, 0xFF};
+  static const int16_t want24[] = {0x1234, 0x1235, -32768, 0};
+  offset = makeHeader(1, 1, 44100, 24, 4, false);
+  memcpy(wavFile + offset, bytes24, sizeof(bytes24));
+  ok = ok && readBack(offset, &source) && convertAll(&source, 4, 4, false, out) == 4
+       && memcmp(out, want24, sizeof(want24)) == 0;
+  static const float floats[] = {0.5f, -1.0f, 1.5f, -0.25f};
+  static const int16_t wantFloat[] = {16384, -32768, 32767, -8192};
+  offset = makeHeader(3, 1, 44100, 32, 4, false);
+  memcpy(wavFile + offset, floats, sizeof(floats));
+  ok = ok && readBack(offset, &source) && convertAll(&source, 4, 4, false, out) == 4
+       && memcmp(out, wantFloat, sizeof(wantFloat)) == 0;
+  check("8-bit, 24-bit and float to 16 bits", ok);
+
+  // Channels
+  offset = makeHeader(1, 6, 44100, 16, 100, true);
+  for (int i = 0; i < 100 * 6; i++)
+    wavPut16(wavFile + offset + 2*i, (i % 6 + 1) * 1000);
+  ok = readBack(offset, &source) && convertAll(&source, 100, 100, false, out) == 100;
+  for (int i = 0; ok && i < 100; i++)
+    ok = out[2*i] == 1000 && out[2*i + 1] == 2000;
+  check("six channels to two", ok);
+
+  // Rates
+  checkRate(48000, 80);
+  checkRate(22050, 65);
+
+  // Resume: 48 kHz stereo 24-bit
+  offset = makeHeader(1, 2, 48000, 24, NUM_FRAMES, false);
+  for (int i = 0; i < NUM_FRAMES; i++) {
+    for (int c = 0; c < 2; c++) {
+      int32_t v = (int32_t)lrint(4000000 * sin(2 * M_PI * (440 + 300*c) * i / 48000.0)) + (i * 37 % 5000);
+      uint8_t *p = wavFile + offset + 6*i + 3*c;
+      p[0] = v; p[1] = v >> 8; p[2] = v >> 16;
+    }
+  }
+  ok = readBack(offset, &source);
+  int frames = convertAll(&source, NUM_FRAMES, MAX_OUT, false, out);
+  int resumed = convertAll(&source, 777, 50, true, other);
+  ok = ok && frames > 0 && resumed == frames && memcmp(out, other, frames * 4) == 0;
+  check("resumed from saved state: the same samples", ok);
+
+  // Converted header
+  uint8_t header[WAV_CONVERTED_HEADER_BYTES];
+  WavConverter::makeHeader(header, 2, 123456, 987654, 0x5A5A1234);
+  uint32_t sourceSize, sourceDate, dataBytes;
+  ok = WavConverter::readKey(header, &sourceSize, &sourceDate, &dataBytes)
+       && sourceSize == 987654 && sourceDate == 0x5A5A1234 && dataBytes == 123456;
+  WavConverter::makeHeader(wavFile, 2, 0, 987654, 0x5A5A1234);   // not yet complete
+  ok = ok && readBack(WAV_CONVERTED_HEADER_BYTES, &source) && WavConverter::isNative(&source)
+       && source.dataBytes == 0;
+  check("converted header", ok);
+
+  // Cycles per block of output, from 48 kHz 16-bit stereo
+  offset = makeHeader(1, 2, 48000, 16, NUM_FRAMES, false);
+  for (int i = 0; i < NUM_FRAMES * 2; i++)
+    wavPut16(wavFile + offset + 2*i, (int16_t)(i * 7919));
+  readBack(offset, &source);
+  uint32_t start = ARM_DWT_CYCCNT;
+  frames = convertAll(&source, 128, MAX_OUT, false, out);
+  uint32_t cycles = (ARM_DWT_CYCCNT - start) / (frames / 128);
+  Serial.print("cycles per block of output, 48 kHz stereo: ");
+  Serial.println(cycles);
+}
+
+void loop() {
+}
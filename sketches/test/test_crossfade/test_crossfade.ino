@@ -0,0 +1,76 @@
+/*----------------------------------------------------------------------
+ * Checks the crossfade between two tracks: runs the outgoing track
+ * (steady full scale, on the left) and the incoming one (on the right)
+ * through a RampMixer, posts the two ramps in the same block the way
+ * AudioPlayer::crossfade() does, and measures the total power,
+ * left^2 + right^2, at every sample. For an equal-power crossfade that
+ * should stay at 0 dB the whole way, with no gap at the start.
+ *
+ * For comparison: the same with linear ramps (a dip of 3 dB in the
+ * middle), and with the two ramps posted a block apart.
+ *
+ * Needs no hardware; runs on a host too.
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include <math.h>
+#include "RampMixer.h"
+
+#define LEVEL           16384
+#define CROSSFADE_MSEC  500
+#define BLOCKS          ((CROSSFADE_MSEC * 44100 / 1000) / MIXER_BLOCK_SAMPLES + 4)
+
+int16_t track[MIXER_BLOCK_SAMPLES];
+int16_t outLeft[MIXER_BLOCK_SAMPLES];
+int16_t outRight[MIXER_BLOCK_SAMPLES];
+
+// Prints the power range, in dB, from the handoff to the end.
+
+void measure(const char *name, FadeCurve curve, int blocksApart) {
+  RampMixer mixer;
+  const int16_t *left[MIXER_VOICES]  = {track, NULL, NULL, NULL};
+  const int16_t *right[MIXER_VOICES] = {NULL, track, NULL, NULL};
+  mixer.setGain(0, MIXER_UNITY, 0);
+  mixer.setGain(1, 0, 0);
+  mixer.mix(left, right, outLeft, outRight, MIXER_BLOCK_SAMPLES);
+
+  float lowest = 1000.0, highest = -1000.0;
+  for (int block = 0; block < BLOCKS; block++) {
+    if (block == 0)
+      mixer.setGain(0, 0, CROSSFADE_MSEC, curve);
+    if (block == blocksApart)
+      mixer.setGain(1, MIXER_UNITY, CROSSFADE_MSEC, curve);
+    mixer.mix(left, right, outLeft, outRight, MIXER_BLOCK_SAMPLES);
+    for (int i = 0; i < MIXER_BLOCK_SAMPLES; i++) {
+      float l = (float)outLeft[i] / LEVEL;
+      float r = (float)outRight[i] / LEVEL;
+      float dB = 10.0 * log10f(l * l + r * r + 1e-12);
+      if (dB < lowest)
+        lowest = dB;
+      if (dB > highest)
+        highest = dB;
+    }
+  }
+  Serial.print(name);
+  Serial.print(": power from ");
+  Serial.print(lowest, 3);
+  Serial.print(" to ");
+  Serial.print(highest, 3);
+  Serial.print(" dB");
+  if (curve == fadeEqualPower && blocksApart == 0)
+    Serial.print(lowest > -0.1 && highest < 0.1 ? "  ok" : "  FAILED");
+  Serial.println();
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+  for (int i = 0; i < MIXER_BLOCK_SAMPLES; i++)
+    track[i] = LEVEL;
+  measure("equal power", fadeEqualPower, 0);
+  measure("linear", fadeLinear, 0);
+  measure("equal power, a block apart", fadeEqualPower, 1);
+}
+
+void loop() {
+}
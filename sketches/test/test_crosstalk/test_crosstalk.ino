@@ -0,0 +1,77 @@
+/*----------------------------------------------------------------------
+ * Checks the CrosstalkMatrix kernel (SMLAD on the Teensy) against the
+ * plain C reference on random matrices and vectors, and prints the CPU
+ * cycles per product for both. Then decouples a synthetic touch: sensor
+ * 2 touched, with sensors 1 and 3 picking up 15% of its rise.
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include "CrosstalkMatrix.h"
+
+#define NUM_TRIALS 10000
+
+int16_t matrix[NUM_CHANNELS * CROSSTALK_ROW_LENGTH] __attribute__((aligned(4)));
+int16_t vector[CROSSTALK_ROW_LENGTH] __attribute__((aligned(4)));
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+
+  int32_t fast[NUM_CHANNELS];
+  int32_t reference[NUM_CHANNELS];
+  uint32_t fastCycles = 0;
+  uint32_t referenceCycles = 0;
+  int mismatches = 0;
+  for (int trial = 0; trial < NUM_TRIALS; trial++) {
+    for (int i = 0; i < NUM_CHANNELS * CROSSTALK_ROW_LENGTH; i++)
+      matrix[i] = (i % CROSSTALK_ROW_LENGTH < NUM_CHANNELS) ? random(65536) - 32768 : 0;
+    for (int i = 0; i < CROSSTALK_ROW_LENGTH; i++)
+      vector[i] = random(8191) - 4095;
+    uint32_t start = ARM_DWT_CYCCNT;
+    CrosstalkMatrix::multiply(matrix, vector, fast);
+    fastCycles += ARM_DWT_CYCCNT - start;
+    start = ARM_DWT_CYCCNT;
+    CrosstalkMatrix::multiplyReference(matrix, vector, reference);
+    referenceCycles += ARM_DWT_CYCCNT - start;
+    for (int i = 0; i < NUM_CHANNELS; i++) {
+      if (fast[i] != reference[i])
+        mismatches++;
+    }
+  }
+  Serial.print("mismatches: ");
+  Serial.println(mismatches);
+  Serial.print("cycles/product, kernel: ");
+  Serial.print((float)fastCycles / NUM_TRIALS);
+  Serial.print(", reference: ");
+  Serial.println((float)referenceCycles / NUM_TRIALS);
+
+  CrosstalkMatrix crosstalk;
+  uint16_t idle[NUM_CHANNELS];
+  for (int i = 0; i < NUM_CHANNELS; i++)
+    idle[i] = 200;
+  crosstalk.setIdle(idle);
+  for (int touched = 0; touched < NUM_CHANNELS; touched++) {
+    if (touched > 0)
+      crosstalk.setCoupling(touched, touched - 1, 0.15);
+    if (touched < NUM_CHANNELS - 1)
+      crosstalk.setCoupling(touched, touched + 1, 0.15);
+  }
+  if (!crosstalk.invert())
+    Serial.println("can't invert");
+  uint16_t raw[NUM_CHANNELS];
+  for (int i = 0; i < NUM_CHANNELS; i++)
+    raw[i] = idle[i];
+  raw[0] += 90;                         // 15% of 600
+  raw[1] += 600;
+  raw[2] += 90;
+  crosstalk.apply(raw, 1023);
+  Serial.print("decoupled (expect 200 800 200 200):");
+  for (int i = 0; i < NUM_CHANNELS; i++) {
+    Serial.print(" ");
+    Serial.print(raw[i]);
+  }
+  Serial.println();
+}
+
+void loop() {
+}
@@ -0,0 +1,179 @@
+/*----------------------------------------------------------------------
+ * Checks the EnvelopeFollower on audio from a WAV file, on a simulated SD
+ * card (no audio shield needed; it can be built on a regular computer
+ * too). The file has silence, half a second of a 1 kHz tone on the left
+ * channel, then silence again; it's read a block at a time, as the audio
+ * library would, and each block goes to the followers.
+ *
+ *   silence     the envelope is zero
+ *   attack      the first whole block of the tone reads its RMS (or
+ *               peak) level
+ *   release     the envelope falls back within about the release time
+ *   source      EnvelopeSensorSource puts the envelope, scaled, in place
+ *               of the followed channels' readings and leaves the others
+ *   latency     from the tone starting to a 2 kHz sensor sample crossing
+ *               half its level, with the ProximityFilter an audio channel
+ *               gets (1 sample) and with the touch sensors' default (200)
+ *
+ * and prints the cycles per block. Each check prints "ok" or "FAILED".
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include <math.h>
+#include "WavStream.h"
+#include "EnvelopeFollower.h"
+#include "ProximityFilter.h"
+
+#define RATE        44100
+#define NUM_FRAMES  RATE                  // 1 sec, stereo
+#define TONE_START  (RATE / 5)
+#define TONE_END    (RATE * 7 / 10)
+#define TONE_HZ     1000
+#define AMPLITUDE   16000
+#define NUM_BLOCKS  ((NUM_FRAMES + WAV_BLOCK_SAMPLES - 1) / WAV_BLOCK_SAMPLES)
+#define SENSOR_RATE 2000
+
+uint8_t wavFile[WAV_PCM_HEADER_BYTES + NUM_FRAMES * 4];
+uint16_t rmsLevel[NUM_BLOCKS];            // the followers' output after each block
+uint16_t peakLevel[NUM_BLOCKS];
+uint16_t rightLevel[NUM_BLOCKS];
+
+static void makeWav() {
+  int offset = makeWavHeader(wavFile, 2, RATE, NUM_FRAMES * 4);
+  for (int i = 0; i < NUM_FRAMES; i++) {
+    int16_t v = 0;
+    if (i >= TONE_START && i < TONE_END)
+      v = (int16_t)lrint(AMPLITUDE * sin(2 * M_PI * TONE_HZ * i / RATE));
+    wavPut16(wavFile + offset + 4*i, v);
+    wavPut16(wavFile + offset + 4*i + 2, 0);
+  }
+}
+
+static void check(const char *what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? ": ok" : ": FAILED");
+}
+
+// Milliseconds from the tone starting until the sensor reading, sampled
+// at SENSOR_RATE from the latest envelope, gets halfway to its level
+static float latency(int filterSamples) {
+  ProximityFilter filter;
+  filter.configure(emaFilter, filterSamples, 1023);
+  filter.reset(0);
+  uint16_t half = (uint16_t)(((uint32_t)rmsLevel[TONE_END / WAV_BLOCK_SAMPLES - 1] * 1023) >> 16);
+  for (int sample = 0; sample < SENSOR_RATE; sample++) {
+    uint32_t frame = (uint32_t)sample * RATE / SENSOR_RATE;
+    int block = (int)(frame / WAV_BLOCK_SAMPLES) - 1;    // the last one done
+    uint16_t envelope = block < 0 ? 0 : rmsLevel[block];
+    uint16_t raw = (uint16_t)(((uint32_t)envelope * 1023) >> 15);
+    if ((filter.filter(raw) >> 16) >= half && frame >= TONE_START)
+      return (float)(frame - TONE_START) * 1000.0 / RATE;
+  }
+  return 1000.0;
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+  makeWav();
+
+  SimulatedSd sd;
+  sd.addFile("/A1/TONE.WAV", wavFile, sizeof(wavFile));
+  SimulatedSdFile file(&sd);
+  WavStream stream;
+  int16_t left[WAV_BLOCK_SAMPLES], right[WAV_BLOCK_SAMPLES];
+  EnvelopeFollower rms, peak, silent;
+  peak.setType(peakEnvelope);
+
+  stream.open(&file, "/A1/TONE.WAV");
+  stream.start();
+  int blocks = 0;
+  while (blocks < NUM_BLOCKS && stream.readBlock(left, right)) {
+    rmsLevel[blocks] = rms.processBlock(left, WAV_BLOCK_SAMPLES);
+    peakLevel[blocks] = peak.processBlock(left, WAV_BLOCK_SAMPLES);
+    rightLevel[blocks] = silent.processBlock(right, WAV_BLOCK_SAMPLES);
+    blocks++;
+  }
+  check("whole file read", blocks == NUM_BLOCKS);
+
+  int first = (TONE_START + WAV_BLOCK_SAMPLES - 1) / WAV_BLOCK_SAMPLES;   // the first whole block of tone
+  int last = TONE_END / WAV_BLOCK_SAMPLES - 1;
+  bool silence = true;
+  for (int b = 0; b < TONE_START / WAV_BLOCK_SAMPLES; b++)
+    if (rmsLevel[b] != 0 || peakLevel[b] != 0)
+      silence = false;
+  for (int b = 0; b < blocks; b++)
+    if (rightLevel[b] != 0)
+      silence = false;
+  check("silence reads zero", silence);
+
+  float toneRms = AMPLITUDE / sqrt(2.0);
+  Serial.print("first block of the tone: rms ");
+  Serial.print(rmsLevel[first]);
+  Serial.print(" (");
+  Serial.print((int)toneRms);
+  Serial.print("), peak ");
+  Serial.print(peakLevel[first]);
+  Serial.print(" (");
+  Serial.print(AMPLITUDE);
+  Serial.println(")");
+  check("attack within a block", fabs(rmsLevel[first] - toneRms) < 0.02 * toneRms
+        && peakLevel[first] > 0.98 * AMPLITUDE && peakLevel[first] <= AMPLITUDE);
+  bool steady = true;
+  for (int b = first; b <= last; b++)
+    if (fabs(rmsLevel[b] - toneRms) > 0.02 * toneRms)
+      steady = false;
+  check("steady during the tone", steady);
+
+  // The default release is 8 blocks: 1/8 of the way down per block
+  int fallen = last + 1;
+  while (fallen < blocks && rmsLevel[fallen] > toneRms / 10)
+    fallen++;
+  Serial.print("release to 10%: ");
+  Serial.print((fallen - last) * WAV_BLOCK_SAMPLES * 1000 / RATE);
+  Serial.println(" msec");
+  check("release", fallen - last >= 8 && fallen - last <= 24);
+
+  // In place of the sensor readings
+  SimulatedSensorSource sensors(1023);
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    sensors.setLevel(channel, 300);
+  EnvelopeSensorSource source(&sensors);
+  rms.processBlock(NULL, 0);
+  source.setFollower(0, &rms);
+  source.setFollower(1, &silent);
+  uint16_t values[NUM_CHANNELS];
+  source.read(values);
+  bool replaced = values[0] == (uint16_t)(((uint32_t)rms.getEnvelope() * 1023) >> 15)
+                  && values[1] == 0;
+  for (int channel = 2; channel < NUM_CHANNELS; channel++)
+    if (values[channel] != 300)
+      replaced = false;
+  source.setFollower(0, NULL);
+  source.read(values);
+  check("envelope in place of the followed channels", replaced && values[0] == 300);
+
+  float fast = latency(1);
+  float slow = latency(200);
+  Serial.print("tone to half level at the sensors: filter of 1 sample ");
+  Serial.print(fast, 1);
+  Serial.print(" msec, 200 samples ");
+  Serial.print(slow, 1);
+  Serial.println(" msec");
+  check("audio channel responds within two blocks", fast < 2.0 * WAV_BLOCK_SAMPLES * 1000 / RATE);
+
+  uint32_t start = ARM_DWT_CYCCNT;
+  for (int i = 0; i < 10000; i++)
+    rms.processBlock(left, WAV_BLOCK_SAMPLES);
+  uint32_t rmsCycles = (ARM_DWT_CYCCNT - start) / 10000;
+  start = ARM_DWT_CYCCNT;
+  for (int i = 0; i < 10000; i++)
+    peak.processBlock(left, WAV_BLOCK_SAMPLES);
+  Serial.print("cycles per block: rms ");
+  Serial.print(rmsCycles);
+  Serial.print(", peak ");
+  Serial.println((ARM_DWT_CYCCNT - start) / 10000);
+}
+
+void loop() {
+}
@@ -0,0 +1,50 @@
+/*----------------------------------------------------------------------
+ * Benchmark for the ProximityFilter kernels. Runs each kind of filter
+ * over the same synthetic signal (a noisy step, like a hand arriving at
+ * the sensor) and prints the CPU cycles per sample, and how many samples
+ * it took the output to get halfway up the step (i.e. the delay).
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include "ProximityFilter.h"
+
+#define NUM_TEST_SAMPLES 4000
+#define STEP_AT 1000
+
+uint16_t signal[NUM_TEST_SAMPLES];
+
+const char *filterNames[] = {"ema", "cascadedEma", "median", "oneEuro"};
+FilterType filterTypes[] = {emaFilter, cascadedEmaFilter, medianFilter, oneEuroFilter};
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+
+  // Idle at 100 counts, step to 900 counts, +/- 20 counts of noise
+  for (int i = 0; i < NUM_TEST_SAMPLES; i++)
+    signal[i] = (i < STEP_AT ? 100 : 900) + random(41) - 20;
+
+  for (int f = 0; f < 4; f++) {
+    ProximityFilter filter;
+    filter.configure(filterTypes[f], 200, 1024);
+    filter.reset(signal[0]);
+
+    int halfway = -1;
+    uint32_t start = ARM_DWT_CYCCNT;
+    for (int i = 0; i < NUM_TEST_SAMPLES; i++) {
+      int32_t v = filter.filter(signal[i]);
+      if (halfway < 0 && i >= STEP_AT && (v >> 16) >= 500)
+        halfway = i - STEP_AT;
+    }
+    uint32_t cycles = ARM_DWT_CYCCNT - start;
+
+    Serial.print(filterNames[f]);
+    Serial.print(": cycles/sample: ");
+    Serial.print((float)cycles / NUM_TEST_SAMPLES);
+    Serial.print(", samples to halfway: ");
+    Serial.println(halfway);
+  }
+}
+
+void loop() {
+}
@@ -0,0 +1,163 @@
+/*----------------------------------------------------------------------
+ * Checks the RampMixer: the SMLAD mix against the plain C reference
+ * (random signals, ramps on all four voices, and full scale on all four
+ * at the highest gain, which must clip and not wrap), then fades a
+ * full-scale tone in and out with each curve and reports the largest
+ * jump in gain from one sample to the next. The old loop()-stepped fades jumped 1% of
+ * full scale at a time (328 counts at 32767); a ramp should stay well
+ * under that. Last, the CPU cycles per 128-sample stereo block, steady
+ * and ramping.
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include "RampMixer.h"
+
+#define NUM_BLOCKS  1000
+#define FADE_MSEC   50
+#define TONE        32767
+
+const char *curveNames[] = {"linear", "equalPower", "exponential"};
+FadeCurve curves[] = {fadeLinear, fadeEqualPower, fadeExponential};
+
+int16_t input[2 * MIXER_VOICES][MIXER_BLOCK_SAMPLES] __attribute__((aligned(4)));
+int16_t outLeft[MIXER_BLOCK_SAMPLES] __attribute__((aligned(4)));
+int16_t outRight[MIXER_BLOCK_SAMPLES] __attribute__((aligned(4)));
+int16_t refLeft[MIXER_BLOCK_SAMPLES] __attribute__((aligned(4)));
+int16_t refRight[MIXER_BLOCK_SAMPLES] __attribute__((aligned(4)));
+
+const int16_t *left[MIXER_VOICES];
+const int16_t *right[MIXER_VOICES];
+
+// The largest sample-to-sample change in one fade of a constant input:
+// with a constant input, the output *is* the gain curve.
+
+int maxStep(FadeCurve curve, int32_t from, int32_t to, int32_t *last) {
+  RampMixer mixer;
+  mixer.setGain(0, from, 0);
+  mixer.setGain(0, to, FADE_MSEC, curve);
+  for (int i = 0; i < MIXER_BLOCK_SAMPLES; i++)
+    input[0][i] = TONE;
+  const int16_t *in[MIXER_VOICES] = {input[0], NULL, NULL, NULL};
+  int previous = ((int32_t)TONE * from + MIXER_UNITY / 2) >> MIXER_GAIN_Q;
+  int largest = 0;
+  for (int block = 0; block < 2 * FADE_MSEC * 44100 / 1000 / MIXER_BLOCK_SAMPLES; block++) {
+    mixer.mix(in, in, outLeft, outRight, MIXER_BLOCK_SAMPLES);
+    for (int i = 0; i < MIXER_BLOCK_SAMPLES; i++) {
+      int step = abs(outLeft[i] - previous);
+      if (step > largest)
+        largest = step;
+      previous = outLeft[i];
+    }
+  }
+  *last = previous;
+  return largest;
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+
+  // Kernel against reference
+  RampMixer fast;
+  RampMixer reference;
+  int mismatches = 0;
+  for (int block = 0; block < NUM_BLOCKS; block++) {
+    if (block % 50 == 0) {
+      for (int voice = 0; voice < MIXER_VOICES; voice++) {
+        int32_t gain = random(MIXER_MAX_GAIN + 1);
+        int msec = random(200);
+        FadeCurve curve = curves[random(3)];
+        fast.setGain(voice, gain, msec, curve);
+        reference.setGain(voice, gain, msec, curve);
+      }
+    }
+    for (int voice = 0; voice < MIXER_VOICES; voice++) {
+      for (int i = 0; i < MIXER_BLOCK_SAMPLES; i++) {
+        input[2 * voice][i] = random(65536) - 32768;
+        input[2 * voice + 1][i] = random(65536) - 32768;
+      }
+      bool missing = (block + voice) % 7 == 0;          // a player with nothing to send
+      left[voice] = missing ? NULL : input[2 * voice];
+      right[voice] = missing ? NULL : input[2 * voice + 1];
+    }
+    fast.mix(left, right, outLeft, outRight, MIXER_BLOCK_SAMPLES);
+    reference.mixReference(left, right, refLeft, refRight, MIXER_BLOCK_SAMPLES);
+    for (int i = 0; i < MIXER_BLOCK_SAMPLES; i++) {
+      if (outLeft[i] != refLeft[i] || outRight[i] != refRight[i])
+        mismatches++;
+    }
+  }
+  Serial.print("mismatches: ");
+  Serial.print(mismatches);
+  Serial.println(mismatches == 0 ? "  ok" : "  FAILED");
+
+  // The worst case: full scale on all four voices at the highest gain
+  // (asking for more is clamped), both polarities, with the kernel's
+  // 32-bit sum against the reference's 64-bit one
+  for (int polarity = 0; polarity < 2; polarity++) {
+    RampMixer loud;
+    RampMixer loudReference;
+    for (int voice = 0; voice < MIXER_VOICES; voice++) {
+      loud.setGain(voice, 4 * MIXER_UNITY, 0);
+      loudReference.setGain(voice, 4 * MIXER_UNITY, 0);
+      for (int i = 0; i < MIXER_BLOCK_SAMPLES; i++)
+        input[2 * voice][i] = input[2 * voice + 1][i] = polarity ? -32768 : 32767;
+      left[voice] = input[2 * voice];
+      right[voice] = input[2 * voice + 1];
+    }
+    loud.mix(left, right, outLeft, outRight, MIXER_BLOCK_SAMPLES);
+    loudReference.mixReference(left, right, refLeft, refRight, MIXER_BLOCK_SAMPLES);
+    int16_t expected = polarity ? -32768 : 32767;
+    bool clipped = loud.getGain(0) == MIXER_MAX_GAIN;
+    for (int i = 0; i < MIXER_BLOCK_SAMPLES; i++) {
+      if (outLeft[i] != expected || outRight[i] != expected || refLeft[i] != expected || refRight[i] != expected)
+        clipped = false;
+    }
+    Serial.print(polarity ? "full scale negative" : "full scale positive");
+    Serial.print(", four voices at the highest gain: clips to ");
+    Serial.print(outLeft[0]);
+    Serial.println(clipped ? "  ok" : "  FAILED");
+  }
+
+  // Click-free fades
+  for (int c = 0; c < 3; c++) {
+    int32_t in, out;
+    int up = maxStep(curves[c], 0, MIXER_UNITY, &in);
+    int down = maxStep(curves[c], MIXER_UNITY, 0, &out);
+    Serial.print(curveNames[c]);
+    Serial.print(": largest step, fade-in: ");
+    Serial.print(up);
+    Serial.print(", fade-out: ");
+    Serial.print(down);
+    Serial.print(", ends at: ");
+    Serial.print(in);
+    Serial.print(" / ");
+    Serial.print(out);
+    Serial.println((up < 328 && down < 328 && in == TONE && out == 0) ? "  ok" : "  FAILED");
+  }
+
+  // Cycles per block
+  for (int ramping = 0; ramping < 2; ramping++) {
+    RampMixer mixer;
+    for (int voice = 0; voice < MIXER_VOICES; voice++) {
+      left[voice] = input[2 * voice];
+      right[voice] = input[2 * voice + 1];
+      mixer.setGain(voice, MIXER_UNITY / 2, 0);
+    }
+    uint32_t cycles = 0;
+    for (int block = 0; block < NUM_BLOCKS; block++) {
+      if (ramping && block % 10 == 0) {
+        for (int voice = 0; voice < MIXER_VOICES; voice++)
+          mixer.setGain(voice, (block / 10) % 2 ? MIXER_UNITY : 0, 1000, fadeEqualPower);
+      }
+      uint32_t start = ARM_DWT_CYCCNT;
+      mixer.mix(left, right, outLeft, outRight, MIXER_BLOCK_SAMPLES);
+      cycles += ARM_DWT_CYCCNT - start;
+    }
+    Serial.print(ramping ? "cycles/block, ramping: " : "cycles/block, steady: ");
+    Serial.println((float)cycles / NUM_BLOCKS);
+  }
+}
+
+void loop() {
+}
@@ -0,0 +1,157 @@
+/*----------------------------------------------------------------------
+ * Checks the GestureRecognizer against scripted timelines (no hardware
+ * needed; it can be built on a regular computer too). Each script is a
+ * list of touches and releases; it's played with update() called every
+ * millisecond, like the loop would, and the gestures that come out must
+ * be exactly the expected ones, at the expected times:
+ *
+ *   tap, double tap, long press, two taps too far apart for a double
+ *   tap, swipes up and down, a swipe too slow to count, and a swipe
+ *   that changes direction
+ *
+ * Every script is played twice: once from time zero, and once starting
+ * just before micros() wraps around, which has to make no difference.
+ * Then prints the cycles per update() and per touch/release. Each check
+ * prints "ok" or "FAILED".
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include <stdio.h>
+#include "GestureRecognizer.h"
+
+#define MAX_STEPS    8
+#define MAX_EXPECTED 4
+#define END          -1
+
+struct Step {
+  int  msec;
+  int  channel;                           // END: the script stops at msec
+  bool touch;
+};
+
+struct Expected {
+  int         msec;
+  int         channel;
+  GestureType type;
+};
+
+struct Script {
+  const char *name;
+  Step        steps[MAX_STEPS];
+  Expected    expected[MAX_EXPECTED];
+  int         numExpected;
+};
+
+static const Script scripts[] = {
+  {"tap",
+   {{0, 0, true}, {100, 0, false}, {1000, END, false}},
+   {{400, 0, tapGesture}}, 1},
+  {"double tap",
+   {{0, 1, true}, {100, 1, false}, {250, 1, true}, {350, 1, false}, {1000, END, false}},
+   {{350, 1, doubleTapGesture}}, 1},
+  {"long press",
+   {{0, 2, true}, {1500, 2, false}, {2500, END, false}},
+   {{600, 2, longPressGesture}}, 1},
+  {"two slow taps",
+   {{0, 3, true}, {100, 3, false}, {500, 3, true}, {600, 3, false}, {1500, END, false}},
+   {{400, 3, tapGesture}, {900, 3, tapGesture}}, 2},
+  {"swipe up",
+   {{0, 0, true}, {150, 1, true}, {200, 0, false}, {300, 2, true}, {350, 1, false}, {450, 2, false}, {1500, END, false}},
+   {{300, 2, swipeUpGesture}}, 1},
+  {"swipe down",
+   {{0, 3, true}, {100, 3, false}, {200, 2, true}, {300, 2, false}, {400, 1, true}, {500, 1, false}, {1500, END, false}},
+   {{400, 1, swipeDownGesture}}, 1},
+  {"swipe too slow",
+   {{0, 0, true}, {100, 0, false}, {400, 1, true}, {500, 1, false}, {1500, END, false}},
+   {{400, 0, tapGesture}, {800, 1, tapGesture}}, 2},
+  {"swipe changes direction",
+   {{0, 1, true}, {100, 2, true}, {150, 1, false}, {200, 1, true}, {250, 2, false}, {300, 1, false}, {1500, END, false}},
+   {{600, 1, tapGesture}}, 1},
+};
+
+#define NUM_SCRIPTS (int)(sizeof(scripts) / sizeof(scripts[0]))
+
+static void check(const char *what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? ": ok" : ": FAILED");
+}
+
+static bool play(const Script *script, uint32_t start) {
+  GestureRecognizer gestures;
+  GestureEvent event;
+  int found = 0;
+  bool ok = true;
+  int step = 0;
+  for (int msec = 0; ; msec++) {
+    uint32_t now = start + (uint32_t)msec * 1000;
+    while (script->steps[step].msec == msec && script->steps[step].channel != END) {
+      if (script->steps[step].touch)
+        gestures.touch(script->steps[step].channel, now);
+      else
+        gestures.release(script->steps[step].channel, now);
+      step++;
+    }
+    if (script->steps[step].channel == END && script->steps[step].msec == msec)
+      break;
+    gestures.update(now);
+    while (gestures.getGesture(&event)) {
+      const Expected *e = found < script->numExpected ? &script->expected[found] : NULL;
+      if (!e || event.channel != e->channel || event.type != e->type
+          || event.timeMicros != start + (uint32_t)e->msec * 1000) {
+        Serial.print("  unexpected gesture ");
+        Serial.print(event.type);
+        Serial.print(" on channel ");
+        Serial.print(event.channel);
+        Serial.print(" at ");
+        Serial.print((long)((event.timeMicros - start) / 1000));
+        Serial.println(" msec");
+        ok = false;
+      }
+      found++;
+    }
+  }
+  return ok && found == script->numExpected;
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+
+  for (int i = 0; i < NUM_SCRIPTS; i++) {
+    check(scripts[i].name, play(&scripts[i], 0));
+    char name[64];
+    snprintf(name, sizeof(name), "%s, across the wraparound", scripts[i].name);
+    check(name, play(&scripts[i], 0xFFFFFFFF - 250000));
+  }
+
+  // Cost: update() with all channels waiting on a timeout, and a stream
+  // of touches and releases
+  GestureRecognizer gestures;
+  GestureEvent event;
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    gestures.touch(channel * 2 % NUM_CHANNELS, 0);
+  uint32_t start = ARM_DWT_CYCCNT;
+  for (int i = 0; i < 100000; i++)
+    gestures.update(1000);
+  uint32_t updateCycles = (ARM_DWT_CYCCNT - start) / 100000;
+  gestures.reset();
+  start = ARM_DWT_CYCCNT;
+  uint32_t now = 0;
+  for (int i = 0; i < 100000; i++) {
+    int channel = i & (NUM_CHANNELS - 1);
+    now += 50000;
+    if ((i >> 2) & 1)
+      gestures.release(channel, now);
+    else
+      gestures.touch(channel, now);
+    while (gestures.getGesture(&event))
+      ;
+  }
+  Serial.print("cycles per update(): ");
+  Serial.print(updateCycles);
+  Serial.print(", per touch/release: ");
+  Serial.println((ARM_DWT_CYCCNT - start) / 100000);
+}
+
+void loop() {
+}
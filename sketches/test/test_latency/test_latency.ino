@@ -0,0 +1,210 @@
+/*----------------------------------------------------------------------
+ * Latency regression test on a simulated clock (no hardware needed; it
+ * can be built on a regular computer too, with -DTACTILE_LATENCY_PROBE).
+ * Needs TACTILE_LATENCY_PROBE (see TactileBasics.h).
+ *
+ * First the LatencyProbe itself, with made-up times:
+ *
+ *   first mark  only the first mark of a stage after a touch counts
+ *   no touch    a mark without a touch before it is ignored
+ *   wraparound  a touch just before micros() wraps is measured right
+ *   stats       min/max are exact, the median and 99th percentile are
+ *               within a bucket (about 10%)
+ *
+ * Then a simulated exhibit: a SensorSampler at 2 kHz on a simulated
+ * sensor, a loop that takes 0-2 msec each time round, filters the
+ * samples and "starts" the outputs, and an audio update every 128
+ * samples at 44.1 kHz. Hands arrive at the sensors one after another.
+ * The latencies the probe reports have to stay within what the loop and
+ * the audio block allow:
+ *
+ *   touch to play() and to the vibrator  at most one time round the loop
+ *   touch to audio out                   that plus one audio block
+ *
+ * Each check prints "ok" or "FAILED".
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include "LatencyProbe.h"
+#include "SensorSampler.h"
+#include "ProximityFilter.h"
+
+#define RATE           2000
+#define PERIOD_USEC    (1000000 / RATE)
+#define LOOP_MAX_USEC  2000
+#define AUDIO_USEC     2902               // 128 samples at 44.1 kHz
+#define NUM_TOUCHES    400
+#define TOUCH_USEC     400000             // one hand every 0.4 sec
+#define RAMP_USEC      10000              // idle to full in 10 msec
+#define HOLD_USEC      150000
+#define IDLE           100
+#define FULL           900
+#define TOUCH_LEVEL    500
+#define RELEASE_LEVEL  300
+
+#ifdef TACTILE_LATENCY_PROBE
+
+static void check(const char *what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? ": ok" : ": FAILED");
+}
+
+static bool near(uint32_t value, uint32_t expected) {
+  return value >= expected - expected / 10 && value <= expected + expected / 10;
+}
+
+static void testProbe() {
+  LatencyStats stats;
+
+  LatencyProbe::reset();
+  LatencyProbe::touch(0, 1000);
+  LatencyProbe::mark(0, latencyPlay, 1500);
+  LatencyProbe::mark(0, latencyPlay, 9000);
+  LatencyProbe::getStats(0, latencyPlay, &stats);
+  check("only the first mark counts", stats.count == 1 && stats.minMicros == 500 && stats.maxMicros == 500);
+
+  LatencyProbe::mark(1, latencyPlay, 2000);
+  LatencyProbe::getStats(1, latencyPlay, &stats);
+  check("a mark without a touch is ignored", stats.count == 0);
+
+  LatencyProbe::reset();
+  LatencyProbe::touch(2, 0xFFFFFF00);
+  LatencyProbe::mark(2, latencyVibration, 0x100);
+  LatencyProbe::getStats(2, latencyVibration, &stats);
+  check("across the wraparound", stats.count == 1 && stats.minMicros == 0x200);
+
+  LatencyProbe::reset();
+  for (uint32_t i = 1; i <= 1000; i++) {
+    LatencyProbe::touch(3, i * 10000);
+    LatencyProbe::mark(3, latencyAudioOut, i * 10000 + i);
+  }
+  LatencyProbe::getStats(3, latencyAudioOut, &stats);
+  check("stats", stats.count == 1000 && stats.minMicros == 1 && stats.maxMicros == 1000
+        && near(stats.p50Micros, 500) && near(stats.p99Micros, 990));
+}
+
+/*---- The simulated exhibit ----*/
+
+SimulatedSensorSource source(1023);
+SensorSampler sampler(&source);
+ProximityFilter filter[NUM_CHANNELS];
+bool touched[NUM_CHANNELS];
+bool playing[NUM_CHANNELS];               // play() called, audio not out yet
+
+// Where the hand is at this time: which channel, and how close
+static uint16_t level(uint32_t now, int *channel) {
+  uint32_t n = now / TOUCH_USEC;
+  uint32_t t = now % TOUCH_USEC;
+  *channel = n % NUM_CHANNELS;
+  if (n >= NUM_TOUCHES || t >= RAMP_USEC + HOLD_USEC)
+    return IDLE;
+  if (t >= RAMP_USEC)
+    return FULL;
+  return IDLE + (FULL - IDLE) * t / RAMP_USEC;
+}
+
+static void runExhibit() {
+  LatencyProbe::reset();
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    filter[channel].configure(emaFilter, 16, 1023);
+    filter[channel].reset(IDLE);
+    source.setLevel(channel, IDLE);
+  }
+  uint32_t tick = 0, loopEnd = 0, audioTime = AUDIO_USEC;
+  while (loopEnd < (uint32_t)(NUM_TOUCHES + 1) * TOUCH_USEC) {
+    loopEnd += random(LOOP_MAX_USEC + 1);
+
+    // Interrupts while the loop ran: the sampling timer and the audio
+    // update, which sends the data of a track that play() started
+    while (tick * PERIOD_USEC <= loopEnd || audioTime <= loopEnd) {
+      uint32_t sampleTime = tick * PERIOD_USEC;
+      if (sampleTime <= audioTime && sampleTime <= loopEnd) {
+        int channel;
+        uint16_t v = level(sampleTime, &channel);
+        for (int c = 0; c < NUM_CHANNELS; c++)
+          source.setLevel(c, c == channel ? v : IDLE);
+        sampler.sampleNow(sampleTime);
+        tick++;
+      } else {
+        for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+          if (playing[channel]) {
+            LATENCY_MARK(channel, latencyAudioOut, audioTime);
+            playing[channel] = false;
+          }
+        }
+        audioTime += AUDIO_USEC;
+      }
+    }
+
+    // The loop: touches are detected from the samples, and the outputs
+    // started as it finishes
+    uint32_t time;
+    uint16_t values[NUM_CHANNELS];
+    bool started[NUM_CHANNELS] = {false};
+    while (sampler.getSample(&time, values)) {
+      for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+        int32_t value = filter[channel].filter(values[channel]) >> 16;
+        if (!touched[channel] && value >= TOUCH_LEVEL) {
+          touched[channel] = true;
+          LATENCY_TOUCH(channel, time);
+          started[channel] = true;
+        } else if (touched[channel] && value < RELEASE_LEVEL) {
+          touched[channel] = false;
+        }
+      }
+    }
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+      if (started[channel]) {
+        LATENCY_MARK(channel, latencyPlay, loopEnd);
+        LATENCY_MARK(channel, latencyVibration, loopEnd);
+        playing[channel] = true;
+      }
+    }
+  }
+}
+
+static void report(const char *what, LatencyStage stage, uint32_t *count, uint32_t *max) {
+  *count = 0;
+  *max = 0;
+  Serial.print(what);
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    LatencyStats stats;
+    LatencyProbe::getStats(channel, stage, &stats);
+    *count += stats.count;
+    if (stats.maxMicros > *max)
+      *max = stats.maxMicros;
+    Serial.print(channel == 0 ? " " : ", ");
+    Serial.print(stats.minMicros);
+    Serial.print("/");
+    Serial.print(stats.p50Micros);
+    Serial.print("/");
+    Serial.print(stats.p99Micros);
+    Serial.print("/");
+    Serial.print(stats.maxMicros);
+  }
+  Serial.println(" usec");
+}
+
+#endif
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+#ifndef TACTILE_LATENCY_PROBE
+  Serial.println("TACTILE_LATENCY_PROBE is off: define it (see TactileBasics.h) and build again");
+#else
+  testProbe();
+  runExhibit();
+  Serial.println("min/median/99%/max by channel:");
+  uint32_t playCount, playMax, outCount, outMax, vibCount, vibMax;
+  report("  touch to play()   ", latencyPlay, &playCount, &playMax);
+  report("  touch to audio out", latencyAudioOut, &outCount, &outMax);
+  report("  touch to vibrator ", latencyVibration, &vibCount, &vibMax);
+  check("every touch measured", playCount == NUM_TOUCHES && outCount == NUM_TOUCHES && vibCount == NUM_TOUCHES);
+  check("play() within one time round the loop", playMax <= LOOP_MAX_USEC && vibMax == playMax);
+  check("audio out within one more block", outMax <= LOOP_MAX_USEC + AUDIO_USEC);
+#endif
+}
+
+void loop() {
+}
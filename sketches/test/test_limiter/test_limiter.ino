@@ -0,0 +1,167 @@
+/*----------------------------------------------------------------------
+ * Checks the master bus PeakLimiter (no audio shield needed; it can be
+ * built on a regular computer too). Four full-scale tracks are mixed the
+ * way the player mixes them with the limiter on: each at a quarter of
+ * its gain, so the sum can't clip, and then the limiter puts the level
+ * back:
+ *
+ *   peaks       the limited mix never goes over the threshold
+ *   below       a quiet track comes out bit for bit, only later
+ *   release     after a loud burst the gain comes back
+ *   meter       a track at twice the threshold reads as 6 dB
+ *   measure     the same, read without processing (the codec limits)
+ *   silence     missing inputs are silence
+ *
+ * and prints the CPU cycles per audio block. Each check prints "ok" or
+ * "FAILED".
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include <math.h>
+#include "PeakLimiter.h"
+
+#define BLOCK        128
+#define NUM_BLOCKS   400                   // about 1.2 sec
+#define THRESHOLD    29204                 // -1 dBFS
+#define HEADROOM     2                     // the voices at 1/4
+
+int16_t inLeft[BLOCK], inRight[BLOCK];
+int16_t outLeft[BLOCK], outRight[BLOCK];
+
+static void check(const char *what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? ": ok" : ": FAILED");
+}
+
+static float gainDb(int32_t gain) {
+  return 20.0 * log10((float)gain / LIMITER_UNITY);
+}
+
+// Four sines, each at full scale, mixed at a quarter
+static void mixTracks(int block) {
+  static const float hz[4] = {110.0, 233.0, 347.0, 1021.0};
+  for (int i = 0; i < BLOCK; i++) {
+    float t = (float)(block * BLOCK + i) / 44100.0;
+    int32_t left = 0, right = 0;
+    for (int track = 0; track < 4; track++) {
+      left  += (int32_t)(32767 * sin(2 * M_PI * hz[track] * t)) >> HEADROOM;
+      right += (int32_t)(32767 * sin(2 * M_PI * hz[track] * t + track)) >> HEADROOM;
+    }
+    inLeft[i] = left;
+    inRight[i] = right;
+  }
+}
+
+static void sine(int block, float amplitude) {
+  for (int i = 0; i < BLOCK; i++) {
+    inLeft[i] = (int16_t)(amplitude * sin(2 * M_PI * 440.0 * (block * BLOCK + i) / 44100.0));
+    inRight[i] = -inLeft[i];
+  }
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+  PeakLimiter limiter;
+  limiter.setThreshold(THRESHOLD);
+  limiter.setMakeupShift(HEADROOM);
+
+  // Peaks: four loud tracks
+  int32_t maxOut = 0;
+  for (int block = 0; block < NUM_BLOCKS; block++) {
+    mixTracks(block);
+    limiter.process(inLeft, inRight, outLeft, outRight, BLOCK);
+    for (int i = 0; i < BLOCK; i++) {
+      if (abs(outLeft[i]) > maxOut)
+        maxOut = abs(outLeft[i]);
+      if (abs(outRight[i]) > maxOut)
+        maxOut = abs(outRight[i]);
+    }
+  }
+  Serial.print("four full-scale tracks: peak out ");
+  Serial.print(maxOut);
+  Serial.print(", gain reduction ");
+  Serial.print(-gainDb(limiter.takeMinGain()), 1);
+  Serial.println(" dB");
+  check("peaks never over the threshold", maxOut <= THRESHOLD && maxOut > THRESHOLD * 9 / 10);
+
+  // Below the threshold: bit for bit, LIMITER_LOOKAHEAD - 1 samples late
+  limiter.reset();
+  static int16_t history[NUM_BLOCKS * BLOCK];
+  bool exact = true;
+  for (int block = 0; block < 100; block++) {
+    sine(block, 7000.0);                    // 28000 after the makeup
+    memcpy(history + block * BLOCK, inLeft, sizeof(inLeft));
+    limiter.process(inLeft, inRight, outLeft, outRight, BLOCK);
+    for (int i = 0; i < BLOCK; i++) {
+      int t = block * BLOCK + i - (LIMITER_LOOKAHEAD - 1);
+      int16_t expected = t < 0 ? 0 : history[t] * (1 << HEADROOM);
+      if (outLeft[i] != expected || outRight[i] != -expected)
+        exact = false;
+    }
+  }
+  check("below the threshold: bit for bit", exact && limiter.takeMinGain() == LIMITER_UNITY);
+
+  // Release: 0.1 sec loud, then quiet
+  limiter.reset();
+  int32_t afterBurst = 0;
+  for (int block = 0; block < NUM_BLOCKS; block++) {
+    sine(block, block < 35 ? 32767.0 : 1000.0);
+    limiter.process(inLeft, inRight, outLeft, outRight, BLOCK);
+    int32_t gain = limiter.takeMinGain();
+    if (block == 35 + 4 * 44100 / 10 / BLOCK)   // four release times later
+      afterBurst = gain;
+  }
+  Serial.print("gain four release times after a burst: ");
+  Serial.print(gainDb(afterBurst), 2);
+  Serial.println(" dB");
+  check("gain comes back after a burst", afterBurst > LIMITER_UNITY * 95 / 100);
+
+  // Meter: twice the threshold is 6 dB
+  limiter.reset();
+  for (int block = 0; block < 50; block++) {
+    sine(block, 2.0 * THRESHOLD / (1 << HEADROOM));
+    limiter.process(inLeft, inRight, outLeft, outRight, BLOCK);
+  }
+  float reduction = -gainDb(limiter.takeMinGain());
+  Serial.print("meter, twice the threshold: ");
+  Serial.print(reduction, 2);
+  Serial.println(" dB");
+  check("meter", reduction > 5.9 && reduction < 6.1);
+
+  for (int block = 0; block < 50; block++) {
+    sine(block, 2.0 * THRESHOLD / (1 << HEADROOM));
+    limiter.measure(inLeft, inRight, BLOCK);
+  }
+  reduction = -gainDb(limiter.takeMinGain());
+  check("measured without processing", reduction > 5.9 && reduction < 6.1);
+
+  // Silence
+  limiter.reset();
+  bool silent = true;
+  for (int block = 0; block < 4; block++) {
+    limiter.process(NULL, NULL, outLeft, outRight, BLOCK);
+    for (int i = 0; i < BLOCK; i++)
+      if (outLeft[i] || outRight[i])
+        silent = false;
+  }
+  check("missing inputs are silence", silent);
+
+  // Cycles per block, the mix made beforehand
+  static int16_t mixed[2][4][BLOCK];
+  for (int block = 0; block < 4; block++) {
+    mixTracks(block);
+    memcpy(mixed[0][block], inLeft, sizeof(inLeft));
+    memcpy(mixed[1][block], inRight, sizeof(inRight));
+  }
+  limiter.reset();
+  uint32_t start = ARM_DWT_CYCCNT;
+  for (int block = 0; block < NUM_BLOCKS; block++)
+    limiter.process(mixed[0][block % 4], mixed[1][block % 4], outLeft, outRight, BLOCK);
+  uint32_t cycles = (ARM_DWT_CYCCNT - start) / NUM_BLOCKS;
+  Serial.print("cycles per block, limiting: ");
+  Serial.println(cycles);
+}
+
+void loop() {
+}
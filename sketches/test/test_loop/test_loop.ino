@@ -0,0 +1,184 @@
+/*----------------------------------------------------------------------
+ * Checks gapless looping in the WavStream, on the simulated SD card (so
+ * no card or audio shield is needed, and it can be built on a regular
+ * computer too). The test track's samples count its frames (left is
+ * the frame number, right minus that), so every sample that comes out
+ * says where it came from:
+ *
+ *   loop points  read from a "smpl" chunk after the data
+ *   wrap         the track plays to the loop end, then repeats from the
+ *                loop start, sample for sample, for hundreds of loops
+ *   whole track  no loop points: end to start, with no gap
+ *   pre-roll     the loop start is inside the pre-roll; all in memory
+ *   seam         with a crossfade, the join moves in small steps, and
+ *                everything outside the seam is untouched
+ *   loop off     while playing: the track goes on to its end and stops
+ *
+ * Each check prints "ok" or "FAILED".
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include "WavStream.h"
+
+#define NUM_FRAMES  5000                  // stereo
+#define LOOP_START  1000                  // frames
+#define LOOP_END    3000                  // the first frame after the loop
+#define SEAM_FRAMES 64
+#define DATA_BYTES  (NUM_FRAMES * 4)
+#define SMPL_BYTES  (36 + 24)
+
+uint8_t wavFile[44 + DATA_BYTES + 8 + SMPL_BYTES];
+uint8_t plainFile[44 + DATA_BYTES];
+
+static void makeWav() {
+  makeWavHeader(wavFile, 2, 44100, DATA_BYTES);
+  wavPut32(wavFile + 4, sizeof(wavFile) - 8);  // and the smpl chunk
+  for (int i = 0; i < NUM_FRAMES; i++) {
+    int16_t l = i, r = -i;
+    uint8_t *p = wavFile + 44 + 4*i;
+    wavPut16(p, l);
+    wavPut16(p + 2, r);
+  }
+
+  // One forward loop; its end frame is played
+  uint8_t *smpl = wavFile + 44 + DATA_BYTES;
+  memset(smpl, 0, 8 + SMPL_BYTES);
+  memcpy(smpl, "smpl", 4);
+  wavPut32(smpl + 4, SMPL_BYTES);
+  wavPut32(smpl + 8 + 28, 1);
+  wavPut32(smpl + 8 + 36 + 8, LOOP_START);
+  wavPut32(smpl + 8 + 36 + 12, LOOP_END - 1);
+
+  memcpy(plainFile, wavFile, sizeof(plainFile));
+  wavPut32(plainFile + 4, sizeof(plainFile) - 8);
+}
+
+static void check(const char *what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? ": ok" : ": FAILED");
+}
+
+SimulatedSd sd;
+SimulatedSdFile file(&sd);
+int16_t left[WAV_BLOCK_SAMPLES], right[WAV_BLOCK_SAMPLES];
+uint32_t framesOut;                         // since the track started
+
+// Which frame of the track the n-th frame out should be
+static int expected(uint32_t n, int start, int end) {
+  if (n < (uint32_t)end)
+    return n;
+  return start + (n - end) % (end - start);
+}
+
+// Plays blocks (on from framesOut) and counts the frames that aren't
+// what they should be.
+// With seamFrames, the frames in the seam are left out, and the largest
+// step from one frame to the next is returned in *maxStep.
+static int play(WavStream *stream, int blocks, int start, int end,
+                int seamFrames = 0, int *maxStep = 0) {
+  int wrong = 0;
+  int last = 0;
+  for (int b = 0; b < blocks; b++) {
+    if (!stream->readBlock(left, right))
+      return wrong + 1;
+    for (int i = 0; i < WAV_BLOCK_SAMPLES; i++, framesOut++) {
+      int frame = expected(framesOut, start, end);
+      if (right[i] != -left[i])
+        wrong++;
+      if (frame < end - seamFrames && left[i] != frame)
+        wrong++;
+      if (maxStep && i + b > 0 && abs(left[i] - last) > *maxStep)
+        *maxStep = abs(left[i] - last);
+      last = left[i];
+    }
+  }
+  return wrong;
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+  makeWav();
+  sd.addFile("/E1/LOOP.WAV", wavFile, sizeof(wavFile));
+  sd.addFile("/E1/PLAIN.WAV", plainFile, sizeof(plainFile));
+
+  WavFormat format;
+  file.open("/E1/LOOP.WAV");
+  bool plain = WavStream::readHeader(&file, &format) && format.loopEnd == 0;
+  file.seek(0);
+  bool loop = WavStream::readHeader(&file, &format, true);
+  uint8_t frames[8];                          // the file is left at the data
+  bool atData = file.read(frames, 8) == 8 && frames[4] == 1 && frames[6] == 0xFF;
+  check("loop points read from the smpl chunk",
+        plain && loop && format.loopStart == LOOP_START * 4 && format.loopEnd == LOOP_END * 4
+        && format.dataBytes == DATA_BYTES && atData);
+  file.close();
+
+  // Wrap, from the card. 400 blocks is about 25 times round the loop.
+  WavStream stream;
+  stream.setLoop(true);
+  stream.open(&file, "/E1/LOOP.WAV");
+  stream.start();
+  framesOut = 0;
+  int wrong = play(&stream, 400, LOOP_START, LOOP_END);
+  check("wraps at the loop points, sample for sample", wrong == 0 && stream.isPlaying());
+
+  stream.open(&file, "/E1/PLAIN.WAV");
+  stream.start();
+  framesOut = 0;
+  wrong = play(&stream, 400, 0, NUM_FRAMES);
+  check("whole track loops with no gap", wrong == 0 && stream.isPlaying());
+
+  // The first 1500 frames in memory, then the card
+  stream.startPreroll(&format, wavFile + 44, 1500 * 4);
+  framesOut = 0;
+  wrong = play(&stream, 1, LOOP_START, LOOP_END);
+  stream.openRest(&file, "/E1/LOOP.WAV");
+  wrong += play(&stream, 400, LOOP_START, LOOP_END);
+  check("loop start inside the pre-roll", wrong == 0 && stream.getUnderruns() == 0);
+
+  stream.startPreroll(&format, wavFile + 44, DATA_BYTES);
+  framesOut = 0;
+  wrong = play(&stream, 400, LOOP_START, LOOP_END);
+  check("all in memory", wrong == 0 && !stream.readsFile());
+
+  // Without a crossfade the join is one step of the loop's length
+  int plainStep = 0, seamStep = 0;
+  stream.open(&file, "/E1/LOOP.WAV");
+  stream.start();
+  framesOut = 0;
+  play(&stream, 100, LOOP_START, LOOP_END, 0, &plainStep);
+  stream.setLoop(true, SEAM_FRAMES);
+  stream.open(&file, "/E1/LOOP.WAV");
+  stream.start();
+  framesOut = 0;
+  wrong = play(&stream, 400, LOOP_START, LOOP_END, SEAM_FRAMES, &seamStep);
+  Serial.print("largest step at the join: ");
+  Serial.print(plainStep);
+  Serial.print(" without a crossfade, ");
+  Serial.print(seamStep);
+  Serial.println(" with one");
+  check("seam crossfade", wrong == 0
+        && seamStep <= (LOOP_END - LOOP_START) / (SEAM_FRAMES + 1) + 2);
+
+  // Loop off in the middle of a loop
+  stream.setLoop(true);
+  stream.open(&file, "/E1/LOOP.WAV");
+  stream.start();
+  framesOut = 0;
+  play(&stream, 50, LOOP_START, LOOP_END);
+  stream.setLoop(false);
+  int last = -1;
+  wrong = 0;
+  while (stream.readBlock(left, right)) {
+    for (int i = 0; i < WAV_BLOCK_SAMPLES && last < NUM_FRAMES - 1; i++) {
+      if (last >= 0 && left[i] != last + 1)
+        wrong++;
+      last = left[i];
+    }
+  }
+  check("loop off: plays on to the end", wrong == 0 && last == NUM_FRAMES - 1 && !stream.isPlaying());
+}
+
+void loop() {
+}
@@ -0,0 +1,163 @@
+/*----------------------------------------------------------------------
+ * Checks the Mpr121SensorSource against simulated MPR121 chips (no
+ * hardware needed; it can be built on a regular computer too), and
+ * measures the I2C traffic it causes:
+ *
+ *   setup       both chips found; a missing second chip is noticed
+ *   batching    each read is one burst transaction per chip, instead
+ *               of one per electrode
+ *   values      raw values are 1023 - filtered data, and a channel reads
+ *               the strongest of its electrodes, on either chip
+ *   rate        polled constantly, the chips are read once per read
+ *               interval; an IRQ gets an immediate read
+ *   snapshot    read() keeps returning the last burst's values until
+ *               the next one
+ *   errors      a failed read is counted and the old values are kept
+ *
+ * and prints the bus load at 400 kHz and the cycles per burst. Each
+ * check prints "ok" or "FAILED".
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include "Mpr121SensorSource.h"
+
+#define BUS_HZ      400000
+#define BITS_PER_BYTE 9                   // 8 data bits and the ACK
+#define RUN_USEC    1000000
+#define POLL_USEC   100
+
+// The second chip doesn't answer, or (once broken) neither does any
+class FlakyMpr121 : public SimulatedMpr121
+{
+ public:
+  FlakyMpr121() { noSecondChip = false; broken = false; }
+  bool readRegisters(uint8_t address, uint8_t reg, uint8_t *buffer, int count) {
+    if (broken || (noSecondChip && address != MPR121_ADDRESS))
+      return false;
+    return SimulatedMpr121::readRegisters(address, reg, buffer, count);
+  }
+  bool noSecondChip;
+  bool broken;
+};
+
+static void check(const char *what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? ": ok" : ": FAILED");
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+
+  FlakyMpr121 bus;
+  for (int e = 0; e < MPR121_ELECTRODES * MPR121_MAX_CHIPS; e++)
+    bus.setFilteredData(e, 900);
+  Mpr121SensorSource chips(&bus, 2);
+  chips.begin();
+  check("setup: both chips found", chips.isConnected());
+  FlakyMpr121 oneChip;
+  oneChip.noSecondChip = true;
+  Mpr121SensorSource missing(&oneChip, 2);
+  missing.begin();
+  check("setup: missing chip noticed", !missing.isConnected());
+
+  // One burst
+  uint32_t transactions = bus.getTransactionCount();
+  uint32_t bytes = bus.getByteCount();
+  chips.interrupt();
+  chips.poll(0);
+  transactions = bus.getTransactionCount() - transactions;
+  bytes = bus.getByteCount() - bytes;
+  check("batching: one transaction per chip", transactions == 2 && bytes == 2 * (3 + MPR121_BURST_BYTES));
+
+  // The same data an electrode at a time, for comparison
+  uint32_t singleBytes = bus.getByteCount();
+  uint8_t data[2];
+  for (int chip = 0; chip < 2; chip++)
+    for (int e = 0; e < MPR121_ELECTRODES; e++)
+      bus.readRegisters(MPR121_ADDRESS + chip, 0x04 + 2 * e, data, 2);   // filtered data
+  singleBytes = bus.getByteCount() - singleBytes;
+  Serial.print("bytes per read of both chips: burst ");
+  Serial.print(bytes);
+  Serial.print(", electrode by electrode ");
+  Serial.println(singleBytes);
+
+  // Values: channel 1 also covers electrode 20, on the second chip
+  chips.setChannelElectrodes(1, (1 << 1) | (1 << 20));
+  bus.setFilteredData(0, 700);
+  bus.setFilteredData(1, 800);
+  bus.setFilteredData(20, 600);
+  chips.interrupt();
+  chips.poll(1);
+  uint16_t values[NUM_CHANNELS];
+  chips.read(values);
+  check("values: 1023 - data, strongest electrode", values[0] == 323 && values[1] == 423 && values[2] == 123);
+
+  // Snapshot until the next burst
+  bus.setFilteredData(0, 500);
+  chips.read(values);
+  bool snapshot = values[0] == 323;
+  chips.interrupt();
+  chips.poll(2);
+  chips.read(values);
+  check("snapshot: unchanged until the next burst", snapshot && values[0] == 523);
+
+  // Rate: polled every 100 usec for a second, with an IRQ now and then
+  uint32_t reads = chips.getReadCount();
+  transactions = bus.getTransactionCount();
+  bytes = bus.getByteCount();
+  int irqs = 0;
+  bool irqServed = true;
+  for (uint32_t now = 10000; now < 10000 + RUN_USEC; now += POLL_USEC) {
+    bool irq = (now % 100000) == 50000;
+    if (irq) {
+      chips.interrupt();
+      irqs++;
+    }
+    uint32_t before = chips.getReadCount();
+    chips.poll(now);
+    if (irq && chips.getReadCount() != before + 1)
+      irqServed = false;
+  }
+  reads = chips.getReadCount() - reads;
+  transactions = bus.getTransactionCount() - transactions;
+  bytes = bus.getByteCount() - bytes;
+  uint32_t expected = RUN_USEC / MPR121_READ_INTERVAL_USEC;
+  float load = (float)bytes * BITS_PER_BYTE / BUS_HZ * 100.0;
+  Serial.print("a second of polling: ");
+  Serial.print(reads);
+  Serial.print(" reads (");
+  Serial.print(irqs);
+  Serial.print(" for an IRQ), ");
+  Serial.print(transactions);
+  Serial.print(" transactions, ");
+  Serial.print(bytes);
+  Serial.print(" bytes, bus load at 400 kHz ");
+  Serial.print(load, 1);
+  Serial.println("%");
+  check("rate: once per read interval", reads >= expected && reads <= expected + irqs && transactions == 2 * reads);
+  check("rate: an IRQ gets an immediate read", irqServed);
+
+  // Errors
+  chips.read(values);
+  uint16_t before = values[0];
+  bus.setFilteredData(0, 100);
+  bus.broken = true;
+  chips.interrupt();
+  chips.poll(2000000);
+  chips.read(values);
+  check("errors: counted, old values kept", chips.getErrorCount() == 1 && values[0] == before);
+  bus.broken = false;
+
+  // Cost of a burst (mostly the simulated bus, on a host)
+  uint32_t start = ARM_DWT_CYCCNT;
+  for (int i = 0; i < 10000; i++) {
+    chips.interrupt();
+    chips.poll(3000000 + i);
+  }
+  Serial.print("cycles per burst of both chips: ");
+  Serial.println((ARM_DWT_CYCCNT - start) / 10000);
+}
+
+void loop() {
+}
@@ -0,0 +1,77 @@
+/*----------------------------------------------------------------------
+ * Shows what pre-arming saves, on a simulated SD card (so no card or
+ * audio shield is needed, and it can be built on a regular computer
+ * too). A WAV file is made in memory; then, for each way of starting it,
+ * prints the card time spent between the touch and the first audio
+ * block:
+ *
+ *   cold      open + header + first buffers, all after the touch
+ *   prepared  WavStream::open() when proximity crossed the pre-arm
+ *             threshold, so the touch only calls start()
+ *
+ * Also checks that the prepared stream gives exactly the same samples,
+ * and that a cancelled one doesn't touch the card again.
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include "WavStream.h"
+
+#define NUM_FRAMES 4410                  // 0.1 sec, stereo
+
+uint8_t wavFile[44 + NUM_FRAMES * 4];
+
+static void makeWav() {
+  makeWavHeader(wavFile, 2, 44100, NUM_FRAMES * 4);
+  for (int i = 0; i < NUM_FRAMES * 2; i++) {
+    int16_t v = (i * 37) & 0x7FFF;
+    wavPut16(wavFile + 44 + 2*i, v);
+  }
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+  makeWav();
+
+  SimulatedSd sd;
+  sd.addFile("/E1/TRACK.WAV", wavFile, sizeof(wavFile));
+  SimulatedSdFile file(&sd);
+  WavStream stream;
+  int16_t left[WAV_BLOCK_SAMPLES], right[WAV_BLOCK_SAMPLES];
+  int16_t coldLeft[WAV_BLOCK_SAMPLES];
+
+  // Cold start: everything happens after the touch.
+  sd.resetBusyMicros();
+  stream.open(&file, "/E1/TRACK.WAV");
+  stream.start();
+  stream.readBlock(coldLeft, right);
+  uint32_t cold = sd.getBusyMicros();
+  stream.stop();
+
+  // Prepared: the slow part happened before the touch.
+  stream.open(&file, "/E1/TRACK.WAV");
+  sd.resetBusyMicros();
+  stream.start();
+  stream.readBlock(left, right);
+  uint32_t prepared = sd.getBusyMicros();
+  stream.stop();
+
+  Serial.print("card time from touch to first block, cold: ");
+  Serial.print(cold);
+  Serial.print(" usec, prepared: ");
+  Serial.print(prepared);
+  Serial.println(" usec");
+  Serial.print("same samples: ");
+  Serial.println(memcmp(left, coldLeft, sizeof(left)) == 0 ? "yes" : "NO");
+
+  // Cancelled: no more card access after the hand went away.
+  stream.open(&file, "/E1/TRACK.WAV");
+  sd.resetBusyMicros();
+  stream.stop();
+  Serial.print("card time to cancel: ");
+  Serial.print(sd.getBusyMicros());
+  Serial.println(" usec");
+}
+
+void loop() {
+}
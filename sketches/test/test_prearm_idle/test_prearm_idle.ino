@@ -0,0 +1,167 @@
+/*----------------------------------------------------------------------
+ * Checks that a track pre-armed after a long idle time is still the one
+ * a touch starts, on a simulated SD card (so no card or audio shield is
+ * needed, and it can be built on a regular computer too). The voice
+ * pool and the streams are the library's; the inactivity timeout of
+ * Tactile::loop() and AudioPlayer::cancelAll() need the audio library,
+ * so the few lines of them that matter are repeated here, with a
+ * simulated clock.
+ *
+ *   - a track plays, then the channel is idle past the timeout: the
+ *     timeout cancels it and frees its voice
+ *   - a hand comes near: the next track is armed on a voice, and that
+ *     counts as activity, so the timeout doesn't fire while it's near
+ *   - with a timeout of 0 (the default), cancelAll() runs on every
+ *     pass; the armed voice survives it
+ *   - the touch starts the armed voice, with no card time, and plays
+ *     the same samples as a cold start
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include <string.h>
+#include "VoicePool.h"
+#include "WavStream.h"
+
+#define NUM_FRAMES   4410                 // 0.1 sec, stereo
+#define TEST_CHANNELS 4
+#define TEST_VOICES   4
+#define TIMEOUT_MSEC 60000                // as in the shipped sketches
+#define PASS_MSEC    10                   // one pass through loop()
+
+uint8_t wavFile[44 + NUM_FRAMES * 4];
+const char *path = "/E1/TRACK.WAV";
+
+SimulatedSd sd;
+SimulatedSdFile file(&sd);
+VoicePool pool(TEST_VOICES);
+WavStream streams[TEST_VOICES];
+int current[TEST_CHANNELS];               // the channel's voice, -1 if none
+uint32_t now;                             // msec
+uint32_t lastActionTime;
+uint32_t restartTimeout;
+
+static void makeWav() {
+  makeWavHeader(wavFile, 2, 44100, NUM_FRAMES * 4);
+  for (int i = 0; i < NUM_FRAMES * 2; i++) {
+    int16_t v = (i * 41) & 0x7FFF;
+    wavPut16(wavFile + 44 + 2*i, v);
+  }
+}
+
+static void check(const char *what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? ": ok" : ": FAILED");
+}
+
+// AudioPlayer::cancelAll()
+static int cancelAll() {
+  int cancelled = 0;
+  for (int voice = 0; voice < TEST_VOICES; voice++) {
+    int channel = pool.getChannel(voice);
+    if (channel < 0 || pool.isArmed(voice))
+      continue;
+    if (streams[voice].isPlaying())
+      cancelled++;
+    streams[voice].stop();
+    pool.free(voice);
+  }
+  for (int channel = 0; channel < TEST_CHANNELS; channel++) {
+    if (!pool.isArmed(current[channel]))
+      current[channel] = -1;
+  }
+  return cancelled;
+}
+
+// The end of Tactile::loop(); true if it cancelled anything.
+static bool loopPass() {
+  now += PASS_MSEC;
+  if (now - lastActionTime > restartTimeout && cancelAll()) {
+    lastActionTime = now;
+    return true;
+  }
+  return false;
+}
+
+// NEW_PREARM, then AudioPlayer::prepareTrack()
+static int prearm(int channel) {
+  lastActionTime = now;
+  int cutFrom;
+  int voice = pool.allocate(channel, 0, false, &cutFrom);
+  if (voice < 0 || !streams[voice].open(&file, path))
+    return -1;
+  pool.setArmed(voice, true);
+  current[channel] = voice;
+  return voice;
+}
+
+// NEW_TOUCH, then AudioPlayer::startTrack(): the armed voice if there is
+// one, else a new one, opened cold.
+static int touch(int channel) {
+  lastActionTime = now;
+  int voice = current[channel];
+  if (voice >= 0 && pool.isArmed(voice)) {
+    streams[voice].start();
+    pool.setArmed(voice, false);
+    return voice;
+  }
+  int cutFrom;
+  voice = pool.allocate(channel, 0, true, &cutFrom);
+  streams[voice].open(&file, path);
+  streams[voice].start();
+  current[channel] = voice;
+  return voice;
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+  makeWav();
+  sd.addFile(path, wavFile, sizeof(wavFile));
+  for (int channel = 0; channel < TEST_CHANNELS; channel++)
+    current[channel] = -1;
+  int16_t left[WAV_BLOCK_SAMPLES], right[WAV_BLOCK_SAMPLES];
+  int16_t coldLeft[WAV_BLOCK_SAMPLES];
+
+  // A touch plays a track, then nothing happens for longer than the
+  // timeout.
+  restartTimeout = TIMEOUT_MSEC;
+  now = 0;
+  lastActionTime = 0;
+  int played = touch(1);
+  streams[played].readBlock(coldLeft, right);
+  bool fired = false;
+  while (now < TIMEOUT_MSEC + 1000)
+    fired = loopPass() || fired;
+  check("idle past the timeout: the playing track is cancelled",
+        fired && pool.getChannel(played) < 0 && current[1] < 0);
+
+  // A hand comes near, slowly.
+  int armed = prearm(1);
+  check("pre-arm: a voice is armed", armed >= 0 && pool.isArmed(armed)
+        && streams[armed].isArmed());
+  fired = false;
+  for (int pass = 0; pass < 50; pass++)
+    fired = loopPass() || fired;
+  check("pre-arm counts as activity: no timeout while the hand is near",
+        !fired && now - lastActionTime <= restartTimeout);
+
+  // With no timeout, cancelAll() runs on every pass.
+  restartTimeout = 0;
+  for (int pass = 0; pass < 50; pass++)
+    loopPass();
+  check("timeout of 0: the armed voice is kept",
+        pool.getChannel(armed) == 1 && pool.isArmed(armed)
+        && streams[armed].isArmed() && current[1] == armed);
+
+  // The touch.
+  sd.resetBusyMicros();
+  int started = touch(1);
+  streams[started].readBlock(left, right);
+  check("the touch starts the armed voice", started == armed && streams[started].isPlaying());
+  check("no card time from touch to first block", sd.getBusyMicros() == 0);
+  check("same samples as a cold start", memcmp(left, coldLeft, sizeof(left)) == 0);
+  check("not armed once it's playing", !pool.isArmed(started));
+}
+
+void loop() {
+}
@@ -0,0 +1,126 @@
+/*----------------------------------------------------------------------
+ * Checks pre-opening on a simulated SD card (so no card or audio shield
+ * is needed, and it can be built on a regular computer too). A channel
+ * with a folder of four tracks is touched 20 times, in shuffled order,
+ * each touch playing a few blocks:
+ *
+ *   cold        the track is chosen, looked up in the folder, opened
+ *               and its first buffer read, all after the touch
+ *   pre-opened  all that is done when the channel goes idle, so the
+ *               touch costs no card time at all
+ *   no fill     pre-opened, but the first buffer is read by the first
+ *               block after the touch
+ *
+ * Prints the card time from touch to the first block, on average, and
+ * checks that the sound is the same, sample for sample.
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include "WavStream.h"
+
+#define NUM_FRAMES    11025               // 0.25 sec, stereo
+#define NUM_TRACKS    4
+#define NUM_TOUCHES   20
+#define TOUCH_BLOCKS  10
+#define BLOCK_USEC    2902                // 128 samples at 44.1 kHz
+
+uint8_t wavFile[NUM_TRACKS][44 + NUM_FRAMES * 4];
+const char *paths[NUM_TRACKS] = {"/E1/A.WAV", "/E1/B.WAV", "/E1/C.WAV", "/E1/D.WAV"};
+int order[NUM_TOUCHES];
+int16_t reference[NUM_TOUCHES][TOUCH_BLOCKS * WAV_BLOCK_SAMPLES];
+
+static void makeWav(int track) {
+  uint8_t *w = wavFile[track];
+  makeWavHeader(w, 2, 44100, NUM_FRAMES * 4);
+  for (int i = 0; i < NUM_FRAMES * 2; i++) {
+    int16_t v = (i * (31 + 6 * track)) & 0x7FFF;
+    wavPut16(w + 44 + 2*i, v);
+  }
+}
+
+// Each pass through the folder in a new order, like playReshuffled
+static void shuffle() {
+  for (int pass = 0; pass < NUM_TOUCHES / NUM_TRACKS; pass++) {
+    int *p = order + pass * NUM_TRACKS;
+    for (int i = 0; i < NUM_TRACKS; i++)
+      p[i] = i;
+    for (int i = NUM_TRACKS - 1; i > 0; i--) {
+      int j = random(i + 1);
+      int t = p[i];
+      p[i] = p[j];
+      p[j] = t;
+    }
+  }
+}
+
+SimulatedSd sd;
+SimulatedSdFile file(&sd);
+int16_t left[WAV_BLOCK_SAMPLES], right[WAV_BLOCK_SAMPLES];
+
+// Plays every touch. With preopen, the next track is opened when the
+// channel goes idle (after the release), and the card time that takes
+// isn't counted. Returns the average card time from touch to the first
+// block; *mismatches counts samples different from the reference.
+static uint32_t playTouches(bool preopen, bool fill, bool record, int *mismatches) {
+  WavStream stream;
+  uint32_t touchMicros = 0;
+  *mismatches = 0;
+  if (preopen)
+    stream.open(&file, paths[order[0]], fill);
+  for (int t = 0; t < NUM_TOUCHES; t++) {
+    sd.resetBusyMicros();                   // touch
+    if (!preopen)
+      stream.open(&file, paths[order[t]]);
+    stream.start();
+    for (int b = 0; b < TOUCH_BLOCKS; b++) {
+      stream.readBlock(left, right);
+      if (b == 0)
+        touchMicros += sd.getBusyMicros();
+      int16_t *ref = reference[t] + b * WAV_BLOCK_SAMPLES;
+      if (record)
+        memcpy(ref, left, sizeof(left));
+      else
+        for (int i = 0; i < WAV_BLOCK_SAMPLES; i++)
+          if (left[i] != ref[i])
+            (*mismatches)++;
+    }
+    stream.stop();                          // release
+    if (preopen && t + 1 < NUM_TOUCHES)
+      stream.open(&file, paths[order[t + 1]], fill);
+  }
+  return touchMicros / NUM_TOUCHES;
+}
+
+static void report(const char *what, uint32_t usec, int mismatches) {
+  Serial.print(what);
+  Serial.print(": card time from touch to first block: ");
+  Serial.print(usec);
+  Serial.print(" usec, blocks of delay: ");
+  Serial.print((usec + BLOCK_USEC - 1) / BLOCK_USEC);
+  Serial.print(", samples different from cold: ");
+  Serial.println(mismatches);
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+  for (int track = 0; track < NUM_TRACKS; track++) {
+    makeWav(track);
+    sd.addFile(paths[track], wavFile[track], sizeof(wavFile[track]));
+  }
+  shuffle();
+
+  int mismatches;
+  uint32_t cold = playTouches(false, true, true, &mismatches);
+  report("cold", cold, 0);
+  uint32_t preopened = playTouches(true, true, false, &mismatches);
+  report("pre-opened", preopened, mismatches);
+  bool ok = preopened == 0 && mismatches == 0;
+  uint32_t noFill = playTouches(true, false, false, &mismatches);
+  report("pre-opened, no fill", noFill, mismatches);
+  ok = ok && noFill < cold && mismatches == 0;
+  Serial.println(ok ? "pre-open: ok" : "pre-open: FAILED");
+}
+
+void loop() {
+}
@@ -0,0 +1,158 @@
+/*----------------------------------------------------------------------
+ * Checks the pre-roll handoff on a simulated SD card (so no card or
+ * audio shield is needed, and it can be built on a regular computer
+ * too). A one-second WAV file is made in memory, and played:
+ *
+ *   cold      open + header + first buffers, all after the touch
+ *   pre-roll  the first 100 msec from memory; the file is opened after
+ *             the first block, while the blocks that the card time
+ *             would take are played from the pre-roll
+ *
+ * and the two outputs have to be identical, sample for sample. Then
+ * again with a pre-roll shorter than the card time: there is a gap of
+ * silence (counted as underruns), and the sound has to carry on from
+ * exactly where the pre-roll ended. Last, what fits in a small budget.
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include "WavStream.h"
+#include "PrerollCache.h"
+
+#define NUM_FRAMES  44100                 // 1 sec, stereo
+#define BLOCK_USEC  2902                  // 128 samples at 44.1 kHz
+#define POOL_BYTES  65536
+
+uint8_t wavFile[44 + NUM_FRAMES * 4];
+uint8_t pool[POOL_BYTES] __attribute__((aligned(4)));
+int16_t reference[NUM_FRAMES + WAV_BLOCK_SAMPLES];
+
+static void makeWav() {
+  makeWavHeader(wavFile, 2, 44100, NUM_FRAMES * 4);
+  for (int i = 0; i < NUM_FRAMES * 2; i++) {
+    int16_t v = (i * 37) & 0x7FFF;
+    wavPut16(wavFile + 44 + 2*i, v);
+  }
+}
+
+SimulatedSd sd;
+SimulatedSdFile file(&sd);
+int16_t left[WAV_BLOCK_SAMPLES], right[WAV_BLOCK_SAMPLES];
+
+// How long opening the file will take on the card: header and first
+// buffers.
+
+int blocksToOpen() {
+  SimulatedSdFile probe(&sd);
+  uint32_t before = sd.getBusyMicros();
+  WavFormat format;
+  uint8_t buffer[WAV_BUFFER_BYTES];
+  probe.open("/E1/TRACK.WAV");
+  WavStream::readHeader(&probe, &format);
+  probe.read(buffer, sizeof(buffer));
+  probe.close();
+  return (sd.getBusyMicros() - before + BLOCK_USEC - 1) / BLOCK_USEC;
+}
+
+// Plays from the pre-roll. The blocks that opening the file takes are
+// played before openRest() (on a Teensy they overlap it). Returns the
+// number of samples different from the cold start; once there's been an
+// underrun, the file has to carry on from where the pre-roll ended.
+
+int playFromPreroll(WavStream *stream, const PrerollEntry *entry, uint32_t *firstBlockUsec, int *from) {
+  int blocksDuringOpen = blocksToOpen();
+  sd.resetBusyMicros();
+  stream->startPreroll(&entry->format, entry->data, entry->bytes);
+  stream->readBlock(left, right);
+  *firstBlockUsec = sd.getBusyMicros();
+
+  int mismatches = 0;
+  int frame = 0;
+  for (int b = 0; b <= blocksDuringOpen; b++) {
+    if (b > 0)
+      stream->readBlock(left, right);
+    for (int i = 0; i < WAV_BLOCK_SAMPLES && stream->getUnderruns() == 0; i++)
+      if (left[i] != reference[frame + i])
+        mismatches++;
+    frame += WAV_BLOCK_SAMPLES;
+  }
+  stream->openRest(&file, "/E1/TRACK.WAV");
+  if (stream->getUnderruns() > 0)
+    frame = entry->bytes / 4;
+  *from = frame;
+  while (stream->readBlock(left, right)) {
+    for (int i = 0; i < WAV_BLOCK_SAMPLES; i++, frame++)
+      if (left[i] != reference[frame])
+        mismatches++;
+  }
+  return mismatches;
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+  makeWav();
+  sd.addFile("/E1/TRACK.WAV", wavFile, sizeof(wavFile));
+  sd.addFile("/E1/TWO.WAV", wavFile, sizeof(wavFile));
+  sd.addFile("/E1/THREE.WAV", wavFile, sizeof(wavFile));
+  sd.addFile("/E1/FOUR.WAV", wavFile, sizeof(wavFile));
+
+  // Cold start, and the reference output
+  WavStream stream;
+  sd.resetBusyMicros();
+  stream.open(&file, "/E1/TRACK.WAV");
+  stream.start();
+  int frame = 0;
+  uint32_t cold = 0;
+  while (stream.readBlock(left, right)) {
+    if (frame == 0)
+      cold = sd.getBusyMicros();
+    memcpy(reference + frame, left, sizeof(left));
+    frame += WAV_BLOCK_SAMPLES;
+  }
+
+  PrerollCache cache;
+  cache.setPool(pool, POOL_BYTES);
+  cache.add(&file, "/E1/TRACK.WAV", 100);
+  uint32_t firstBlock;
+  int from;
+  WavStream prerolled;
+  int mismatches = playFromPreroll(&prerolled, cache.find("/E1/TRACK.WAV"), &firstBlock, &from);
+  Serial.print("card time from touch to first block, cold: ");
+  Serial.print(cold);
+  Serial.print(" usec, pre-roll: ");
+  Serial.print(firstBlock);
+  Serial.println(" usec");
+  Serial.print("100 msec pre-roll: samples different from cold: ");
+  Serial.print(mismatches);
+  Serial.print(", underruns: ");
+  Serial.println(prerolled.getUnderruns());
+
+  cache.clear();
+  cache.add(&file, "/E1/TRACK.WAV", 5);
+  WavStream tooShort;
+  mismatches = playFromPreroll(&tooShort, cache.find("/E1/TRACK.WAV"), &firstBlock, &from);
+  Serial.print("5 msec pre-roll: underruns: ");
+  Serial.print(tooShort.getUnderruns());
+  Serial.print(", carries on from frame ");
+  Serial.print(from);
+  Serial.print(", samples different after that: ");
+  Serial.println(mismatches);
+
+  cache.clear();
+  cache.add(&file, "/E1/TRACK.WAV", 100);
+  cache.add(&file, "/E1/TWO.WAV", 100);
+  cache.add(&file, "/E1/THREE.WAV", 100);
+  cache.add(&file, "/E1/FOUR.WAV", 100);
+  Serial.print("budget ");
+  Serial.print(POOL_BYTES / 1024);
+  Serial.print(" KB: ");
+  Serial.print(cache.getNumTracks());
+  Serial.print(" tracks fit (");
+  Serial.print(cache.getUsedBytes());
+  Serial.print(" bytes), ");
+  Serial.print(cache.getNumSkipped());
+  Serial.println(" didn't");
+}
+
+void loop() {
+}
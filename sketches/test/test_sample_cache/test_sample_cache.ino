@@ -0,0 +1,122 @@
+/*----------------------------------------------------------------------
+ * Checks the SampleCache, on the simulated SD card (so no card or audio
+ * shield is needed, and it can be built on a regular computer too):
+ *
+ *   eviction   with room for three tracks, the least recently used one
+ *              goes when a fourth comes in, but never one that's in use
+ *   hit rate   hits, misses and too-large tracks are counted right
+ *   capture    a track copied into the cache while it streams from the
+ *              card plays back from memory identically, with no card
+ *              time at all
+ *
+ * Each check prints "ok" or "FAILED".
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include "SampleCache.h"
+
+#define NUM_FRAMES 22050                 // 0.5 sec, stereo
+
+uint8_t wavFile[44 + NUM_FRAMES * 4];
+
+static void makeWav() {
+  makeWavHeader(wavFile, 2, 44100, NUM_FRAMES * 4);
+  for (int i = 0; i < NUM_FRAMES * 2; i++) {
+    int16_t v = (i * 37) & 0x7FFF;
+    wavPut16(wavFile + 44 + 2*i, v);
+  }
+}
+
+static void check(const char *what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? ": ok" : ": FAILED");
+}
+
+// A track that's been played through to the end
+static void load(SampleCache *cache, const char *path, uint32_t bytes) {
+  WavFormat format = {2, 44100 * 4, 44, bytes};
+  SampleCacheEntry *entry = cache->allocate(path, &format);
+  if (entry)
+    cache->complete(entry);
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+  makeWav();
+
+  // Eviction: room for three 30000-byte tracks
+  SampleCache cache;
+  cache.setBudget(100000, 50000, malloc, free);
+  load(&cache, "A.WAV", 30000);
+  load(&cache, "B.WAV", 30000);
+  load(&cache, "C.WAV", 30000);
+  SampleCacheEntry *a = cache.lookup("A.WAV");
+  cache.release(a);                          // A is now the most recent
+  load(&cache, "D.WAV", 30000);
+  check("least recently used is evicted",
+        !cache.isCached("B.WAV") && cache.isCached("A.WAV") && cache.isCached("C.WAV")
+        && cache.isCached("D.WAV") && cache.getEvictions() == 1);
+
+  SampleCacheEntry *c = cache.lookup("C.WAV");   // C is playing...
+  load(&cache, "E.WAV", 30000);
+  load(&cache, "F.WAV", 30000);
+  check("entry in use isn't evicted", cache.isCached("C.WAV") && cache.getUsedBytes() <= 100000);
+  cache.release(c);
+
+  load(&cache, "LONG.WAV", 60000);
+  check("too large isn't cached", !cache.isCached("LONG.WAV") && cache.getTooLarge() == 1);
+
+  // Hit rate. So far: 2 hits (A, C), 0 misses, 1 too large (which goes
+  // with a miss when it's played). 3 misses and 5 hits more.
+  cache.lookup("LONG.WAV");
+  cache.lookup("B.WAV");
+  cache.lookup("X.WAV");
+  for (int i = 0; i < 5; i++)
+    cache.release(cache.lookup("F.WAV"));
+  check("hits and misses", cache.getHits() == 7 && cache.getMisses() == 3);
+  check("hit rate leaves out tracks too large to cache",
+        cache.getHitRatePercent() == 7 * 100 / (7 + 3 - 1));
+
+  // Capture while streaming, then play from memory
+  SimulatedSd sd;
+  sd.addFile("/E1/CLIP.WAV", wavFile, sizeof(wavFile));
+  SimulatedSdFile file(&sd);
+  WavStream stream;
+  int16_t left[WAV_BLOCK_SAMPLES], right[WAV_BLOCK_SAMPLES];
+  static int16_t fromCard[NUM_FRAMES + WAV_BLOCK_SAMPLES];
+
+  SampleCache clips;
+  clips.setBudget(200000, 100000, malloc, free);
+  stream.open(&file, "/E1/CLIP.WAV");
+  SampleCacheEntry *entry = clips.allocate("/E1/CLIP.WAV", stream.getFormat());
+  stream.setCapture(entry->data);
+  stream.start();
+  int frame = 0;
+  while (stream.readBlock(left, right)) {
+    memcpy(fromCard + frame, left, sizeof(left));
+    frame += WAV_BLOCK_SAMPLES;
+  }
+  check("captured while streaming", stream.isCaptured()
+        && memcmp(entry->data, wavFile + 44, NUM_FRAMES * 4) == 0);
+  clips.complete(entry);
+
+  sd.resetBusyMicros();
+  entry = clips.lookup("/E1/CLIP.WAV");
+  stream.startPreroll(&entry->format, entry->data, entry->format.dataBytes);
+  int mismatches = 0;
+  frame = 0;
+  while (stream.readBlock(left, right)) {
+    for (int i = 0; i < WAV_BLOCK_SAMPLES; i++, frame++)
+      if (left[i] != fromCard[frame])
+        mismatches++;
+  }
+  clips.release(entry);
+  check("played from memory, same samples", mismatches == 0 && frame >= NUM_FRAMES);
+  Serial.print("card time playing from memory: ");
+  Serial.print(sd.getBusyMicros());
+  Serial.println(" usec");
+}
+
+void loop() {
+}
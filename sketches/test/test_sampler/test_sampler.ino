@@ -0,0 +1,40 @@
+/*----------------------------------------------------------------------
+ * Test program for the Sensors module's background sampling. The loop
+ * deliberately wastes a random amount of time (as if it were busy with
+ * audio and vibration work), and once a second prints the sampler's
+ * statistics. The sample intervals should stay steady at 1/rate no
+ * matter how long the loop takes, and there should be no overruns.
+ ----------------------------------------------------------------------*/
+
+#include "TeensyUtils.h"
+#include "Sensors.h"
+
+TeensyUtils *tu;
+Sensors *ts;
+uint32_t lastReport = 0;
+
+void setup() {
+  tu = TeensyUtils::setup();
+  ts = Sensors::setup(tu);
+  ts->setSampleRate(2000);
+}
+
+void loop() {
+  float proximity[NUM_CHANNELS];
+  int sensorStatus[NUM_CHANNELS];
+  int sensorChanged[NUM_CHANNELS];
+
+  ts->getTouchStatus(proximity, sensorStatus, sensorChanged);
+
+  delayMicroseconds(random(5000));      // simulated busy loop, 0-5 msec
+
+  if (millis() - lastReport > 1000) {
+    lastReport = millis();
+    ts->printSamplerStats();
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+      Serial.print("  ");
+      Serial.print(proximity[channel]);
+    }
+    Serial.println();
+  }
+}
@@ -0,0 +1,131 @@
+/*----------------------------------------------------------------------
+ * Checks the SensorSampler against a simulated ADC and a simulated
+ * clock (no hardware needed; it can be built on a regular computer too;
+ * test_sampler is the same thing on a Teensy, with the real timer).
+ *
+ * Ten simulated seconds: the timer fires every 500 usec (2 kHz), a few
+ * usec late at random, now and then 20 usec late (audio interrupts
+ * turned off for a moment); the loop takes 0 to 5 msec at random, and
+ * empties the ring each time round. Then:
+ *
+ *   rate        the mean interval is 1/rate
+ *   jitter      the intervals depend on the timer alone, not the loop
+ *   order       every sample comes out once, in order, with its values
+ *   overruns    none with the 5 msec loop; a 50 msec stall loses the
+ *               samples that don't fit, and counts them
+ *
+ * and prints the sampler's cost per sample and per loop. Each check
+ * prints "ok" or "FAILED".
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include "SensorSampler.h"
+
+#define RATE          2000
+#define PERIOD_USEC   (1000000 / RATE)
+#define RUN_USEC      10000000
+#define MAX_LATE_USEC 3
+#define LOCKED_USEC   20
+
+static void check(const char *what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? ": ok" : ": FAILED");
+}
+
+SimulatedSensorSource source(1023);
+SensorSampler sampler(&source);
+
+// Runs the timeline up to endMicros; the loop takes up to loopMicros
+// each time round, and stalls once for stallMicros. Returns false if a
+// sample came out of order or with the wrong values.
+static bool run(uint32_t endMicros, uint32_t loopMicros, uint32_t stallMicros, uint32_t *maxAge) {
+  uint32_t tick = 0;                        // timer periods so far
+  uint32_t loopEnd = 0;
+  uint32_t lastTime = 0;
+  bool first = true, ordered = true;
+  *maxAge = 0;
+  while (loopEnd < endMicros) {
+    uint32_t busy = random(loopMicros + 1);
+    if (stallMicros && loopEnd > endMicros / 2) {
+      busy = stallMicros;
+      stallMicros = 0;
+    }
+    loopEnd += busy;
+
+    // Timer interrupts during this time round the loop
+    while (tick * PERIOD_USEC <= loopEnd) {
+      uint32_t late = random(MAX_LATE_USEC + 1);
+      if (random(100) == 0)
+        late = LOCKED_USEC;
+      uint32_t now = tick * PERIOD_USEC + late;
+      for (int channel = 0; channel < NUM_CHANNELS; channel++)
+        source.setLevel(channel, (tick + channel) & 1023);
+      sampler.sampleNow(now);
+      tick++;
+    }
+
+    // The loop takes everything
+    uint32_t time;
+    uint16_t values[NUM_CHANNELS];
+    while (sampler.getSample(&time, values)) {
+      uint32_t t = time / PERIOD_USEC;
+      if ((!first && time <= lastTime) || values[0] != (t & 1023)
+          || values[NUM_CHANNELS - 1] != ((t + NUM_CHANNELS - 1) & 1023))
+        ordered = false;
+      if (time < loopEnd && loopEnd - time > *maxAge)
+        *maxAge = loopEnd - time;
+      lastTime = time;
+      first = false;
+    }
+  }
+  return ordered;
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+
+  uint32_t maxAge;
+  bool ordered = run(RUN_USEC, 5000, 0, &maxAge);
+  Serial.print("2 kHz, loop 0-5 msec: samples ");
+  Serial.print(sampler.getSampleCount());
+  Serial.print(", interval min/mean/max ");
+  Serial.print(sampler.getMinInterval());
+  Serial.print("/");
+  Serial.print(sampler.getMeanInterval());
+  Serial.print("/");
+  Serial.print(sampler.getMaxInterval());
+  Serial.print(" usec, oldest sample taken ");
+  Serial.print(maxAge);
+  Serial.print(" usec late, overruns ");
+  Serial.println(sampler.getOverrunCount());
+  check("rate", sampler.getMeanInterval() >= PERIOD_USEC - 1 && sampler.getMeanInterval() <= PERIOD_USEC);
+  check("jitter set by the timer, not the loop",
+        sampler.getMinInterval() >= PERIOD_USEC - LOCKED_USEC
+        && sampler.getMaxInterval() <= PERIOD_USEC + LOCKED_USEC);
+  check("every sample once, in order", ordered && sampler.getOverrunCount() == 0);
+
+  // A 50 msec stall: the ring holds 32 msec at 2 kHz
+  sampler.resetStats();
+  ordered = run(RUN_USEC, 5000, 50000, &maxAge);
+  uint32_t lost = sampler.getOverrunCount();
+  Serial.print("with one 50 msec stall: overruns ");
+  Serial.println(lost);
+  check("overruns counted after a stall", ordered && lost > 0 && lost <= 50000 / PERIOD_USEC - SAMPLER_RING_SIZE + 2);
+
+  // Cost
+  const int n = 100000;
+  uint16_t values[NUM_CHANNELS];
+  uint32_t time;
+  uint32_t start = ARM_DWT_CYCCNT;
+  for (int i = 0; i < n; i++) {
+    sampler.sampleNow(i * PERIOD_USEC);
+    sampler.getSample(&time, values);
+  }
+  uint32_t cycles = (ARM_DWT_CYCCNT - start) / n;
+  Serial.print("cycles per sample, in and out: ");
+  Serial.println(cycles);
+}
+
+void loop() {
+}
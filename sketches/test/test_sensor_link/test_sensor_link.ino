@@ -0,0 +1,75 @@
+/*----------------------------------------------------------------------
+ * Exercises the sensor boards' digital link protocol without a board: a
+ * LoopbackSerialPort plays the board, sending frames with random noise
+ * bytes in between and every tenth frame corrupted. Prints how many good
+ * frames got through (should be all of them), the CRC errors, and the
+ * CPU cycles per byte for the parser. Then shows the channel falling
+ * back to the analog reading when the "board" goes quiet.
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include "LinkSensorSource.h"
+
+#define NUM_FRAMES 10000
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+
+  SimulatedSensorSource analog(1024);
+  analog.setLevel(0, 100);
+  LinkSensorSource link(&analog);
+  LoopbackSerialPort board;
+  link.setPort(0, &board);
+
+  int sent = 0;
+  uint32_t bytes = 0;
+  uint32_t cycles = 0;
+  uint16_t values[NUM_CHANNELS];
+  for (int i = 0; i < NUM_FRAMES; i++) {
+    uint8_t noise = random(256);
+    if (random(4) == 0) {
+      board.write(&noise, 1);
+      bytes++;
+    }
+    SensorLinkFrame frame;
+    frame.sequence = i;
+    frame.boardMicros = micros();
+    frame.counts = random(SENSOR_LINK_FULL_SCALE);
+    uint8_t buffer[SENSOR_LINK_FRAME_BYTES];
+    SensorLinkParser::encode(&frame, buffer);
+    if (i % 10 == 5)
+      buffer[7] ^= 0x10;
+    else
+      sent++;
+    board.write(buffer, SENSOR_LINK_FRAME_BYTES);
+    bytes += SENSOR_LINK_FRAME_BYTES;
+    uint32_t start = ARM_DWT_CYCCNT;
+    link.poll(micros());
+    cycles += ARM_DWT_CYCCNT - start;
+  }
+  link.read(values);
+
+  SensorLinkParser *parser = link.getParser(0);
+  Serial.print("good frames sent: ");
+  Serial.print(sent);
+  Serial.print(", received: ");
+  Serial.print(parser->getFrameCount());
+  Serial.print(", CRC errors: ");
+  Serial.print(parser->getCrcErrorCount());
+  Serial.print(", cycles/byte: ");
+  Serial.println((float)cycles / bytes);
+
+  Serial.print("linked: ");
+  Serial.print(link.isLinked(0));
+  delay(SENSOR_LINK_TIMEOUT_USEC / 1000 + 10);
+  link.poll(micros());
+  link.read(values);
+  Serial.print(", after the board goes quiet: ");
+  Serial.print(link.isLinked(0));
+  Serial.print(", reading (expect 1600): ");
+  Serial.println(values[0]);
+}
+
+void loop() {
+}
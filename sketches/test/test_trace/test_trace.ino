@@ -0,0 +1,197 @@
+/*----------------------------------------------------------------------
+ * Records a sensor trace and replays it, all in memory (no SD card
+ * needed; it can be built on a regular computer too). Five seconds of
+ * four sensors at 2 kHz, with hands arriving now and then, go through a
+ * TraceWriter whose sectors are copied out a millisecond apart, as the
+ * loop would write them to the card, except for one half-second stall.
+ * A TraceReader then reads the copy back in short pieces.
+ *
+ *   round trip   every sample that wasn't dropped comes back exactly,
+ *                values and times
+ *   drops        the stall drops samples (and counts them), and the
+ *                trace carries on decodably after it
+ *   replay       the touches found by a filter and thresholds on the
+ *                replayed samples are the ones that were recorded; a
+ *                different threshold on the same trace finds none
+ *
+ * and prints the bytes per sample and the cycles per recorded sample.
+ * Each check prints "ok" or "FAILED".
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include <string.h>
+#include "SensorTrace.h"
+#include "ProximityFilter.h"
+
+#define RATE          2000
+#define PERIOD_USEC   (1000000 / RATE)
+#define NUM_SAMPLES   (5 * RATE)
+#define STALL_FROM    (2 * RATE)          // the card takes half a second here
+#define STALL_SAMPLES (RATE / 2)
+#define IDLE          200
+#define FULL          800
+#define TOUCH_EVERY   (RATE * 4 / 5)
+#define TOUCH_SAMPLES (RATE * 3 / 10)
+#define CARD_BYTES    (64 * 1024)
+
+uint16_t recorded[NUM_SAMPLES][NUM_CHANNELS];
+uint32_t recordedTime[NUM_SAMPLES];
+bool     kept[NUM_SAMPLES];
+uint8_t  card[CARD_BYTES];
+uint32_t cardBytes;
+
+// Reads the copy back, a few bytes short of what's asked for each time
+class MemoryTraceReader : public TraceReader
+{
+ public:
+  MemoryTraceReader() { _pos = 0; }
+ protected:
+  int readData(uint8_t *buffer, int size) {
+    int n = size > 100 ? 100 : size;
+    if ((uint32_t)n > cardBytes - _pos)
+      n = cardBytes - _pos;
+    memcpy(buffer, card + _pos, n);
+    _pos += n;
+    return n;
+  }
+ private:
+  uint32_t _pos;
+};
+
+static void check(const char *what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? ": ok" : ": FAILED");
+}
+
+// A hand on channel (n % NUM_CHANNELS) for TOUCH_SAMPLES of every
+// TOUCH_EVERY, over a slowly drifting, slightly noisy idle level
+static void makeSamples() {
+  for (int i = 0; i < NUM_SAMPLES; i++) {
+    recordedTime[i] = 1000000 + i * PERIOD_USEC + random(4);
+    int n = i / TOUCH_EVERY;
+    int t = i % TOUCH_EVERY;
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+      int v = IDLE + i / 500 + random(5) - 2;
+      if (channel == n % NUM_CHANNELS && t >= TOUCH_EVERY / 2 && t < TOUCH_EVERY / 2 + TOUCH_SAMPLES)
+        v = FULL + random(5) - 2;
+      recorded[i][channel] = v;
+    }
+  }
+}
+
+static void copySector(TraceWriter *writer) {
+  const uint8_t *sector = writer->getSector();
+  if (sector && cardBytes + TRACE_SECTOR_SIZE <= CARD_BYTES) {
+    memcpy(card + cardBytes, sector, TRACE_SECTOR_SIZE);
+    cardBytes += TRACE_SECTOR_SIZE;
+    writer->releaseSector();
+  }
+}
+
+// How many touches a filter and thresholds find
+static int countTouches(const uint16_t samples[][NUM_CHANNELS], int numSamples, int touchLevel, int releaseLevel) {
+  ProximityFilter filter[NUM_CHANNELS];
+  bool touched[NUM_CHANNELS] = {false};
+  int touches = 0;
+  for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+    filter[channel].configure(emaFilter, 16, 1023);
+    filter[channel].reset(samples[0][channel]);
+  }
+  for (int i = 0; i < numSamples; i++) {
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+      int32_t value = filter[channel].filter(samples[i][channel]) >> 16;
+      if (!touched[channel] && value >= touchLevel) {
+        touched[channel] = true;
+        touches++;
+      } else if (touched[channel] && value < releaseLevel) {
+        touched[channel] = false;
+      }
+    }
+  }
+  return touches;
+}
+
+uint16_t replayed[NUM_SAMPLES][NUM_CHANNELS];
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+  makeSamples();
+
+  // Record, copying out a sector every other sample (every millisecond)
+  TraceWriter writer;
+  writer.begin(1023, RATE);
+  for (int i = 0; i < NUM_SAMPLES; i++) {
+    kept[i] = writer.addSample(recordedTime[i], recorded[i]);
+    bool stalled = i >= STALL_FROM && i < STALL_FROM + STALL_SAMPLES;
+    if (!stalled && (i & 1))
+      copySector(&writer);
+  }
+  while (writer.getSector())
+    copySector(&writer);
+  int tailBytes;
+  const uint8_t *tail = writer.getTail(&tailBytes);
+  memcpy(card + cardBytes, tail, tailBytes);
+  cardBytes += tailBytes;
+
+  uint32_t drops = writer.getDropCount();
+  Serial.print("recorded ");
+  Serial.print(writer.getSampleCount());
+  Serial.print(" samples in ");
+  Serial.print(cardBytes);
+  Serial.print(" bytes (");
+  Serial.print((float)(cardBytes - TRACE_HEADER_SIZE) / writer.getSampleCount(), 2);
+  Serial.print(" per sample), dropped ");
+  Serial.println(drops);
+  check("stall drops samples, and counts them", drops > 0 && drops < STALL_SAMPLES
+        && writer.getSampleCount() + drops == NUM_SAMPLES);
+
+  // Read back
+  MemoryTraceReader reader;
+  bool header = reader.begin() && reader.getNumChannels() == NUM_CHANNELS
+                && reader.getFullScale() == 1023 && reader.getSampleRate() == RATE;
+  check("header", header);
+  bool same = true;
+  int numReplayed = 0;
+  uint32_t time;
+  for (int i = 0; i < NUM_SAMPLES; i++) {
+    if (!kept[i])
+      continue;
+    if (!reader.next(&time, replayed[numReplayed])) {
+      same = false;
+      break;
+    }
+    if (time != recordedTime[i] - recordedTime[0]
+        || memcmp(replayed[numReplayed], recorded[i], sizeof(recorded[i])) != 0)
+      same = false;
+    numReplayed++;
+  }
+  check("every kept sample back exactly, after the drops too", same && !reader.next(&time, replayed[0]));
+
+  // Replayed with the same settings it finds what happened; with others,
+  // what they would have found
+  int live = countTouches(recorded, NUM_SAMPLES, 500, 300);
+  int replay = countTouches(replayed, numReplayed, 500, 300);
+  int high = countTouches(replayed, numReplayed, 900, 850);
+  Serial.print("touches: live ");
+  Serial.print(live);
+  Serial.print(", replayed ");
+  Serial.print(replay);
+  Serial.print(", replayed with the threshold above the hand ");
+  Serial.println(high);
+  check("replay finds the recorded touches", live == NUM_SAMPLES / TOUCH_EVERY && replay == live && high == 0);
+
+  // Cost of recording
+  writer.begin(1023, RATE);
+  uint32_t start = ARM_DWT_CYCCNT;
+  for (int i = 0; i < NUM_SAMPLES; i++) {
+    writer.addSample(recordedTime[i], recorded[i]);
+    if (writer.getSector())
+      writer.releaseSector();
+  }
+  Serial.print("cycles per recorded sample: ");
+  Serial.println((ARM_DWT_CYCCNT - start) / NUM_SAMPLES);
+}
+
+void loop() {
+}
@@ -0,0 +1,185 @@
+/*----------------------------------------------------------------------
+ * Checks the TrackSelector's choices (no hardware needed; it can be
+ * built on a regular computer too):
+ *
+ *   shuffle     each pass plays every track once; all 24 orders of 4
+ *               tracks are equally likely; a reshuffled pass never
+ *               starts with the track that ended the last one
+ *   random      no track again within the no-repeat window, and all
+ *               tracks equally often
+ *   weighted    tracks chosen in proportion to their weights
+ *   state       saved and loaded, the choices carry on identically
+ *
+ * "Equally likely" is a chi-square test against the expected counts,
+ * at a level that a fair selector fails once in a thousand runs. Each
+ * check prints "ok" or "FAILED".
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include "TrackSelector.h"
+
+#define NUM_TRIALS 48000
+
+static void check(const char *what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? ": ok" : ": FAILED");
+}
+
+static float chiSquare(const uint32_t *counts, const float *expected, int n) {
+  float sum = 0;
+  for (int i = 0; i < n; i++) {
+    float d = counts[i] - expected[i];
+    sum += d * d / expected[i];
+  }
+  return sum;
+}
+
+// Lehmer code of a permutation of 4: 0..23
+static int permutationIndex(const int *p) {
+  int index = 0;
+  for (int i = 0; i < 4; i++) {
+    int smaller = 0;
+    for (int j = i + 1; j < 4; j++)
+      if (p[j] < p[i])
+        smaller++;
+    index = index * (4 - i) + smaller;
+  }
+  return index;
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+  TrackSelector selector;
+  selector.setSeed(12345);
+
+  // Shuffle: the first pass from scratch, many times
+  uint32_t counts[TRACK_SELECTOR_MAX_TRACKS];
+  float expected[TRACK_SELECTOR_MAX_TRACKS];
+  memset(counts, 0, sizeof(counts));
+  for (int trial = 0; trial < NUM_TRIALS; trial++) {
+    int p[4];
+    selector.setTracks(4);
+    for (int i = 0; i < 4; i++)
+      p[i] = selector.nextShuffled(true);
+    counts[permutationIndex(p)]++;
+  }
+  for (int i = 0; i < 24; i++)
+    expected[i] = NUM_TRIALS / 24.0;
+  float chi = chiSquare(counts, expected, 24);
+  Serial.print("shuffle orders, chi-square (23 df): ");
+  Serial.println(chi, 1);
+  check("shuffle orders equally likely", chi < 49.7);
+
+  // Passes: each a permutation, no repeat across the seam
+  selector.setTracks(7);
+  int last = -1;
+  bool allOnce = true, seamRepeats = false;
+  for (int pass = 0; pass < 1000; pass++) {
+    bool seen[7] = {false};
+    for (int i = 0; i < 7; i++) {
+      int t = selector.nextShuffled(true);
+      if (seen[t])
+        allOnce = false;
+      seen[t] = true;
+      if (i == 0 && t == last)
+        seamRepeats = true;
+      last = t;
+    }
+  }
+  check("reshuffled passes: every track once, no repeat at the seam", allOnce && !seamRepeats);
+  int first[7];
+  for (int i = 0; i < 7; i++)
+    first[i] = selector.nextShuffled(false);
+  bool same = true;
+  for (int pass = 0; pass < 10; pass++)
+    for (int i = 0; i < 7; i++)
+      if (selector.nextShuffled(false) != first[i])
+        same = false;
+  check("shuffled without reshuffle: the same order every pass", same);
+
+  // Random with a no-repeat window
+  const int n = 10, window = 3;
+  selector.setTracks(n);
+  selector.setNoRepeat(window);
+  int recent[window];
+  for (int i = 0; i < window; i++)
+    recent[i] = -1;
+  bool repeats = false;
+  memset(counts, 0, sizeof(counts));
+  for (int trial = 0; trial < NUM_TRIALS; trial++) {
+    int t = selector.nextRandom();
+    for (int i = 0; i < window; i++)
+      if (recent[i] == t)
+        repeats = true;
+    recent[trial % window] = t;
+    counts[t]++;
+  }
+  for (int i = 0; i < n; i++)
+    expected[i] = (float)NUM_TRIALS / n;
+  chi = chiSquare(counts, expected, n);
+  Serial.print("random, no repeat within 3, chi-square (9 df): ");
+  Serial.println(chi, 1);
+  check("random: no repeats in the window", !repeats);
+  check("random: all tracks equally often", chi < 27.9);
+
+  // Weighted
+  uint16_t weights[4] = {1, 2, 3, 4};
+  selector.setTracks(4);
+  selector.setNoRepeat(0);
+  selector.setWeights(weights);
+  memset(counts, 0, sizeof(counts));
+  for (int trial = 0; trial < NUM_TRIALS; trial++)
+    counts[selector.nextRandom()]++;
+  for (int i = 0; i < 4; i++)
+    expected[i] = NUM_TRIALS * weights[i] / 10.0;
+  chi = chiSquare(counts, expected, 4);
+  Serial.print("weighted 1:2:3:4, counts:");
+  for (int i = 0; i < 4; i++) {
+    Serial.print(" ");
+    Serial.print(counts[i]);
+  }
+  Serial.print(", chi-square (3 df): ");
+  Serial.println(chi, 1);
+  check("weighted: in proportion", chi < 16.3);
+
+  // State: halfway through a pass, with a history
+  TrackSelector a, b;
+  a.setSeed(99);
+  a.setTracks(12);
+  a.setNoRepeat(4);
+  b.setTracks(12);
+  b.setNoRepeat(4);
+  for (int i = 0; i < 17; i++) {
+    a.nextShuffled(true);
+    a.nextRandom();
+  }
+  char text[TRACK_SELECTOR_STATE_CHARS];
+  bool saved = a.saveState(text, sizeof(text)) > 0;
+  bool loaded = b.loadState(text);
+  bool identical = true;
+  for (int i = 0; i < 100; i++) {
+    if (a.nextShuffled(true) != b.nextShuffled(true) || a.nextRandom() != b.nextRandom())
+      identical = false;
+  }
+  TrackSelector other;
+  other.setTracks(11);
+  check("state saved and loaded: the same choices after", saved && loaded && identical
+        && !other.loadState(text));
+
+  bool fits = true;
+  for (int noRepeat = 0; noRepeat <= TRACK_SELECTOR_MAX_TRACKS; noRepeat += TRACK_SELECTOR_MAX_TRACKS) {
+    TrackSelector most;
+    most.setTracks(TRACK_SELECTOR_MAX_TRACKS);
+    most.setNoRepeat(noRepeat);
+    for (int i = 0; i < 1000; i++) {
+      most.nextShuffled(true);
+      most.nextRandom();
+    }
+    fits = fits && most.saveState(text, sizeof(text)) > 0;
+  }
+  check("state of the most tracks fits", fits);
+}
+
+void loop() {
+}
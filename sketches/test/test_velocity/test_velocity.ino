@@ -0,0 +1,135 @@
+/*----------------------------------------------------------------------
+ * Checks the VelocityEstimator on synthetic approaches (no hardware
+ * needed; it can be built on a regular computer too). Each trace idles
+ * at 100 counts with a little noise, then ramps up to 900 and stays
+ * there, like a hand arriving at a sensor.
+ *
+ *   ramps       the peak slope is the ramp's slope (for ramps at least a
+ *               window long), and faster ramps give higher peaks
+ *   noise       idling alone gives only a small peak
+ *   spike       a one-sample spike before a slow approach doesn't set
+ *               its velocity
+ *   turned away a fast approach that stops halfway and goes back doesn't
+ *               set the velocity of the slow one after it
+ *   holds       a real touch keeps its peak while the hand stays
+ *
+ * and prints the cycles per update. Each check prints "ok" or "FAILED".
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include <math.h>
+#include "VelocityEstimator.h"
+
+#define IDLE   100
+#define TOP    900
+#define NOISE  3                          // +/- counts
+
+static void check(const char *what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? ": ok" : ": FAILED");
+}
+
+static uint16_t noisy(float level) {
+  return (uint16_t)lrint(level) + random(2 * NOISE + 1) - NOISE;
+}
+
+static void idle(VelocityEstimator *v, int samples) {
+  for (int i = 0; i < samples; i++)
+    v->update(noisy(IDLE));
+}
+
+// From level to TOP at this many counts per sample, then held there
+static void ramp(VelocityEstimator *v, float from, float countsPerSample, int holdSamples) {
+  for (float level = from; level < TOP; level += countsPerSample)
+    v->update(noisy(level));
+  for (int i = 0; i < holdSamples; i++)
+    v->update(noisy(TOP));
+}
+
+static float peak(VelocityEstimator *v) {
+  return (float)v->getPeakSlope() / 65536.0;
+}
+
+void setup() {
+  Serial.begin(57600);
+  delay(2000);
+  VelocityEstimator v;
+
+  // Ramps from 2 counts/sample (0.4 sec to the top at 2 kHz) to 100
+  const float speeds[] = {2, 5, 10, 25, 50, 100};
+  bool close = true, ordered = true;
+  float last = 0;
+  for (int i = 0; i < 6; i++) {
+    v.reset(IDLE);
+    idle(&v, 100);
+    ramp(&v, IDLE, speeds[i], 200);
+    float p = peak(&v);
+    Serial.print("ramp of ");
+    Serial.print(speeds[i], 0);
+    Serial.print(" counts/sample: peak ");
+    Serial.println(p, 2);
+    // A ramp shorter than the window is spread over it, so it reads lower
+    if (speeds[i] * VELOCITY_WINDOW <= TOP - IDLE && fabs(p - speeds[i]) > 0.1 * speeds[i] + 0.3)
+      close = false;
+    if (p <= last)
+      ordered = false;
+    last = p;
+  }
+  check("peak is the ramp's slope", close);
+  check("faster ramps give higher peaks", ordered);
+
+  v.reset(IDLE);
+  idle(&v, 4000);
+  float idlePeak = peak(&v);
+  v.reset(IDLE);
+  idle(&v, 100);
+  ramp(&v, IDLE, 2, 200);
+  float slowPeak = peak(&v);
+  check("idle noise gives a small peak", idlePeak < slowPeak / 4);
+
+  // A spike, then a slow approach
+  v.reset(IDLE);
+  idle(&v, 100);
+  v.update(IDLE + 600);
+  idle(&v, 100);
+  ramp(&v, IDLE, 2, 200);
+  Serial.print("slow approach after a spike: peak ");
+  Serial.print(peak(&v), 2);
+  Serial.print(" (alone ");
+  Serial.print(slowPeak, 2);
+  Serial.println(")");
+  check("spike forgotten", fabs(peak(&v) - slowPeak) < 0.5);
+
+  // Fast halfway up, back down, then a slow approach
+  v.reset(IDLE);
+  idle(&v, 100);
+  for (float level = IDLE; level < 500; level += 50)
+    v.update(noisy(level));
+  for (int i = 0; i < 50; i++)
+    v.update(noisy(500));
+  for (float level = 500; level > IDLE; level -= 10)
+    v.update(noisy(level));
+  idle(&v, 100);
+  ramp(&v, IDLE, 2, 200);
+  Serial.print("slow approach after one that turned away: peak ");
+  Serial.println(peak(&v), 2);
+  check("turned-away approach forgotten", fabs(peak(&v) - slowPeak) < 0.5);
+
+  // A fast touch, held for two seconds
+  v.reset(IDLE);
+  idle(&v, 100);
+  ramp(&v, IDLE, 50, VELOCITY_WINDOW);
+  float touchPeak = peak(&v);
+  for (int i = 0; i < 4000; i++)
+    v.update(noisy(TOP));
+  check("peak held while touched", peak(&v) == touchPeak && touchPeak > 10 * slowPeak);
+
+  uint32_t start = ARM_DWT_CYCCNT;
+  for (int i = 0; i < 1000000; i++)
+    v.update(IDLE + (i & 63));
+  Serial.print("cycles per update: ");
+  Serial.println((ARM_DWT_CYCCNT - start) / 1000000);
+}
+
+void loop() {
+}
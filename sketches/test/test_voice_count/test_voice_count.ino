@@ -0,0 +1,67 @@
+/*----------------------------------------------------------------------
+ * Benchmark: how many voices can play at once. With layering on,
+ * channel 1's track is started again every few seconds, each time on
+ * one more voice, and for each count this prints the audio library's
+ * worst CPU usage over that time. That includes the SD card reads,
+ * which the players do in the audio interrupt, so it's the card's
+ * bandwidth as much as the CPU that sets the limit. The most voices
+ * that stayed under MAX_USAGE percent is the answer for this card and
+ * these tracks.
+ *
+ * The pool keeps one voice in reserve (see VoicePool.h), so this goes
+ * up to NUM_VOICES-1. Use a track that's longer than
+ * NUM_VOICES * SETTLE_MSEC, and build with a larger NUM_VOICES to find
+ * the real limit.
+ ----------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include "TeensyUtils.h"
+#include "AudioPlayer.h"
+
+#define SETTLE_MSEC 3000
+#define MAX_USAGE   90.0
+
+TeensyUtils *tu;
+AudioPlayer *ta;
+
+void setup() {
+  setLogLevel(0);
+  tu = TeensyUtils::setup();
+  ta = AudioPlayer::setup(tu);
+  ta->setLayering(0, true);
+  ta->setVolume(0, 100 / NUM_VOICES);
+  VoicePool *pool = ta->getVoicePool();
+
+  int sustained = 0;
+  for (int voices = 1; voices < NUM_VOICES; voices++) {
+    ta->startTrack(0);
+    delay(100);                            // opening the file isn't part of it
+    AudioProcessorUsageMaxReset();
+    uint32_t start = millis();
+    while (millis() - start < SETTLE_MSEC) {
+      ta->doTimerTasks();
+      delay(10);
+    }
+    float usage = AudioProcessorUsageMax();
+
+    Serial.print("voices: ");
+    Serial.print(voices);
+    Serial.print(", CPU max: ");
+    Serial.print(usage);
+    Serial.print("%, audio blocks max: ");
+    Serial.println(AudioMemoryUsageMax());
+    if (pool->getNumInUse() < voices) {
+      Serial.println("A voice ended early: use a longer track.");
+      break;
+    }
+    if (usage > MAX_USAGE)
+      break;
+    sustained = voices;
+  }
+  ta->cancelAll();
+  Serial.print("Most voices sustained: ");
+  Serial.println(sustained);
+}
+
+void loop() {
+}